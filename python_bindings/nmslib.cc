@@ -18,14 +18,24 @@
 #include <pybind11/stl.h>
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 #include "init.h"
 #include "index.h"
+#include "object.h"
+#include "utils.h"
 #include "knnquery.h"
 #include "knnqueue.h"
 #include "methodfactory.h"
@@ -34,6 +44,7 @@
 #include "spacefactory.h"
 #include "space/space_sparse_vector.h"
 #include "space/space_l2sqr_sift.h"
+#include "space/space_bit_vector.h"
 #include "thread_pool.h"
 
 #include "cpu_feature_guard.h"
@@ -56,6 +67,7 @@ enum DataType {
   DATATYPE_DENSE_UINT8_VECTOR,
   DATATYPE_SPARSE_VECTOR,
   DATATYPE_OBJECT_AS_STRING,
+  DATATYPE_BIT_VECTOR,
 };
 
 // forward references
@@ -65,6 +77,250 @@ AnyParams loadParams(py::object o);
 void exportLegacyAPI(py::module * m);
 void freeAndClearObjectVector(ObjectVector& data);
 
+// Contiguous chunks of memory shared by many objects
+typedef std::vector<std::unique_ptr<char[]>> ObjectArenas;
+
+// The maximum number of asynchronous queries executed as a single batch
+const size_t async_max_batch_qty = 256;
+
+// pybind11::gil_scoped_acquire can deadlock when acquiring the GIL on threads
+// created from python (https://github.com/nmslib/nmslib/issues/291)
+// This might be fixed in a future version of pybind11 (https://github.com/pybind/pybind11/pull/1211)
+// but until then, lets fall back to the python c-api to fix.
+struct AcquireGIL {
+  PyGILState_STATE state;
+  AcquireGIL()
+    : state(PyGILState_Ensure()) {
+  }
+  ~AcquireGIL() {
+    PyGILState_Release(state);
+  }
+};
+
+template <typename dist_t>
+py::object convertKnnResult(KNNQueue<dist_t> * res) {
+  // Create numpy arrays for the output
+  size_t size = res->Size();
+  py::array_t<int> ids(size);
+  py::array_t<dist_t> distances(size);
+
+  while (!res->Empty() && size > 0) {
+    // iterating here in reversed order, undo that
+    size -= 1;
+    ids.mutable_at(size) = res->TopObject()->id();
+    distances.mutable_at(size) = res->TopDistance();
+    res->Pop();
+  }
+  return py::make_tuple(ids, distances);
+}
+
+/*
+ * The shared state of an asynchronous k-NN query. It is completed by a worker
+ * thread that doesn't hold the GIL: the GIL is needed only to run done-callbacks
+ * (if there are any) and to convert the result to numpy arrays.
+ */
+template <typename dist_t>
+struct AsyncKnnState {
+  AsyncKnnState(const Object * query, size_t k) : query(query), k(k), done(false) {}
+
+  std::unique_ptr<const Object> query;
+  size_t k;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool done;
+  std::unique_ptr<KNNQueue<dist_t>> result;
+  // an error message, empty if the search succeeded
+  std::string error;
+  // callbacks are copied/released only while holding the GIL
+  std::vector<py::object> callbacks;
+};
+
+/*
+ * A future returned by knnQueryAsync. It mimics the interface of concurrent.futures.Future,
+ * so it can be polled (done), waited for (result) or used to notify
+ * an asyncio loop (add_done_callback + loop.call_soon_threadsafe).
+ */
+template <typename dist_t>
+struct KnnFuture {
+  explicit KnnFuture(std::shared_ptr<AsyncKnnState<dist_t>> state) : state(state) {}
+
+  bool done() const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->done;
+  }
+
+  py::object result(py::object timeout) {
+    wait(timeout);
+    std::unique_ptr<KNNQueue<dist_t>> res;
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->error.empty()) throw std::runtime_error(state->error);
+      // the result can be requested more than once
+      res.reset(state->result->Clone());
+    }
+    return convertKnnResult(res.get());
+  }
+
+  // Returns the exception raised by the query (as a RuntimeError) or None if the query succeeded
+  py::object exception(py::object timeout) {
+    wait(timeout);
+    std::string error;
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      error = state->error;
+    }
+    if (error.empty()) return py::none();
+    return py::reinterpret_borrow<py::object>(PyExc_RuntimeError)(error);
+  }
+
+  void addDoneCallback(py::object fn) {
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (!state->done) {
+        state->callbacks.push_back(fn);
+        return;
+      }
+    }
+    callDoneCallback(fn, py::cast(*this));
+  }
+
+  // Called by a worker thread (without holding the GIL) when the search finishes
+  static void complete(const std::shared_ptr<AsyncKnnState<dist_t>> & state,
+                       std::unique_ptr<KNNQueue<dist_t>> result, const std::string & error) {
+    std::vector<py::object> callbacks;
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->result = std::move(result);
+      state->error = error;
+      state->done = true;
+      callbacks.swap(state->callbacks);
+    }
+    state->cv.notify_all();
+
+    if (!callbacks.empty()) {
+      AcquireGIL l;
+      // nothing may escape into the worker thread
+      try {
+        py::object future = py::cast(KnnFuture<dist_t>(state));
+        for (auto & fn : callbacks) {
+          callDoneCallback(fn, future);
+        }
+      } catch (const std::exception & e) {
+        LOG(LIB_ERROR) << "Failed to invoke done callbacks: " << e.what();
+      } catch (...) {
+        LOG(LIB_ERROR) << "Failed to invoke done callbacks: unknown exception";
+      }
+      callbacks.clear();
+    }
+  }
+
+  std::shared_ptr<AsyncKnnState<dist_t>> state;
+
+ private:
+  // Waits for the query to finish, raises TimeoutError if it doesn't finish in time
+  void wait(py::object timeout) {
+    const bool waitForever = timeout.is_none();
+    const double seconds = waitForever ? 0 : py::cast<double>(timeout);
+    bool finished;
+    {
+      py::gil_scoped_release l;
+      std::unique_lock<std::mutex> lock(state->mutex);
+      if (waitForever) {
+        state->cv.wait(lock, [this] { return state->done; });
+      } else {
+        state->cv.wait_for(lock, std::chrono::duration<double>(seconds), [this] { return state->done; });
+      }
+      finished = state->done;
+    }
+    if (!finished) {
+      PyErr_SetString(PyExc_TimeoutError, "The query didn't finish in time");
+      throw py::error_already_set();
+    }
+  }
+
+  // like concurrent.futures, don't let a failing callback affect others (must be called with the GIL)
+  static void callDoneCallback(const py::object & fn, const py::object & future) {
+    try {
+      fn(future);
+    } catch (const py::error_already_set & e) {
+      LOG(LIB_ERROR) << "Exception in a done callback: " << e.what();
+    } catch (const std::exception & e) {
+      LOG(LIB_ERROR) << "Exception in a done callback: " << e.what();
+    } catch (...) {
+      LOG(LIB_ERROR) << "Unknown exception in a done callback";
+    }
+  }
+};
+
+/*
+ * Executes asynchronous k-NN queries in a background thread. Queries submitted
+ * while the previous batch is being processed are accumulated and then executed
+ * as the next batch (using the global thread pool). Thus, queries arriving from
+ * many callers are micro-batched without an extra delay.
+ */
+template <typename dist_t>
+class AsyncKnnDispatcher {
+ public:
+  AsyncKnnDispatcher(const Space<dist_t> & space, const Index<dist_t> & index)
+      : space_(space), index_(index), stop_(false),
+        thread_(&AsyncKnnDispatcher::run, this) {}
+
+  // Finishes all submitted queries, must be called without holding the GIL
+  ~AsyncKnnDispatcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void submit(const std::shared_ptr<AsyncKnnState<dist_t>> & state) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(state);
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void run() {
+    std::vector<std::shared_ptr<AsyncKnnState<dist_t>>> batch;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) return;
+        size_t qty = std::min(pending_.size(), async_max_batch_qty);
+        batch.assign(pending_.begin(), pending_.begin() + qty);
+        pending_.erase(pending_.begin(), pending_.begin() + qty);
+      }
+      ParallelFor(0, batch.size(), 0, [&](size_t i, size_t threadId) {
+        std::unique_ptr<KNNQueue<dist_t>> result;
+        std::string error;
+        try {
+          KNNQuery<dist_t> knn(space_, batch[i]->query.get(), batch[i]->k);
+          index_.Search(&knn, -1);
+          result.reset(knn.Result()->Clone());
+        } catch (const std::exception & e) {
+          error = e.what();
+          if (error.empty()) error = "Unknown error";
+        }
+        KnnFuture<dist_t>::complete(batch[i], std::move(result), error);
+      });
+      batch.clear();
+    }
+  }
+
+  const Space<dist_t> & space_;
+  const Index<dist_t> & index_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::shared_ptr<AsyncKnnState<dist_t>>> pending_;
+  bool stop_;
+  std::thread thread_;
+};
+
 // Wrap a space/objectvector/index together for ease of use
 template <typename dist_t, typename dist_uint_t = dist_t>
 struct IndexWrapper {
@@ -87,12 +343,19 @@ struct IndexWrapper {
       throw std::invalid_argument("The space type " + space_type +
                                   " is not compatible with the type DENSE_UINT8_VECTOR!");
     }
+    auto bitSpacePtr = dynamic_cast<SpaceBitVector<dist_t, uint64_t>*>(space.get());
+    if (data_type == DATATYPE_BIT_VECTOR && bitSpacePtr == nullptr) {
+      throw std::invalid_argument("The space type " + space_type +
+                                  " is not compatible with the type BIT_VECTOR, only bit vector spaces are allowed!");
+    }
   }
 
   void createIndex(py::object index_params, bool print_progress = false) {
     AnyParams params = loadParams(index_params);
 
     py::gil_scoped_release l;
+    // pending asynchronous queries must finish before the index is replaced
+    async_dispatcher.reset();
     auto factory = MethodFactoryRegistry<dist_t>::Instance();
     index.reset(factory.CreateMethod(print_progress, method, space_type, *space, data));
     index->CreateIndex(params);
@@ -100,12 +363,13 @@ struct IndexWrapper {
 
   void loadIndex(const std::string & filename, bool load_data = false) {
     py::gil_scoped_release l;
+    async_dispatcher.reset();
     auto factory = MethodFactoryRegistry<dist_t>::Instance();
     bool print_progress=false; // We are not going to creat the index anyways, only to load an existing one
     index.reset(factory.CreateMethod(print_progress, method, space_type, *space, data));
     if (load_data) {
       vector<string> dummy;
-      freeAndClearObjectVector(data);
+      clearData();
       space->ReadObjectVectorFromBinData(data, dummy, filename + data_suff);
     }
     index->LoadIndex(filename);
@@ -148,7 +412,8 @@ struct IndexWrapper {
     }
 
     ObjectVector queries;
-    readObjectVector(input, &queries);
+    ObjectArenas queryArenas;
+    readObjectVector(input, &queries, py::none(), &queryArenas);
     std::vector<std::unique_ptr<KNNQueue<dist_t>>> results(queries.size());
     {
       py::gil_scoped_release l;
@@ -170,22 +435,78 @@ struct IndexWrapper {
     return ret;
   }
 
-  py::object convertResult(KNNQueue<dist_t> * res) {
-    // Create numpy arrays for the output
-    size_t size = res->Size();
-    py::array_t<int> ids(size);
-    py::array_t<dist_t> distances(size);
-
-    while (!res->Empty() && size > 0) {
-      // iterating here in reversed order, undo that
-      size -= 1;
-      ids.mutable_at(size) = res->TopObject()->id();
-      distances.mutable_at(size) = res->TopDistance();
-      res->Pop();
+  /*
+   * Submits a query for an asynchronous execution and returns immediately.
+   * Queries are executed by a background thread in micro-batches.
+   */
+  KnnFuture<dist_t> knnQueryAsync(py::object input, size_t k) {
+    if (!index) {
+      throw std::invalid_argument("Must call createIndex or loadIndex before this method");
+    }
+
+    auto state = std::make_shared<AsyncKnnState<dist_t>>(readObject(input), k);
+    if (!async_dispatcher) {
+      async_dispatcher.reset(new AsyncKnnDispatcher<dist_t>(*space, *index));
     }
+    async_dispatcher->submit(state);
+    return KnnFuture<dist_t>(state);
+  }
+
+  /*
+   * Unlike knnQueryBatch, which returns a list of per-query tuples, this function
+   * returns two (n, k) matrices of ids and distances. The matrices are allocated
+   * in advance and are filled directly by worker threads (without holding the GIL).
+   * If fewer than k neighbors are found, a row is padded with ids equal to -1
+   * and with the maximum possible distance.
+   */
+  py::object knnQueryBatchPacked(py::object input, size_t k, int num_threads) {
+    if (!index) {
+      throw std::invalid_argument("Must call createIndex or loadIndex before this method");
+    }
+
+    ObjectVector queries;
+    ObjectArenas queryArenas;
+    readObjectVector(input, &queries, py::none(), &queryArenas);
+
+    const size_t qty = queries.size();
+    py::array_t<int> ids({qty, k});
+    py::array_t<dist_t> distances({qty, k});
+    int* pIds = ids.mutable_data();
+    dist_t* pDists = distances.mutable_data();
+    {
+      py::gil_scoped_release l;
+
+      ParallelFor(0, qty, num_threads, [&](size_t query_index, size_t threadId) {
+        KNNQuery<dist_t> knn(*space, queries[query_index], k);
+        index->Search(&knn, -1);
+        std::unique_ptr<KNNQueue<dist_t>> res(knn.Result()->Clone());
+
+        int* pRowIds = pIds + query_index * k;
+        dist_t* pRowDists = pDists + query_index * k;
+        size_t size = std::min(k, static_cast<size_t>(res->Size()));
+        for (size_t i = size; i < k; ++i) {
+          pRowIds[i] = -1;
+          pRowDists[i] = DistMax<dist_t>();
+        }
+        // the queue returns the farthest neighbors first
+        while (!res->Empty() && size > 0) {
+          size -= 1;
+          pRowIds[size] = res->TopObject()->id();
+          pRowDists[size] = res->TopDistance();
+          res->Pop();
+        }
+      });
+
+      freeAndClearObjectVector(queries);
+    }
+
     return py::make_tuple(ids, distances);
   }
 
+  py::object convertResult(KNNQueue<dist_t> * res) {
+    return convertKnnResult(res);
+  }
+
   const Object * readObject(py::object input, int id = 0) {
     switch (data_type) {
       case DATATYPE_DENSE_VECTOR: {
@@ -202,6 +523,12 @@ struct IndexWrapper {
         auto vectSiftPtr = reinterpret_cast<SpaceL2SqrSift*>(space.get());
         return vectSiftPtr->CreateObjFromUint8Vect(id, -1, tempVect);
       }
+      case DATATYPE_BIT_VECTOR: {
+        // Bits are expected to be packed into bytes, e.g., by numpy.packbits(..., bitorder='little')
+        py::array_t<uint8_t, py::array::c_style | py::array::forcecast> temp(input);
+        auto bitSpacePtr = reinterpret_cast<SpaceBitVector<dist_t, uint64_t>*>(space.get());
+        return bitSpacePtr->CreateObjFromPackedBits(id, -1, temp.data(0), temp.size());
+      }
       case DATATYPE_OBJECT_AS_STRING: {
         std::string temp = py::cast<std::string>(input);
         return space->CreateObjFromStr(id, -1, temp.c_str(), NULL).release();
@@ -224,10 +551,61 @@ struct IndexWrapper {
     }
   }
 
+  /*
+   * Creates objects for rows of a dense matrix. The objects don't own their memory:
+   * all of them reside in one contiguous arena, which is added to arenas.
+   * Objects are filled in parallel straight from the (numpy) buffer.
+   * If pIds is NULL, the ids are firstId, firstId + 1, ...
+   * Must be called without holding the GIL.
+   */
+  template <typename elem_t>
+  void createDenseObjects(const elem_t* pData, size_t rows, size_t features, const int* pIds,
+                          ObjectVector* output, ObjectArenas* arenas, IdType firstId = 0) {
+    const size_t dataLen = features * sizeof(elem_t);
+    // Each object is 8-byte aligned (see object.h)
+    const size_t objLen = (ID_SIZE + LABEL_SIZE + DATALENGTH_SIZE + dataLen + 7) / 8 * 8;
+    std::unique_ptr<char[]> arena(new char[rows * objLen]);
+    char* pArena = arena.get();
+
+    const size_t start = output->size();
+    output->resize(start + rows);
+    const size_t chunkSize = 1024;
+    const size_t chunkQty = (rows + chunkSize - 1) / chunkSize;
+
+    ParallelFor(0, chunkQty, 0, [&](size_t chunkId, size_t threadId) {
+      const size_t rowEnd = std::min(rows, (chunkId + 1) * chunkSize);
+      for (size_t row = chunkId * chunkSize; row < rowEnd; ++row) {
+        char* p = pArena + row * objLen;
+        const IdType id = pIds != nullptr ? pIds[row] : firstId + static_cast<IdType>(row);
+        const LabelType label = -1;
+        memcpy(p, &id, ID_SIZE);
+        memcpy(p + ID_SIZE, &label, LABEL_SIZE);
+        memcpy(p + ID_SIZE + LABEL_SIZE, &dataLen, DATALENGTH_SIZE);
+        memcpy(p + ID_SIZE + LABEL_SIZE + DATALENGTH_SIZE, pData + row * features, dataLen);
+        (*output)[start + row] = new Object(p);
+      }
+    });
+    arenas->push_back(std::move(arena));
+  }
+
+  /*
+   * Some vector spaces transform the input (e.g., they pack bits or precompute logarithms).
+   * Objects of such spaces can't be created by copying matrix rows, which we detect by
+   * comparing a space-created object with a raw copy of the first row.
+   */
+  bool isPlainDenseObject(const VectorSpace<dist_t, dist_uint_t>* vectSpacePtr,
+                          const dist_uint_t* pRow, size_t features) {
+    std::vector<dist_uint_t> tempVect(pRow, pRow + features);
+    std::unique_ptr<Object> obj(vectSpacePtr->CreateObjFromVect(0, -1, tempVect));
+    return obj->datalength() == features * sizeof(dist_uint_t) &&
+           memcmp(obj->data(), pRow, obj->datalength()) == 0;
+  }
+
   // reads multiple items from a python object and inserts onto a similarity::ObjectVector
-  // returns the number of elements inserted
+  // returns the number of elements inserted. If arenas isn't NULL, dense vectors
+  // are stored in a contiguous arena, which is added to arenas
   size_t readObjectVector(py::object input, ObjectVector * output,
-                          py::object ids_ = py::none()) {
+                          py::object ids_ = py::none(), ObjectArenas * arenas = nullptr) {
     std::vector<int> ids;
     if (!ids_.is_none()) {
       ids = py::cast<std::vector<int>>(ids_);
@@ -247,8 +625,15 @@ struct IndexWrapper {
       if (buffer.ndim != 2) throw std::runtime_error("data must be a 2d array");
 
       size_t rows = buffer.shape[0], features = buffer.shape[1];
+      if (ids.size() && ids.size() != rows) throw std::invalid_argument("the number of ids doesn't match the number of rows");
+
       std::vector<dist_uint_t> tempVect(features);
       auto vectSpacePtr = reinterpret_cast<VectorSpace<dist_t, dist_uint_t>*>(space.get());
+      if (arenas != nullptr && rows > 0 && isPlainDenseObject(vectSpacePtr, items.data(0), features)) {
+        py::gil_scoped_release l;
+        createDenseObjects(items.data(), rows, features, ids.size() ? &ids[0] : nullptr, output, arenas);
+        return rows;
+      }
       for (size_t row = 0; row < rows; ++row) {
         int id = ids.size() ? ids.at(row) : row;
         const dist_uint_t *elemVecStart = items.data(row);
@@ -274,6 +659,21 @@ struct IndexWrapper {
         output->push_back(vectSiftPtr->CreateObjFromUint8Vect(id, -1, tempVect));
       }
       return rows;
+    } else if (data_type == DATATYPE_BIT_VECTOR) {
+      // each row keeps bits packed into bytes
+      py::array_t<uint8_t, py::array::c_style | py::array::forcecast> items(input);
+      auto buffer = items.request();
+      if (buffer.ndim != 2) throw std::runtime_error("data must be a 2d array");
+
+      size_t rows = buffer.shape[0], byteQty = buffer.shape[1];
+      if (ids.size() && ids.size() != rows) throw std::invalid_argument("the number of ids doesn't match the number of rows");
+
+      auto bitSpacePtr = reinterpret_cast<SpaceBitVector<dist_t, uint64_t>*>(space.get());
+      for (size_t row = 0; row < rows; ++row) {
+        int id = ids.size() ? ids.at(row) : row;
+        output->push_back(bitSpacePtr->CreateObjFromPackedBits(id, -1, items.data(row), byteQty));
+      }
+      return rows;
 
     } else if (data_type == DATATYPE_SPARSE_VECTOR) {
       // the attr calls will fail with an attribute error, but this fixes the legacy
@@ -313,8 +713,10 @@ struct IndexWrapper {
       case DATATYPE_DENSE_VECTOR: {
         auto vectSpacePtr = static_cast<VectorSpace<dist_t, dist_uint_t> *>(space.get());
         py::list ret;
-        const dist_uint_t *values = reinterpret_cast<const dist_uint_t *>(obj->data());
+        // Some spaces transform vectors (e.g., store them in a 16-bit format)
         size_t elemQty = vectSpacePtr->GetElemQty(obj);
+        std::vector<dist_uint_t> values(elemQty);
+        if (elemQty) vectSpacePtr->CreateDenseVectFromObj(obj, &values[0], elemQty);
         for (size_t i = 0; i < elemQty; ++i) {
           ret.append(py::cast(values[i]));
         }
@@ -323,11 +725,25 @@ struct IndexWrapper {
       case DATATYPE_OBJECT_AS_STRING: {
         return py::cast(space->CreateStrFromObj(obj, ""));
       }
+      case DATATYPE_BIT_VECTOR: {
+        // The last word keeps the number of bits, bytes are returned in the packed form
+        auto words = reinterpret_cast<const uint64_t*>(obj->data());
+        size_t wordQty = obj->datalength() / sizeof(uint64_t) - 1;
+        size_t byteQty = (words[wordQty] + 7) / 8;
+        auto bytes = reinterpret_cast<const uint8_t*>(words);
+        py::list ret;
+        for (size_t i = 0; i < byteQty; ++i) {
+          ret.append(py::cast(bytes[i]));
+        }
+        return ret;
+      }
       case DATATYPE_SPARSE_VECTOR: {
-        auto values = reinterpret_cast<const SparseVectElem<dist_t>*>(obj->data());
-        size_t count = obj->datalength() / sizeof(SparseVectElem<dist_t>);
+        // Fast and compressed sparse spaces pack elements in their own formats
+        auto sparse = reinterpret_cast<const SpaceSparseVector<dist_t>*>(space.get());
+        std::vector<SparseVectElem<dist_t>> values;
+        sparse->CreateVectFromObj(obj, values);
         py::list ret;
-        for (size_t i = 0; i < count; ++i) {
+        for (size_t i = 0; i < values.size(); ++i) {
           ret.append(py::make_tuple(values[i].id_, values[i].val_));
         }
         return ret;
@@ -343,7 +759,92 @@ struct IndexWrapper {
   }
 
   size_t addDataPointBatch(py::object input, py::object ids = py::none()) {
-    return readObjectVector(input, &data, ids);
+    return readObjectVector(input, &data, ids, &data_arenas);
+  }
+
+  /*
+   * Adds data points from a file without creating intermediate Python objects:
+   *   "bin"   - the binary format of saveIndex(save_data=True). The file is memory-mapped
+   *             and data points point into the mapping, i.e., they aren't copied at all.
+   *   "fvecs" - float vectors, each preceded by its 32-bit dimensionality.
+   *   "bvecs" - the same for uint8 vectors.
+   * fvecs/bvecs files are read in chunks, ids are the (0-based) row numbers.
+   */
+  size_t addDataPointBatchFromFile(const std::string & filename, const std::string & file_format) {
+    py::gil_scoped_release l;
+    if (file_format == "bin") {
+      const size_t start = data.size();
+      data_files.push_back(space->MapObjectVectorFromBinData(data, filename));
+      return data.size() - start;
+    }
+    if (file_format == "fvecs") {
+      return readVecsFile<float>(filename);
+    }
+    if (file_format == "bvecs") {
+      return readVecsFile<uint8_t>(filename);
+    }
+    throw std::invalid_argument("Unknown file format '" + file_format + "', expected bin, fvecs, or bvecs");
+  }
+
+  template <typename elem_t>
+  size_t readVecsFile(const std::string & filename) {
+    if (data_type != DATATYPE_DENSE_VECTOR &&
+        !(data_type == DATATYPE_DENSE_UINT8_VECTOR && std::is_same<elem_t, uint8_t>::value)) {
+      throw std::invalid_argument("The data type of the index isn't compatible with the file format");
+    }
+    std::ifstream input(filename, std::ios::binary);
+    if (!input) throw std::runtime_error("Cannot open file '" + filename + "' for reading");
+
+    const size_t chunkRowQty = 4096;
+    std::vector<elem_t> chunk;
+    std::vector<dist_uint_t> converted;
+    size_t features = 0;
+    size_t rows = 0;
+    bool plainObjects = false;
+    auto vectSpacePtr = reinterpret_cast<VectorSpace<dist_t, dist_uint_t>*>(space.get());
+
+    while (true) {
+      // Each row is preceded by its dimensionality
+      int32_t dim = 0;
+      size_t chunkRows = 0;
+      chunk.clear();
+      while (chunkRows < chunkRowQty && input.read(reinterpret_cast<char*>(&dim), sizeof dim)) {
+        if (rows == 0 && chunkRows == 0) {
+          if (dim <= 0) throw std::runtime_error("Invalid dimensionality in file '" + filename + "'");
+          features = dim;
+        } else if (static_cast<size_t>(dim) != features) {
+          throw std::runtime_error("All vectors in file '" + filename + "' should have the same dimensionality");
+        }
+        chunk.resize((chunkRows + 1) * features);
+        if (!input.read(reinterpret_cast<char*>(&chunk[chunkRows * features]), features * sizeof(elem_t))) {
+          throw std::runtime_error("The file '" + filename + "' is truncated");
+        }
+        ++chunkRows;
+      }
+      if (chunkRows == 0) break;
+
+      if (data_type == DATATYPE_DENSE_UINT8_VECTOR) {
+        auto vectSiftPtr = reinterpret_cast<SpaceL2SqrSift*>(space.get());
+        for (size_t row = 0; row < chunkRows; ++row) {
+          std::vector<uint8_t> tempVect(&chunk[row * features], &chunk[(row + 1) * features]);
+          data.push_back(vectSiftPtr->CreateObjFromUint8Vect(rows + row, -1, tempVect));
+        }
+      } else {
+        converted.assign(chunk.begin(), chunk.end());
+        if (rows == 0) plainObjects = isPlainDenseObject(vectSpacePtr, &converted[0], features);
+        if (plainObjects) {
+          createDenseObjects(&converted[0], chunkRows, features, nullptr, &data, &data_arenas, rows);
+        } else {
+          std::vector<dist_uint_t> tempVect(features);
+          for (size_t row = 0; row < chunkRows; ++row) {
+            std::copy(&converted[row * features], &converted[(row + 1) * features], tempVect.begin());
+            data.push_back(vectSpacePtr->CreateObjFromVect(rows + row, -1, tempVect));
+          }
+        }
+      }
+      rows += chunkRows;
+    }
+    return rows;
   }
 
   inline size_t size() const { return data.size(); }
@@ -362,11 +863,24 @@ struct IndexWrapper {
     return ret.str();
   }
 
+  void clearData() {
+    freeAndClearObjectVector(data);
+    data_arenas.clear();
+    data_files.clear();
+  }
+
   ~IndexWrapper() {
     // In cases when the interpreter was shutting down, attempting to log in python
     // could throw an exception (https://github.com/nmslib/nmslib/issues/327).
     //LOG(LIB_DEBUG) << "Destroying Index";
-    freeAndClearObjectVector(data);
+    if (async_dispatcher) {
+      // done callbacks of pending queries may need the GIL
+      py::gil_scoped_release l;
+      async_dispatcher.reset();
+    }
+    // The index must be destroyed before the data it refers to
+    index.reset();
+    clearData();
   }
 
   std::string method;
@@ -377,20 +891,11 @@ struct IndexWrapper {
   std::unique_ptr<Space<dist_t>> space;
   std::unique_ptr<Index<dist_t>> index;
   ObjectVector data;
-};
-
-// pybind11::gil_scoped_acquire can deadlock when acquiring the GIL on threads
-// created from python (https://github.com/nmslib/nmslib/issues/291)
-// This might be fixed in a future version of pybind11 (https://github.com/pybind/pybind11/pull/1211)
-// but until then, lets fall back to the python c-api to fix.
-struct AcquireGIL {
-  PyGILState_STATE state;
-  AcquireGIL()
-    : state(PyGILState_Ensure()) {
-  }
-  ~AcquireGIL() {
-    PyGILState_Release(state);
-  }
+  // memory of objects that don't own their buffers
+  ObjectArenas data_arenas;
+  std::vector<std::unique_ptr<MemMappedFile>> data_files;
+  // created on the first call of knnQueryAsync
+  std::unique_ptr<AsyncKnnDispatcher<dist_t>> async_dispatcher;
 };
 
 class PythonLogger
@@ -469,7 +974,8 @@ PYBIND11_PLUGIN(nmslib) {
     .value("DENSE_VECTOR", DATATYPE_DENSE_VECTOR)
     .value("DENSE_UINT8_VECTOR", DATATYPE_DENSE_UINT8_VECTOR)
     .value("SPARSE_VECTOR", DATATYPE_SPARSE_VECTOR)
-    .value("OBJECT_AS_STRING", DATATYPE_OBJECT_AS_STRING);
+    .value("OBJECT_AS_STRING", DATATYPE_OBJECT_AS_STRING)
+    .value("BIT_VECTOR", DATATYPE_BIT_VECTOR);
 
   // Initializes a new index. Param ordering here is set to be consistent with the previous
   // version of the bindings
@@ -538,6 +1044,27 @@ PYBIND11_PLUGIN(nmslib) {
       "----------\n"
       "    A new NMSLIB Index.\n");
 
+  m.def(
+      "set_thread_pool_config",
+      [](size_t num_threads, bool pin_threads) {
+        if (!ThreadPool::SetGlobalConfig(num_threads, pin_threads)) {
+          throw std::runtime_error("The thread pool is already created: "
+                                   "set_thread_pool_config must be called before indices are created or queried");
+        }
+      },
+      py::arg("num_threads") = 0,
+      py::arg("pin_threads") = false,
+      "Configures the thread pool, which is shared by all indices. The pool is used\n"
+      "for parallel indexing and batch queries, which use at most num_threads pool threads\n"
+      "(plus the calling thread) no matter how many threads they are asked to use.\n"
+      "Must be called before the pool is used for the first time.\n\n"
+      "Parameters\n"
+      "----------\n"
+      "num_threads: int optional\n"
+      "    The number of threads in the pool (0 means the number of cores)\n"
+      "pin_threads: bool optional\n"
+      "    Pin threads to CPU cores\n");
+
   // Export Different Types of NMS Indices and spaces
   // hiding in a submodule to avoid cluttering up main namespace
   py::module dist_module = m.def_submodule("dist",
@@ -557,6 +1084,30 @@ PYBIND11_PLUGIN(nmslib) {
 
 template <typename dist_t, typename dist_uint_t = dist_t>
 void exportIndex(py::module * m) {
+  // Export the future returned by asynchronous queries (it depends only on dist_t)
+  std::string future_name = distName<dist_t>() + "KnnFuture";
+  if (!py::hasattr(*m, future_name.c_str())) {
+    py::class_<KnnFuture<dist_t>>(*m, future_name.c_str())
+      .def("done", &KnnFuture<dist_t>::done,
+        "Returns True if the query has finished")
+      .def("result", &KnnFuture<dist_t>::result,
+        py::arg("timeout") = py::none(),
+        "Waits for the query to finish and returns a tuple of (ids, distances).\n"
+        "Raises TimeoutError if the query doesn't finish in timeout seconds\n")
+      .def("exception", &KnnFuture<dist_t>::exception,
+        py::arg("timeout") = py::none(),
+        "Waits for the query to finish and returns the exception raised by it\n"
+        "(or None if the query succeeded). Raises TimeoutError if the query\n"
+        "doesn't finish in timeout seconds\n")
+      .def("add_done_callback", &KnnFuture<dist_t>::addDoneCallback,
+        py::arg("fn"),
+        "Calls fn(future) when the query finishes. The call is made from\n"
+        "a native worker thread (or immediately, if the query has already finished)\n")
+      .def("cancel", [](KnnFuture<dist_t> &) { return false; })
+      .def("cancelled", [](KnnFuture<dist_t> &) { return false; })
+      .def("running", [](KnnFuture<dist_t> & f) { return !f.done(); });
+  }
+
   // Export the index
   std::string index_name = distName<dist_t, dist_uint_t>() + "Index";
   py::class_<IndexWrapper<dist_t, dist_uint_t>>(*m, index_name.c_str())
@@ -606,6 +1157,47 @@ void exportIndex(py::module * m) {
       "list:\n"
       "   A list of tuples of (ids, distances)\n ")
 
+    .def("knnQueryAsync", &IndexWrapper<dist_t, dist_uint_t>::knnQueryAsync,
+      py::arg("vector"), py::arg("k") = 10,
+      "Submits a query for an asynchronous execution and returns without waiting.\n"
+      "Queries submitted concurrently (e.g., from many coroutines) are executed\n"
+      "in batches by a pool of native threads.\n\n"
+      "Parameters\n"
+      "----------\n"
+      "vector: array_like\n"
+      "    A 1D vector to query for.\n"
+      "k: int optional\n"
+      "    The number of neighbours to return\n"
+      "\n"
+      "Returns\n"
+      "----------\n"
+      "future\n"
+      "    A future with the interface similar to concurrent.futures.Future:\n"
+      "    done() polls the query, result(timeout=None) returns a tuple\n"
+      "    (ids, distances), add_done_callback(fn) calls fn(future) upon completion\n"
+      "    (from a native thread, e.g., use loop.call_soon_threadsafe with asyncio).\n")
+
+    .def("knnQueryBatchPacked", &IndexWrapper<dist_t, dist_uint_t>::knnQueryBatchPacked,
+      py::arg("queries"), py::arg("k") = 10, py::arg("num_threads") = 0,
+      "Performs multiple queries on the index, distributing the work over \n"
+      "a thread pool. Unlike knnQueryBatch, results are returned as two matrices\n\n"
+      "Parameters\n"
+      "----------\n"
+      "input: list\n"
+      "    A list of queries to query for\n"
+      "k: int optional\n"
+      "    The number of neighbours to return\n"
+      "num_threads: int optional\n"
+      "    The number of threads to use\n"
+      "\n"
+      "Returns\n"
+      "----------\n"
+      "ids: array_like.\n"
+      "    An (n, k) matrix of neighbour ids. If fewer than k neighbours are found,\n"
+      "    the row is padded with -1.\n"
+      "distances: array_like.\n"
+      "    An (n, k) matrix of distances (padded with the maximum distance value).\n")
+
     .def("loadIndex", &IndexWrapper<dist_t, dist_uint_t>::loadIndex,
       py::arg("filename"),
       py::arg("load_data") = false,
@@ -669,6 +1261,25 @@ void exportIndex(py::module * m) {
       "int\n"
       "    The number of items added\n")
 
+    .def("addDataPointBatchFromFile", &IndexWrapper<dist_t, dist_uint_t>::addDataPointBatchFromFile,
+      py::arg("filename"),
+      py::arg("file_format") = "bin",
+      "Adds multiple datapoints from a file, without creating Python objects\n\n"
+      "Parameters\n"
+      "----------\n"
+      "filename: str\n"
+      "    The name of the file.\n"
+      "file_format: str optional\n"
+      "    'bin' is the format of data saved by saveIndex(save_data=True):\n"
+      "    the file is memory-mapped, so data points are not copied into RAM.\n"
+      "    'fvecs' and 'bvecs' are files of float and uint8 vectors, where\n"
+      "    each vector is preceded by its (32-bit) dimensionality. Ids of\n"
+      "    data points are row numbers.\n"
+      "Returns\n"
+      "----------\n"
+      "int\n"
+      "    The number of items added\n")
+
     .def_readonly("dataType", &IndexWrapper<dist_t, dist_uint_t>::data_type)
     .def_readonly("distType", &IndexWrapper<dist_t, dist_uint_t>::dist_type)
     .def_readonly("distUintType", &IndexWrapper<dist_t, dist_uint_t>::dist_uint_type)
@@ -1,5 +1,6 @@
 import itertools
 import tempfile
+import threading
 import unittest
 import shutil
 
@@ -161,6 +162,46 @@ class DenseIndexTestMixin(object):
             ids = np.sqrt(ids).astype(int)
             self.assertTrue(get_hitrate(get_exact_cosine(query, data), ids) >= 5)
 
+    def testKnnQueryBatchPacked(self):
+        np.random.seed(23)
+        data = np.random.randn(1000, 10).astype(np.float32)
+
+        index = self._get_index()
+        index.addDataPointBatch(data)
+        index.createIndex()
+
+        queries = data[:10]
+        ids, distances = index.knnQueryBatchPacked(queries, k=10, num_threads=2)
+        self.assertEqual(ids.shape, (10, 10))
+        self.assertEqual(distances.shape, (10, 10))
+
+        results = index.knnQueryBatch(queries, k=10, num_threads=2)
+        for row, (expected_ids, expected_distances) in enumerate(results):
+            npt.assert_array_equal(ids[row], expected_ids)
+            npt.assert_allclose(distances[row], expected_distances)
+
+    def testKnnQueryAsync(self):
+        np.random.seed(23)
+        data = np.random.randn(1000, 10).astype(np.float32)
+
+        index = self._get_index()
+        index.addDataPointBatch(data)
+        index.createIndex()
+
+        queries = data[:100]
+        futures = [index.knnQueryAsync(query, k=10) for query in queries]
+        # callbacks are invoked from a native thread
+        finished = threading.Event()
+        futures[-1].add_done_callback(lambda future: finished.set())
+        for query, future in zip(queries, futures):
+            ids, distances = future.result(timeout=60)
+            self.assertTrue(future.done())
+            self.assertIsNone(future.exception(timeout=60))
+            expected_ids, expected_distances = index.knnQuery(query, k=10)
+            npt.assert_array_equal(ids, expected_ids)
+            npt.assert_allclose(distances, expected_distances)
+        self.assertTrue(finished.wait(60))
+
     def testReloadIndex(self):
         np.random.seed(23)
         data = np.random.randn(1000, 10).astype(np.float32)
@@ -188,6 +229,35 @@ class DenseIndexTestMixin(object):
 
         shutil.rmtree(temp_dir)
 
+    def testAddDataPointBatchFromFile(self):
+        np.random.seed(23)
+        data = np.random.randn(1000, 10).astype(np.float32)
+
+        temp_dir = tempfile.mkdtemp()
+        temp_file_pref = os.path.join(temp_dir, 'index')
+
+        original = self._get_index()
+        original.addDataPointBatch(data)
+        original.createIndex()
+        original.saveIndex(temp_file_pref, save_data=True)
+
+        # each fvecs row is preceded by its dimensionality
+        fvecs_file = os.path.join(temp_dir, 'data.fvecs')
+        dims = np.full((data.shape[0], 1), data.shape[1], dtype=np.int32)
+        np.hstack([dims.view(np.float32), data]).tofile(fvecs_file)
+
+        for filename, file_format in [(temp_file_pref + '.dat', 'bin'), (fvecs_file, 'fvecs')]:
+            index = self._get_index()
+            self.assertEqual(index.addDataPointBatchFromFile(filename, file_format), data.shape[0])
+            self.assertEqual(len(index), data.shape[0])
+            index.createIndex()
+
+            ids, distances = index.knnQuery(data[0], k=10)
+            self.assertTrue(get_hitrate(get_exact_cosine(data[0], data), ids) >= 5)
+            del index
+
+        shutil.rmtree(temp_dir)
+
 
 class BitVectorIndexTestMixin(object):
     def _get_index(self, space='bit_jaccard'):
@@ -275,6 +345,26 @@ class BitHammingTestCase(TestCaseBase, BitVectorIndexTestMixin):
                            dtype=nmslib.DistType.INT)
 
 
+class PackedBitHammingTestCase(TestCaseBase):
+    def testPackedBits(self):
+        np.random.seed(23)
+        bits = np.random.randint(2, size=(500, 200)).astype(np.uint8)
+        data = np.packbits(bits, axis=1, bitorder='little')
+
+        index = nmslib.init(method='hnsw', space='bit_hamming', data_type=nmslib.DataType.BIT_VECTOR,
+                            dtype=nmslib.DistType.INT)
+        index.addDataPointBatch(data)
+        index.createIndex()
+
+        ids, distances = index.knnQuery(data[0], k=10)
+        self.assertEqual(ids[0], 0)
+        for i, distance in zip(ids, distances):
+            self.assertEqual(distance, np.count_nonzero(bits[0] != bits[i]))
+            self.assertEqual(index.getDistance(0, i), distance)
+
+        self.assertEqual(list(index[1]), list(data[1]))
+
+
 class SWGraphTestCase(TestCaseBase, DenseIndexTestMixin):
     def _get_index(self, space='cosinesimil'):
         return nmslib.init(method='sw-graph', space=space)
@@ -357,6 +447,24 @@ class SparseTestCase(TestCaseBase):
         self.assertEqual(len(index), 4)
         self.assertEqual(index[3], [(3, 1.0)])
 
+    def testSparseQuant(self):
+        # Values are quantized, while ids are stored exactly
+        for space in ['cosinesimil_sparse_q8', 'negdotprod_sparse_q16']:
+            index = nmslib.init(method='small_world_rand', space=space,
+                                data_type=nmslib.DataType.SPARSE_VECTOR)
+
+            index.addDataPoint(0, [(1, 2.), (2, 3.)])
+            index.addDataPoint(1, [(0, 1.), (1, 2.)])
+            index.addDataPoint(2, [(2, 3.), (100000, 3.)])
+
+            index.createIndex()
+
+            ids, distances = index.knnQuery([(1, 2.), (2, 3.)], k=1)
+            self.assertEqual(ids[0], 0)
+
+            self.assertEqual([e[0] for e in index[2]], [2, 100000])
+            npt.assert_allclose([e[1] for e in index[2]], [3., 3.], rtol=1e-2)
+
 class MemoryLeak1TestCase(TestCaseBase):
     def testMemoryLeak1(self):
         process = psutil.Process(os.getpid())
@@ -67,7 +67,8 @@ void ParseCommandLineForClient(int argc, char*argv[],
                       bool&                   retExternId,
                       bool&                   retObj,
                       string&                 queryTimeParams,
-                      bool&                   batch
+                      bool&                   batch,
+                      bool&                   framedTransport
                       ) {
   po::options_description ProgOptDesc("Allowed options");
   ProgOptDesc.add_options()
@@ -80,6 +81,7 @@ void ParseCommandLineForClient(int argc, char*argv[],
     (RET_EXT_ID_PARAM_OPT.c_str(),   RET_EXT_ID_PARAM_MSG.c_str())
     (RET_OBJ_PARAM_OPT.c_str(), RET_EXT_ID_PARAM_MSG.c_str())
     ("batch,b", po::value<bool>(&batch), "batch mode (only for knn). client can process multiple input lines)")
+    ("framedTransport", po::bool_switch(&framedTransport), "use the framed Thrift transport (the server should use it too)")
     ;
 
   po::variables_map vm;
@@ -134,6 +136,7 @@ int main(int argc, char *argv[]) {
   SearchType  searchType;
   string      queryTimeParams;
   bool        batch = false;
+  bool        framedTransport = false;
 
   ParseCommandLineForClient(argc, argv,
                       host,
@@ -143,7 +146,8 @@ int main(int argc, char *argv[]) {
                       retExternId,
                       retObj,
                       queryTimeParams,
-                      batch);
+                      batch,
+                      framedTransport);
 
   // Let's read the query from the input stream
   string        s;
@@ -157,7 +161,12 @@ int main(int argc, char *argv[]) {
   }
 
   ::apache::thrift::stdcxx::shared_ptr<TTransport>   socket(new TSocket(host, port));
-  ::apache::thrift::stdcxx::shared_ptr<TTransport>   transport(new TBufferedTransport(socket));
+  ::apache::thrift::stdcxx::shared_ptr<TTransport>   transport;
+  if (framedTransport) {
+    transport.reset(new TFramedTransport(socket));
+  } else {
+    transport.reset(new TBufferedTransport(socket));
+  }
   ::apache::thrift::stdcxx::shared_ptr<TProtocol>    protocol(new TBinaryProtocol(transport));
   QueryServiceClient              client(protocol);
 
@@ -15,8 +15,15 @@
 #include <memory>
 #include <stdexcept>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <chrono>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <cmath>
+#include <functional>
 #include <iostream>
 #include <algorithm>
 
@@ -37,6 +44,7 @@
 #include "utils.h"
 #include "space.h"
 #include "spacefactory.h"
+#include "space/space_vector.h"
 #include "index.h"
 #include "rangequery.h"
 #include "knnquery.h"
@@ -46,12 +54,15 @@
 #include "logging.h"
 #include "ztimer.h"
 #include "thread_pool.h"
-
-#define MAX_SPIN_LOCK_QTY 1000000
-#define SLEEP_DURATION    10
+#include "deadline_query.h"
 
 #define DATA_FILE_PREF  ".dat"
 
+// The number of (independently locked) shards of the result cache
+#define CACHE_SHARD_QTY 16
+// The result cache statistics is logged once in this number of lookups
+#define CACHE_STAT_LOG_PERIOD 100000
+
 const unsigned THREAD_COEFF = 4;
 
 using namespace apache::thrift;
@@ -65,25 +76,445 @@ using std::unique_ptr;
 using std::exception;
 using std::mutex;
 using std::unique_lock;
+using std::runtime_error;
 
 using namespace  ::similarity;
 
-class LockedCounterManager {
-public:
-  LockedCounterManager(int& counter, mutex& mtx) : counter_(counter), mtx_(mtx) 
-  {
+typedef std::chrono::steady_clock SteadyClock;
+
+/*
+ * The protocol has no way to mark a partial result. Hence, a query whose
+ * deadline expires during the search fails rather than returns fewer answers.
+ */
+const string TRUNCATED_RESULT_MSG = "The query deadline expired before the search finished, the result would be truncated";
+
+/*
+ * A bounded pool of search threads with a bounded queue of requests.
+ * Thrift threads (one per connection) merely enqueue requests and wait for them.
+ * Besides searches, the queue may contain exclusive tasks (e.g., changing query-time
+ * parameters of methods that can't do it concurrently with searches), which run
+ * only when no search is in progress.
+ * An exclusive task works as a barrier: searches submitted after it wait
+ * in the queue until it finishes, but they are neither rejected, nor spin-locked.
+ */
+class SearchExecutor {
+ public:
+  SearchExecutor(size_t threadQty, size_t maxQueueQty) :
+      maxQueueQty_(maxQueueQty), runQty_(0), exclusiveRun_(false), stop_(false) {
+    CHECK_MSG(threadQty > 0, "The number of search threads should be positive");
+    for (size_t i = 0; i < threadQty; ++i) {
+      threads_.emplace_back([this]() { this->WorkerLoop(); });
+    }
+  }
+
+  ~SearchExecutor() {
+    {
+      unique_lock<mutex> lock(mtx_);
+      stop_ = true;
+    }
+    workCond_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+
+  size_t ThreadQty() const { return threads_.size(); }
+
+  /*
+   * Runs fn in a search thread and waits until it finishes. Exceptions are re-thrown.
+   * If the queue is full, or the deadline passes before the task is started,
+   * the task is not executed and an exception is thrown.
+   */
+  void Run(const std::function<void()>& fn, bool exclusive,
+           SteadyClock::time_point deadline = SteadyClock::time_point::max()) {
+    RunParallel(fn, 1, exclusive, deadline);
+  }
+
+  /*
+   * Runs taskQty copies of fn in (up to) taskQty search threads and waits until they finish.
+   * Each copy occupies a search thread, hence, the total number of concurrently running
+   * searches remains bounded. The copies are supposed to share work, e.g., by pulling
+   * items from a common counter. Thus, the request fails only if none of the copies starts
+   * before the deadline. The queue admits (or rejects) the whole request at once.
+   */
+  void RunParallel(const std::function<void()>& fn, size_t taskQty, bool exclusive,
+                   SteadyClock::time_point deadline = SteadyClock::time_point::max()) {
+    CHECK_MSG(taskQty > 0 && (!exclusive || taskQty == 1), "Invalid number of tasks");
+    vector<std::shared_ptr<Task>> tasks;
+    for (size_t i = 0; i < taskQty; ++i) tasks.emplace_back(new Task(fn, exclusive, deadline));
+    unique_lock<mutex> lock(mtx_);
+    // Exclusive tasks are rare and shouldn't be rejected
+    if (!exclusive && maxQueueQty_ && queue_.size() >= maxQueueQty_) {
+      throw runtime_error("The server is overloaded: the request queue is full");
+    }
+    for (const auto& task : tasks) queue_.push_back(task);
+    workCond_.notify_all();
+    doneCond_.wait(lock, [&tasks]() {
+      for (const auto& task : tasks) if (!task->done_) return false;
+      return true;
+    });
+    bool expired = true;
+    for (const auto& task : tasks) {
+      if (task->error_) std::rethrow_exception(task->error_);
+      expired = expired && task->expired_;
+    }
+    if (expired) {
+      throw runtime_error("The request deadline expired before the search could start");
+    }
+  }
+
+ private:
+  struct Task {
+    Task(const std::function<void()>& fn, bool exclusive, SteadyClock::time_point deadline) :
+        fn_(fn), exclusive_(exclusive), deadline_(deadline), done_(false), expired_(false) {}
+
+    std::function<void()>     fn_;
+    bool                      exclusive_;
+    SteadyClock::time_point   deadline_;
+    bool                      done_;
+    bool                      expired_;
+    std::exception_ptr        error_;
+  };
+
+  // Can the task in the head of the queue be started? Must be called under the lock.
+  bool CanStart() const {
+    if (queue_.empty() || exclusiveRun_) return false;
+    return !queue_.front()->exclusive_ || runQty_ == 0;
+  }
+
+  void WorkerLoop() {
     unique_lock<mutex> lock(mtx_);
-    ++counter_;
+    while (true) {
+      workCond_.wait(lock, [this]() { return stop_ || CanStart(); });
+      if (!CanStart()) return; // stop_ is set
+      std::shared_ptr<Task> task = queue_.front();
+      queue_.pop_front();
+
+      if (!task->exclusive_ && SteadyClock::now() > task->deadline_) {
+        task->expired_ = task->done_ = true;
+        doneCond_.notify_all();
+        continue;
+      }
+
+      ++runQty_;
+      exclusiveRun_ = task->exclusive_;
+      lock.unlock();
+      try {
+        task->fn_();
+      } catch (...) {
+        task->error_ = std::current_exception();
+      }
+      lock.lock();
+      --runQty_;
+      exclusiveRun_ = false;
+      task->done_ = true;
+      doneCond_.notify_all();
+      // The next task may be an exclusive one waiting for searches to finish
+      workCond_.notify_all();
+    }
   }
 
-  ~LockedCounterManager() {
+  size_t                              maxQueueQty_;
+  size_t                              runQty_;
+  bool                                exclusiveRun_;
+  bool                                stop_;
+  std::deque<std::shared_ptr<Task>>   queue_;
+  mutex                               mtx_;
+  std::condition_variable             workCond_;
+  std::condition_variable             doneCond_;
+  vector<std::thread>                 threads_;
+};
+
+/*
+ * Collects concurrent single-query requests into batches. The first request
+ * of a batch (the leader) waits until the batch window expires or the batch
+ * becomes full. Then, the leader submits the whole batch to the executor, whose
+ * search threads process the requests in parallel.
+ * Other requests of the batch simply wait for their results. Thus, a request
+ * may be delayed by at most the batch window (plus the time to process the batch).
+ */
+class QueryBatcher {
+ public:
+  QueryBatcher(SearchExecutor& executor, std::chrono::microseconds window, size_t maxBatchQty) :
+      executor_(executor), window_(window), maxBatchQty_(std::max<size_t>(1, maxBatchQty)) {}
+
+  // Runs fn as a part of a batch and waits until it finishes. Exceptions are re-thrown.
+  void Run(const std::function<void()>& fn, SteadyClock::time_point deadline) {
+    Request req(fn);
     unique_lock<mutex> lock(mtx_);
-    --counter_;
+
+    const bool isLeader = !current_;
+    if (isLeader) {
+      current_.reset(new Batch());
+      current_->deadline_ = deadline;
+    }
+    std::shared_ptr<Batch> batch = current_;
+    batch->requests_.push_back(&req);
+    // The batch can't be skipped by the executor, while at least one request hasn't expired
+    batch->deadline_ = std::max(batch->deadline_, deadline);
+    if (batch->requests_.size() >= maxBatchQty_) {
+      // Close the batch: subsequent requests start a new one
+      current_.reset();
+      batch->fullCond_.notify_one();
+    }
+
+    if (isLeader) {
+      batch->fullCond_.wait_for(lock, window_, [this, &batch]() { return current_ != batch; });
+      if (current_ == batch) current_.reset();
+      lock.unlock();
+
+      // No requests can be added to the closed batch
+      const vector<Request*>& requests = batch->requests_;
+      std::exception_ptr batchError;
+      // As in knnQueryBatch, requests are processed by (at most) all search threads of the executor
+      std::atomic<size_t> nextIndex(0);
+      try {
+        executor_.RunParallel([&requests, &nextIndex]() {
+          size_t i;
+          while ((i = nextIndex++) < requests.size()) {
+            try {
+              requests[i]->fn_();
+            } catch (...) {
+              requests[i]->error_ = std::current_exception();
+            }
+          }
+        }, std::min(executor_.ThreadQty(), requests.size()), false, batch->deadline_);
+      } catch (...) {
+        // E.g., the request queue is full
+        batchError = std::current_exception();
+      }
+
+      lock.lock();
+      if (batchError) {
+        for (Request* r : requests) r->error_ = batchError;
+      }
+      batch->done_ = true;
+      doneCond_.notify_all();
+    } else {
+      doneCond_.wait(lock, [&batch]() { return batch->done_; });
+    }
+
+    if (req.error_) std::rethrow_exception(req.error_);
+  }
+
+ private:
+  struct Request {
+    explicit Request(const std::function<void()>& fn) : fn_(fn) {}
+
+    const std::function<void()>&  fn_;
+    std::exception_ptr            error_;
+  };
+  struct Batch {
+    Batch() : done_(false) {}
+
+    vector<Request*>              requests_;
+    SteadyClock::time_point       deadline_;
+    bool                          done_;
+    std::condition_variable       fullCond_;
+  };
+
+  SearchExecutor&                 executor_;
+  std::chrono::microseconds       window_;
+  size_t                          maxBatchQty_;
+  // the batch that accepts new requests (or nullptr)
+  std::shared_ptr<Batch>          current_;
+  mutex                           mtx_;
+  std::condition_variable         doneCond_;
+};
+
+/*
+ * A sharded LRU cache of (serialized) k-NN search results. Each shard
+ * has its own lock and receives an equal share of the memory budget.
+ * Because results are cached after serialization, a cache hit skips
+ * both the search and the conversion of answer objects to strings.
+ *
+ * A plain LRU cache admits every new result, so a stream of one-off queries
+ * evicts popular results. Hence, the cache uses the TinyLFU admission policy:
+ * a new result is admitted only if its key was looked up more frequently
+ * than the keys of the results that would be evicted:
+ *
+ * Einziger, G., Friedman, R., & Manes, B. TinyLFU: A highly efficient
+ * cache admission policy. ACM Transactions on Storage 2017.
+ */
+class QueryResultCache {
+ public:
+  struct Stats {
+    uint64_t  hitQty_      = 0;
+    uint64_t  missQty_     = 0;
+    // the number of results that were not admitted
+    uint64_t  rejectQty_   = 0;
+    size_t    entryQty_    = 0;
+    size_t    bytes_       = 0;
+  };
+
+  QueryResultCache(size_t maxBytes, size_t shardQty) : generation_(0), hitQty_(0), missQty_(0), rejectQty_(0) {
+    CHECK_MSG(shardQty > 0, "The number of cache shards should be positive");
+    for (size_t i = 0; i < shardQty; ++i) shards_.emplace_back(new Shard(maxBytes / shardQty));
+  }
+
+  // Returns false if the key isn't in the cache
+  bool Get(const string& key, ReplyEntryList& res) {
+    const size_t keyHash = std::hash<string>()(key);
+    Shard& shard = getShard(keyHash);
+    bool found = false;
+    {
+      unique_lock<mutex> lock(shard.mtx_);
+      // Misses are counted too: they are the candidates for admission
+      shard.sketch_.Increment(keyHash);
+      auto it = shard.entries_.find(key);
+      if (it != shard.entries_.end()) {
+        // Move the entry to the head of the LRU list
+        shard.lru_.splice(shard.lru_.begin(), shard.lru_, it->second.lruPos_);
+        res = it->second.res_;
+        found = true;
+      }
+    }
+    const uint64_t lookupQty = (found ? ++hitQty_ : ++missQty_) + (found ? missQty_.load() : hitQty_.load());
+    if (lookupQty % CACHE_STAT_LOG_PERIOD == 0) {
+      const Stats stats = GetStats();
+      LOG(LIB_INFO) << "Result cache: " << stats.hitQty_ << " hits " << stats.missQty_ << " misses "
+                    << stats.rejectQty_ << " rejected results " << stats.entryQty_ << " entries "
+                    << stats.bytes_ << " bytes";
+    }
+    return found;
+  }
+
+  /*
+   * Each Clear() starts a new generation. A search should obtain the generation
+   * before it starts and pass it to Put(). The result of a search that overlapped
+   * with Clear() (e.g., it used outdated query-time parameters) isn't cached.
+   */
+  uint64_t Generation() const { return generation_.load(); }
+
+  void Put(const string& key, const ReplyEntryList& res, uint64_t generation) {
+    const size_t keyHash = std::hash<string>()(key);
+    Shard& shard = getShard(keyHash);
+    size_t bytes = sizeof(Entry) + 2 * key.size();
+    for (const ReplyEntry& e : res) bytes += sizeof(e) + e.externId.size() + e.obj.size();
+    if (bytes > shard.maxBytes_) return;
+
+    unique_lock<mutex> lock(shard.mtx_);
+    // Clear() increments the generation before clearing the shards
+    if (generation != generation_.load()) return;
+    if (shard.entries_.count(key)) return;
+    // Find LRU victims first: nothing is evicted if the new result isn't admitted
+    size_t freeBytes = shard.maxBytes_ - shard.bytes_, victimQty = 0;
+    const unsigned keyFreq = shard.sketch_.Estimate(keyHash);
+    for (auto it = shard.lru_.rbegin(); freeBytes < bytes; ++it, ++victimQty) {
+      const Entry& victim = shard.entries_.find(*it)->second;
+      if (shard.sketch_.Estimate(victim.keyHash_) >= keyFreq) {
+        ++rejectQty_;
+        return;
+      }
+      freeBytes += victim.bytes_;
+    }
+    for (; victimQty > 0; --victimQty) {
+      auto it = shard.entries_.find(shard.lru_.back());
+      shard.bytes_ -= it->second.bytes_;
+      shard.lru_.pop_back();
+      shard.entries_.erase(it);
+    }
+    shard.lru_.push_front(key);
+    Entry& e = shard.entries_[key];
+    e.res_ = res;
+    e.bytes_ = bytes;
+    e.keyHash_ = keyHash;
+    e.lruPos_ = shard.lru_.begin();
+    shard.bytes_ += bytes;
+  }
+
+  void Clear() {
+    ++generation_;
+    for (auto& shard : shards_) {
+      unique_lock<mutex> lock(shard->mtx_);
+      shard->entries_.clear();
+      shard->lru_.clear();
+      // Lookup frequencies are kept: they don't depend on query-time parameters
+      shard->bytes_ = 0;
+    }
+  }
+
+  Stats GetStats() const {
+    Stats stats;
+    stats.hitQty_ = hitQty_.load();
+    stats.missQty_ = missQty_.load();
+    stats.rejectQty_ = rejectQty_.load();
+    for (const auto& shard : shards_) {
+      unique_lock<mutex> lock(shard->mtx_);
+      stats.entryQty_ += shard->entries_.size();
+      stats.bytes_ += shard->bytes_;
+    }
+    return stats;
+  }
+
+ private:
+  /*
+   * A count-min sketch of 4 rows with 8-bit counters, which estimates
+   * how often keys were looked up recently. After the number of increments reaches
+   * the sample size, all the counters are halved, so that old lookups are forgotten.
+   */
+  class FreqSketch {
+   public:
+    FreqSketch() : counters_(ROW_QTY * ROW_SIZE), incrQty_(0) {}
+
+    void Increment(size_t keyHash) {
+      for (size_t row = 0; row < ROW_QTY; ++row) {
+        uint8_t& c = counters_[row * ROW_SIZE + index(keyHash, row)];
+        if (c < std::numeric_limits<uint8_t>::max()) ++c;
+      }
+      if (++incrQty_ >= SAMPLE_SIZE) {
+        for (uint8_t& c : counters_) c /= 2;
+        incrQty_ /= 2;
+      }
+    }
+    unsigned Estimate(size_t keyHash) const {
+      unsigned res = std::numeric_limits<uint8_t>::max();
+      for (size_t row = 0; row < ROW_QTY; ++row) {
+        res = std::min<unsigned>(res, counters_[row * ROW_SIZE + index(keyHash, row)]);
+      }
+      return res;
+    }
+   private:
+    static const size_t ROW_QTY = 4;
+    static const size_t ROW_SIZE = 4096; // must be a power of two
+    static const size_t SAMPLE_SIZE = 10 * ROW_SIZE;
+
+    // Row indices are obtained by re-hashing the key hash with different odd multipliers
+    static size_t index(size_t keyHash, size_t row) {
+      static const uint64_t MULT[ROW_QTY] = {0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+                                             0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL};
+      return ((uint64_t(keyHash) * MULT[row]) >> 32) & (ROW_SIZE - 1);
+    }
+
+    vector<uint8_t>                   counters_;
+    size_t                            incrQty_;
+  };
+
+  struct Entry {
+    ReplyEntryList                    res_;
+    size_t                            bytes_;
+    size_t                            keyHash_;
+    std::list<string>::iterator       lruPos_;
+  };
+  struct Shard {
+    explicit Shard(size_t maxBytes) : maxBytes_(maxBytes), bytes_(0) {}
+
+    mutex                             mtx_;
+    size_t                            maxBytes_;
+    size_t                            bytes_;
+    // the most recently used keys are in the beginning
+    std::list<string>                 lru_;
+    std::unordered_map<string, Entry> entries_;
+    FreqSketch                        sketch_;
+  };
+
+  Shard& getShard(size_t keyHash) {
+    return *shards_[keyHash % shards_.size()];
   }
 
-private:
-  int&     counter_; 
-  mutex&   mtx_;
+  vector<unique_ptr<Shard>>           shards_;
+  std::atomic<uint64_t>               generation_;
+  std::atomic<uint64_t>               hitQty_;
+  std::atomic<uint64_t>               missQty_;
+  std::atomic<uint64_t>               rejectQty_;
 };
 
 template <class dist_t>
@@ -100,13 +531,32 @@ class QueryServiceHandler : virtual public QueryServiceIf {
                       const string&                      SaveIndexLoc,
                       bool&                              CacheData,
                       const AnyParams&                   IndexParams,
-                      const AnyParams&                   QueryTimeParams) :
+                      const AnyParams&                   QueryTimeParams,
+                      size_t                             SearchThreadQty,
+                      size_t                             MaxQueueQty,
+                      unsigned                           QueryTimeoutMs,
+                      unsigned                           BatchWindowUs,
+                      size_t                             MaxBatchQty,
+                      size_t                             CacheMaxMB,
+                      float                              CacheQuantStep,
+                      bool                               BinaryObj) :
     debugPrint_(debugPrint),
     methName_(MethodName),
     space_(SpaceFactoryRegistry<dist_t>::Instance().CreateSpace(SpaceType, SpaceParams)),
-    counter_(0)
-
+    queryTimeout_(QueryTimeoutMs),
+    executor_(SearchThreadQty, MaxQueueQty),
+    binaryObj_(BinaryObj),
+    cacheQuantStep_(CacheQuantStep)
   {
+    if (CacheMaxMB > 0) {
+      LOG(LIB_INFO) << "Caching k-NN results, memory limit: " << CacheMaxMB << " MB, quantization step: " << CacheQuantStep;
+      cache_.reset(new QueryResultCache(CacheMaxMB * 1024 * 1024, CACHE_SHARD_QTY));
+    }
+    if (BatchWindowUs > 0) {
+      LOG(LIB_INFO) << "Batching single-query requests, window: " << BatchWindowUs << " us, max. batch size: " << MaxBatchQty;
+      batcher_.reset(new QueryBatcher(executor_, std::chrono::microseconds(BatchWindowUs), MaxBatchQty));
+    }
+
     unique_ptr<DataFileInputState> inpState;
 
     if (!CacheData || !DoesFileExist(LoadIndexLoc + DATA_FILE_PREF)) {
@@ -157,33 +607,51 @@ class QueryServiceHandler : virtual public QueryServiceIf {
 
     LOG(LIB_INFO) << "Setting query-time parameters";
     index_->SetQueryTimeParams(QueryTimeParams);
+    if (!index_->ConcurrentQueryTimeParams()) {
+      LOG(LIB_INFO) << "The method " << methName_ << " can't change query-time parameters while searches are in progress:"
+                    << " setQueryTimeParams will wait for them to finish";
+    }
   }
 
   ~QueryServiceHandler() {
     for (auto e: dataSet_) delete e;
   }
 
+  // Returns false if caching is disabled
+  bool getCacheStats(QueryResultCache::Stats& stats) const {
+    if (!cache_) return false;
+    stats = cache_->GetStats();
+    return true;
+  }
+
+  /*
+   * The index is shared among all search threads. If the method publishes query-time
+   * parameters as immutable snapshots (see Index::ConcurrentQueryTimeParams), the new
+   * parameters are applied immediately: searches in progress keep using the old snapshot
+   * and nothing is blocked. Otherwise, the parameters are applied by an exclusive task
+   * of the executor, i.e., after the searches in progress finish. Searches submitted
+   * in the meantime are queued.
+   */
   void setQueryTimeParams(const string& queryTimeParamStr) {
     try {
-      // Query time parameters are essentially spin-locked
-      while (true) {
-        for (size_t i = 0; i < MAX_SPIN_LOCK_QTY; ++i) {
-          unique_lock<mutex> lock(mtx_);
-          if (0 == counter_) {
-            vector<string>  desc;
-            ParseArg(queryTimeParamStr, desc);
-            if (debugPrint_) {
-              LOG(LIB_INFO) << "Setting query time parameters (" << queryTimeParamStr << ")";
-              for (string s: desc) {
-                LOG(LIB_INFO) << s;
-              }
-            }
-            index_->SetQueryTimeParams(AnyParams(desc));
-            return;
-          }
-        } // the lock will be released in the end of the block
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(SLEEP_DURATION));
+      vector<string>  desc;
+      ParseArg(queryTimeParamStr, desc);
+      if (debugPrint_) {
+        LOG(LIB_INFO) << "Setting query time parameters (" << queryTimeParamStr << ")";
+        for (string s: desc) {
+          LOG(LIB_INFO) << s;
+        }
+      }
+      AnyParams params(desc);
+      std::function<void()> setFunc = [&]() {
+        index_->SetQueryTimeParams(params);
+        // Cached results may be different from the results obtained with new parameters
+        if (cache_) cache_->Clear();
+      };
+      if (index_->ConcurrentQueryTimeParams()) {
+        setFunc();
+      } else {
+        executor_.Run(setFunc, true /* exclusive */);
       }
     } catch (const exception& e) {
         QueryException qe;
@@ -198,9 +666,6 @@ class QueryServiceHandler : virtual public QueryServiceIf {
 
   void rangeQuery(ReplyEntryList& _return, const double r, const string& queryObjStr, 
                   const bool retExternId, const bool retObj) {
-    // This will increase the counter and prevent modification of query time parameters.
-    LockedCounterManager  mngr(counter_, mtx_);
-
     try {
       if (debugPrint_) {
         LOG(LIB_INFO) << "Running a range query, r=" << r << " retExternId=" << retExternId << " retObj=" << retObj;
@@ -209,10 +674,15 @@ class QueryServiceHandler : virtual public QueryServiceIf {
 
       wtm.reset();
 
+      const SteadyClock::time_point deadline = getDeadline();
       unique_ptr<Object>  queryObj(space_->CreateObjFromStr(0, -1, queryObjStr, NULL));
 
-      RangeQuery<dist_t> range(*space_, queryObj.get(), r);
-      index_->Search(&range, -1);
+      DeadlineQuery<RangeQuery, dist_t> range(deadline, *space_, queryObj.get(), r);
+      executor_.Run([&]() { index_->Search(&range, -1); }, false, deadline);
+      if (range.Expired()) {
+        LOG(LIB_INFO) << "The range query was terminated early, because its deadline expired";
+        throw runtime_error(TRUNCATED_RESULT_MSG);
+      }
 
       _return.clear();
 
@@ -222,56 +692,16 @@ class QueryServiceHandler : virtual public QueryServiceIf {
         LOG(LIB_INFO) << "Finished in: " << wtm.elapsed() / 1e3f << " ms";
       }
 
-      vector<IdType> ids;
-      vector<double> dists;
-      vector<string> externIds;
-      vector<string> objs;
-
-     
-      if (debugPrint_) { 
-        LOG(LIB_INFO) << "Results: ";
-      }
-      
       const ObjectVector&     vResObjs  = *range.Result(); 
       const vector<dist_t>&   vResDists = *range.ResultDists();
 
+      _return.resize(vResObjs.size());
+      // Answers are returned in the reverse order
       for (size_t i = 0; i < vResObjs.size(); ++i) {
-        const Object* pObj = vResObjs[i];
-        dist_t dist        = vResDists[i];
-
-        ReplyEntry e;
-
-        e.__set_id(pObj->id());
-        e.__set_dist(dist);
-
-        if (debugPrint_) {
-          ids.insert(ids.begin(), e.id);
-          dists.insert(dists.begin(), e.dist);
-        }
-
-        string externId;
-
-        if (retExternId || retObj) {
-          CHECK(e.id < externIds_.size());
-          externId = externIds_[e.id];
-          e.__set_externId(externId);
-          externIds.insert(externIds.begin(), e.externId);
-        }
-
-        if (retObj) {
-          const string& s = space_->CreateStrFromObj(pObj, externId);
-          e.__set_obj(s);
-          if (debugPrint_) {
-            objs.insert(objs.begin(), s);
-          }
-        }
-        _return.insert(_return.begin(), e);
+        fillReplyEntry(vResObjs[i], vResDists[i], retExternId, retObj, _return[vResObjs.size() - 1 - i]);
       }
       if (debugPrint_) {
-        for (size_t i = 0; i < ids.size(); ++i) {
-          LOG(LIB_INFO) << "id=" << ids[i] << " dist=" << dists[i] << ( retExternId ? " " + externIds[i] : string(""));
-          if (retObj) LOG(LIB_INFO) << objs[i]; 
-        }
+        printResult(_return, retExternId, retObj);
       }
     } catch (const exception& e) {
         QueryException qe;
@@ -319,9 +749,6 @@ class QueryServiceHandler : virtual public QueryServiceIf {
 
   void knnQuery(ReplyEntryList& _return, const int32_t k, 
                 const std::string& queryObjStr, const bool retExternId, const bool retObj) {
-    // This will increase the counter and prevent modification of query time parameters.
-    LockedCounterManager  mngr(counter_, mtx_);
-
     try {
       if (debugPrint_) {
         LOG(LIB_INFO) << "Running a " << k << "-NN query" << " retExternId=" << retExternId << " retObj=" << retObj;
@@ -330,14 +757,34 @@ class QueryServiceHandler : virtual public QueryServiceIf {
 
       wtm.reset();
 
+      const SteadyClock::time_point deadline = getDeadline();
       unique_ptr<Object>  queryObj(space_->CreateObjFromStr(0, -1, queryObjStr, NULL));
 
-      KNNQuery<dist_t> knn(*space_, queryObj.get(), k);
-      index_->Search(&knn, -1);
-      unique_ptr<KNNQueue<dist_t>> res(knn.Result()->Clone());
+      string cacheKey;
+      uint64_t cacheGeneration = 0;
+      if (cache_) {
+        // Must be obtained before the search starts
+        cacheGeneration = cache_->Generation();
+        cacheKey = getCacheKey(queryObjStr, queryObj.get(), k, retExternId, retObj);
+        if (cache_->Get(cacheKey, _return)) {
+          if (debugPrint_) {
+            LOG(LIB_INFO) << "Found the result in the cache, " << _return.size() << " answers";
+          }
+          return;
+        }
+      }
 
-      _return.clear();
-      _return.reserve(k);
+      DeadlineQuery<KNNQuery, dist_t> knn(deadline, *space_, queryObj.get(), k);
+      std::function<void()> searchFunc = [&]() { index_->Search(&knn, -1); };
+      if (batcher_) {
+        batcher_->Run(searchFunc, deadline);
+      } else {
+        executor_.Run(searchFunc, false, deadline);
+      }
+      if (knn.Expired()) {
+        LOG(LIB_INFO) << "The k-NN query was terminated early, because its deadline expired";
+        throw runtime_error(TRUNCATED_RESULT_MSG);
+      }
 
       wtm.split();
 
@@ -345,55 +792,10 @@ class QueryServiceHandler : virtual public QueryServiceIf {
         LOG(LIB_INFO) << "Finished in: " << wtm.elapsed() / 1e3f << " ms";
       }
 
-      vector<IdType> ids;
-      vector<double> dists;
-      vector<string> objs;
-      vector<string> externIds;
-
-     
-      if (debugPrint_) { 
-        LOG(LIB_INFO) << "Results: ";
-      }
-
-      while (!res->Empty()) {
-        const Object* topObj = res->TopObject();
-        dist_t topDist = res->TopDistance();
-
-        ReplyEntry e;
-
-        e.__set_id(topObj->id());
-        e.__set_dist(topDist);
-
-        if (debugPrint_) {
-          ids.insert(ids.begin(), e.id);
-          dists.insert(dists.begin(), e.dist);
-        }
-
-        string externId;
-
-        if (retExternId || retObj) {
-          CHECK(e.id < externIds_.size());
-          externId = externIds_[e.id];
-          e.__set_externId(externId);
-          externIds.insert(externIds.begin(), e.externId);
-        }
-
-        if (retObj) {
-          const string& s = space_->CreateStrFromObj(topObj, externId);
-          e.__set_obj(s);
-          if (debugPrint_) {
-            objs.insert(objs.begin(), s);
-          }
-        }
-        _return.push_back(e);
-        res->Pop();
-      }
-      std::reverse(_return.begin(), _return.end());
+      fillReply(knn, retExternId, retObj, _return);
+      if (cache_) cache_->Put(cacheKey, _return, cacheGeneration);
       if (debugPrint_) {
-        for (size_t i = 0; i < ids.size(); ++i) {
-          LOG(LIB_INFO) << "id=" << ids[i] << " dist=" << dists[i] << ( retExternId ? " " + externIds[i] : string(""));
-          if (retObj) LOG(LIB_INFO) << objs[i]; 
-        }
+        printResult(_return, retExternId, retObj);
       }
     } catch (const exception& e) {
         QueryException qe;
@@ -411,46 +813,39 @@ class QueryServiceHandler : virtual public QueryServiceIf {
   void knnQueryBatch(ReplyEntryListBatch& _return, const int32_t k,
                      const std::vector<std::string>& queryObjs, const bool retExternId,
                      const bool retObj, const int32_t numThreads) {
-    // This will increase the counter and prevent modification of query time parameters.
-    LockedCounterManager  mngr(counter_, mtx_);
-
     try {
       _return.clear();
       _return.resize(queryObjs.size());
 
-      ParallelFor(0, queryObjs.size(), numThreads, [&](size_t queryIndex, size_t threadId) {
-        unique_ptr<Object>  queryObj(space_->CreateObjFromStr(0, -1, queryObjs[queryIndex], NULL));
-        KNNQuery<dist_t> knn(*space_, queryObj.get(), k);
-        index_->Search(&knn, -1);
-        unique_ptr<KNNQueue<dist_t>> res(knn.Result()->Clone());
-
-        _return[queryIndex].reserve(k);
-        while (!res->Empty()) {
-          const Object* topObj = res->TopObject();
-          dist_t topDist = res->TopDistance();
-
-          ReplyEntry e;
-
-          e.__set_id(topObj->id());
-          e.__set_dist(topDist);
-
-          string externId;
-
-          if (retExternId || retObj) {
-            CHECK(e.id < externIds_.size());
-            externId = externIds_[e.id];
-            e.__set_externId(externId);
-          }
-
-          if (retObj) {
-            const string& s = space_->CreateStrFromObj(topObj, externId);
-            e.__set_obj(s);
+      const SteadyClock::time_point deadline = getDeadline();
+      /*
+       * The batch is processed by (at most) numThreads search threads of the executor,
+       * i.e., it is charged against the same concurrency bound as single-query requests.
+       * Each thread picks the next unprocessed query until all queries are processed.
+       */
+      size_t taskQty = numThreads > 0 ? std::min<size_t>(numThreads, executor_.ThreadQty()) : executor_.ThreadQty();
+      taskQty = std::min(taskQty, queryObjs.size());
+      std::atomic<size_t> nextQueryIndex(0);
+      std::atomic<size_t> expiredQty(0);
+      if (taskQty > 0) executor_.RunParallel([&]() {
+        size_t queryIndex;
+        while ((queryIndex = nextQueryIndex++) < queryObjs.size()) {
+          unique_ptr<Object>  queryObj(space_->CreateObjFromStr(0, -1, queryObjs[queryIndex], NULL));
+          DeadlineQuery<KNNQuery, dist_t> knn(deadline, *space_, queryObj.get(), k);
+          index_->Search(&knn, -1);
+          if (knn.Expired()) {
+            ++expiredQty;
+            // The deadline is shared, hence, the remaining queries would expire as well
+            nextQueryIndex = queryObjs.size();
+            break;
           }
-          _return[queryIndex].push_back(e);
-          res->Pop();
+          fillReply(knn, retExternId, retObj, _return[queryIndex]);
         }
-        std::reverse(_return[queryIndex].begin(), _return[queryIndex].end());
-      });
+      }, taskQty, false, deadline);
+      if (expiredQty) {
+        LOG(LIB_INFO) << "The batch of " << queryObjs.size() << " k-NN queries was terminated early, because its deadline expired";
+        throw runtime_error(TRUNCATED_RESULT_MSG);
+      }
 
     } catch (const exception& e) {
       QueryException qe;
@@ -472,8 +867,99 @@ class QueryServiceHandler : virtual public QueryServiceIf {
   vector<string>              externIds_;
   ObjectVector                dataSet_; 
 
-  int                         counter_; 
-  mutex                       mtx_;
+  // The maximum time to process a query (zero means no limit)
+  std::chrono::milliseconds   queryTimeout_;
+  SearchExecutor              executor_;
+  // batches single k-NN queries (or nullptr if batching is disabled)
+  unique_ptr<QueryBatcher>    batcher_;
+  // if true, answer objects are returned as raw binary data rather than strings
+  bool                        binaryObj_;
+
+  void fillReplyEntry(const Object* pObj, dist_t dist, bool retExternId, bool retObj, ReplyEntry& e) const {
+    e.__set_id(pObj->id());
+    e.__set_dist(dist);
+    if (retExternId || retObj) {
+      CHECK(e.id < externIds_.size());
+      e.__set_externId(externIds_[e.id]);
+    }
+    if (retObj) {
+      /*
+       * The binary format is the in-memory representation of the object, e.g.,
+       * an array of floats for dense vectors. It is much cheaper to produce
+       * than the text format, which requires formatting each vector element.
+       */
+      if (binaryObj_) {
+        e.obj.assign(pObj->data(), pObj->datalength());
+        e.__isset.obj = true;
+      } else {
+        e.__set_obj(space_->CreateStrFromObj(pObj, e.externId));
+      }
+    }
+  }
+
+  /*
+   * Fills the reply with the k-NN answers (the closest one goes first).
+   * Objects at the "infinite" distance aren't real neighbors and are skipped.
+   */
+  void fillReply(const KNNQuery<dist_t>& knn, bool retExternId, bool retObj, ReplyEntryList& res) const {
+    unique_ptr<KNNQueue<dist_t>> queue(knn.Result()->Clone());
+    // The queue pops the farthest answer first
+    while (!queue->Empty() && queue->TopDistance() >= DistMax<dist_t>()) queue->Pop();
+    res.clear();
+    res.resize(queue->Size());
+    for (size_t i = res.size(); i > 0; --i) {
+      fillReplyEntry(queue->TopObject(), queue->TopDistance(), retExternId, retObj, res[i - 1]);
+      queue->Pop();
+    }
+  }
+
+  void printResult(const ReplyEntryList& res, bool retExternId, bool retObj) const {
+    LOG(LIB_INFO) << "Results: ";
+    for (const ReplyEntry& e : res) {
+      LOG(LIB_INFO) << "id=" << e.id << " dist=" << e.dist << ( retExternId ? " " + e.externId : string(""));
+      if (retObj && !binaryObj_) LOG(LIB_INFO) << e.obj;
+    }
+  }
+
+  // caches k-NN results (or nullptr if caching is disabled)
+  unique_ptr<QueryResultCache> cache_;
+  // if positive, elements of dense vectors are quantized before computing cache keys
+  float                       cacheQuantStep_;
+
+  /*
+   * The cache key includes all the parameters affecting the result. By default, the key
+   * contains the query string. If the quantization step is positive and the space is
+   * a dense vector space, the key contains elements of the query vector divided
+   * by the step and rounded. Then, nearly identical vectors share the key (unless
+   * their elements fall on the opposite sides of a quantization boundary).
+   */
+  string getCacheKey(const string& queryObjStr, const Object* queryObj,
+                     int32_t k, bool retExternId, bool retObj) const {
+    string key;
+    key.append(reinterpret_cast<const char*>(&k), sizeof k);
+    key.push_back(retExternId ? '1' : '0');
+    key.push_back(retObj ? '1' : '0');
+
+    const VectorSpace<dist_t>* vectSpace = dynamic_cast<const VectorSpace<dist_t>*>(space_.get());
+    if (cacheQuantStep_ > 0 && vectSpace != nullptr) {
+      key.push_back('q');
+      // Elements aren't necessarily stored as dist_t (e.g., in half-precision spaces)
+      vector<dist_t> vect(vectSpace->GetElemQty(queryObj));
+      vectSpace->CreateDenseVectFromObj(queryObj, vect.data(), vect.size());
+      for (dist_t elem : vect) {
+        int64_t q = static_cast<int64_t>(std::floor(elem / cacheQuantStep_));
+        key.append(reinterpret_cast<const char*>(&q), sizeof q);
+      }
+    } else {
+      key.push_back('s');
+      key.append(queryObjStr);
+    }
+    return key;
+  }
+
+  SteadyClock::time_point getDeadline() const {
+    return queryTimeout_.count() ? SteadyClock::now() + queryTimeout_ : SteadyClock::time_point::max();
+  }
 };
 
 namespace po = boost::program_options;
@@ -491,6 +977,16 @@ void ParseCommandLineForServer(int argc, char*argv[],
                       bool&                   CacheData,
                       int&                    port,
                       size_t&                 threadQty,
+                      size_t&                 searchThreadQty,
+                      size_t&                 maxQueueQty,
+                      unsigned&               queryTimeoutMs,
+                      unsigned&               batchWindowUs,
+                      size_t&                 maxBatchQty,
+                      bool&                   pinThreads,
+                      size_t&                 cacheMaxMB,
+                      float&                  cacheQuantStep,
+                      bool&                   binaryObj,
+                      bool&                   framedTransport,
                       string&                 LogFile,
                       string&                 DistType,
                       string&                 SpaceType,
@@ -513,6 +1009,26 @@ void ParseCommandLineForServer(int argc, char*argv[],
     (DEBUG_PARAM_OPT.c_str(),         po::bool_switch(&debugPrint), DEBUG_PARAM_MSG.c_str())
     (PORT_PARAM_OPT.c_str(),          po::value<int>(&port)->required(), PORT_PARAM_MSG.c_str())
     (THREAD_PARAM_OPT.c_str(),        po::value<size_t>(&threadQty)->default_value(defaultThreadQty), THREAD_PARAM_MSG.c_str())
+    ("searchThreadQty",               po::value<size_t>(&searchThreadQty)->default_value(std::max<size_t>(1, thread::hardware_concurrency())),
+                                      "A number of threads that execute searches (server threads merely queue requests)")
+    ("maxQueueQty",                   po::value<size_t>(&maxQueueQty)->default_value(0),
+                                      "A maximum number of queued requests, further requests are rejected (0 means no limit)")
+    ("queryTimeoutMs",                po::value<unsigned>(&queryTimeoutMs)->default_value(0),
+                                      "A per-request deadline in ms: expired requests aren't started, searches are terminated early and the requests fail (0 means no limit)")
+    ("batchWindowUs",                 po::value<unsigned>(&batchWindowUs)->default_value(0),
+                                      "Concurrent k-NN requests arriving within this window (in microseconds) are processed as a batch (0 disables batching)")
+    ("maxBatchQty",                   po::value<size_t>(&maxBatchQty)->default_value(64),
+                                      "A maximum number of requests in a batch")
+    ("pinThreads",                    po::bool_switch(&pinThreads),
+                                      "Pin threads of the search thread pool to CPU cores")
+    ("cacheMaxMB",                    po::value<size_t>(&cacheMaxMB)->default_value(0),
+                                      "A memory limit (in MB) for the cache of k-NN results (0 disables caching)")
+    ("cacheQuantStep",                po::value<float>(&cacheQuantStep)->default_value(0),
+                                      "If positive, nearly identical dense query vectors are matched in the cache after quantizing their elements using this step")
+    ("binaryObj",                     po::bool_switch(&binaryObj),
+                                      "Return answer objects in the binary (in-memory) format rather than as strings")
+    ("framedTransport",               po::bool_switch(&framedTransport),
+                                      "Use the framed rather than the buffered Thrift transport")
     (LOG_FILE_PARAM_OPT.c_str(),      po::value<string>(&LogFile)->default_value(LOG_FILE_PARAM_DEFAULT), LOG_FILE_PARAM_MSG.c_str())
     (SPACE_TYPE_PARAM_OPT.c_str(),    po::value<string>(&spaceParamStr)->required(),                SPACE_TYPE_PARAM_MSG.c_str())
     (DIST_TYPE_PARAM_OPT.c_str(),     po::value<string>(&DistType)->default_value(DIST_TYPE_FLOAT), DIST_TYPE_PARAM_MSG.c_str())
@@ -585,6 +1101,16 @@ int main(int argc, char *argv[]) {
   bool        debugPrint = 0;
   int         port = 0;
   size_t      threadQty = 0;
+  size_t      searchThreadQty = 0;
+  size_t      maxQueueQty = 0;
+  unsigned    queryTimeoutMs = 0;
+  unsigned    batchWindowUs = 0;
+  size_t      maxBatchQty = 0;
+  bool        pinThreads = false;
+  size_t      cacheMaxMB = 0;
+  float       cacheQuantStep = 0;
+  bool        binaryObj = false;
+  bool        framedTransport = false;
   string      LogFile;
   string      DistType;
   string      SpaceType;
@@ -607,6 +1133,16 @@ int main(int argc, char *argv[]) {
                       CacheData,
                       port,
                       threadQty,
+                      searchThreadQty,
+                      maxQueueQty,
+                      queryTimeoutMs,
+                      batchWindowUs,
+                      maxBatchQty,
+                      pinThreads,
+                      cacheMaxMB,
+                      cacheQuantStep,
+                      binaryObj,
+                      framedTransport,
                       LogFile,
                       DistType,
                       SpaceType,
@@ -620,6 +1156,9 @@ int main(int argc, char *argv[]) {
 
   initLibrary(0, LogFile.empty() ? LIB_LOGSTDERR:LIB_LOGFILE, LogFile.c_str());
 
+  // Must be done before the index is created: the global pool is created on the first use
+  ThreadPool::SetGlobalConfig(searchThreadQty, pinThreads);
+
   ToLower(DistType);
 
   unique_ptr<QueryServiceIf>   queryHandler;
@@ -635,7 +1174,15 @@ int main(int argc, char *argv[]) {
                                                     SaveIndexLoc,
                                                     CacheData,
                                                     *IndexParams,
-                                                    *QueryTimeParams));
+                                                    *QueryTimeParams,
+                                                    searchThreadQty,
+                                                    maxQueueQty,
+                                                    queryTimeoutMs,
+                                                    batchWindowUs,
+                                                    maxBatchQty,
+                                                    cacheMaxMB,
+                                                    cacheQuantStep,
+                                                    binaryObj));
   } else if (DIST_TYPE_FLOAT == DistType) {
     queryHandler.reset(new QueryServiceHandler<float>(debugPrint,
                                                     SpaceType,
@@ -647,7 +1194,15 @@ int main(int argc, char *argv[]) {
                                                     SaveIndexLoc,
                                                     CacheData,
                                                     *IndexParams,
-                                                    *QueryTimeParams));
+                                                    *QueryTimeParams,
+                                                    searchThreadQty,
+                                                    maxQueueQty,
+                                                    queryTimeoutMs,
+                                                    batchWindowUs,
+                                                    maxBatchQty,
+                                                    cacheMaxMB,
+                                                    cacheQuantStep,
+                                                    binaryObj));
   } else {
     LOG(LIB_FATAL) << "Unknown distance value type: " << DistType;
   }
@@ -655,7 +1210,12 @@ int main(int argc, char *argv[]) {
   ::apache::thrift::stdcxx::shared_ptr<QueryServiceIf> handler(queryHandler.get());
   ::apache::thrift::stdcxx::shared_ptr<TProcessor> processor(new QueryServiceProcessor(handler));
   ::apache::thrift::stdcxx::shared_ptr<TServerTransport> serverTransport(new TServerSocket(port));
-  ::apache::thrift::stdcxx::shared_ptr<TTransportFactory> transportFactory(new TBufferedTransportFactory());
+  ::apache::thrift::stdcxx::shared_ptr<TTransportFactory> transportFactory;
+  if (framedTransport) {
+    transportFactory.reset(new TFramedTransportFactory());
+  } else {
+    transportFactory.reset(new TBufferedTransportFactory());
+  }
   ::apache::thrift::stdcxx::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
 
 #if SIMPLE_SERVER
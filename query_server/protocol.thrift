@@ -19,7 +19,9 @@ service QueryService {
   /*
    * This function allows one to set query-time parameters.
    * Currently, this has a global effect for all subsequent queries.
-   * Therefore, this call shouldn't overlap in time with search.
+   * Searches in progress finish with the old parameters. Depending
+   * on the method, either they aren't blocked (e.g., HNSW and SW-graph),
+   * or the call waits until they finish.
    * Note that the call *IS* thread-safe, however, different
    * threads concurrently calling this method will merely override 
    * same global variables. As a result, we will see the settings
@@ -28,6 +28,7 @@ parser.add_argument('-r', '--range', help='range for the range search', action='
 parser.add_argument('-t', '--queryTimeParams', help='Query time parameter', action='store', default='')
 parser.add_argument('-o', '--retObj', help='Return string representation of found objects?', action='store_true', default=False)
 parser.add_argument('-e', '--retExternId', help='Return external IDs?', action='store_true', default=False)
+parser.add_argument('--framedTransport', help='Use the framed transport (the server should use it too)?', action='store_true', default=False)
 
 args = parser.parse_args()
 
@@ -42,7 +43,10 @@ try:
   # Make socket
   transport = TSocket.TSocket(host, port)
   # Buffering is critical. Raw sockets are very slow
-  transport = TTransport.TBufferedTransport(transport)
+  if args.framedTransport:
+    transport = TTransport.TFramedTransport(transport)
+  else:
+    transport = TTransport.TBufferedTransport(transport)
   # Wrap in a protocol
   protocol = TBinaryProtocol.TBinaryProtocol(transport)
 
@@ -19,17 +19,22 @@
 #include <iostream>
 #include <memory>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 
 #include "init.h"
 #include "space.h"
+#include "knnquery.h"
 #include "space/space_leven.h"
 #include "space/space_sparse_lp.h"
 #include "space/space_sparse_scalar.h"
 #include "space/space_sparse_vector_inter.h"
 #include "space/space_sparse_scalar_fast.h"
+#include "space/space_sparse_quant.h"
 #include "space/space_sparse_vector.h"
 #include "space/space_scalar.h"
 #include "space/space_sparse_jaccard.h"
+#include "space/space_sparse_dense_fusion.h"
 #ifdef WITH_EXTRAS
 #include "space/space_sqfd.h"
 #endif
@@ -1538,6 +1543,115 @@ void TestSparseQueryNormNegativeScalarProductFast(const string& dataFile, size_t
 }
 
 
+// Generates qty sparse vector elements with distinct ids in [0, maxId)
+void GenSparseVectUniform(size_t qty, size_t maxId, vector<SparseVectElem<float>>& res) {
+  vector<IdType> ids;
+  while (ids.size() < qty) {
+    ids.push_back(RandomInt() % maxId);
+    if (ids.size() == qty) {
+      sort(ids.begin(), ids.end());
+      ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    }
+  }
+  res.clear();
+  for (IdType id : ids) res.push_back(SparseVectElem<float>(id, RandomReal<float>()));
+}
+
+/*
+ * Re-ranking N data vectors (dataQty elements each) for a long query (queryQty elements):
+ * the SIMD intersection (the query is passed as an object) is compared against 
+ * the query object, which scatters the query in advance and uses the gather pass (if it is faster).
+ */
+void TestSparseNegativeScalarProductFastScattered(size_t N, size_t queryQty, size_t dataQty, size_t maxId, size_t Rep) {
+    typedef float T;
+
+    unique_ptr<SpaceSparseNegativeScalarProductFast>  space(new SpaceSparseNegativeScalarProductFast());
+    ObjectVector                                      elems;
+    vector<SparseVectElem<T>>                         v;
+
+    for (size_t i = 0; i < N; ++i) {
+      GenSparseVectUniform(dataQty, maxId, v);
+      elems.push_back(space->CreateObjFromVect(i, -1, v));
+    }
+    GenSparseVectUniform(queryQty, maxId, v);
+    unique_ptr<Object> pQueryObj(space->CreateObjFromVect(N, -1, v));
+
+    for (bool bScatter : {false, true}) {
+      KNNQuery<T> query(*space, pQueryObj.get(), 10);
+
+      WallClockTimer  t;
+
+      t.reset();
+
+      T DiffSum = 0;
+
+      T fract = T(1)/N;
+
+      for (size_t i = 0; i < Rep; ++i) {
+          for (size_t j = 0; j < N; ++j) {
+              T dist = bScatter ? query.DistanceObjLeft(elems[j]) : space->IndexTimeDistance(elems[j], pQueryObj.get());
+              DiffSum += 0.01f * dist / N;
+          }
+          DiffSum *= fract;
+      }
+
+      uint64_t tDiff = t.split();
+
+      LOG(LIB_INFO) << "Ignore: " << DiffSum;
+      LOG(LIB_INFO) << typeid(T).name() << " query qty: " << queryQty << " data qty: " << dataQty << " max id: " << maxId <<
+              (bScatter ? " scattered query" : " intersection") <<
+              " Elapsed: " << tDiff / 1e3 << " ms " << 
+              " # of (fast) negative scalar/dot product dist second: " << (1e6/tDiff) * N * Rep ;
+    }
+
+    for (const Object* o : elems) delete o;
+}
+
+/*
+ * Computing negative scalar products between N sparse vectors (elemQty elements each)
+ * stored in the format of the space SpaceType. The average object size is reported as well.
+ */
+template <class SpaceType>
+void TestSparseNegativeScalarProductFormat(size_t N, size_t elemQty, size_t maxId, size_t Rep) {
+    typedef float T;
+
+    unique_ptr<SpaceType>         space(new SpaceType());
+    ObjectVector                  elems;
+    vector<SparseVectElem<T>>     v;
+
+    size_t totSize = 0;
+    for (size_t i = 0; i < N; ++i) {
+      GenSparseVectUniform(elemQty, maxId, v);
+      elems.push_back(space->CreateObjFromVect(i, -1, v));
+      totSize += elems.back()->datalength();
+    }
+
+    WallClockTimer  t;
+
+    t.reset();
+
+    T DiffSum = 0;
+
+    T fract = T(1)/N;
+
+    for (size_t i = 0; i < Rep; ++i) {
+        for (size_t j = 1; j < N; ++j) {
+            DiffSum += 0.01f * space->IndexTimeDistance(elems[j-1], elems[j]) / N;
+        }
+        DiffSum *= fract;
+    }
+
+    uint64_t tDiff = t.split();
+
+    LOG(LIB_INFO) << "Ignore: " << DiffSum;
+    LOG(LIB_INFO) << space->StrDesc() << " elem qty: " << elemQty << " max id: " << maxId <<
+            " bytes per object: " << totSize / N <<
+            " Elapsed: " << tDiff / 1e3 << " ms " <<
+            " # of negative scalar/dot product dist second: " << (1e6/tDiff) * (N - 1) * Rep ;
+
+    for (const Object* o : elems) delete o;
+}
+
 template <class T>
 void TestSparseCosineSimilarity(const string& dataFile, size_t N, size_t Rep) {
     unique_ptr<SpaceSparseCosineSimilarity<T>>  space(new SpaceSparseCosineSimilarity<T>());
@@ -1879,17 +1993,19 @@ void TestAngularDistance(size_t N, size_t dim, size_t Rep) {
 
 }
 
+template <class uint_t>
 void TestBitHamming(size_t N, size_t dim, size_t Rep) {
-    size_t WordQty = (dim + 31)/32; 
-    uint32_t* pArr = new uint32_t[N * WordQty];
+    const size_t WordBitQty = 8 * sizeof(uint_t);
+    size_t WordQty = (dim + WordBitQty - 1)/WordBitQty; 
+    uint_t* pArr = new uint_t[N * WordQty];
 
-    uint32_t *p = pArr;
+    uint_t *p = pArr;
     for (size_t i = 0; i < N; ++i, p+= WordQty) {
         vector<PivotIdType> perm(dim);
         GenRandIntVect(&perm[0], dim);
         for (unsigned j = 0; j < dim; ++j)
           perm[j] = perm[j] % 2;
-        vector<uint32_t> h;
+        vector<uint_t> h;
         Binarize(perm, 1, h); 
         CHECK(h.size() == WordQty);
         memcpy(p, &h[0], WordQty * sizeof(h[0]));
@@ -1918,7 +2034,7 @@ void TestBitHamming(size_t N, size_t dim, size_t Rep) {
     uint64_t tDiff = t.split();
 
     LOG(LIB_INFO) << "Ignore: " << DiffSum;
-    LOG(LIB_INFO) << "Elapsed: " << tDiff / 1e3 << " ms " << " # of BitHamming per second: " << (1e6/tDiff) * N * Rep ;
+    LOG(LIB_INFO) << "Elapsed: " << tDiff / 1e3 << " ms " << " # of BitHamming (" << WordBitQty << "-bit words) per second: " << (1e6/tDiff) * N * Rep ;
 
     delete [] pArr;
 
@@ -2011,6 +2127,94 @@ void TestSparseJaccardSimilarity(const string& dataFile, size_t N, size_t Rep) {
 
 }
 
+template <class T>
+void WriteFusionPOD(ofstream& out, T val) {
+  out.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+/*
+ * Hybrid lexical+semantic entries: a sparse vector with sparseQty elements
+ * (ids are drawn from a 10x larger range) followed by two dense vectors.
+ * Data and weight files are created in the current directory and deleted afterwards.
+ */
+void TestSparseDenseFusion(size_t N, size_t sparseQty, size_t dim, size_t Rep) {
+    typedef float T;
+
+    const string weightFileName = "tmp_bench_fusion_weights.txt";
+    const string dataFileName   = "tmp_bench_fusion_data.bin";
+    {
+      ofstream out(weightFileName);
+      out << "queryWeights: 0.5 0.3 0.2" << endl;
+      out << "indexWeights: 0.5 0.3 0.2" << endl;
+    }
+    {
+      ofstream out(dataFileName, ios::binary);
+      WriteFusionPOD(out, uint32_t(N));
+      WriteFusionPOD(out, uint32_t(3));
+      WriteFusionPOD(out, uint32_t(1)); WriteFusionPOD(out, uint32_t(0));
+      WriteFusionPOD(out, uint32_t(0)); WriteFusionPOD(out, uint32_t(dim));
+      WriteFusionPOD(out, uint32_t(0)); WriteFusionPOD(out, uint32_t(dim));
+
+      vector<T> vect(dim);
+      for (size_t i = 0; i < N; ++i) {
+        string id = "doc" + ConvertToString(i);
+        WriteFusionPOD(out, uint32_t(id.size()));
+        out.write(id.data(), id.size());
+
+        WriteFusionPOD(out, uint32_t(sparseQty));
+        for (size_t k = 0; k < sparseQty; ++k) {
+          WriteFusionPOD(out, uint32_t(k * 10 + RandomInt() % 10));
+          WriteFusionPOD(out, RandomReal<T>());
+        }
+        for (size_t k = 0; k < 2; ++k) {
+          GenRandVect(&vect[0], dim, -T(1), T(1));
+          WriteFusionPOD(out, uint32_t(dim));
+          for (T v : vect) WriteFusionPOD(out, v);
+        }
+      }
+    }
+
+    unique_ptr<Space<T>>  space(new SpaceSparseDenseFusion(weightFileName));
+    ObjectVector          elems;
+    vector<string>        tmp;
+
+    unique_ptr<DataFileInputState> inpState(space->ReadDataset(elems, tmp, dataFileName, N));
+    space->UpdateParamsFromFile(*inpState);
+
+    N = min(N, elems.size());
+
+    WallClockTimer  t;
+
+    t.reset();
+
+    T DiffSum = 0;
+
+    T fract = T(1)/N;
+
+    for (size_t i = 0; i < Rep; ++i) {
+        for (size_t j = 1; j < N; ++j) {
+            DiffSum += 0.01f * space->IndexTimeDistance(elems[j-1], elems[j]) / N;
+        }
+        /* 
+         * Multiplying by 0.01 and dividing the sum by N is to prevent Intel from "cheating":
+         *
+         * http://searchivarius.org/blog/problem-previous-version-intels-library-benchmark
+         */
+        DiffSum *= fract;
+    }
+
+    uint64_t tDiff = t.split();
+
+    LOG(LIB_INFO) << "Ignore: " << DiffSum;
+    LOG(LIB_INFO) << typeid(T).name() << " # of sparse elements: " << sparseQty << " dense dim: " << dim <<
+            " Elapsed: " << tDiff / 1e3 << " ms " << 
+            " # of sparse-dense fusion dist second: " << (1e6/tDiff) * N * Rep ;
+
+    for (const Object* o : elems) delete o;
+    remove(weightFileName.c_str());
+    remove(dataFileName.c_str());
+}
+
 template <class T>
 void TestRenyiDivSlow(size_t N, size_t dim, size_t Rep, T alpha) {
     T* pArr = new T[N * dim];
@@ -2127,17 +2331,29 @@ int main(int argc, char* argv[]) {
     TestLevenshtein(10000, 50);
 
     nTest++;
-    TestBitHamming(1000, 32, 50000);
+    TestBitHamming<uint32_t>(1000, 32, 50000);
+    nTest++;
+    TestBitHamming<uint64_t>(1000, 32, 50000);
+    nTest++;
+    TestBitHamming<uint32_t>(1000, 64, 25000);
+    nTest++;
+    TestBitHamming<uint64_t>(1000, 64, 25000);
+    nTest++;
+    TestBitHamming<uint32_t>(1000, 128, 12000);
+    nTest++;
+    TestBitHamming<uint64_t>(1000, 128, 12000);
     nTest++;
-    TestBitHamming(1000, 64, 25000);
+    TestBitHamming<uint32_t>(1000, 256, 6000);
     nTest++;
-    TestBitHamming(1000, 128, 12000);
+    TestBitHamming<uint64_t>(1000, 256, 6000);
     nTest++;
-    TestBitHamming(1000, 256, 6000);
+    TestBitHamming<uint32_t>(1000, 512, 3000);
     nTest++;
-    TestBitHamming(1000, 512, 3000);
+    TestBitHamming<uint64_t>(1000, 512, 3000);
     nTest++;
-    TestBitHamming(1000, 1024, 1500);
+    TestBitHamming<uint32_t>(1000, 1024, 1500);
+    nTest++;
+    TestBitHamming<uint64_t>(1000, 1024, 1500);
 
     nTest++;
     TestBitJaccard(1000, 32, 50000);
@@ -2191,6 +2407,24 @@ int main(int argc, char* argv[]) {
     nTest++;
     TestSparseAngularDistanceFast(sampleDataPrefix + "sparse_wiki_5K.txt", 1000, 1000);
 
+    nTest++;
+    TestSparseNegativeScalarProductFastScattered(10000, 300, 30, 100000, 100);
+    nTest++;
+    TestSparseNegativeScalarProductFastScattered(10000, 300, 30, 5000, 100);
+    nTest++;
+    TestSparseNegativeScalarProductFastScattered(10000, 300, 300, 100000, 100);
+    nTest++;
+    TestSparseNegativeScalarProductFastScattered(10000, 1000, 30, 5000000, 20);
+
+    for (size_t maxId : {20000, 1000000}) {
+      nTest++;
+      TestSparseNegativeScalarProductFormat<SpaceSparseNegativeScalarProductFast>(10000, 200, maxId, 20);
+      nTest++;
+      TestSparseNegativeScalarProductFormat<SpaceSparseNegativeScalarProductQuant<int8_t>>(10000, 200, maxId, 20);
+      nTest++;
+      TestSparseNegativeScalarProductFormat<SpaceSparseNegativeScalarProductQuant<int16_t>>(10000, 200, maxId, 20);
+    }
+
     nTest++;
     TestSparseCosineSimilarity<float>(sampleDataPrefix + "sparse_5K.txt", 1000, 1000);
     nTest++;
@@ -2211,6 +2445,11 @@ int main(int argc, char* argv[]) {
     nTest++;
     TestSparseJaccardSimilarity<float>(sampleDataPrefix + "sparse_ids_5K.txt", 1000, 1000);
 
+    nTest++;
+    TestSparseDenseFusion(1000, 16, 64, 1000);
+    nTest++;
+    TestSparseDenseFusion(1000, 128, 384, 300);
+
     LOG(LIB_INFO) << "Single-precision (sparse) LP-distance tests";
     nTest++;
     TestSparseLp<float>(1000, 1000, -1);
@@ -0,0 +1,82 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "init.h"
+#include "logging.h"
+#include "thread_pool.h"
+#include "ztimer.h"
+
+using namespace similarity;
+using namespace std;
+
+/*
+ * A micro-benchmark: small parallel loops (e.g., a batch of a few queries)
+ * using the persistent thread pool vs. spawning threads for each loop.
+ */
+void BenchParallelForOverhead(size_t numThreads, size_t loopQty, size_t itemQty) {
+  vector<size_t> res(itemQty);
+
+  WallClockTimer timer;
+  timer.reset();
+  for (size_t k = 0; k < loopQty; ++k) {
+    ParallelFor(0, itemQty, numThreads, [&](size_t id, size_t) { res[id] += id; });
+  }
+  timer.split();
+  uint64_t poolTime = timer.elapsed();
+
+  timer.reset();
+  for (size_t k = 0; k < loopQty; ++k) {
+    atomic<size_t> current(0);
+    vector<thread> threads;
+    for (size_t threadId = 0; threadId < numThreads; ++threadId) {
+      threads.push_back(thread([&] {
+        size_t id;
+        while ((id = current.fetch_add(1)) < itemQty) res[id] += id;
+      }));
+    }
+    for (auto& thread : threads) thread.join();
+  }
+  timer.split();
+  uint64_t spawnTime = timer.elapsed();
+
+  for (size_t id = 0; id < itemQty; ++id) {
+    CHECK_MSG(res[id] == 2 * loopQty * id, "Bug: wrong result of the parallel loop");
+  }
+
+  LOG(LIB_INFO) << "# of threads: " << numThreads << " # of items: " << itemQty;
+  LOG(LIB_INFO) << "Average time per parallel loop (microseconds): thread pool: "
+                << double(poolTime) / loopQty << " spawning threads: " << double(spawnTime) / loopQty;
+}
+
+int main(int argc, char* argv[]) {
+  string LogFile;
+  if (argc == 2) LogFile = argv[1];
+  initLibrary(0, LogFile.empty() ? LIB_LOGSTDERR:LIB_LOGFILE, LogFile.c_str());
+
+  const size_t loopQty = 2000;
+
+  for (size_t numThreads : {2, 4, 8}) {
+    for (size_t itemQty : {4, 16, 256}) {
+      BenchParallelForOverhead(numThreads, loopQty, itemQty);
+    }
+  }
+
+  return 0;
+}
@@ -40,6 +40,7 @@
 #include "meta_analysis.h"
 #include "params.h"
 #include "params_cmdline.h"
+#include "thread_pool.h"
 
 using namespace similarity;
 
@@ -94,7 +95,7 @@ void ProcessResults(const ExperimentConfig<dist_t>& config,
 
   ExpRes.ComputeAll();
 
-  Header << "MethodName\tRecall\tRecall@1\tPrecisionOfApprox\tRelPosError\tNumCloser\tClassAccuracy\tQueryTime\tDistComp\tImprEfficiency\tImprDistComp\tMem\tIndexTime\tIndexLoadTime\tIndexSaveTime\tQueryPerSec\tIndexParams\tQueryTimeParams\tNumData" << std::endl;
+  Header << "MethodName\tRecall\tRecall@1\tPrecisionOfApprox\tRelPosError\tNumCloser\tClassAccuracy\tQueryTime\tDistComp\tImprEfficiency\tImprDistComp\tMem\tIndexTime\tIndexLoadTime\tIndexSaveTime\tQueryPerSec\tIndexParams\tQueryTimeParams\tNumData\tQueryTimeP50\tQueryTimeP90\tQueryTimeP99\tQueryTimeP999" << std::endl;
 
   Data << "\"" << MethodName << "\"\t";
   Data << ExpRes.GetRecallAvg() << "\t";
@@ -114,7 +115,11 @@ void ProcessResults(const ExperimentConfig<dist_t>& config,
   Data << ExpRes.GetQueryPerSecAvg() << "\t";
   Data << "\"" << IndexParamStr << "\"" << "\t";
   Data << "\"" << QueryTimeParamStr << "\"" << "\t";
-  Data << config.GetDataObjects().size();
+  Data << config.GetDataObjects().size() << "\t";
+  Data << ExpRes.GetQueryTimeP50Avg() << "\t";
+  Data << ExpRes.GetQueryTimeP90Avg() << "\t";
+  Data << ExpRes.GetQueryTimeP99Avg() << "\t";
+  Data << ExpRes.GetQueryTimeP999Avg();
   Data << std::endl;
 
   PrintStr  = produceHumanReadableReport(config, ExpRes, MethodName, IndexParamStr, QueryTimeParamStr);
@@ -133,6 +138,7 @@ void RunExper(bool                                bPrintProgress,
              const string                         SpaceType,
              const shared_ptr<AnyParams>&         SpaceParams,
              unsigned                             ThreadTestQty,
+             const vector<double>&                LoadQPS,
              bool                                 DoAppend, 
              const string&                        ResFilePrefix,
              unsigned                             TestSetQty,
@@ -154,11 +160,15 @@ void RunExper(bool                                bPrintProgress,
 
   bool bWriteGSCache = false;
   bool bReadGSCache = false;
+  bool bExtendGSCache = false;
   bool bFail = false;
   bool bCacheGS = !CacheGSFilePrefix.empty();
 
   unique_ptr<fstream>      cacheGSControl;
   unique_ptr<fstream>      cacheGSBinary;
+  // If the data set grows, the extended cache is written to these files first
+  unique_ptr<fstream>      extCacheGSControl;
+  unique_ptr<fstream>      extCacheGSBinary;
 
   if (!RangeArg.empty()) {
     if (!SplitStr(RangeArg, range, ',')) {
@@ -178,10 +188,12 @@ void RunExper(bool                                bPrintProgress,
   size_t cacheDataSetQty = 0;
 
   const string& cacheGSIncompleteFlagName = CacheGSFilePrefix + "_incomplete.flag";
+  const string& cacheGSControlName = CacheGSFilePrefix + "_ctrl.txt";
+  const string& cacheGSBinaryName  = CacheGSFilePrefix + "_data.bin";
+  const string& extCacheGSControlName = cacheGSControlName + ".tmp";
+  const string& extCacheGSBinaryName  = cacheGSBinaryName + ".tmp";
 
   if (bCacheGS) {
-    const string& cacheGSControlName = CacheGSFilePrefix + "_ctrl.txt";
-    const string& cacheGSBinaryName  = CacheGSFilePrefix + "_data.bin";
 
     if (DoesFileExist(cacheGSIncompleteFlagName) ||
         (DoesFileExist(cacheGSControlName) != DoesFileExist(cacheGSBinaryName))
@@ -246,11 +258,35 @@ void RunExper(bool                                bPrintProgress,
     // Let's check the number of data entries, must exactly coincide with
     // what was used to create the cache!
     if (config.GetOrigDataQty() != cacheDataSetQty) {
-      stringstream err;
-      err << "The number of entries in the file, or the maximum number "
-          << "of data elements don't match the value in the cache file: "
-          << cacheDataSetQty;
-      throw runtime_error(err.str());
+      /*
+       * New data points are always added to the data set (and never to query sets),
+       * so the cache can be extended, but only if it's going to be fully read.
+       */
+      if (config.GetOrigDataQty() < cacheDataSetQty ||
+          config.GetTestSetToRunQty() != config.GetTestSetTotalQty() ||
+          config.GetQueryToRunQty() != config.GetTotalQueryQty()) {
+        stringstream err;
+        err << "The number of entries in the file, or the maximum number "
+            << "of data elements don't match the value in the cache file: "
+            << cacheDataSetQty
+            << " (the cache can be extended only if the data set grows and"
+            << " all cached test sets and queries are used)";
+        throw runtime_error(err.str());
+      }
+      LOG(LIB_INFO) << "The data set has " << (config.GetOrigDataQty() - cacheDataSetQty)
+                    << " new data points, the gold standard cache will be extended";
+      bExtendGSCache = true;
+
+      extCacheGSControl.reset(new fstream(extCacheGSControlName.c_str(),
+                                          std::ios::trunc | std::ios::out));
+      extCacheGSBinary.reset(new fstream(extCacheGSBinaryName.c_str(),
+                                          std::ios::trunc | std::ios::out |
+                                          // On Windows you don't get a proper binary stream without ios::binary!
+                                          ios::binary));
+      extCacheGSControl->exceptions(std::ios::badbit);
+      extCacheGSBinary->exceptions(std::ios::badbit);
+
+      config.Write(*extCacheGSControl, *extCacheGSBinary);
     }
   }
 
@@ -317,6 +353,25 @@ void RunExper(bool                                bPrintProgress,
       CHECK_MSG(savedThreadQty == ThreadTestQty,
                 "Error: the gold standard was computed using " +ConvertToString(savedThreadQty) + " threads, but the current test will use "  +
                 ConvertToString(ThreadTestQty) + " threads. You have to use the same number of threads while computing gold standard data and testing!");
+      if (bExtendGSCache) {
+        // Old data points precede new ones, and all new points are in the data set
+        const size_t newDataQty = config.GetOrigDataQty() - cacheDataSetQty;
+        managerGS.Extend(ThreadTestQty, maxCacheGSRelativeQty, config.GetDataObjects().size() - newDataQty);
+        managerGS.Write(*extCacheGSControl, *extCacheGSBinary, TestSetId, ThreadTestQty);
+
+        // The extended cache replaces the old one only after all test sets are processed
+        if (TestSetId + 1 == config.GetTestSetToRunQty()) {
+          cacheGSControl.reset();
+          cacheGSBinary.reset();
+          extCacheGSControl.reset();
+          extCacheGSBinary.reset();
+          CHECK_MSG(std::rename(extCacheGSControlName.c_str(), cacheGSControlName.c_str()) == 0,
+                    "Error renaming the file: " + extCacheGSControlName);
+          CHECK_MSG(std::rename(extCacheGSBinaryName.c_str(), cacheGSBinaryName.c_str()) == 0,
+                    "Error renaming the file: " + extCacheGSBinaryName);
+          LOG(LIB_INFO) << "The gold standard cache is extended";
+        }
+      }
     } else {
       managerGS.Compute(ThreadTestQty, maxCacheGSRelativeQty);
       if (bWriteGSCache) {
@@ -429,7 +484,8 @@ void RunExper(bool                                bPrintProgress,
                                     ExpResRange, ExpResKNN,
                                     config, 
                                     *IndexPtr, 
-                                    QueryTimeParams);
+                                    QueryTimeParams,
+                                    LoadQPS);
 
 
       } catch (const std::exception& e) {
@@ -523,6 +579,9 @@ int main(int ac, char* av[]) {
   string                RangeArg;
   float                 eps = 0.0;
   unsigned              ThreadTestQty;
+  unsigned              PoolThreadQty;
+  bool                  PinThreads;
+  vector<double>        LoadQPS;
 
   shared_ptr<AnyParams>           IndexTimeParams;
   vector<shared_ptr<AnyParams>>   QueryTimeParams;
@@ -538,6 +597,9 @@ int main(int ac, char* av[]) {
                          SpaceType,
                          SpaceParams,
                          ThreadTestQty,
+                         PoolThreadQty,
+                         PinThreads,
+                         LoadQPS,
                          DoAppend, 
                          ResFilePrefix,
                          TestSetQty,
@@ -568,6 +630,9 @@ int main(int ac, char* av[]) {
 
     LOG(LIB_INFO) << "Program arguments are processed";
 
+    // The pool is created on first use, so it has to be configured before the index is created
+    ThreadPool::SetGlobalConfig(PoolThreadQty, PinThreads);
+
     ToLower(DistType);
 
     if (DIST_TYPE_INT == DistType) {
@@ -580,6 +645,7 @@ int main(int ac, char* av[]) {
                     SpaceType,
                     SpaceParams,
                     ThreadTestQty,
+                    LoadQPS,
                     DoAppend, 
                     ResFilePrefix,
                     TestSetQty,
@@ -604,6 +670,7 @@ int main(int ac, char* av[]) {
                     SpaceType,
                     SpaceParams,
                     ThreadTestQty,
+                    LoadQPS,
                     DoAppend, 
                     ResFilePrefix,
                     TestSetQty,
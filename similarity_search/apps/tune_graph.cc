@@ -0,0 +1,469 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cmath>
+#include <memory>
+#include <limits>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+
+#include "init.h"
+#include "global.h"
+#include "utils.h"
+#include "memory.h"
+#include "ztimer.h"
+#include "experiments.h"
+#include "experimentconf.h"
+#include "space.h"
+#include "index.h"
+#include "tune.h"
+#include "ef_schedule.h"
+#include "method/hnsw.h"
+#include "method/small_world_rand.h"
+#include "logging.h"
+#include "spacefactory.h"
+#include "methodfactory.h"
+#include "params_def.h"
+#include "searchoracle.h"
+
+#include "meta_analysis.h"
+#include "params.h"
+#include "cmd_options.h"
+
+using namespace similarity;
+
+using std::vector;
+using std::string;
+using std::stringstream;
+using std::unique_ptr;
+using std::shared_ptr;
+
+const string EF_LIST_PARAM_OPT      = "efList";
+const string EF_LIST_PARAM_MSG      = "a comma-separated list of query-time ef values to try";
+const string EF_LIST_PARAM_DEFAULT  = "10,20,40,80,160,320,640";
+
+const string FRONTIER_FILE_PARAM_OPT = "frontierFile";
+const string FRONTIER_FILE_PARAM_MSG = "a TSV file to save the Pareto frontier (recall vs 99th percentile of the query time vs memory)";
+
+/*
+ * Default grids of index-time parameters, which are used if
+ * no index-time parameters are given in the command line.
+ */
+vector<string> GetDefaultIndexParams(const string& methodName) {
+  const bool      isHNSW = methodName == METH_HNSW;
+  // Neighborhood sizes in SW-graph are typically smaller than in HNSW
+  const string    neighbParam = isHNSW ? "M" : "NN";
+  vector<unsigned> neighbQty = isHNSW ? vector<unsigned>({8, 16, 32}) : vector<unsigned>({5, 10, 20});
+
+  vector<string> res;
+  for (unsigned efConstruction : {100, 200}) {
+    for (unsigned qty : neighbQty) {
+      res.push_back(neighbParam + "=" + ConvertToString(qty) + ",efConstruction=" + ConvertToString(efConstruction));
+    }
+  }
+  return res;
+}
+
+template <typename dist_t>
+void RunTuning(const string&                  MethodName,
+               const vector<string>&          vIndexParamStr,
+               const string&                  SpaceType,
+               const AnyParams&               SpaceParams,
+               unsigned                       TestSetQty,
+               const string&                  DataFile,
+               const string&                  QueryFile,
+               unsigned                       MaxNumData,
+               unsigned                       MaxNumQuery,
+               const vector<unsigned>&        knn,
+               const vector<unsigned>&        efList,
+               float                          desiredRecall,
+               unsigned                       ThreadTestQty,
+               float                          maxCacheGSRelativeQty,
+               const string&                  ResFile,
+               const string&                  FrontierFile) {
+  if (MethodName != METH_HNSW && MethodName != METH_SMALL_WORLD_RAND) {
+    LOG(LIB_FATAL) << "Wrong method name, " <<
+                      "you should specify only a single method from the list: " << METH_HNSW << " " << METH_SMALL_WORLD_RAND;
+  }
+  if (knn.empty()) {
+    LOG(LIB_FATAL) << "You need to specify at least one value of k!";
+  }
+  if (efList.empty()) {
+    LOG(LIB_FATAL) << "You need to specify at least one value of ef!";
+  }
+
+  const string efParamName = MethodName == METH_HNSW ? "ef" : "efSearch";
+
+  LOG(LIB_INFO) << "We are going to tune parameters for " << MethodName;
+
+  try {
+    unique_ptr<Space<dist_t>> space(SpaceFactoryRegistry<dist_t>::Instance().CreateSpace(SpaceType, SpaceParams));
+
+    if (NULL == space.get()) {
+      LOG(LIB_FATAL) << "Cannot create space: '" << SpaceType;
+    }
+
+    ExperimentConfig<dist_t> config(*space,
+                                    DataFile, QueryFile, TestSetQty,
+                                    MaxNumData, MaxNumQuery,
+                                    knn, 0 /* eps */, vector<dist_t>());
+    config.ReadDataset();
+
+    vector<shared_ptr<AnyParams>> vQueryTimeParams;
+    for (unsigned ef : efList) {
+      vQueryTimeParams.push_back(shared_ptr<AnyParams>(
+                        new AnyParams({efParamName + "=" + ConvertToString(ef)})));
+    }
+
+    // The gold standard is computed only once per test set and is shared among all index configurations
+    vector<unique_ptr<GoldStandardManager<dist_t>>> vManagerGS(config.GetTestSetToRunQty());
+    MemUsage                                        mem_usage_measure;
+    const double                                    data_size = DataSpaceUsed(config.GetDataObjects()) / 1024.0 / 1024.0;
+
+    vector<TunePoint> points;
+
+    for (const string& indexParamStr : vIndexParamStr) {
+      vector<string> desc;
+      ParseArg(indexParamStr, desc);
+      AnyParams IndexParams(desc);
+
+      vector<unique_ptr<MetaAnalysis>> vStat;
+      vector<vector<MetaAnalysis*>>    ExpResRange;
+      vector<vector<MetaAnalysis*>>    ExpResKNN(knn.size(), vector<MetaAnalysis*>(efList.size()));
+
+      for (size_t i = 0; i < knn.size(); ++i) {
+        for (size_t efId = 0; efId < efList.size(); ++efId) {
+          vStat.push_back(unique_ptr<MetaAnalysis>(new MetaAnalysis(config.GetTestSetToRunQty())));
+          ExpResKNN[i][efId] = vStat.back().get();
+        }
+      }
+
+      for (int TestSetId = 0; TestSetId < config.GetTestSetToRunQty(); ++TestSetId) {
+        config.SelectTestSet(TestSetId);
+        // SelectTestSet must go before managerGS.Compute()!!!
+        if (!vManagerGS[TestSetId]) {
+          vManagerGS[TestSetId].reset(new GoldStandardManager<dist_t>(config));
+          vManagerGS[TestSetId]->Compute(ThreadTestQty, maxCacheGSRelativeQty);
+        }
+
+        LOG(LIB_INFO) << ">>>> Test set id: " << TestSetId << " index-time parameters: " << IndexParams.ToString();
+
+        const double vmsize_before = mem_usage_measure.get_vmsize();
+
+        WallClockTimer wtm;
+        wtm.reset();
+
+        unique_ptr<Index<dist_t>> IndexPtr(MethodFactoryRegistry<dist_t>::Instance().
+                                              CreateMethod(false,
+                                                           MethodName,
+                                                           SpaceType, config.GetSpace(),
+                                                           config.GetDataObjects()));
+        IndexPtr->CreateIndex(IndexParams);
+
+        wtm.split();
+
+        const double vmsize_after = mem_usage_measure.get_vmsize();
+        const double IndexTime = double(wtm.elapsed())/1e6;
+        double       MemByMethod = vmsize_after - vmsize_before + data_size;
+
+        if (IndexPtr->DuplicateData()) MemByMethod -= data_size;
+
+        for (auto& stat : vStat) {
+          stat->SetMem(TestSetId, MemByMethod);
+          stat->SetIndexTime(TestSetId, IndexTime);
+        }
+
+        Experiments<dist_t>::RunAll(false /* don't print info */,
+                                    ThreadTestQty,
+                                    TestSetId,
+                                    *vManagerGS[TestSetId],
+                                    true /* recall only */,
+                                    ExpResRange, ExpResKNN,
+                                    config,
+                                    *IndexPtr,
+                                    vQueryTimeParams);
+      }
+
+      for (size_t i = 0; i < knn.size(); ++i) {
+        for (size_t efId = 0; efId < efList.size(); ++efId) {
+          MetaAnalysis* stat = ExpResKNN[i][efId];
+          stat->ComputeAll();
+
+          TunePoint p;
+          p.K               = knn[i];
+          p.IndexParams     = indexParamStr;
+          p.QueryTimeParams = vQueryTimeParams[efId]->ToString();
+          p.Ef              = efList[efId];
+          p.Recall          = stat->GetRecallAvg();
+          p.QueryTime       = stat->GetQueryTimeAvg();
+          p.QueryTimeP99    = stat->GetQueryTimeP99Avg();
+          p.Mem             = stat->GetMemAvg();
+          p.IndexTime       = stat->GetIndexTimeAvg();
+          points.push_back(p);
+
+          LOG(LIB_INFO) << "K=" << p.K << " " << p.IndexParams << " " << p.QueryTimeParams
+                        << " recall: " << p.Recall << " query time: " << p.QueryTime
+                        << " p99: " << p.QueryTimeP99 << " mem: " << p.Mem << " MB"
+                        << " index time: " << p.IndexTime << " sec";
+        }
+      }
+    }
+
+    vector<size_t> frontier = ComputeParetoFrontier(points);
+
+    LOG(LIB_INFO) << "Pareto frontier (" << frontier.size() << " out of " << points.size() << " points)";
+    for (size_t id : frontier) {
+      const TunePoint& p = points[id];
+      LOG(LIB_INFO) << "K=" << p.K << " " << p.IndexParams << " " << p.QueryTimeParams
+                    << " recall: " << p.Recall << " p99: " << p.QueryTimeP99 << " mem: " << p.Mem;
+    }
+
+    if (!FrontierFile.empty()) {
+      ofstream out(FrontierFile, ios::trunc);
+
+      if (!out) {
+        LOG(LIB_FATAL) << "Can't open file: '" << FrontierFile << "' for writing";
+      }
+      out << "K\tIndexParams\tQueryTimeParams\tRecall\tQueryTime\tQueryTimeP99\tMem\tIndexTime" << endl;
+      for (size_t id : frontier) {
+        const TunePoint& p = points[id];
+        out << p.K << "\t" << p.IndexParams << "\t" << p.QueryTimeParams << "\t"
+            << p.Recall << "\t" << p.QueryTime << "\t" << p.QueryTimeP99 << "\t"
+            << p.Mem << "\t" << p.IndexTime << endl;
+      }
+      out.close();
+    }
+
+    /*
+     * The cheapest configuration: for each index configuration and each k,
+     * we select the smallest ef that achieves the desired recall. Among
+     * index configurations where the desired recall can be achieved for all k,
+     * we choose the one with the smallest sum of 99th percentiles of the query time.
+     * Ties are resolved in favor of configurations using less memory.
+     */
+    size_t  bestConfId = vIndexParamStr.size();
+    double  bestCost = numeric_limits<double>::max(), bestMem = numeric_limits<double>::max();
+    vector<size_t> bestEf;
+
+    const size_t pointsPerConf = knn.size() * efList.size();
+
+    for (size_t confId = 0; confId < vIndexParamStr.size(); ++confId) {
+      double          cost = 0, mem = 0;
+      vector<size_t>  confEf;
+      for (size_t i = 0; i < knn.size() && confEf.size() == i; ++i) {
+        for (size_t efId = 0; efId < efList.size(); ++efId) {
+          const TunePoint& p = points[confId * pointsPerConf + i * efList.size() + efId];
+          if (p.Recall >= desiredRecall) {
+            confEf.push_back(p.Ef);
+            cost += p.QueryTimeP99;
+            mem = p.Mem;
+            break;
+          }
+        }
+      }
+      if (confEf.size() != knn.size()) continue;
+      if (cost < bestCost || (cost == bestCost && mem < bestMem)) {
+        bestConfId = confId;
+        bestCost = cost;
+        bestMem = mem;
+        bestEf = confEf;
+      }
+    }
+
+    if (bestConfId == vIndexParamStr.size()) {
+      LOG(LIB_FATAL) << "Failed to get the desired recall " << desiredRecall << " for all values of k!";
+    }
+
+    stringstream bestQueryParams;
+    EfSchedule   schedule;
+    {
+      stringstream scheduleStr;
+      for (size_t i = 0; i < knn.size(); ++i) {
+        if (i) scheduleStr << ";";
+        scheduleStr << knn[i] << ":" << bestEf[i];
+      }
+      schedule.Parse(scheduleStr.str());
+    }
+    bestQueryParams << efParamName << "=" << *std::max_element(bestEf.begin(), bestEf.end())
+                    << "," << EF_BY_K_PARAM << "=" << schedule.ToString();
+
+    LOG(LIB_INFO) << "Optimization results";
+    LOG(LIB_INFO) << "Desired recall: " << desiredRecall;
+    LOG(LIB_INFO) << "Sum of 99th percentiles of the query time: " << bestCost;
+    LOG(LIB_INFO) << "Memory: " << bestMem << " MB";
+    LOG(LIB_INFO) << "optimal index-time parameters: " << vIndexParamStr[bestConfId];
+    LOG(LIB_INFO) << "optimal query-time parameters: " << bestQueryParams.str();
+
+    if (!ResFile.empty()) {
+      ofstream out(ResFile, ios::trunc);
+
+      if (!out) {
+        LOG(LIB_FATAL) << "Can't open file: '" << ResFile << "' for writing";
+      }
+
+      out << vIndexParamStr[bestConfId] << endl;
+      out << bestQueryParams.str() << endl;
+      out.close();
+    }
+  } catch (const std::exception& e) {
+    LOG(LIB_FATAL) << "Exception: " << e.what();
+  } catch (...) {
+    LOG(LIB_FATAL) << "Unknown exception";
+  }
+}
+
+int main(int argc, char* argv[]) {
+  WallClockTimer timer;
+  timer.reset();
+
+  string          LogFile;
+  string          DistType;
+  string          SpaceType;
+  string          ResFile;
+  string          FrontierFile;
+  unsigned        TestSetQty;
+  string          DataFile;
+  string          QueryFile;
+  float           MaxCacheGSRelativeQty;
+  unsigned        MaxNumData;
+  unsigned        MaxNumQuery;
+  unsigned        ThreadTestQty;
+  string          MethodName;
+  string          knnArg;
+  string          efListArg;
+  double          desiredRecall;
+  vector<string>  vIndexParamStr;
+
+  CmdOptions cmd_options;
+
+  cmd_options.Add(new CmdParam(SPACE_TYPE_PARAM_OPT, SPACE_TYPE_PARAM_MSG,
+                               &SpaceType, true));
+  cmd_options.Add(new CmdParam(DIST_TYPE_PARAM_OPT, DIST_TYPE_PARAM_MSG,
+                               &DistType, false, DIST_TYPE_FLOAT));
+  cmd_options.Add(new CmdParam(DATA_FILE_PARAM_OPT, DATA_FILE_PARAM_MSG,
+                               &DataFile, true));
+  cmd_options.Add(new CmdParam(MAX_NUM_DATA_PARAM_OPT, MAX_NUM_QUERY_PARAM_MSG,
+                               &MaxNumData, false, MAX_NUM_DATA_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(QUERY_FILE_PARAM_OPT, QUERY_FILE_PARAM_MSG,
+                               &QueryFile, false, QUERY_FILE_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(MAX_CACHE_GS_QTY_PARAM_OPT, MAX_CACHE_GS_QTY_PARAM_MSG,
+                               &MaxCacheGSRelativeQty, false, MAX_CACHE_GS_QTY_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(LOG_FILE_PARAM_OPT, LOG_FILE_PARAM_MSG,
+                               &LogFile, false, LOG_FILE_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(MAX_NUM_QUERY_PARAM_OPT, MAX_NUM_QUERY_PARAM_MSG,
+                               &MaxNumQuery, false, MAX_NUM_QUERY_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(TEST_SET_QTY_PARAM_OPT, TEST_SET_QTY_PARAM_MSG,
+                               &TestSetQty, false, TEST_SET_QTY_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(KNN_PARAM_OPT, KNN_PARAM_MSG,
+                               &knnArg, true));
+  cmd_options.Add(new CmdParam(METHOD_PARAM_OPT, METHOD_PARAM_MSG,
+                               &MethodName, true));
+  cmd_options.Add(new CmdParam(THREAD_TEST_QTY_PARAM_OPT, THREAD_TEST_QTY_PARAM_MSG,
+                               &ThreadTestQty, false, THREAD_TEST_QTY_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(INDEX_TIME_PARAMS_PARAM_OPT, INDEX_TIME_PARAMS_PARAM_MSG,
+                               &vIndexParamStr, false));
+  cmd_options.Add(new CmdParam(EF_LIST_PARAM_OPT, EF_LIST_PARAM_MSG,
+                               &efListArg, false, EF_LIST_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(DESIRED_RECALL_PARAM, "the desired recall (for each k)",
+                               &desiredRecall, true));
+  cmd_options.Add(new CmdParam("outFile,o", "output file (the best index-time parameters and query-time parameters)",
+                               &ResFile, false));
+  cmd_options.Add(new CmdParam(FRONTIER_FILE_PARAM_OPT, FRONTIER_FILE_PARAM_MSG,
+                               &FrontierFile, false));
+
+  try {
+    cmd_options.Parse(argc, argv);
+  } catch (const CmdParserException& e) {
+    cmd_options.ToString();
+    std::cout.flush();
+    LOG(LIB_FATAL) << e.what();
+  } catch (const std::exception& e) {
+    cmd_options.ToString();
+    std::cout.flush();
+    LOG(LIB_FATAL) << e.what();
+  } catch (...) {
+    cmd_options.ToString();
+    std::cout.flush();
+    LOG(LIB_FATAL) << "Failed to parse cmd arguments";
+  }
+
+  initLibrary(0, LogFile.empty() ? LIB_LOGSTDERR:LIB_LOGFILE, LogFile.c_str());
+
+  ToLower(DistType);
+  ToLower(SpaceType);
+  ToLower(MethodName);
+
+  vector<unsigned>        knn, efList;
+  shared_ptr<AnyParams>   SpaceParams;
+
+  try {
+    {
+      vector<string> SpaceDesc;
+      string str = SpaceType;
+      ParseSpaceArg(str, SpaceType, SpaceDesc);
+      SpaceParams = shared_ptr<AnyParams>(new AnyParams(SpaceDesc));
+    }
+
+    if (!SplitStr(knnArg, knn, ',')) {
+      LOG(LIB_FATAL) << "Wrong format of the KNN argument: '" << knnArg;
+    }
+    if (!SplitStr(efListArg, efList, ',')) {
+      LOG(LIB_FATAL) << "Wrong format of the ef list: '" << efListArg;
+    }
+    std::sort(efList.begin(), efList.end());
+
+    if (!DoesFileExist(DataFile)) {
+      LOG(LIB_FATAL) << "data file " << DataFile << " doesn't exist";
+    }
+    if (!QueryFile.empty() && !DoesFileExist(QueryFile)) {
+      LOG(LIB_FATAL) << "query file " << QueryFile << " doesn't exist";
+    }
+    if (!MaxNumQuery && QueryFile.empty()) {
+      LOG(LIB_FATAL) << "Set a positive # of queries or specify a query file!";
+    }
+    CHECK_MSG(MaxNumData < MAX_DATASET_QTY, "The maximum number of points should not exceed" + ConvertToString(MAX_DATASET_QTY));
+    CHECK_MSG(MaxNumQuery < MAX_DATASET_QTY, "The maximum number of queries should not exceed" + ConvertToString(MAX_DATASET_QTY));
+  } catch (const exception& e) {
+    LOG(LIB_FATAL) << "Exception: " << e.what();
+  }
+
+  if (vIndexParamStr.empty()) vIndexParamStr = GetDefaultIndexParams(MethodName);
+
+  if (DIST_TYPE_INT == DistType) {
+    RunTuning<int>(MethodName, vIndexParamStr,
+                   SpaceType, *SpaceParams,
+                   TestSetQty, DataFile, QueryFile, MaxNumData, MaxNumQuery,
+                   knn, efList, desiredRecall,
+                   ThreadTestQty, MaxCacheGSRelativeQty,
+                   ResFile, FrontierFile);
+  } else if (DIST_TYPE_FLOAT == DistType) {
+    RunTuning<float>(MethodName, vIndexParamStr,
+                     SpaceType, *SpaceParams,
+                     TestSetQty, DataFile, QueryFile, MaxNumData, MaxNumQuery,
+                     knn, efList, desiredRecall,
+                     ThreadTestQty, MaxCacheGSRelativeQty,
+                     ResFile, FrontierFile);
+  } else {
+    LOG(LIB_FATAL) << "Unknown distance value type: " << DistType;
+  }
+
+  timer.split();
+  LOG(LIB_INFO) << "Time elapsed = " << timer.elapsed() / 1e6;
+  LOG(LIB_INFO) << "Finished at " << LibGetCurrentTime();
+
+  return 0;
+}
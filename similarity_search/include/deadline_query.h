@@ -0,0 +1,94 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _DEADLINE_QUERY_H_
+#define _DEADLINE_QUERY_H_
+
+#include <chrono>
+#include <utility>
+
+#include "object.h"
+#include "utils.h"
+
+// A query checks its deadline once in this number of distance computations (must be a power of two)
+#define DEADLINE_CHECK_PERIOD 64
+
+namespace similarity {
+
+/*
+ * A query that enforces a deadline: after the deadline passes, all
+ * subsequent distances computed via the query object are "infinite"
+ * and no objects are added to the result. Thus, the search can't find
+ * better answers anymore, which makes (e.g., graph-based) search methods
+ * terminate early. The current (best-so-far) answers are retained, but
+ * the result of an expired query can have fewer entries than requested.
+ * This doesn't affect methods that compute distances without calling
+ * the query object.
+ */
+template <template <typename> class QueryType, typename dist_t>
+class DeadlineQuery : public QueryType<dist_t> {
+ public:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  template <typename... Args>
+  DeadlineQuery(TimePoint deadline, Args&&... args) :
+      QueryType<dist_t>(std::forward<Args>(args)...), deadline_(deadline), checkQty_(0), expired_(false) {}
+
+  dist_t DistanceObjLeft(const Object* object) const override {
+    if (checkExpired()) return DistMax<dist_t>();
+    return QueryType<dist_t>::DistanceObjLeft(object);
+  }
+
+  // CheckAndAddToResult(object) of k-NN and range queries calls this function
+  dist_t DistanceObjLeftBounded(const Object* object, dist_t bound) const override {
+    if (checkExpired()) return DistMax<dist_t>();
+    return QueryType<dist_t>::DistanceObjLeftBounded(object, bound);
+  }
+
+  // A batch is large enough to check the clock every time
+  void DistanceObjLeftBatch(const Object* const* ppObj, size_t qty, dist_t bound, dist_t* pDist) const override {
+    if (!expired_) expired_ = std::chrono::steady_clock::now() > deadline_;
+    if (expired_) {
+      for (size_t i = 0; i < qty; ++i) pDist[i] = DistMax<dist_t>();
+      return;
+    }
+    QueryType<dist_t>::DistanceObjLeftBatch(ppObj, qty, bound, pDist);
+  }
+
+  // Otherwise, the "infinite" distances would be added to a k-NN result that isn't full yet
+  bool CheckAndAddToResult(const dist_t distance, const Object* object) override {
+    if (expired_) return false;
+    return QueryType<dist_t>::CheckAndAddToResult(distance, object);
+  }
+  using QueryType<dist_t>::CheckAndAddToResult;
+
+  bool Expired() const { return expired_; }
+
+ private:
+  // The clock is checked once in DEADLINE_CHECK_PERIOD distance computations
+  bool checkExpired() const {
+    if (!expired_ && (++checkQty_ & (DEADLINE_CHECK_PERIOD - 1)) == 0) {
+      expired_ = std::chrono::steady_clock::now() > deadline_;
+    }
+    return expired_;
+  }
+
+  TimePoint                 deadline_;
+  mutable size_t            checkQty_;
+  mutable bool              expired_;
+};
+
+}  // namespace similarity
+
+#endif
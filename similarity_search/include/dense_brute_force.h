@@ -0,0 +1,120 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _DENSE_BRUTE_FORCE_H_
+#define _DENSE_BRUTE_FORCE_H_
+
+#include <vector>
+
+#include "object.h"
+#include "space.h"
+#include "knnquery.h"
+#include "knnqueue.h"
+#include "rangequery.h"
+
+namespace similarity {
+
+using std::vector;
+
+/*
+ * A fast path of the brute-force search for dense float vectors.
+ *
+ * Data vectors are packed into a contiguous (zero-padded) matrix and their norms
+ * are precomputed. For each block of data vectors, the search computes dot products with
+ * the query using a SIMD kernel that processes several data vectors at once. Distances are then
+ * obtained using norms (e.g., ||x-y||^2 = ||x||^2 + ||y||^2 - 2 <x,y>). Such distances
+ * are not exactly equal to the ones computed by the space, because the order of (floating-point)
+ * operations is different. Hence, they are used only to filter out data points that are
+ * guaranteed (up to a conservative bound on the rounding error) not to be in the answer.
+ * The remaining data points are verified by the space, so the result is exactly the same
+ * as the result of the vanilla brute-force search.
+ */
+class DenseBruteForce {
+ public:
+  enum DistType {
+    kL2,
+    kCosine,
+    kNegDotProd
+  };
+
+  // Returns false if the space isn't supported
+  static bool GetDistType(const Space<float>& space, DistType& distType);
+
+  // data vectors must have the same dimensionality
+  DenseBruteForce(const ObjectVector& data, DistType distType);
+
+  size_t dim() const { return dim_; }
+
+  /*
+   * Processes data points with ids in the range [start, end).
+   * Only data points that are not filtered out are passed
+   * to the function query->CheckAndAddToResult. Distance
+   * computations are counted as if all the data points were compared to the query.
+   * If the query has a wrong dimensionality, all data points are checked.
+   */
+  void Search(KNNQuery<float>* query, size_t start, size_t end) const;
+  void Search(RangeQuery<float>* query, size_t start, size_t end) const;
+
+  /*
+   * Data vectors are processed in blocks of this size, so that dot products stay in the L1 cache.
+   * This is also the maximum number of data points for which ComputeLowerBounds can be called at once.
+   */
+  static const size_t BLOCK_QTY = 256;
+
+  // A (zero-padded) query vector together with its norm
+  struct PreparedQuery {
+    vector<float> paddedVect;
+    float         norm2;
+    float         norm;
+  };
+
+  // Returns false if the query has a wrong dimensionality
+  bool PrepareQuery(const Object* pQueryObj, PreparedQuery& query) const;
+
+  /*
+   * Computes lower bounds for distances between the query and data points
+   * with ids in the range [start, end), where end - start <= BLOCK_QTY.
+   * A data point whose bound is larger than a threshold is guaranteed to
+   * be farther from the query than the threshold.
+   */
+  void ComputeLowerBounds(const PreparedQuery& query, size_t start, size_t end, float* pBounds) const;
+
+ private:
+  template <typename QueryType> void GenSearch(QueryType* query, size_t start, size_t end) const;
+
+  // The current threshold: a point may be added to the result only if its distance is below it
+  static float GetThreshold(const KNNQuery<float>* query) {
+    return query->ResultSize() < query->GetK() ? DistMax<float>() : query->Result()->TopDistance();
+  }
+  static float GetThreshold(const RangeQuery<float>* query) {
+    return query->Radius();
+  }
+
+  // Computes dot products of the (padded) query with the data vectors in the range [start, end)
+  void ComputeDotProducts(const float* pQuery, size_t start, size_t end, float* pRes) const;
+
+  const ObjectVector&     data_;
+  DistType                distType_;
+  size_t                  dim_;
+  // The dimensionality rounded up to the multiple of the SIMD register size
+  size_t                  paddedDim_;
+  // A bound on the relative floating-point error of the dot product
+  float                   relErr_;
+  vector<float>           matrix_;
+  vector<float>           norms_;
+};
+
+}   // namespace similarity
+
+#endif      // _DENSE_BRUTE_FORCE_H_
@@ -21,6 +21,8 @@
 #include <algorithm>
 #include <cstdlib>
 #include <limits>
+#include <vector>
+#include <cstdint>
 
 #include <portable_popcount.h>
 
@@ -59,6 +61,23 @@ template <class T> T L2NormSIMD(const T* pVect1, const T* pVect2, size_t qty);
 
 float L2SqrSIMD(const float* pVect1, const float* pVect2, size_t qty);
 
+/*
+ * Early-abandoning versions of L1NormSIMD and L2NormSIMD (see Space::HiddenDistanceBounded):
+ * partial sums are checked periodically. If a partial sum exceeds the bound, the function
+ * returns this sum (which is larger than the bound, but smaller than the actual distance).
+ * Otherwise, the result is exactly the same as the result of the unbounded version.
+ */
+template <class T> T L1NormSIMDBounded(const T* pVect1, const T* pVect2, size_t qty, T bound);
+template <class T> T L2NormSIMDBounded(const T* pVect1, const T* pVect2, size_t qty, T bound);
+
+/*
+ * Compute L1 and L2 distances from qty vectors of the dimensionality dim to the query
+ * (pDist[i] is the distance between ppVect[i] and pQuery). Several vectors are processed
+ * at a time, but the results are exactly the same as the results of L1NormSIMD and L2NormSIMD.
+ */
+template <class T> void L1NormSIMDBatch(const T* pQuery, const T* const* ppVect, size_t qty, size_t dim, T* pDist);
+template <class T> void L2NormSIMDBatch(const T* pQuery, const T* const* ppVect, size_t qty, size_t dim, T* pDist);
+
 /*
  * Scalar product related distances 
  */
@@ -76,6 +95,15 @@ template <class T> T NormScalarProductSIMD(const T *p1, const T *p2, size_t qty)
 template <class T> T ScalarProduct(const T *p1, const T *p2, size_t qty);
 template <class T> T ScalarProductSIMD(const T *p1, const T *p2, size_t qty);
 
+/*
+ * Distances between vectors stored in 16-bit floating-point formats (Float16 and BFloat16, see half_float.h).
+ * Vector elements are converted to 32-bit floats, which are also used to accumulate results.
+ */
+template <class T> float L2NormHalf(const T* p1, const T* p2, size_t qty);
+template <class T> float ScalarProductHalf(const T* p1, const T* p2, size_t qty);
+template <class T> float NormScalarProductHalf(const T* p1, const T* p2, size_t qty);
+template <class T> float CosineSimilarityHalf(const T* p1, const T* p2, size_t qty);
+
 // Fast normalized-scalar product between sparse vectors (using SIMD)
 float NormSparseScalarProductFast(const char* pData1, size_t len1, const char* pData2, size_t len2);
 /*
@@ -86,6 +114,55 @@ float QueryNormSparseScalarProductFast(const char* pData, size_t lenData, const
 // Fast scalar product between sparse vectors without normalization (using SIMD)
 float SparseScalarProductFast(const char* pData1, size_t len1, const char* pData2, size_t len2);
 
+/*
+ * A query vector (in the format of fast sparse spaces) whose elements are scattered
+ * into a lookup table: a dense array indexed by element ids, if ids are small enough,
+ * or a small open-addressing hash table otherwise. A scalar product with a data vector
+ * is then computed in a single gather pass over data vector elements rather than
+ * by intersecting two sorted lists of ids. This pays off only if the query is long
+ * compared to the data vector (see PreferGather).
+ */
+class SparseScatteredQuery {
+ public:
+  SparseScatteredQuery(const char* pQuery, size_t lenQuery);
+
+  size_t  ElemQty() const { return elemQty_; }
+  float   NormCoeff() const { return normCoeff_; }
+  bool    IsDense() const { return !denseVals_.empty(); }
+  // Returns true if the gather pass is expected to be faster than the intersection
+  bool    PreferGather(const char* pData, size_t lenData) const;
+  /*
+   * The (non-normalized) scalar product of the query and a data vector,
+   * the normalization coefficient of the data vector is saved to dataNormCoeff.
+   */
+  float   ScalarProduct(const char* pData, size_t lenData, float& dataNormCoeff) const;
+ private:
+  struct HashEntry {
+    uint32_t  id_;  // zero marks an empty entry, see removeBlockZeros
+    float     val_;
+  };
+
+  size_t                  elemQty_ = 0;
+  float                   normCoeff_ = 0;
+  std::vector<float>      denseVals_;
+  std::vector<HashEntry>  hashTable_;
+  uint32_t                hashShift_ = 0;
+};
+
+// Versions of the functions above, where the query is scattered in advance
+float NormSparseScalarProductFastGather(const char* pData, size_t lenData, const SparseScatteredQuery& query);
+float QueryNormSparseScalarProductFastGather(const char* pData, size_t lenData, const SparseScatteredQuery& query);
+float SparseScalarProductFastGather(const char* pData, size_t lenData, const SparseScatteredQuery& query);
+
+/*
+ * Scalar products between sparse vectors in the compressed format with quantized values
+ * (T is int8_t or int16_t, see space_sparse_quant.h). Ids are decoded during the intersection
+ * and products of quantized values are summed up as integers.
+ */
+template <class T> float SparseQuantScalarProduct(const char* pData1, size_t len1, const char* pData2, size_t len2);
+// The normalized version, the result is in [-1, 1] and zero if one of the vectors is all zeros
+template <class T> float NormSparseQuantScalarProduct(const char* pData1, size_t len1, const char* pData2, size_t len2);
+
 /*
  * Sometimes due to rounding errors, we get values > 1 or < -1.
  * This throws off other functions that use scalar product, e.g., acos
@@ -223,21 +300,23 @@ int SpearmanRho(const PivotIdType* x, const PivotIdType* y, size_t qty);
 int SpearmanFootruleSIMD(const PivotIdType* x, const PivotIdType* y, size_t qty);
 int SpearmanRhoSIMD(const PivotIdType* x, const PivotIdType* y, size_t qty);
 
+// The number of 1s in 32-bit and 64-bit words
+inline unsigned BitPopCount(uint32_t v) { return __builtin_popcount(v); }
+inline unsigned BitPopCount(uint64_t v) { return __builtin_popcountll(v); }
+
 template <typename dist_t, typename dist_uint_t>
 dist_t inline BitJaccard(const dist_uint_t* a, const dist_uint_t* b, size_t qty) {
   dist_uint_t num = 0, den = 0;
 
   for (size_t i=0; i < qty; ++i) {
-    //  __builtin_popcount quickly computes the number on 1s
-    num +=  __builtin_popcount(a[i] & b[i]);
-    den +=  __builtin_popcount(a[i] | b[i]);
+    //  BitPopCount quickly computes the number on 1s
+    num +=  BitPopCount(a[i] & b[i]);
+    den +=  BitPopCount(a[i] | b[i]);
   }
 
   return 1  - (dist_t(num) / dist_t(den));
 }
 
-//unsigned BitHamming(const uint32_t* a, const uint32_t* b, size_t qty);
-
 unsigned inline BitHamming(const uint32_t* a, const uint32_t* b, size_t qty) {
   unsigned res = 0;
 
@@ -249,6 +328,23 @@ unsigned inline BitHamming(const uint32_t* a, const uint32_t* b, size_t qty) {
   return res;
 }
 
+/*
+ * The Hamming distance between bit vectors packed into qty 64-bit words.
+ * The number of 1s is computed using AVX-512 VPOPCNTDQ or AVX2 (if available).
+ */
+unsigned BitHamming(const uint64_t* a, const uint64_t* b, size_t qty);
+
+/*
+ * Computes Hamming distances from qty bit vectors (each one has wordQty 64-bit words)
+ * to the query: pDist[i] is the distance between ppVect[i] and pQuery.
+ * The query is loaded only once and the following vectors are prefetched.
+ */
+void BitHammingBatch(const uint64_t* pQuery, const uint64_t* const* ppVect, size_t qty, size_t wordQty, unsigned* pDist);
+
+inline void BitHammingBatch(const uint32_t* pQuery, const uint32_t* const* ppVect, size_t qty, size_t wordQty, unsigned* pDist) {
+  for (size_t i = 0; i < qty; ++i) pDist[i] = BitHamming(ppVect[i], pQuery, wordQty);
+}
+
 // Returns the size of the intersection
 unsigned IntersectSizeScalarFast(const IdType *pArr1, size_t qty1, const IdType *pArr2, size_t qty2);
 unsigned IntersectSizeScalarStand(const IdType *pArr1, size_t qty1, const IdType *pArr2, size_t qty2);
@@ -15,11 +15,15 @@
 #ifndef DISTCOMP_EDIST_HPP
 #define DISTCOMP_EDIST_HPP
 
+#include <vector>
+#include <cstdint>
+#include <climits>
+
 namespace similarity {
 
 /* 
  * The maximum number of elements that will be kept on the stack
- * by the function levenshtein. 
+ * by the function levenshteinSimple. 
  *
  * TODO:@leo If there are too many threads, we might run out stack memory.
  *           but it is probably extremely unlikely with the buffer of this size.
@@ -28,10 +32,62 @@ namespace similarity {
 
 #define MAX_LEVEN_BUFFER_QTY  512
 
+/*
+ * The Levenshtein distance computed using the bit-parallel algorithm
+ * (see the class LevenshteinPattern below).
+ */
 template<class T> int levenshtein(const T* p1, size_t len1, const T* p2, size_t len2) ;
 template<class T> int levenshtein(const T &s1, const T & s2) {
   return levenshtein(s1.c_str(), s1.size(), s2.c_str(), s2.size());
 }
+/*
+ * The Levenshtein distance, which is exact only if it does not exceed maxDist.
+ * Otherwise, the computation may stop early and the function returns
+ * some value larger than maxDist.
+ */
+template<class T> int levenshteinBounded(const T* p1, size_t len1, const T* p2, size_t len2, int maxDist);
+/*
+ * A classic dynamic programming algorithm that uses O(len1 * len2) time.
+ * It is much slower than the bit-parallel one and is kept mostly for testing.
+ */
+template<class T> int levenshteinSimple(const T* p1, size_t len1, const T* p2, size_t len2) ;
+
+/*
+ * A string (pattern) preprocessed for the bit-parallel computation of the Levenshtein distance 
+ * (G. Myers 1999 and H. Hyyro 2003). For each symbol, we memorize a bit-vector of positions 
+ * where the symbol occurs in the pattern. Then, a column of the dynamic programming matrix 
+ * is computed using a few bit operations per 64-element block.
+ * Thus, the distance to a string of length n is computed in O(n * ceil(len/64)) time.
+ * The pattern can be compared with many strings, e.g., when a query is compared with data points.
+ *
+ * If the distance is bounded, we compute only the blocks that may contain values not
+ * exceeding the bound (Ukkonen's cut-off) and stop once the bound cannot be achieved. 
+ */
+template <class T> class LevenshteinPattern {
+ public:
+  LevenshteinPattern(const T* p, size_t len);
+  /*
+   * If the distance exceeds maxDist, the function returns some value larger than maxDist.
+   */
+  int Distance(const T* p, size_t len, int maxDist = INT_MAX) const;
+  /*
+   * Computes distances to qty strings. For patterns not longer than 64 symbols,
+   * we process several strings at a time. The meaning of maxDist is the same as in Distance.
+   */
+  void Distances(const T* const* ppStr, const size_t* pLen, size_t qty, 
+                 int* pDist, int maxDist = INT_MAX) const;
+
+  size_t size() const { return len_; }
+ private:
+  const uint64_t* getEq(T c) const;
+
+  size_t                  len_;
+  size_t                  blockQty_;
+  // Sorted distinct symbols of the pattern, it is used only if T is a multi-byte type
+  std::vector<T>          alphabet_;
+  // blockQty_ words for each symbol, which are preceded by zero words for symbols not in alphabet_
+  std::vector<uint64_t>   peq_;
+};
 
 
 }
@@ -0,0 +1,84 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _EF_SCHEDULE_H_
+#define _EF_SCHEDULE_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <sstream>
+#include <algorithm>
+
+#include "utils.h"
+#include "logging.h"
+
+// The name of the query-time parameter of graph-based methods
+#define EF_BY_K_PARAM     "efByK"
+
+namespace similarity {
+
+using std::string;
+using std::vector;
+using std::pair;
+
+/*
+ * A per-k schedule of the search-queue size (ef) for graph-based methods.
+ * It is specified as a semicolon-separated list of k:ef pairs, e.g., 1:20;10:40;100:200.
+ * A query with a given k uses the ef value of the smallest listed k' >= k.
+ * If there's no such k', or the schedule is empty, the default ef is used.
+ */
+class EfSchedule {
+ public:
+  void Parse(const string& desc) {
+    schedule_.clear();
+    if (desc.empty()) return;
+
+    vector<string> pairs;
+    CHECK_MSG(SplitStr(desc, pairs, ';'), "Cannot parse the ef schedule: '" + desc + "'");
+    for (const string& s : pairs) {
+      vector<size_t> kEf;
+      if (!SplitStr(s, kEf, ':') || kEf.size() != 2 || !kEf[0] || !kEf[1]) {
+        PREPARE_RUNTIME_ERR(err) << "Wrong format of the ef schedule entry '" << s << "'"
+                                 << " expecting k:ef, where k and ef are positive integers";
+        THROW_RUNTIME_ERR(err);
+      }
+      schedule_.push_back(std::make_pair(kEf[0], kEf[1]));
+    }
+    std::sort(schedule_.begin(), schedule_.end());
+  }
+
+  size_t GetEf(size_t k, size_t defaultEf) const {
+    auto it = std::lower_bound(schedule_.begin(), schedule_.end(), std::make_pair(k, size_t(0)));
+    return it == schedule_.end() ? defaultEf : it->second;
+  }
+
+  bool Empty() const { return schedule_.empty(); }
+
+  string ToString() const {
+    std::stringstream res;
+    for (size_t i = 0; i < schedule_.size(); ++i) {
+      if (i) res << ";";
+      res << schedule_[i].first << ":" << schedule_[i].second;
+    }
+    return res.str();
+  }
+
+ private:
+  vector<pair<size_t, size_t>> schedule_;
+};
+
+}   // namespace similarity
+
+#endif     // _EF_SCHEDULE_H_
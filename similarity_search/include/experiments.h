@@ -27,6 +27,8 @@
 #include <thread>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <chrono>
 
 #include "global.h"
 #include "object.h"
@@ -42,6 +44,7 @@
 #include "meta_analysis.h"
 #include "query_creator.h"
 #include "thread_pool.h"
+#include "latency_histogram.h"
 
 namespace similarity {
 
@@ -69,7 +72,8 @@ public:
                      vector<vector<MetaAnalysis*>>&       ExpResKNN,
                      const ExperimentConfig<dist_t>&      config,
                      IndexType&                           Method,
-                     const vector<shared_ptr<AnyParams>>& QueryTimeParams) {
+                     const vector<shared_ptr<AnyParams>>& QueryTimeParams,
+                     const vector<double>&                LoadQPS = vector<double>()) {
 
     if (LogInfo) LOG(LIB_INFO) << ">>>> TestSetId: " << TestSetId;
     if (LogInfo) LOG(LIB_INFO) << ">>>> Will use: "  << ThreadTestQty << " threads in efficiency testing";
@@ -84,7 +88,7 @@ public:
                                                   managerGS.GetRangeGS(i),
                                                   recallOnly,
                                                   ExpResRange[i], config, cr, 
-                                                  Method, QueryTimeParams);
+                                                  Method, QueryTimeParams, LoadQPS);
       }
     }
 
@@ -97,7 +101,7 @@ public:
                                               managerGS.GetKNNGS(i),
                                               recallOnly,
                                               ExpResKNN[i], config, cr, 
-                                              Method, QueryTimeParams);
+                                              Method, QueryTimeParams, LoadQPS);
       }
     }
     if (LogInfo) LOG(LIB_INFO) << "experiment done at " << LibGetCurrentTime();
@@ -112,7 +116,8 @@ public:
                      const ExperimentConfig<dist_t>&                config,
                      const QueryCreatorType&                        QueryCreator,
                      IndexType&                                     Method,
-                     const vector<shared_ptr<AnyParams>>&           QueryTimeParams) {
+                     const vector<shared_ptr<AnyParams>>&           QueryTimeParams,
+                     const vector<double>&                          LoadQPS) {
     size_t numquery = config.GetQueryObjects().size();
     unsigned MethQty = QueryTimeParams.size();
 
@@ -138,8 +143,8 @@ public:
     vector<unsigned>  max_result_size(MethQty);
     vector<double>    avg_result_size(MethQty);
     vector<uint64_t>  DistCompQty(MethQty);
-
-    mutex             UpdateStat;
+    // Query times in microseconds
+    vector<LatencyHistogram>  QueryTimeHist(MethQty);
 
     config.GetSpace().SetQueryPhase();
 
@@ -164,15 +169,23 @@ public:
 
       vector<vector<size_t>>                  QueryIds;
       vector<vector<unique_ptr<QueryType>>>   Queries; // queries with results
+      /*
+       * Each thread collects statistics separately. They are merged
+       * after all the queries are executed, so that test threads don't
+       * need to synchronize (which could affect their performance).
+       */
+      vector<ThreadStat>                      ThreadStats;
 
       QueryIds.resize(ThreadTestQty);
       Queries.resize(ThreadTestQty);
+      ThreadStats.resize(ThreadTestQty);
 
       /*
        * Because each thread uses its own parameter set, we must use
-       * exactly ThreadTestQty sets.
+       * exactly ThreadTestQty sets. ParallelFor may run fewer threads
+       * concurrently, so that the measured throughput would be lower.
        */
-      ParallelFor(0, ThreadTestQty, ThreadTestQty, [&](unsigned QueryPart, unsigned ThreadId) {
+      RunInDedicatedThreads(ThreadTestQty, [&](unsigned QueryPart) {
         size_t numquery = config.GetQueryObjects().size();
 
         WallClockTimer wtm;
@@ -187,23 +200,13 @@ public:
             Method.Search(query.get());
             uint64_t  t2 = wtm.split();
 
-            {
-              lock_guard<mutex> g(UpdateStat);
-
-              ExpRes[MethNum]->AddDistComp(TestSetId, query->DistanceComputations());
-              ExpRes[MethNum]->AddQueryTime(TestSetId, (1.0*t2 - t1)/1e3);
+            ThreadStat& stat = ThreadStats[QueryPart];
 
+            stat.QueryTime.push_back((1.0*t2 - t1)/1e3);
+            stat.QueryTimeHist.Record(t2 - t1);
 
-              DistCompQty[MethNum] += query->DistanceComputations();
-              avg_result_size[MethNum] += query->ResultSize();
-
-              if (query->ResultSize() > max_result_size[MethNum]) {
-                max_result_size[MethNum] = query->ResultSize();
-              }
-
-              QueryIds[QueryPart].push_back(q);
-              Queries[QueryPart].push_back(std::move(query));
-            }
+            QueryIds[QueryPart].push_back(q);
+            Queries[QueryPart].push_back(std::move(query));
           }
         }
       });
@@ -212,6 +215,33 @@ public:
 
       SearchTime[MethNum] = wtm.elapsed();
 
+      for (unsigned QueryPart = 0; QueryPart < ThreadTestQty; ++QueryPart) {
+        const ThreadStat& stat = ThreadStats[QueryPart];
+        for (size_t qi = 0; qi < Queries[QueryPart].size(); ++qi) {
+          const QueryType*  pQuery = Queries[QueryPart][qi].get();
+
+          ExpRes[MethNum]->AddDistComp(TestSetId, pQuery->DistanceComputations());
+          ExpRes[MethNum]->AddQueryTime(TestSetId, stat.QueryTime[qi]);
+
+          DistCompQty[MethNum] += pQuery->DistanceComputations();
+          avg_result_size[MethNum] += pQuery->ResultSize();
+
+          if (pQuery->ResultSize() > max_result_size[MethNum]) {
+            max_result_size[MethNum] = pQuery->ResultSize();
+          }
+        }
+        QueryTimeHist[MethNum].Merge(stat.QueryTimeHist);
+      }
+
+      const LatencyHistogram& hist = QueryTimeHist[MethNum];
+      ExpRes[MethNum]->SetQueryTimePercentiles(TestSetId,
+                                               hist.Percentile(50) / 1e3, hist.Percentile(90) / 1e3,
+                                               hist.Percentile(99) / 1e3, hist.Percentile(99.9) / 1e3);
+
+      for (double qps : LoadQPS) {
+        RunOpenLoop<QueryType, QueryCreatorType>(ThreadTestQty, qps, config, QueryCreator, Method);
+      }
+
       AvgNumDistComp[MethNum] = static_cast<double>(DistCompQty[MethNum])/numquery;
       ImprDistComp[MethNum]   = config.GetDataObjects().size() / AvgNumDistComp[MethNum];
 
@@ -277,6 +307,10 @@ public:
         LOG(LIB_INFO) << ">>>> Time elapsed:           " << timeSec << " sec";
         LOG(LIB_INFO) << ">>>> # of queries per sec: : " << queryPerSec;
         LOG(LIB_INFO) << ">>>> Avg time per query:     " << (timeSec/1e3/numquery) << " msec";
+        const LatencyHistogram& hist = QueryTimeHist[MethNum];
+        LOG(LIB_INFO) << ">>>> Query time p50/p90/p99/p999: "
+                      << hist.Percentile(50) / 1e3   << " / " << hist.Percentile(90) / 1e3 << " / "
+                      << hist.Percentile(99) / 1e3   << " / " << hist.Percentile(99.9) / 1e3 << " msec";
         LOG(LIB_INFO) << ">>>> System time elapsed:    " << (SystemTimeElapsed[MethNum]/double(1e6)) << " sec";
         LOG(LIB_INFO) << "=========================================";
       }
@@ -311,6 +345,67 @@ public:
 
     if (LogInfo) LOG(LIB_INFO) << "#### Finished " << QueryType::Type() << " " << LibGetCurrentTime();
   }
+
+ private:
+  struct ThreadStat {
+    vector<double>    QueryTime;
+    LatencyHistogram  QueryTimeHist;
+  };
+
+  /*
+   * An open-loop load test: queries arrive at a fixed rate (TargetQPS)
+   * regardless of how fast previous queries are answered. They are processed
+   * by ThreadTestQty threads. The latency of a query is measured from its
+   * scheduled arrival time rather than from the actual start of processing.
+   * Thus, it includes the time spent waiting for a free thread, which a closed-loop
+   * test (where the next query starts only after the previous one finishes) ignores.
+   * Running this test for increasing rates produces a throughput-vs-latency curve.
+   */
+  template <typename QueryType, typename QueryCreatorType>
+  static void RunOpenLoop(unsigned                        ThreadTestQty,
+                          double                          TargetQPS,
+                          const ExperimentConfig<dist_t>& config,
+                          const QueryCreatorType&         QueryCreator,
+                          IndexType&                      Method) {
+    typedef std::chrono::steady_clock Clock;
+
+    CHECK_MSG(TargetQPS > 0, "The target number of queries per second should be positive");
+    const size_t numquery = config.GetQueryObjects().size();
+
+    vector<LatencyHistogram>    Latency(ThreadTestQty);
+    vector<Clock::time_point>   LastFinish(ThreadTestQty);
+    std::atomic<size_t>         NextQuery(0);
+    const Clock::time_point     Start = Clock::now();
+
+    // ParallelFor may run fewer threads concurrently, which would reduce the load
+    RunInDedicatedThreads(ThreadTestQty, [&](unsigned ThreadPart) {
+      LastFinish[ThreadPart] = Start;
+      for (size_t q = NextQuery++; q < numquery; q = NextQuery++) {
+        const Clock::time_point arrival =
+            Start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(q / TargetQPS));
+        unique_ptr<QueryType> query(QueryCreator(config.GetSpace(), config.GetQueryObjects()[q]));
+        std::this_thread::sleep_until(arrival);
+        Method.Search(query.get());
+        LastFinish[ThreadPart] = Clock::now();
+        Latency[ThreadPart].Record(
+            std::chrono::duration_cast<std::chrono::microseconds>(LastFinish[ThreadPart] - arrival).count());
+      }
+    });
+
+    LatencyHistogram hist;
+    Clock::time_point finish = Start;
+    for (unsigned i = 0; i < ThreadTestQty; ++i) {
+      hist.Merge(Latency[i]);
+      finish = std::max(finish, LastFinish[i]);
+    }
+    const double timeSec = std::chrono::duration<double>(finish - Start).count();
+
+    LOG(LIB_INFO) << ">>>> Open-loop test, target QPS: " << TargetQPS
+                  << " achieved QPS: " << (timeSec > 0 ? numquery / timeSec : 0)
+                  << " latency p50/p90/p99/p999: "
+                  << hist.Percentile(50) / 1e3 << " / " << hist.Percentile(90) / 1e3 << " / "
+                  << hist.Percentile(99) / 1e3 << " / " << hist.Percentile(99.9) / 1e3 << " msec";
+  }
 };
 
 }   // namespace similarity
@@ -25,8 +25,10 @@
 #include "factory/space/space_js.h"
 #include "factory/space/space_lp.h"
 #include "factory/space/space_scalar.h"
+#include "factory/space/space_vector_half.h"
 #include "factory/space/space_sparse_lp.h"
 #include "factory/space/space_sparse_scalar.h"
+#include "factory/space/space_sparse_quant.h"
 #include "factory/space/space_word_embed.h"
 #include "factory/space/space_ab_diverg.h"
 #include "factory/space/space_renyi_diverg.h"
@@ -45,9 +47,9 @@ inline void initSpaces() {
   REGISTER_SPACE_CREATOR(float,  SPACE_DUMMY,  CreateDummy)
 
   // Registering binary/bit Hamming/Jaccard
-  SpaceFactoryRegistry<int>::CreateFuncPtr bit_hamming_func_ptr = CreateBitHamming<int,uint32_t>;
+  SpaceFactoryRegistry<int>::CreateFuncPtr bit_hamming_func_ptr = CreateBitHamming<int,uint64_t>;
   REGISTER_SPACE_CREATOR(int,    SPACE_BIT_HAMMING, bit_hamming_func_ptr )
-  SpaceFactoryRegistry<float>::CreateFuncPtr bit_jaccard_func_ptr = CreateBitJaccard<float,uint32_t>;
+  SpaceFactoryRegistry<float>::CreateFuncPtr bit_jaccard_func_ptr = CreateBitJaccard<float,uint64_t>;
   REGISTER_SPACE_CREATOR(float, SPACE_BIT_JACCARD,  bit_jaccard_func_ptr )
 
   // Registering the Levensthein-distance: regular and normalized
@@ -86,6 +88,14 @@ inline void initSpaces() {
   REGISTER_SPACE_CREATOR(float,  SPACE_ANGULAR_DISTANCE, CreateAngularDistance)
   REGISTER_SPACE_CREATOR(float,  SPACE_NEGATIVE_SCALAR, CreateNegativeScalarProduct)
 
+  // Dense spaces with 16-bit storage (IEEE half precision and bfloat16)
+  REGISTER_SPACE_CREATOR(float,  SPACE_L2_FP16, CreateL2Half<Float16>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_L2_BF16, CreateL2Half<BFloat16>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_COSINE_SIMILARITY_FP16, CreateCosineSimilarityHalf<Float16>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_COSINE_SIMILARITY_BF16, CreateCosineSimilarityHalf<BFloat16>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_NEGATIVE_SCALAR_FP16, CreateNegativeScalarProductHalf<Float16>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_NEGATIVE_SCALAR_BF16, CreateNegativeScalarProductHalf<BFloat16>)
+
   // Sparse
   REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_L, CreateSparseL)
   REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_LINF, CreateSparseLINF)
@@ -103,6 +113,14 @@ inline void initSpaces() {
   REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_NEGATIVE_SCALAR_PROD_BIN_FAST, CreateSparseNegativeScalarProductBinFast)
   REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_QUERY_NORM_NEGATIVE_SCALAR_FAST, CreateSparseQueryNormNegativeScalarProductFast)
 
+  // Sparse spaces with delta-encoded ids and 8-bit or 16-bit quantized values
+  REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_COSINE_SIMILARITY_Q8, CreateSparseCosineSimilarityQuant<int8_t>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_COSINE_SIMILARITY_Q16, CreateSparseCosineSimilarityQuant<int16_t>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_ANGULAR_DISTANCE_Q8, CreateSparseAngularDistanceQuant<int8_t>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_ANGULAR_DISTANCE_Q16, CreateSparseAngularDistanceQuant<int16_t>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_NEGATIVE_SCALAR_Q8, CreateSparseNegativeScalarProductQuant<int8_t>)
+  REGISTER_SPACE_CREATOR(float,  SPACE_SPARSE_NEGATIVE_SCALAR_Q16, CreateSparseNegativeScalarProductQuant<int16_t>)
+
   REGISTER_SPACE_CREATOR(float, SPACE_SPARSE_JACCARD, CreateSpaceSparseJaccard)
   REGISTER_SPACE_CREATOR(float, SPACE_SPARSE_JACCARD_GOLDFINGER, CreateSpaceSparseJaccardGoldfinger)
 
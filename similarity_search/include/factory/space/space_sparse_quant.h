@@ -0,0 +1,47 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef FACTORY_SPACE_SPARSE_QUANT_H
+#define FACTORY_SPACE_SPARSE_QUANT_H
+
+#include <space/space_sparse_quant.h>
+
+namespace similarity {
+
+/*
+ * Creating functions.
+ */
+
+template <typename qval_t>
+Space<float>* CreateSparseCosineSimilarityQuant(const AnyParams& /* ignoring params */) {
+  return new SpaceSparseCosineSimilarityQuant<qval_t>();
+}
+
+template <typename qval_t>
+Space<float>* CreateSparseAngularDistanceQuant(const AnyParams& /* ignoring params */) {
+  return new SpaceSparseAngularDistanceQuant<qval_t>();
+}
+
+template <typename qval_t>
+Space<float>* CreateSparseNegativeScalarProductQuant(const AnyParams& /* ignoring params */) {
+  return new SpaceSparseNegativeScalarProductQuant<qval_t>();
+}
+
+/*
+ * End of creating functions.
+ */
+
+}
+
+#endif
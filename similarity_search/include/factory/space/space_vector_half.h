@@ -0,0 +1,47 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef FACTORY_SPACE_VECTOR_HALF_H
+#define FACTORY_SPACE_VECTOR_HALF_H
+
+#include <space/space_vector_half.h>
+
+namespace similarity {
+
+/*
+ * Creating functions.
+ */
+
+template <typename half_t>
+Space<float>* CreateL2Half(const AnyParams& /* ignoring params */) {
+  return new SpaceL2Half<half_t>();
+}
+
+template <typename half_t>
+Space<float>* CreateCosineSimilarityHalf(const AnyParams& /* ignoring params */) {
+  return new SpaceCosineSimilarityHalf<half_t>();
+}
+
+template <typename half_t>
+Space<float>* CreateNegativeScalarProductHalf(const AnyParams& /* ignoring params */) {
+  return new SpaceNegativeScalarProductHalf<half_t>();
+}
+
+/*
+ * End of creating functions.
+ */
+
+}
+
+#endif
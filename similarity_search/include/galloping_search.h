@@ -0,0 +1,76 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _GALLOPING_SEARCH_H_
+#define _GALLOPING_SEARCH_H_
+
+#include <cstddef>
+
+namespace similarity {
+
+/*
+ * The galloping (exponential) search is used to advance posting-list pointers.
+ * It finds the smallest position pos in [start, qty) such that key(arr[pos]) >= target
+ * (or qty, if no such position exists). The cost is O(log(pos - start)) rather
+ * than O(pos - start), which matters when posting lists are skipped over by
+ * WAND-like algorithms. The search window is first expanded exponentially and
+ * then narrowed using the binary search. Short remaining ranges are scanned
+ * linearly, b/c this is faster than branchy bisection.
+ *
+ * For an example of using galloping search in list intersection see, e.g.:
+ *
+ *  Bentley, Jon Louis, and Andrew Chi-Chih Yao.
+ *  "An almost optimal algorithm for unbounded searching."
+ *  Information processing letters 5.3 (1976): 82-87.
+ */
+template <typename ElemType, typename TargetType, typename KeyFunc>
+inline size_t GallopLowerBound(const ElemType* arr, size_t start, size_t qty,
+                               const TargetType& target, KeyFunc key) {
+  const size_t kLinearScanQty = 16;
+
+  if (start >= qty || !(key(arr[start]) < target)) return start;
+  /*
+   * Invariant: key(arr[lo]) < target, and the answer is in (lo, hi]
+   * (hi == qty means that all remaining elements are smaller than the target).
+   */
+  size_t lo = start;
+  size_t step = 1;
+  size_t hi = start + step;
+  while (hi < qty && key(arr[hi]) < target) {
+    lo = hi;
+    step <<= 1;
+    hi = lo + step;
+  }
+  if (hi > qty) hi = qty;
+
+  while (hi - lo > kLinearScanQty) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (key(arr[mid]) < target) lo = mid; else hi = mid;
+  }
+  size_t pos = lo + 1;
+  while (pos < hi && key(arr[pos]) < target) ++pos;
+  return pos;
+}
+
+/*
+ * A version for arrays of plain keys.
+ */
+template <typename ElemType>
+inline size_t GallopLowerBound(const ElemType* arr, size_t start, size_t qty, const ElemType& target) {
+  return GallopLowerBound(arr, start, qty, target, [](const ElemType& e) -> const ElemType& { return e; });
+}
+
+}  // namespace similarity
+
+#endif     //  _GALLOPING_SEARCH_H_
@@ -27,15 +27,43 @@
 #include "space.h"
 #include "utils.h"
 #include "ztimer.h"
+#include "thread_pool.h"
+#include "dense_brute_force.h"
 
 #define SEQ_SEARCH_TIME        "SeqSearchTime"
 #define SEQ_GS_QTY             "GoldStandQty"
 #define GS_NOTE_FIELD          "Note"
 #define GS_TEST_SET_ID         "TestSetId"
 #define GS_THREAD_TEST_QTY     "ThreadTestQty"
+#define GS_SHARD_CHECKSUM      "ShardChecksum"
 
 namespace similarity {
 
+/*
+ * The gold standard is computed for blocks of queries and data points (tiles):
+ * a block of data points is loaded into the CPU cache once for the whole block of queries.
+ */
+const size_t GS_QUERY_BLOCK_QTY     = 16;
+const size_t GS_DATA_BLOCK_QTY      = DenseBruteForce::BLOCK_QTY;
+/*
+ * If all distances are memorized (e.g., for range queries), the block of queries
+ * is made smaller so that a thread doesn't keep more than this number of entries.
+ */
+const size_t GS_MAX_BLOCK_ENTRY_QTY = 8 * 1024 * 1024;
+// The number of queries in one checksummed shard of the cache
+const size_t GS_CACHE_SHARD_QTY     = 1024;
+
+// Updates a 64-bit FNV-1a checksum
+inline void UpdateChecksum(uint64_t& checksum, const void* p, size_t len) {
+  const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(p);
+  for (size_t i = 0; i < len; ++i) {
+    checksum ^= pBytes[i];
+    checksum *= 1099511628211ULL;
+  }
+}
+
+const uint64_t CHECKSUM_INIT = 14695981039346656037ULL;
+
 using std::vector;
 using std::ostream;
 using std::istream;
@@ -70,6 +98,11 @@ struct ResultEntry {
     out.write(reinterpret_cast<const char*>(&mLabel), sizeof mLabel);
     out.write(reinterpret_cast<const char*>(&mDist),  sizeof mDist);
   }
+  void updateChecksum(uint64_t& checksum) const {
+    UpdateChecksum(checksum, &mId,    sizeof mId);
+    UpdateChecksum(checksum, &mLabel, sizeof mLabel);
+    UpdateChecksum(checksum, &mDist,  sizeof mDist);
+  }
   bool operator<(const ResultEntry& o) const {
     if (mDist != o.mDist) return mDist < o.mDist;
     return mId < o.mId;
@@ -92,18 +125,92 @@ enum ClassResult {
   kClassWrong,
 };
 
+/*
+ * Collects distances from one query to data points. If maxQty is non-zero,
+ * only maxQty entries closest to the query are kept (in a max-heap),
+ * otherwise all entries are memorized.
+ */
+template <class dist_t>
+class GoldStandardAccumulator {
+public:
+  explicit GoldStandardAccumulator(size_t maxQty = 0) : maxQty_(maxQty) {}
+
+  /*
+   * A data point can get into the set of kept entries only
+   * if its distance to the query isn't larger than the threshold.
+   */
+  dist_t Threshold() const {
+    return maxQty_ && entries_.size() >= maxQty_ ? entries_.front().mDist : DistMax<dist_t>();
+  }
+
+  void Add(const ResultEntry<dist_t>& e) {
+    if (!maxQty_) {
+      entries_.push_back(e);
+    } else if (entries_.size() < maxQty_) {
+      entries_.push_back(e);
+      std::push_heap(entries_.begin(), entries_.end());
+    } else if (e < entries_.front()) {
+      std::pop_heap(entries_.begin(), entries_.end());
+      entries_.back() = e;
+      std::push_heap(entries_.begin(), entries_.end());
+    }
+  }
+
+  vector<ResultEntry<dist_t>>& Entries() { return entries_; }
+
+private:
+  size_t                      maxQty_;
+  vector<ResultEntry<dist_t>> entries_;
+};
+
 template <class dist_t>
 class GoldStandard {
 public:
   GoldStandard(){}
-  GoldStandard(const typename similarity::Space<dist_t>& space,
-              const ObjectVector& datapoints,
-              typename similarity::Query<dist_t>* query,
-              float maxKeepEntryCoeff
-              ) {
-    DoSeqSearch(space, datapoints, query);
+  /*
+   * Creates the gold standard from entries (in an arbitrary order), which are moved
+   * from the input vector. If maxKeepEntryCoeff is non-zero, we keep only
+   * resultQty * maxKeepEntryCoeff entries closest to the query.
+   */
+  GoldStandard(vector<ResultEntry<dist_t>>& entries,
+               size_t resultQty,
+               uint64_t seqSearchTime,
+               float maxKeepEntryCoeff) : SeqSearchTime_(seqSearchTime) {
+    SortedAllEntries_.swap(entries);
+    std::sort(SortedAllEntries_.begin(), SortedAllEntries_.end());
+    Truncate(resultQty, maxKeepEntryCoeff);
+  }
+  /*
+   * Merges the gold standard computed for another (disjoint) set of data points.
+   * If either gold standard was truncated (i.e., it has fewer entries than
+   * the respective number of data points), the merged list is cut right after
+   * the farthest entry of the truncated list: the order of remaining
+   * entries is unknown. This doesn't affect results as long as truncated lists
+   * contain at least resultQty * maxKeepEntryCoeff entries.
+   */
+  void Merge(const GoldStandard& other, size_t thisDataQty, size_t otherDataQty) {
+    const vector<ResultEntry<dist_t>>& otherEntries = other.SortedAllEntries_;
+    vector<ResultEntry<dist_t>> merged(SortedAllEntries_.size() + otherEntries.size());
+    std::merge(SortedAllEntries_.begin(), SortedAllEntries_.end(),
+               otherEntries.begin(), otherEntries.end(),
+               merged.begin());
+
+    auto mergedEnd = merged.end();
+    if (SortedAllEntries_.size() < thisDataQty && !SortedAllEntries_.empty()) {
+      mergedEnd = std::min(mergedEnd, std::upper_bound(merged.begin(), mergedEnd, SortedAllEntries_.back()));
+    }
+    if (otherEntries.size() < otherDataQty && !otherEntries.empty()) {
+      mergedEnd = std::min(mergedEnd, std::upper_bound(merged.begin(), mergedEnd, otherEntries.back()));
+    }
+    merged.erase(mergedEnd, merged.end());
+
+    SortedAllEntries_.swap(merged);
+    SeqSearchTime_ += other.SeqSearchTime_;
+  }
+  // Keeps resultQty * maxKeepEntryCoeff entries (or all entries if maxKeepEntryCoeff is zero)
+  void Truncate(size_t resultQty, float maxKeepEntryCoeff) {
     size_t maxKeepEntryQty =
-        std::min((size_t)std::round(query->ResultSize()*maxKeepEntryCoeff),
+        std::min((size_t)std::round(resultQty*maxKeepEntryCoeff),
                  SortedAllEntries_.size());
 
     if (maxKeepEntryQty != 0) {
@@ -118,18 +225,19 @@ public:
     }
   }
   /*
-   * See the endianness comment.
+   * See the endianness comment. The checksum is computed for the binary data.
    */
-  void Write(ostream& controlStream, ostream& binaryStream) const {
+  void Write(ostream& controlStream, ostream& binaryStream, uint64_t& checksum) const {
 
     WriteField(controlStream, SEQ_SEARCH_TIME, ConvertToString(SeqSearchTime_));
     WriteField(controlStream, SEQ_GS_QTY, ConvertToString(SortedAllEntries_.size()));
     for (size_t i = 0; i < SortedAllEntries_.size(); ++i) {
       SortedAllEntries_[i].writeBinary(binaryStream);
+      SortedAllEntries_[i].updateChecksum(checksum);
     }
   }
 
-  void Read(istream& controlStream, istream& binaryStream) {
+  void Read(istream& controlStream, istream& binaryStream, uint64_t& checksum) {
     string s;
     ReadField(controlStream, SEQ_SEARCH_TIME, s);
     ConvertFromString(s, SeqSearchTime_);
@@ -137,8 +245,11 @@ public:
     size_t qty = 0;
     ConvertFromString(s, qty);
     SortedAllEntries_.resize(qty);
-    for (size_t i = 0; i < qty; ++i)
+    for (size_t i = 0; i < qty; ++i) {
       SortedAllEntries_[i].readBinary(binaryStream);
+      SortedAllEntries_[i].updateChecksum(checksum);
+    }
+    if (!binaryStream) throw runtime_error("Error reading the binary gold standard data, the file is likely truncated");
   }
   uint64_t GetSeqSearchTime()     const { return SeqSearchTime_; }
 
@@ -148,78 +259,30 @@ public:
    */
   const vector<ResultEntry<dist_t>>&   GetSortedEntries() const { return  SortedAllEntries_;}
 private:
-  void DoSeqSearch(const Space<dist_t>& space,
-                   const ObjectVector&  datapoints,
-                   typename similarity::Query<dist_t>* pQuery) {
-    WallClockTimer  wtm;
-
-    wtm.reset();
-
-    SortedAllEntries_.resize(datapoints.size());
-    const Object* pQueryObj = pQuery->QueryObject();
-
-    for (size_t i = 0; i < datapoints.size(); ++i) {
-      // Distance can be asymmetric, but the query is always on the right side
-      SortedAllEntries_[i] = ResultEntry<dist_t>(datapoints[i]->id(),
-                                                 datapoints[i]->label(),
-                                                 space.IndexTimeDistance(datapoints[i], pQueryObj));
-      pQuery->CheckAndAddToResult(SortedAllEntries_[i].mDist, datapoints[i]);
-    }
-
-    wtm.split();
-
-    SeqSearchTime_ = wtm.elapsed();
-
-    std::sort(SortedAllEntries_.begin(), SortedAllEntries_.end());
-  }
-
-  uint64_t                            SeqSearchTime_;
+  uint64_t                            SeqSearchTime_ = 0;
 
   vector<ResultEntry<dist_t>>         SortedAllEntries_;
 };
 
-template <typename dist_t, typename QueryCreatorType>
-struct GoldStandardThreadParams {
-  const ExperimentConfig<dist_t>&             config_;
-  const QueryCreatorType&                     QueryCreator_;
-  float                                       maxKeepEntryCoeff_;
-  const unsigned                              ThreadQty_;
-  const unsigned                              GoldStandPart_;
-  vector<unique_ptr<GoldStandard<dist_t>>>&   vGoldStand_;
-  GoldStandardThreadParams(const ExperimentConfig<dist_t>& config,
-                           const QueryCreatorType& QueryCreator,
-                           float maxKeepEntryCoeff,
-                           unsigned ThreadQty,
-                           unsigned GoldStandPart,
-                           vector<unique_ptr<GoldStandard<dist_t>>>& vGoldStand) : config_(config),
-                                                                                   QueryCreator_(QueryCreator),
-                                                                                   maxKeepEntryCoeff_(maxKeepEntryCoeff),
-                                                                                   ThreadQty_(ThreadQty),
-                                                                                   GoldStandPart_(GoldStandPart),
-                                                                                   vGoldStand_(vGoldStand) {}
-};
-
-template <typename dist_t, typename QueryCreatorType>
-struct GoldStandardThread {
-  void operator ()(GoldStandardThreadParams<dist_t,QueryCreatorType>& prm) {
-    size_t numquery = prm.config_.GetQueryObjects().size();
-
-    unsigned GoldStandPart = prm.GoldStandPart_;
-    unsigned ThreadQty = prm.ThreadQty_;
-
-    for (size_t q = 0; q < numquery; ++q) {
-      if ((q % ThreadQty) == GoldStandPart) {
-        unique_ptr<Query<dist_t>> query(prm.QueryCreator_(prm.config_.GetSpace(),
-                                                          prm.config_.GetQueryObjects()[q]));
+/*
+ * A fast filter for dense float vectors, it is used only for k-NN queries,
+ * where the number of kept entries is bounded, and only for spaces
+ * supported by DenseBruteForce.
+ */
+template <class dist_t>
+inline DenseBruteForce* CreateGoldStandardFilter(const Space<dist_t>&, const ObjectVector&) {
+  return nullptr;
+}
 
-        prm.vGoldStand_[q].reset(new GoldStandard<dist_t>(prm.config_.GetSpace(),
-                                                          prm.config_.GetDataObjects(),
-                                                          query.get(),
-                                                          prm.maxKeepEntryCoeff_));
-      }
-    }
+template <>
+inline DenseBruteForce* CreateGoldStandardFilter<float>(const Space<float>& space, const ObjectVector& data) {
+  DenseBruteForce::DistType distType;
+  if (data.empty() || !DenseBruteForce::GetDistType(space, distType)) return nullptr;
+  for (const Object* pObj : data) {
+    if (pObj->datalength() != data[0]->datalength()) return nullptr;
   }
-};
+  return new DenseBruteForce(data, distType);
+}
 
 template <class dist_t>
 class GoldStandardManager {
@@ -233,17 +296,53 @@ public:
   void Compute(size_t threadQty, float maxKeepEntryCoeff) {
     threadQty = std::max(size_t(1), threadQty);
     LOG(LIB_INFO) << "Computing gold standard data using " << threadQty << " threads, keeping " << maxKeepEntryCoeff<< "x entries compared to the result set size";;
+    const size_t dataQty = config_.GetDataObjects().size();
     for (size_t i = 0; i < config_.GetRange().size(); ++i) {
       vvGoldStandardRange_[i].clear();
       const dist_t radius = config_.GetRange()[i];
       RangeCreator<dist_t>  cr(radius);
-      procOneSet(cr, vvGoldStandardRange_[i], threadQty, maxKeepEntryCoeff);
+      procOneSet(cr, 0, vvGoldStandardRange_[i], 0, dataQty, threadQty, maxKeepEntryCoeff);
     }
     for (size_t i = 0; i < config_.GetKNN().size(); ++i) {
       vvGoldStandardKNN_[i].clear();
       const size_t K = config_.GetKNN()[i];
       KNNCreator<dist_t>  cr(K, config_.GetEPS());
-      procOneSet(cr, vvGoldStandardKNN_[i], threadQty, maxKeepEntryCoeff);
+      procOneSet(cr, K, vvGoldStandardKNN_[i], 0, dataQty, threadQty, maxKeepEntryCoeff);
+    }
+  }
+  /*
+   * Extends the gold standard (e.g., read from the cache), which was computed
+   * for the first oldDataQty data points, to all data points of the current test set.
+   * This works, because new data points are appended to the end of the data set.
+   */
+  void Extend(size_t threadQty, float maxKeepEntryCoeff, size_t oldDataQty) {
+    threadQty = std::max(size_t(1), threadQty);
+    const size_t dataQty = config_.GetDataObjects().size();
+    CHECK(oldDataQty <= dataQty);
+    LOG(LIB_INFO) << "Extending gold standard data from " << oldDataQty << " to " << dataQty << " data points";
+    for (size_t i = 0; i < config_.GetRange().size(); ++i) {
+      const dist_t radius = config_.GetRange()[i];
+      RangeCreator<dist_t>  cr(radius);
+      vector<unique_ptr<GoldStandard<dist_t>>> vNew;
+      procOneSet(cr, 0, vNew, oldDataQty, dataQty, threadQty, 0 /* keep everything */);
+      for (size_t q = 0; q < vNew.size(); ++q) {
+        GoldStandard<dist_t>& gs = *vvGoldStandardRange_[i][q];
+        gs.Merge(*vNew[q], oldDataQty, dataQty - oldDataQty);
+        size_t resultQty = 0;
+        for (const ResultEntry<dist_t>& e : gs.GetSortedEntries()) resultQty += e.mDist <= radius;
+        gs.Truncate(resultQty, maxKeepEntryCoeff);
+      }
+    }
+    for (size_t i = 0; i < config_.GetKNN().size(); ++i) {
+      const size_t K = config_.GetKNN()[i];
+      KNNCreator<dist_t>  cr(K, config_.GetEPS());
+      vector<unique_ptr<GoldStandard<dist_t>>> vNew;
+      procOneSet(cr, K, vNew, oldDataQty, dataQty, threadQty, maxKeepEntryCoeff);
+      for (size_t q = 0; q < vNew.size(); ++q) {
+        GoldStandard<dist_t>& gs = *vvGoldStandardKNN_[i][q];
+        gs.Merge(*vNew[q], oldDataQty, dataQty - oldDataQty);
+        gs.Truncate(std::min(K, dataQty), maxKeepEntryCoeff);
+      }
     }
   }
   void Read(istream& controlStream, istream& binaryStream,
@@ -298,10 +397,18 @@ private:
   vector<vector<unique_ptr<GoldStandard<dist_t>>>>    vvGoldStandardRange_;
   vector<vector<unique_ptr<GoldStandard<dist_t>>>>    vvGoldStandardKNN_;
 
+  /*
+   * Entries are written in shards of GS_CACHE_SHARD_QTY queries,
+   * the checksum of each shard is saved to the control file.
+   */
   void writeOneGS(ostream& controlStream, ostream& binaryStream,
                   const vector<unique_ptr<GoldStandard<dist_t>>>& oneGS) {
-    for(const unique_ptr<GoldStandard<dist_t>>& obj : oneGS) {
-      obj->Write(controlStream, binaryStream);
+    for (size_t shardStart = 0; shardStart < oneGS.size(); shardStart += GS_CACHE_SHARD_QTY) {
+      uint64_t checksum = CHECKSUM_INIT;
+      for (size_t k = shardStart; k < std::min(oneGS.size(), shardStart + GS_CACHE_SHARD_QTY); ++k) {
+        oneGS[k]->Write(controlStream, binaryStream, checksum);
+      }
+      WriteField(controlStream, GS_SHARD_CHECKSUM, checksum);
     }
   }
 
@@ -309,50 +416,129 @@ private:
                  size_t queryQty,
                  vector<unique_ptr<GoldStandard<dist_t>>>& oneGS) {
     oneGS.resize(queryQty);
-    for (size_t k = 0; k < queryQty; ++k) {
-      unique_ptr<GoldStandard<dist_t>>  gs(new GoldStandard<dist_t>());
-      gs->Read(controlStream, binaryStream);
-      oneGS[k].reset(gs.release());
+    for (size_t shardStart = 0; shardStart < queryQty; shardStart += GS_CACHE_SHARD_QTY) {
+      uint64_t checksum = CHECKSUM_INIT;
+      for (size_t k = shardStart; k < std::min(queryQty, shardStart + GS_CACHE_SHARD_QTY); ++k) {
+        unique_ptr<GoldStandard<dist_t>>  gs(new GoldStandard<dist_t>());
+        gs->Read(controlStream, binaryStream, checksum);
+        oneGS[k].reset(gs.release());
+      }
+      uint64_t savedChecksum = 0;
+      ReadField(controlStream, GS_SHARD_CHECKSUM, savedChecksum);
+      if (savedChecksum != checksum) {
+        PREPARE_RUNTIME_ERR(err) << "Checksum mismatch in the gold standard cache (the shard starting with query #"
+                                 << shardStart << "), the cache is corrupt and should be removed";
+        THROW_RUNTIME_ERR(err);
+      }
     }
   }
 
+  /*
+   * Computes the gold standard for data points with ids in the range [dataStart, dataEnd).
+   * K is the number of neighbors (zero for range queries). For k-NN queries, the number of 
+   * entries to keep is known in advance, so we don't need to memorize all the distances.
+   */
   template <typename QueryCreatorType>
   void procOneSet(const QueryCreatorType&                   QueryCreator,
+                  size_t                                    K,
                   vector<unique_ptr<GoldStandard<dist_t>>>& vGoldStand,
+                  size_t                                    dataStart,
+                  size_t                                    dataEnd,
                   size_t                                    threadQty,
                   float                                     maxKeepEntryCoeff) {
-    size_t queryQty = config_.GetQueryObjects().size();
+    const size_t queryQty = config_.GetQueryObjects().size();
+    const size_t dataQty = dataEnd - dataStart;
     vGoldStand.resize(queryQty);
 
-    vector<unique_ptr<GoldStandardThreadParams<dist_t,QueryCreatorType>>> GoldStandParams(threadQty);
+    const size_t resultQty = std::min(K, dataQty);
+    const size_t maxKeepEntryQty = std::min((size_t)std::round(resultQty * maxKeepEntryCoeff), dataQty);
 
-    for (unsigned GoldPart = 0; GoldPart < threadQty; ++GoldPart) {
-      GoldStandParams[GoldPart].reset(
-          new GoldStandardThreadParams<dist_t, QueryCreatorType>(config_,
-                                                                 QueryCreator,
-                                                                 maxKeepEntryCoeff,
-                                                                 threadQty,
-                                                                 GoldPart,
-                                                                 vGoldStand));
-    }
+    size_t queryBlockQty = GS_QUERY_BLOCK_QTY;
+    unique_ptr<DenseBruteForce> filter;
 
-    if (threadQty == 1) {
-      GoldStandardThread<dist_t, QueryCreatorType>()(*GoldStandParams[0]);
+    if (maxKeepEntryQty) {
+      filter.reset(CreateGoldStandardFilter(config_.GetSpace(), config_.GetDataObjects()));
     } else {
-      vector<thread> Threads(threadQty);
+      queryBlockQty = std::max(size_t(1), std::min(queryBlockQty, GS_MAX_BLOCK_ENTRY_QTY / std::max(size_t(1), dataQty)));
+    }
 
-      for (unsigned GoldPart = 0; GoldPart < threadQty; ++GoldPart) {
-        Threads[GoldPart] = thread(GoldStandardThread<dist_t,QueryCreatorType>(),ref(*GoldStandParams[GoldPart]));
-      }
+    const size_t blockQty = (queryQty + queryBlockQty - 1) / queryBlockQty;
+
+    ParallelFor(0, blockQty, threadQty, [&](size_t blockId, size_t threadId) {
+      const size_t queryStart = blockId * queryBlockQty;
+      procQueryBlock(QueryCreator, queryStart, std::min(queryQty, queryStart + queryBlockQty),
+                     dataStart, dataEnd, resultQty, maxKeepEntryQty, maxKeepEntryCoeff, filter.get(), vGoldStand);
+    });
+  }
+
+  /*
+   * Processes queries with ids in the range [queryStart, queryEnd). If maxKeepEntryQty 
+   * is zero, all distances are memorized and the result set size is obtained from
+   * the query. Otherwise, resultQty is the size of the result set.
+   */
+  template <typename QueryCreatorType>
+  void procQueryBlock(const QueryCreatorType&                   QueryCreator,
+                      size_t                                    queryStart,
+                      size_t                                    queryEnd,
+                      size_t                                    dataStart,
+                      size_t                                    dataEnd,
+                      size_t                                    resultQty,
+                      size_t                                    maxKeepEntryQty,
+                      float                                     maxKeepEntryCoeff,
+                      const DenseBruteForce*                    filter,
+                      vector<unique_ptr<GoldStandard<dist_t>>>& vGoldStand) {
+    const Space<dist_t>&  space = config_.GetSpace();
+    const ObjectVector&   data = config_.GetDataObjects();
+    const ObjectVector&   queries = config_.GetQueryObjects();
+    const size_t          qty = queryEnd - queryStart;
+
+    vector<unique_ptr<Query<dist_t>>>         vQuery(qty);
+    vector<GoldStandardAccumulator<dist_t>>   vAccum(qty, GoldStandardAccumulator<dist_t>(maxKeepEntryQty));
+    vector<DenseBruteForce::PreparedQuery>    vPreparedQuery(qty);
+    vector<char>                              vUseFilter(qty);
+    vector<uint64_t>                          vSeqSearchTime(qty);
+
+    for (size_t i = 0; i < qty; ++i) {
+      vQuery[i].reset(QueryCreator(space, queries[queryStart + i]));
+      vUseFilter[i] = filter != nullptr && filter->PrepareQuery(queries[queryStart + i], vPreparedQuery[i]);
+      if (!maxKeepEntryQty) vAccum[i].Entries().reserve(dataEnd - dataStart);
+    }
 
-      for (unsigned GoldPart = 0; GoldPart < threadQty; ++GoldPart) {
-        Threads[GoldPart].join();
+    float           bounds[GS_DATA_BLOCK_QTY];
+    WallClockTimer  wtm;
+
+    for (size_t blockStart = dataStart; blockStart < dataEnd; blockStart += GS_DATA_BLOCK_QTY) {
+      const size_t blockEnd = std::min(dataEnd, blockStart + GS_DATA_BLOCK_QTY);
+
+      for (size_t i = 0; i < qty; ++i) {
+        const Object*                     pQueryObj = vQuery[i]->QueryObject();
+        GoldStandardAccumulator<dist_t>&  accum = vAccum[i];
+
+        wtm.reset();
+        if (vUseFilter[i]) filter->ComputeLowerBounds(vPreparedQuery[i], blockStart, blockEnd, bounds);
+
+        for (size_t k = blockStart; k < blockEnd; ++k) {
+          // The filter skips points that cannot be closer than the farthest kept entry
+          if (vUseFilter[i] && bounds[k - blockStart] > accum.Threshold()) continue;
+          // Distance can be asymmetric, but the query is always on the right side
+          const dist_t dist = space.IndexTimeDistance(data[k], pQueryObj);
+          if (!maxKeepEntryQty) vQuery[i]->CheckAndAddToResult(dist, data[k]);
+          accum.Add(ResultEntry<dist_t>(data[k]->id(), data[k]->label(), dist));
+        }
+        wtm.split();
+        vSeqSearchTime[i] += wtm.elapsed();
       }
     }
+
+    for (size_t i = 0; i < qty; ++i) {
+      vGoldStand[queryStart + i].reset(new GoldStandard<dist_t>(vAccum[i].Entries(),
+                                                                maxKeepEntryQty ? resultQty : vQuery[i]->ResultSize(),
+                                                                vSeqSearchTime[i],
+                                                                maxKeepEntryCoeff));
+    }
   }
 };
 
-
 }
 
 #endif
@@ -0,0 +1,124 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef HALF_FLOAT_H
+#define HALF_FLOAT_H
+
+/*
+ * 16-bit floating-point formats used to store dense vectors compactly:
+ * IEEE 754 half precision (fp16) and bfloat16 (bf16), which is simply
+ * the upper half of a 32-bit float. Computations are always carried out
+ * using 32-bit floats, the 16-bit formats are used only for storage.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include "portable_intrinsics.h"
+
+namespace similarity {
+
+struct Float16 {
+  uint16_t bits_;
+};
+
+struct BFloat16 {
+  uint16_t bits_;
+};
+
+inline uint32_t FloatToBits(float v) {
+  uint32_t res;
+  memcpy(&res, &v, sizeof(res));
+  return res;
+}
+
+inline float BitsToFloat(uint32_t v) {
+  float res;
+  memcpy(&res, &v, sizeof(res));
+  return res;
+}
+
+inline float ToFloat(BFloat16 v) {
+  return BitsToFloat(uint32_t(v.bits_) << 16);
+}
+
+inline float ToFloat(Float16 v) {
+#if defined(PORTABLE_F16C)
+  return _cvtsh_ss(v.bits_);
+#else
+  const uint32_t sign = uint32_t(v.bits_ & 0x8000) << 16;
+  const uint32_t exp  = (v.bits_ >> 10) & 0x1f;
+  uint32_t       mant = v.bits_ & 0x3ff;
+
+  if (exp == 0x1f) return BitsToFloat(sign | 0x7f800000 | (mant << 13)); // Inf or NaN
+  if (exp) return BitsToFloat(sign | ((exp + 112) << 23) | (mant << 13));
+  if (!mant) return BitsToFloat(sign); // Signed zero
+  // A subnormal half is a normal float: normalize the mantissa
+  uint32_t e = 113;
+  while (!(mant & 0x400)) {
+    mant <<= 1;
+    --e;
+  }
+  return BitsToFloat(sign | (e << 23) | ((mant & 0x3ff) << 13));
+#endif
+}
+
+// Both conversions from float round to nearest even
+template <class T> T FromFloat(float v);
+
+template <>
+inline BFloat16 FromFloat<BFloat16>(float v) {
+  const uint32_t bits = FloatToBits(v);
+  BFloat16 res;
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    // Keep NaNs quiet (rounding could turn a NaN into Inf)
+    res.bits_ = uint16_t((bits >> 16) | 0x40);
+  } else {
+    res.bits_ = uint16_t((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+  }
+  return res;
+}
+
+template <>
+inline Float16 FromFloat<Float16>(float v) {
+  Float16 res;
+#if defined(PORTABLE_F16C)
+  res.bits_ = _cvtss_sh(v, 0 /* round to nearest even */);
+#else
+  const uint32_t bits = FloatToBits(v);
+  const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+  const uint32_t absBits = bits & 0x7fffffff;
+
+  if (absBits > 0x7f800000) {
+    res.bits_ = sign | 0x7e00;                      // NaN
+  } else if (absBits >= 0x477ff000) {
+    res.bits_ = sign | 0x7c00;                      // Overflow (and Inf)
+  } else if (absBits < 0x38800000) {
+    // The result is subnormal or zero: let float addition do the rounding
+    res.bits_ = sign | uint16_t(FloatToBits(BitsToFloat(absBits) + 0.5f) - FloatToBits(0.5f));
+  } else {
+    const uint32_t mantOdd = (absBits >> 13) & 1;
+    res.bits_ = sign | uint16_t((absBits - (uint32_t(112) << 23) + 0xfff + mantOdd) >> 13);
+  }
+#endif
+  return res;
+}
+
+// The name of the format, which is used as a suffix of space names
+inline const char* HalfFormatName(const Float16*) { return "fp16"; }
+inline const char* HalfFormatName(const BFloat16*) { return "bf16"; }
+
+}  // namespace similarity
+
+#endif
@@ -76,6 +76,12 @@ public:
   virtual void SetQueryTimeParams(const AnyParams& params) = 0;
   // Reset query-time parameters so that they have default values
   virtual void ResetQueryTimeParams() { SetQueryTimeParams(getEmptyParams()); }
+  /*
+   * If true, SetQueryTimeParams can be called while searches are in progress.
+   * Such a method publishes an immutable snapshot of query-time parameters,
+   * and each search uses either the old or the new snapshot (never a mix of them).
+   */
+  virtual bool ConcurrentQueryTimeParams() const { return false; }
   /*
    * In rare cases, mostly when we wrap up 3rd party methods,
    * we simply duplicate the data set. This function
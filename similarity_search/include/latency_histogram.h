@@ -0,0 +1,108 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _LATENCY_HISTOGRAM_H_
+#define _LATENCY_HISTOGRAM_H_
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace similarity {
+
+using std::vector;
+
+/*
+ * A histogram of (integer) latencies with a bounded relative error,
+ * which is similar to the HDR histogram. Values below 2 * SUB_BUCKET_QTY
+ * are stored exactly. Larger values are split into ranges [2^m, 2^(m+1)),
+ * each of which is divided into SUB_BUCKET_QTY equal sub-buckets. Hence,
+ * the relative error of a reported percentile is below 1/SUB_BUCKET_QTY.
+ *
+ * The histogram isn't thread-safe: each thread is supposed to
+ * fill its own histogram. Histograms are merged at the end.
+ */
+class LatencyHistogram {
+ public:
+  static const unsigned SUB_BUCKET_BITS = 7;
+  static const uint64_t SUB_BUCKET_QTY  = uint64_t(1) << SUB_BUCKET_BITS;
+
+  LatencyHistogram() : counts_(BucketIndex(UINT64_MAX) + 1), totalQty_(0), maxVal_(0) {}
+
+  void Record(uint64_t val) {
+    ++counts_[BucketIndex(val)];
+    ++totalQty_;
+    maxVal_ = std::max(maxVal_, val);
+  }
+
+  void Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+    totalQty_ += other.totalQty_;
+    maxVal_ = std::max(maxVal_, other.maxVal_);
+  }
+
+  void Clear() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    totalQty_ = 0;
+    maxVal_ = 0;
+  }
+
+  uint64_t Count() const { return totalQty_; }
+  uint64_t Max() const { return maxVal_; }
+
+  /*
+   * Returns the upper bound of the bucket containing the value at
+   * the given percentile (0 < pct <= 100), or 0 if the histogram is empty.
+   */
+  uint64_t Percentile(double pct) const {
+    if (!totalQty_) return 0;
+    uint64_t rank = static_cast<uint64_t>(pct / 100.0 * totalQty_ + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, totalQty_));
+    uint64_t sum = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      sum += counts_[i];
+      if (sum >= rank) return std::min(BucketUpperBound(i), maxVal_);
+    }
+    return maxVal_;
+  }
+
+  static size_t BucketIndex(uint64_t val) {
+    if (val < 2 * SUB_BUCKET_QTY) return val;
+    unsigned shift = MostSignificantBit(val) - SUB_BUCKET_BITS;
+    return shift * SUB_BUCKET_QTY + (val >> shift);
+  }
+
+  // The largest value that falls into the bucket with the given index
+  static uint64_t BucketUpperBound(size_t bucketId) {
+    if (bucketId < 2 * SUB_BUCKET_QTY) return bucketId;
+    unsigned shift = bucketId / SUB_BUCKET_QTY - 1;
+    uint64_t subBucket = bucketId - shift * SUB_BUCKET_QTY;
+    return (subBucket << shift) + ((uint64_t(1) << shift) - 1);
+  }
+
+ private:
+  static unsigned MostSignificantBit(uint64_t val) {
+    unsigned res = 0;
+    while (val >>= 1) ++res;
+    return res;
+  }
+
+  vector<uint64_t>  counts_;
+  uint64_t          totalQty_;
+  uint64_t          maxVal_;
+};
+
+}   // namespace similarity
+
+#endif     // _LATENCY_HISTOGRAM_H_
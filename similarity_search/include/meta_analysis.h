@@ -46,6 +46,10 @@ public:
     LoadTime_       .resize(TestSetQty);
     SaveTime_       .resize(TestSetQty);
     QueryPerSec_    .resize(TestSetQty);
+    QueryTimeP50_   .resize(TestSetQty);
+    QueryTimeP90_   .resize(TestSetQty);
+    QueryTimeP99_   .resize(TestSetQty);
+    QueryTimeP999_  .resize(TestSetQty);
   }
 
   // Let's protect Add* functions, b/c them can be called from different threads  
@@ -88,6 +92,13 @@ public:
   void SetQueryPerSec(size_t SetId, double QueryPerSec) {
     QueryPerSec_[SetId] = QueryPerSec;
   }
+  // Percentiles of the query time (in msec)
+  void SetQueryTimePercentiles(size_t SetId, double P50, double P90, double P99, double P999) {
+    QueryTimeP50_[SetId]  = P50;
+    QueryTimeP90_[SetId]  = P90;
+    QueryTimeP99_[SetId]  = P99;
+    QueryTimeP999_[SetId] = P999;
+  }
   void SetImprEfficiency(size_t SetId, double ImprEfficiency) {
     ImprEfficiency_[SetId] = ImprEfficiency;
   }
@@ -112,6 +123,10 @@ public:
     ComputeOneSimple("LoadTime", LoadTime_, LoadTimeAvg, LoadTimeConfMin, LoadTimeConfMax);
     ComputeOneSimple("SaveTime", SaveTime_, SaveTimeAvg, SaveTimeConfMin, SaveTimeConfMax);
     ComputeOneSimple("QueryPerSec", QueryPerSec_, QueryPerSecAvg, QueryPerSecConfMin, QueryPerSecConfMax);
+    ComputeOneSimple("QueryTimeP50", QueryTimeP50_, QueryTimeP50Avg, QueryTimeP50ConfMin, QueryTimeP50ConfMax);
+    ComputeOneSimple("QueryTimeP90", QueryTimeP90_, QueryTimeP90Avg, QueryTimeP90ConfMin, QueryTimeP90ConfMax);
+    ComputeOneSimple("QueryTimeP99", QueryTimeP99_, QueryTimeP99Avg, QueryTimeP99ConfMin, QueryTimeP99ConfMax);
+    ComputeOneSimple("QueryTimeP999", QueryTimeP999_, QueryTimeP999Avg, QueryTimeP999ConfMin, QueryTimeP999ConfMax);
   }
 
   double GetRecallAvg() const { return RecallAvg;} 
@@ -170,6 +185,11 @@ public:
   double GetQueryTimeConfMin() const{return QueryTimeConfMin;}; 
   double GetQueryTimeConfMax() const { return QueryTimeConfMax;}
 
+  double GetQueryTimeP50Avg() const { return QueryTimeP50Avg;} 
+  double GetQueryTimeP90Avg() const { return QueryTimeP90Avg;} 
+  double GetQueryTimeP99Avg() const { return QueryTimeP99Avg;} 
+  double GetQueryTimeP999Avg() const { return QueryTimeP999Avg;} 
+
   double GetDistCompAvg() const { return DistCompAvg;} 
   double GetDistCompConfMin() const{return DistCompConfMin;}; 
   double GetDistCompConfMax() const { return DistCompConfMax;}
@@ -189,6 +209,10 @@ double IndexTimeAvg, IndexTimeConfMin, IndexTimeConfMax;
 double LoadTimeAvg, LoadTimeConfMin, LoadTimeConfMax;
 double SaveTimeAvg, SaveTimeConfMin, SaveTimeConfMax;
 double QueryPerSecAvg, QueryPerSecConfMin, QueryPerSecConfMax;
+double QueryTimeP50Avg, QueryTimeP50ConfMin, QueryTimeP50ConfMax;
+double QueryTimeP90Avg, QueryTimeP90ConfMin, QueryTimeP90ConfMax;
+double QueryTimeP99Avg, QueryTimeP99ConfMin, QueryTimeP99ConfMax;
+double QueryTimeP999Avg, QueryTimeP999ConfMin, QueryTimeP999ConfMax;
 double zVal_;
 
 vector<vector<double>>   Recall_; 
@@ -206,6 +230,10 @@ vector<double>           IndexTime_;
 vector<double>           LoadTime_; 
 vector<double>           SaveTime_; 
 vector<double>           QueryPerSec_; 
+vector<double>           QueryTimeP50_; 
+vector<double>           QueryTimeP90_; 
+vector<double>           QueryTimeP99_; 
+vector<double>           QueryTimeP999_; 
 
 MetaAnalysis(){} // be private!
 
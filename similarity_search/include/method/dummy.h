@@ -74,6 +74,8 @@ class DummyMethod : public Index<dist_t> {
   }
 
   void SetQueryTimeParams(const AnyParams& QueryTimeParams) override;
+  // The query-time parameter isn't stored
+  bool ConcurrentQueryTimeParams() const override { return true; }
 
   ~DummyMethod(){};
 
@@ -27,6 +27,7 @@
 
 #include "index.h"
 #include "params.h"
+#include "ef_schedule.h"
 
 #include <condition_variable>
 #include <iostream>
@@ -467,13 +468,14 @@ namespace similarity {
         void Search(KNNQuery<dist_t> *query, IdType) const override;
 
         void SetQueryTimeParams(const AnyParams &) override;
+        bool ConcurrentQueryTimeParams() const override { return true; }
 
     private:
         typedef std::vector<HnswNode *> ElementList;
-        void baseSearchAlgorithmOld(KNNQuery<dist_t> *query);
-        void baseSearchAlgorithmV1Merge(KNNQuery<dist_t> *query);
-        void SearchOld(KNNQuery<dist_t> *query, bool normalize);
-        void SearchV1Merge(KNNQuery<dist_t> *query, bool normalize);
+        void baseSearchAlgorithmOld(KNNQuery<dist_t> *query, size_t ef);
+        void baseSearchAlgorithmV1Merge(KNNQuery<dist_t> *query, size_t ef);
+        void SearchOld(KNNQuery<dist_t> *query, size_t ef, bool normalize);
+        void SearchV1Merge(KNNQuery<dist_t> *query, size_t ef, bool normalize);
 
         int getRandomLevel(double revSize)
         {
@@ -528,7 +530,6 @@ namespace similarity {
         size_t maxM_;
         size_t maxM0_;
         size_t efConstruction_;
-        size_t ef_;
         size_t searchMethod_;
         size_t indexThreadQty_;
         const Space<dist_t> &space_;
@@ -559,7 +560,17 @@ namespace similarity {
 
         enum AlgoType { kOld, kV1Merge, kHybrid };
 
-        AlgoType searchAlgoType_;
+        struct SearchParams {
+            size_t ef = 20;
+            // per-k values of ef (overriding ef)
+            EfSchedule efSchedule;
+            AlgoType searchAlgoType = kHybrid;
+        };
+        /*
+         * SetQueryTimeParams replaces the snapshot (using atomic_store) rather than modifies it.
+         * Thus, parameters can be changed while searches (which use atomic_load) are in progress.
+         */
+        std::shared_ptr<const SearchParams> queryTimeParams_;
 
     protected:
         DISABLE_COPY_AND_ASSIGN(Hnsw);
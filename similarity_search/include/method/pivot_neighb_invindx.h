@@ -160,6 +160,7 @@ class PivotNeighbInvertedIndex : public Index<dist_t> {
   void GetPermutationPPIndexEfficiently(const Object* object, Permutation& p) const;
   void GetPermutationPPIndexEfficiently(const Query<dist_t>* query, Permutation& p) const;
   void GetPermutationPPIndexEfficiently(Permutation &p, const vector <dist_t> &vDst) const;
+  void GetPermutationPPIndexEfficiently(Permutation &p, const dist_t* vDst) const;
 
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(PivotNeighbInvertedIndex);
@@ -16,8 +16,10 @@
 #define _SEQSEARCH_H_
 
 #include <string>
+#include <memory>
 
 #include "index.h"
+#include "dense_brute_force.h"
 
 #define METH_SEQ_SEARCH                 "brute_force"
 #define METH_SEQ_SEARCH_SYN             "seq_search"
@@ -27,8 +29,11 @@ namespace similarity {
 using std::string;
 using std::vector;
 
-// Sequential search
-
+/*
+ * Sequential search. For dense float vectors and supported spaces (L2, cosine similarity,
+ * and negative dot product), the search uses a fast SIMD-based path (see DenseBruteForce),
+ * unless the index-time parameter denseFastPath is set to zero.
+ */
 template <typename dist_t>
 class SeqSearch : public Index<dist_t> {
  public:
@@ -42,6 +47,8 @@ class SeqSearch : public Index<dist_t> {
   void Search(KNNQuery<dist_t>* query, IdType) const override;
 
   void SetQueryTimeParams(const AnyParams& params) override {}
+  // There are no query-time parameters
+  bool ConcurrentQueryTimeParams() const override { return true; }
 
   size_t GetSize() const override { return getData().size(); }
  private:
@@ -51,7 +58,10 @@ class SeqSearch : public Index<dist_t> {
   ObjectVector*           pData_;
   bool                    multiThread_;
   IdTypeUnsign            threadQty_;
-  vector<ObjectVector>    vvThreadData;
+  std::unique_ptr<DenseBruteForce>
+                          denseBF_;
+
+  template <typename QueryType> void GenSearch(QueryType* query) const;
 
   const ObjectVector& getData() const { return pData_ != NULL ? *pData_ : this->data_; }
   // disable copy and assign
@@ -17,17 +17,27 @@
 
 #include <string>
 #include <sstream>
-#include <unordered_map>
 #include <memory>
+#include <limits>
+#include <cstdint>
+#include <atomic>
 
 #include "index.h"
+#include "mmap_file.h"
+#include "galloping_search.h"
 #include "space/space_sparse_scalar_fast.h"
 
 #define METH_SIMPLE_INV_INDEX             "simple_invindx"
 
+#define SIMPL_INV_PROC_DAAT               "daat"
+#define SIMPL_INV_PROC_WAND               "wand"
+#define SIMPL_INV_PROC_BMW                "bmw"
+#define SIMPL_INV_PROC_SAAT               "saat"
+
 namespace similarity {
 
 using std::string;
+using std::vector;
 
 template <typename dist_t>
 class SimplInvIndex : public Index<dist_t> {
@@ -37,42 +47,46 @@ class SimplInvIndex : public Index<dist_t> {
    * which are guaranteed to be be valid during testing.
    * So, we can memorize them safely.
    */
-  SimplInvIndex(bool printProgress, 
-              Space<dist_t>& space, 
+  SimplInvIndex(bool printProgress,
+              Space<dist_t>& space,
               const ObjectVector& data) : Index<dist_t>(data),
+                                          query_time_params_(std::make_shared<SearchParams>()),
                                           printProgress_(printProgress),
-                                          pSpace_(dynamic_cast<SpaceSparseNegativeScalarProductFast*>(&space)) {
+                                          pSpace_(dynamic_cast<SpaceSparseNegativeScalarProductFast*>(&space)),
+                                          block_size_(0),
+                                          impact_ordered_(false),
+                                          index_thread_qty_(0) {
     if (pSpace_ == nullptr) {
       PREPARE_RUNTIME_ERR(err) <<
           "The method " << StrDesc() << " works only with the space " << SPACE_SPARSE_NEGATIVE_SCALAR_FAST;
       THROW_RUNTIME_ERR(err);
     }
+    setStoragePointers();
   }
 
-  void CreateIndex(const AnyParams& IndexParams) override; 
+  void CreateIndex(const AnyParams& IndexParams) override;
 
   /*
-   * One can implement functions for index serialization and reading.
-   * However, this is not required.
+   * The index is saved in a binary format, which consists of
+   * the header followed by the sorted term dictionary and
+   * contiguous arrays of postings and blocks. LoadIndex memory-maps
+   * the file and uses these arrays in place, i.e., without copying.
+   * LoadIndex validates only the header and the dictionary, posting lists
+   * are validated when they are accessed for the first time.
    */
-  // SaveIndex is not necessarily implemented
-  virtual void SaveIndex(const string& location) override {
-    throw runtime_error("SaveIndex is not implemented for method: " + StrDesc());
-  }
-  // LoadIndex is not necessarily implemented
-  virtual void LoadIndex(const string& location) override {
-    throw runtime_error("LoadIndex is not implemented for method: " + StrDesc());
-  }
+  virtual void SaveIndex(const string& location) override;
+  virtual void LoadIndex(const string& location) override;
 
   void SetQueryTimeParams(const AnyParams& QueryTimeParams) override;
+  bool ConcurrentQueryTimeParams() const override { return true; }
 
   ~SimplInvIndex() override;
 
-  const std::string StrDesc() const override { 
+  const std::string StrDesc() const override {
     return METH_SIMPLE_INV_INDEX;
   }
 
-  void Search(RangeQuery<dist_t>* query, IdType) const override { 
+  void Search(RangeQuery<dist_t>* query, IdType) const override {
     throw runtime_error("Range search is not supported!");
   }
   void Search(KNNQuery<dist_t>* query, IdType) const override;
@@ -84,31 +98,89 @@ class SimplInvIndex : public Index<dist_t> {
   // a protected creator that has already a created parameter manager
   void CreateIndex(AnyParamManager& ParamManager);
 
+  void SearchDAAT(KNNQuery<dist_t>* query) const;
+  /*
+   * Top-K retrieval with the dynamic pruning using either Broder's WAND
+   * or (if useBlockMax is true) the Block-Max WAND:
+   *
+   * Broder, A. Z., Carmel, D., Herscovici, M., Soffer, A., & Zien, J.
+   * Efficient query evaluation using a two-level retrieval process. CIKM 2003.
+   *
+   * Ding, S., & Suel, T. Faster top-k document retrieval using block-max indexes. SIGIR 2011.
+   */
+  void SearchWAND(KNNQuery<dist_t>* query, bool useBlockMax) const;
+  /*
+   * Score-at-a-time processing of impact-ordered posting lists. Postings
+   * are processed in the order of decreasing contributions. If maxPostQty > 0,
+   * the processing stops after maxPostQty postings (anytime/approximate retrieval):
+   *
+   * Lin, J., & Trotman, A. Anytime ranking for impact-ordered indexes. ICTIR 2015.
+   */
+  void SearchSAAT(KNNQuery<dist_t>* query, size_t maxPostQty) const;
+
   struct PostEntry {
     IdType   doc_id_; // IdType is signed
     dist_t   val_;
     PostEntry(int32_t doc_id = 0, dist_t val = 0) : doc_id_(doc_id), val_(val) {}
   };
+  /*
+   * A posting list is split into blocks of a fixed size. For each block, we memorize
+   * the last document id as well as the minimum and the maximum value. The maximum (minimum)
+   * value is used to upper bound the product of the value and the query term value,
+   * when the latter is positive (negative).
+   */
+  struct PostBlock {
+    IdType   last_doc_id_;
+    dist_t   min_val_;
+    dist_t   max_val_;
+    PostBlock(IdType last_doc_id = 0, dist_t min_val = 0, dist_t max_val = 0) :
+      last_doc_id_(last_doc_id), min_val_(min_val), max_val_(max_val) {}
+  };
+  /*
+   * An entry of the term dictionary, which is sorted by term ids.
+   * Offsets point to contiguous arrays of postings and blocks.
+   * All fields have fixed sizes, so that the dictionary can be stored on disk as is.
+   */
+  struct TermEntry {
+    uint32_t term_id_;
+    uint32_t reserved_;
+    uint64_t post_offset_;
+    uint64_t post_qty_;
+    uint64_t block_offset_;
+    uint64_t block_qty_;
+    // min/max values over the whole list
+    dist_t   min_val_;
+    dist_t   max_val_;
+  };
+
+  /*
+   * A light-weight view of the posting list: it points either
+   * to the memory owned by the index or to the memory-mapped file.
+   */
   struct PostList {
-    // Variables are const, so that they can be initialized only in constructor
-    // However, the memory that entries_ point to isn't const and can be modified
-    const size_t     qty_;
-    PostEntry* const entries_;
-    PostList(size_t qty) :
-        qty_(qty),
-        entries_(new PostEntry[qty]) {
-    }
-    ~PostList() {
-      delete [] entries_;
-    }
+    size_t             qty_;
+    const PostEntry*   entries_;
+    // the same entries sorted in the order of decreasing values (or nullptr)
+    const PostEntry*   impact_entries_;
+    size_t             block_qty_;
+    const PostBlock*   blocks_;
+    dist_t             min_val_;
+    dist_t             max_val_;
   };
 
+  // Returns false if the term isn't in the dictionary
+  bool FindPostList(unsigned termId, PostList& pl) const;
+  // Throws an exception if the posting list of a loaded index is corrupt
+  void checkPostList(size_t termIndex) const;
+  // Computes block-max (and list-max) values, must be called after the list is filled
+  void computeBlockMax(TermEntry& e);
+
   /**
    * A structure that keeps information about current state of search within one posting list.
    */
   struct PostListQueryState {
-    // pointer to the posting list (fixed from the beginning)
-    const PostList*  post_;
+    // the posting list (fixed from the beginning)
+    const PostList   post_;
     // actual position in the list
     size_t           post_pos_;
     // value of the respective term in the query (fixed from the beginning)
@@ -117,12 +189,121 @@ class SimplInvIndex : public Index<dist_t> {
     dist_t           qval_x_docval_;
 
     PostListQueryState(const PostList& pl, dist_t qval, dist_t qval_x_docval)
-        : post_(&pl), post_pos_(0), qval_(qval), qval_x_docval_(qval_x_docval) {}
+        : post_(pl), post_pos_(0), qval_(qval), qval_x_docval_(qval_x_docval) {}
+  };
+
+  /**
+   * A state of the posting list traversal used by WAND and Block-Max WAND.
+   */
+  struct PostListWANDState {
+    PostList         post_;
+    size_t           post_pos_;
+    size_t           block_pos_;
+    dist_t           qval_;
+    // an upper bound for contributions of this query term (it's never negative)
+    dist_t           max_contrib_;
+
+    PostListWANDState(const PostList& pl, dist_t qval)
+        : post_(pl), post_pos_(0), block_pos_(0), qval_(qval),
+          max_contrib_(ContribBound(qval, pl.min_val_, pl.max_val_)) {}
+
+    // A sentinel document id returned for exhausted lists
+    static IdType EndDocId() { return std::numeric_limits<IdType>::max(); }
+
+    static dist_t ContribBound(dist_t qval, dist_t minVal, dist_t maxVal) {
+      return std::max(dist_t(0), qval >= 0 ? qval * maxVal : qval * minVal);
+    }
+
+    IdType CurrDocId() const {
+      return post_pos_ < post_.qty_ ? post_.entries_[post_pos_].doc_id_ : EndDocId();
+    }
+    dist_t CurrContrib() const {
+      return qval_ * post_.entries_[post_pos_].val_;
+    }
+    // Moves to the first entry whose document id is >= docId
+    void Advance(IdType docId) {
+      post_pos_ = GallopLowerBound(post_.entries_, post_pos_, post_.qty_, docId,
+                                   [](const PostEntry& e) -> IdType { return e.doc_id_; });
+    }
+    // Moves (only) the block pointer to the first block whose last document id is >= docId
+    void ShallowAdvance(IdType docId) {
+      block_pos_ = GallopLowerBound(post_.blocks_, block_pos_, post_.block_qty_, docId,
+                                    [](const PostBlock& b) -> IdType { return b.last_doc_id_; });
+    }
+    // The following two functions should be called only after ShallowAdvance()
+    dist_t BlockMaxContrib() const {
+      if (block_pos_ >= post_.block_qty_) return 0;
+      const PostBlock& b = post_.blocks_[block_pos_];
+      return ContribBound(qval_, b.min_val_, b.max_val_);
+    }
+    IdType BlockLastDocId() const {
+      return block_pos_ < post_.block_qty_ ? post_.blocks_[block_pos_].last_doc_id_ : EndDocId();
+    }
+  };
+
+  enum eAlgProctype {
+    kDAAT,
+    kWAND,
+    kBMW,
+    kSAAT
+  };
+
+  string toString(eAlgProctype type) const {
+    if (type == kDAAT)   return SIMPL_INV_PROC_DAAT;
+    if (type == kWAND)   return SIMPL_INV_PROC_WAND;
+    if (type == kBMW)    return SIMPL_INV_PROC_BMW;
+    if (type == kSAAT)   return SIMPL_INV_PROC_SAAT;
+    return "unknown";
+  }
+
+  struct SearchParams {
+    eAlgProctype  inv_proc_alg_ = kDAAT;
+    // The maximum number of postings processed by SAAT (0 means no limit)
+    size_t        saat_post_qty_ = 0;
   };
+  /*
+   * SetQueryTimeParams replaces the snapshot (using atomic_store) rather than modifies it.
+   * Thus, parameters can be changed while searches (which use atomic_load) are in progress.
+   */
+  std::shared_ptr<const SearchParams>                      query_time_params_;
 
   bool                                                     printProgress_;
   SpaceSparseNegativeScalarProductFast*                    pSpace_;
-  std::unordered_map<unsigned, std::unique_ptr<PostList>>  index_;
+  size_t                                                   block_size_;
+  bool                                                     impact_ordered_;
+  size_t                                                   index_thread_qty_;
+
+  /*
+   * The index data is kept in four contiguous arrays. The arrays
+   * are either owned by the index (after CreateIndex) or reside
+   * in the memory-mapped file (after LoadIndex).
+   */
+  vector<TermEntry>                                        term_store_;
+  vector<PostEntry>                                        post_store_;
+  vector<PostBlock>                                        block_store_;
+  vector<PostEntry>                                        impact_store_;
+  std::unique_ptr<MemMappedFile>                           mmap_file_;
+
+  const TermEntry*                                         terms_;
+  size_t                                                   term_qty_;
+  const PostEntry*                                         posts_;
+  const PostBlock*                                         blocks_;
+  const PostEntry*                                         impact_posts_;
+  /*
+   * For a memory-mapped index, the flags are set after the respective posting lists
+   * are validated (see checkPostList). For an index created in memory, it's nullptr.
+   */
+  std::unique_ptr<std::atomic<bool>[]>                     post_checked_;
+
+  // Makes the storage pointers point to the owned arrays
+  void setStoragePointers() {
+    terms_ = term_store_.data();
+    term_qty_ = term_store_.size();
+    posts_ = post_store_.data();
+    blocks_ = block_store_.data();
+    impact_posts_ = impact_ordered_ ? impact_store_.data() : nullptr;
+    post_checked_.reset();
+  }
   // disable copy and assign
   DISABLE_COPY_AND_ASSIGN(SimplInvIndex);
 };
@@ -17,6 +17,7 @@
 
 #include "index.h"
 #include "params.h"
+#include "ef_schedule.h"
 #include <set>
 #include <limits>
 #include <iostream>
@@ -272,6 +273,7 @@ public:
   void addCriticalSection(MSWNode *newElement);
 
   void SetQueryTimeParams(const AnyParams& ) override;
+  bool ConcurrentQueryTimeParams() const override { return true; }
 
   enum PatchingStrategy { kNone = 0, kNeighborsOnly = 1 };
 
@@ -283,7 +285,6 @@ private:
 
   size_t                NN_;
   size_t                efConstruction_;
-  size_t                efSearch_;
   size_t                indexThreadQty_;
   string                pivotFile_;
   ObjectVector          pivots_;
@@ -299,8 +300,8 @@ private:
   MSWNode*        pEntryPoint_ = nullptr;
 
 
-  void SearchOld(KNNQuery<dist_t>* query) const;
-  void SearchV1Merge(KNNQuery<dist_t>* query) const;
+  void SearchOld(KNNQuery<dist_t>* query, size_t efSearch) const;
+  void SearchV1Merge(KNNQuery<dist_t>* query, size_t efSearch) const;
 
   void UpdateNextNodeId(size_t newNextNodeId);
   void CompactIdsIfNeeded();
@@ -309,7 +310,17 @@ private:
   
   enum AlgoType { kOld, kV1Merge };
 
-  AlgoType               searchAlgoType_;
+  struct SearchParams {
+    size_t      efSearch = 10;
+    // per-k values of efSearch (overriding efSearch)
+    EfSchedule  efSchedule;
+    AlgoType    searchAlgoType = kOld;
+  };
+  /*
+   * SetQueryTimeParams replaces the snapshot (using atomic_store) rather than modifies it.
+   * Thus, parameters can be changed while searches (which use atomic_load) are in progress.
+   */
+  std::shared_ptr<const SearchParams> queryTimeParams_;
 
 protected:
 
@@ -0,0 +1,55 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _MMAP_FILE_H_
+#define _MMAP_FILE_H_
+
+#include <string>
+#include <vector>
+
+#include "global.h"
+
+namespace similarity {
+
+using std::string;
+
+/*
+ * A read-only memory-mapped file. The mapping lives as long as the object does.
+ * On platforms without mmap, the file is simply read into memory.
+ * Errors are reported via exceptions.
+ */
+class MemMappedFile {
+ public:
+  explicit MemMappedFile(const string& fileName);
+  ~MemMappedFile();
+
+  const char* data() const { return data_; }
+  size_t      size() const { return size_; }
+  const string& fileName() const { return fileName_; }
+
+ private:
+  string              fileName_;
+  const char*         data_;
+  size_t              size_;
+#if defined(_WIN32) || defined(WIN32)
+  std::vector<char>   buf_;
+#endif
+
+  // disable copy and assign
+  DISABLE_COPY_AND_ASSIGN(MemMappedFile);
+};
+
+}   // namespace similarity
+
+#endif      // _MMAP_FILE_H_
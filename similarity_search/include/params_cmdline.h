@@ -39,6 +39,9 @@ void ParseCommandLine(int argc, char *argv[], bool& bPrintProgress,
                       string&                         SpaceType,
                       shared_ptr<AnyParams>&          SpaceParams,
                       unsigned&                       ThreadTestQty,
+                      unsigned&                       PoolThreadQty,
+                      bool&                           PinThreads,
+                      vector<double>&                 LoadQPS,
                       bool&                           AppendToResFile, 
                       string&                         ResFilePrefix,
                       unsigned&                       TestSetQty,
@@ -94,6 +94,16 @@ const std::string THREAD_TEST_QTY_PARAM_OPT      = "threadTestQty";
 const std::string THREAD_TEST_QTY_PARAM_MSG      = "# of threads during querying";
 const unsigned THREAD_TEST_QTY_PARAM_DEFAULT     = 1;
 
+const std::string POOL_THREAD_QTY_PARAM_OPT      = "poolThreadQty";
+const std::string POOL_THREAD_QTY_PARAM_MSG      = "# of threads in the thread pool used for indexing and batch querying (0 means all cores)";
+const unsigned POOL_THREAD_QTY_PARAM_DEFAULT     = 0;
+
+const std::string PIN_THREADS_PARAM_OPT          = "pinThreads";
+const std::string PIN_THREADS_PARAM_MSG          = "pin threads of the thread pool to CPU cores";
+
+const std::string LOAD_QPS_PARAM_OPT             = "loadQPS";
+const std::string LOAD_QPS_PARAM_MSG             = "comma-separated query arrival rates (queries per second) for open-loop latency tests";
+
 const std::string OUT_FILE_PREFIX_PARAM_OPT      = "outFilePrefix,o";
 const std::string OUT_FILE_PREFIX_PARAM_MSG      = "output file prefix";
 const std::string OUT_FILE_PREFIX_PARAM_DEFAULT  = "";
@@ -193,7 +193,7 @@ inline void Binarize(const vector<PivotIdType> &perm, const PivotIdType thresh,
     bool b =perm[i] >= thresh;
 
     if (b) {
-      bin_perm[i/64] |= (1<<(i%64)) ;
+      bin_perm[i/64] |= (uint64_t(1)<<(i%64)) ;
     }
   }
 }
@@ -36,6 +36,21 @@
 #define PORTABLE_AVX2
 #endif
 
+// Conversions between 16-bit and 32-bit floats
+#if defined(__F16C__)
+#define PORTABLE_F16C
+#endif
+
+// Scalar products of bfloat16 vectors
+#if defined(__AVX512BF16__)
+#define PORTABLE_AVX512_BF16
+#endif
+
+// The number of 1s in 64-bit words of AVX-512 registers
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+#define PORTABLE_AVX512_POPCNT
+#endif
+
 #if defined(__ARM_NEON)
 #define PORTABLE_NEON
 #endif
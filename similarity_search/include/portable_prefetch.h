@@ -18,7 +18,7 @@
 #include <intrin.h>
 #define PREFETCH(a,sel) _mm_prefetch(a, sel)
 #elif defined(__x86_64__) || defined(__i386__)
-#include <mmintrin.h>
+#include <xmmintrin.h>
 #define PREFETCH(a,sel) _mm_prefetch(a, sel)
 #elif defined(__GNUC__)
 #define PREFETCH(a,sel) __builtin_prefetch(a, 0, 0)
@@ -15,6 +15,8 @@
 #ifndef _QUERY_H_
 #define _QUERY_H_
 
+#include <memory>
+
 #include "object.h"
 
 namespace similarity {
@@ -22,6 +24,11 @@ namespace similarity {
 template <typename dist_t>
 class Space;
 
+class QueryState;
+
+// The maximum number of objects whose distances are computed in one call of CheckAndAddToResultBatch
+const size_t QUERY_BATCH_QTY = 32;
+
 template <typename dist_t>
 class Query {
  public:
@@ -37,9 +44,24 @@ class Query {
   // Distance can be asymmetric!
   virtual dist_t DistanceObjLeft(const Object* object) const;
   virtual dist_t DistanceObjRight(const Object* object) const;
+  /*
+   * Same as DistanceObjLeft, but the distance is exact only if it does not exceed the bound.
+   * Otherwise, the function may return any value larger than the bound (see Space::HiddenDistanceBounded).
+   */
+  virtual dist_t DistanceObjLeftBounded(const Object* object, dist_t bound) const;
+  // Computes bounded distances from qty objects to the query in one call (see Space::HiddenDistanceBatch)
+  virtual void DistanceObjLeftBatch(const Object* const* ppObj, size_t qty, dist_t bound, dist_t* pDist) const;
+  /*
+   * Computes distances from qty objects to the query in batches and adds objects to the result.
+   * The bound on the distance (see ResultBound) is updated after each batch.
+   * Returns the number of added objects.
+   */
+  size_t CheckAndAddToResultBatch(const Object* const* ppObj, size_t qty);
 
   virtual void Reset() = 0;
   virtual dist_t Radius() const = 0;
+  // An object farther from the query than this bound cannot be added to the result
+  virtual dist_t ResultBound() const = 0;
   virtual unsigned ResultSize() const = 0;
   virtual bool CheckAndAddToResult(const dist_t distance, const Object* object) = 0;
   virtual void Print() const = 0;
@@ -47,6 +69,8 @@ class Query {
  protected:
   const Space<dist_t>& space_;
   const Object* query_object_;
+  // Query-side data precomputed by the space (see Space::CreateQueryState), can be null
+  std::unique_ptr<QueryState> query_state_;
   mutable uint64_t distance_computations_;
 
   // disable copy and assign
@@ -30,6 +30,7 @@ class RangeQuery : public Query<dist_t> {
   const std::vector<dist_t>* ResultDists() const { return &resultDists_; }
   std::set<const Object*> ResultSet() const ;
   dist_t Radius() const;
+  dist_t ResultBound() const;
   unsigned ResultSize() const;
 
   void Reset();
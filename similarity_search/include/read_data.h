@@ -209,6 +209,38 @@ inline bool ReadVecDataEfficiently<uint32_t>(string line, vector<uint32_t> &res)
   return true;
 }
 
+template <>
+inline bool ReadVecDataEfficiently<uint64_t>(string line, vector<uint64_t> &res)
+{
+  ReplaceSomePunct(line);
+  const char *ptr = line.c_str();
+  char *endPtr = nullptr;
+
+  res.clear();
+  errno = 0;
+
+  for (int val = strtoi_wrapper(ptr, &endPtr);
+       ptr != endPtr;
+       val = strtoi_wrapper(ptr, &endPtr))
+  {
+    ptr = endPtr;
+    if (errno == ERANGE)
+    {
+      errno = 0;
+      return false;
+    }
+    res.push_back(static_cast<uint64_t>(val));
+  }
+
+  if (errno == ERANGE)
+  {
+    errno = 0;
+    return false;
+  }
+
+  return true;
+}
+
 template <typename T>
 inline bool ReadSparseVecDataViaStream(string line, vector<SparseVectElem<T>>& res) {
   try {
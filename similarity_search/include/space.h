@@ -29,7 +29,9 @@
 #include "object.h"
 #include "utils.h"
 #include "logging.h"
+#include "mmap_file.h"
 #include "permutation_type.h"
+#include "portable_prefetch.h"
 
 #define LABEL_PREFIX "label:"
 
@@ -111,6 +113,13 @@ public:
   virtual ~PivotIndex();
   virtual void ComputePivotDistancesIndexTime(const Object* pObj, vector<dist_t>& vResDist) const = 0;
   virtual void ComputePivotDistancesQueryTime(const Query<dist_t>* pQuery, vector<dist_t>& vResDist) const = 0;
+  /*
+   * Computes distances from a batch of qty objects to all pivots. The result is a row-major
+   * qty x (# of pivots) matrix. The default implementation processes objects one by one,
+   * but a space can process a batch more efficiently, e.g., in a cache-friendly manner.
+   */
+  virtual void ComputePivotDistancesIndexTimeBatch(const Object* const* ppObj, size_t qty,
+                                                   vector<dist_t>& vResDist) const;
 };
 
 template <typename dist_t> class Space;
@@ -127,6 +136,15 @@ public:
   virtual void ComputePivotDistancesQueryTime(const Query<dist_t>* pQuery, vector<dist_t>& vResDist) const override;
 };
 
+/*
+ * Query-side data that a space computes once per query (see Space::CreateQueryState),
+ * e.g., a normalized copy of the query vector or offsets of query components.
+ */
+class QueryState {
+ public:
+  virtual ~QueryState() {}
+};
+
 template <typename dist_t>
 class Space {
  public:
@@ -160,6 +178,16 @@ class Space {
     return new DummyPivotIndex<dist_t>(*this, pivots);
   }
 
+  /*
+   * Creates a query state, which is passed to every query-time distance function
+   * (see HiddenDistanceQuery). A query creates the state in its constructor, so that
+   * query-side work is done once per query rather than once per distance computation.
+   * The query object itself must not be modified. By default, no state is needed.
+   */
+  virtual unique_ptr<QueryState> CreateQueryState(const Object* pQuery) const {
+    return unique_ptr<QueryState>();
+  }
+
   /** Standard functions to read/write/create objects */ 
   /*
    * Create an object from string representation.
@@ -230,6 +258,19 @@ class Space {
                                         const std::string& outputFile,
                                         const IdTypeUnsign MaxNumObjects = MAX_DATASET_QTY) const;
 
+  /*
+   * Memory-maps a file created by WriteObjectVectorBinData and appends objects to the dataset.
+   * The objects point to the mapped memory (i.e., they don't own their buffers), so the
+   * data isn't copied and can be larger than the amount of RAM. The returned mapping
+   * must outlive the objects. However, object data must be 8-byte aligned (see object.h),
+   * which isn't the case for objects whose data length isn't a multiple of 8:
+   * such objects are copied. This function shouldn't be used with spaces that
+   * override ReadObjectVectorFromBinData.
+   */
+  unique_ptr<MemMappedFile> MapObjectVectorFromBinData(ObjectVector& dataset,
+                                                       const std::string& inputFile,
+                                                       const IdTypeUnsign maxQty=MAX_DATASET_QTY) const;
+
   /*
    * For some real-valued or integer-valued *DENSE* vector spaces this function
    * returns the number of vector elements. For all other spaces, it returns
@@ -269,6 +310,38 @@ class Space {
    * IndexTimeDistance access can be disable/enabled only by function friends 
    */
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const = 0;
+  /*
+   * Same as HiddenDistance, but the distance needs to be exact only if it does not exceed the bound.
+   * Otherwise, the space may stop the computation early and return any value larger than the bound.
+   * This permits, e.g., to abandon distance computation once a partial sum exceeds the bound.
+   * By default, the full distance is computed.
+   */
+  virtual dist_t HiddenDistanceBounded(const Object* obj1, const Object* obj2, dist_t bound) const {
+    return HiddenDistance(obj1, obj2);
+  }
+  /*
+   * Same as HiddenDistanceBounded(obj, pQuery, bound), but the query (the right argument)
+   * comes with the state created by CreateQueryState (the state pointer can be null).
+   */
+  virtual dist_t HiddenDistanceQuery(const Object* obj, const Object* pQuery, const QueryState* pState,
+                                     dist_t bound) const {
+    return HiddenDistanceBounded(obj, pQuery, bound);
+  }
+  /*
+   * Computes bounded distances (see HiddenDistanceQuery) from qty objects to the query,
+   * which is the right argument: pDist[i] is the distance between ppObj[i] and pQuery.
+   * A space can override this function to process several objects at a time,
+   * e.g., to interleave computations. By default, objects are processed one by one,
+   * while the next ones are being prefetched.
+   */
+  virtual void HiddenDistanceBatch(const Object* pQuery, const QueryState* pState,
+                                   const Object* const* ppObj, size_t qty,
+                                   dist_t bound, dist_t* pDist) const {
+    for (size_t i = 0; i < qty; ++i) {
+      if (i + 2 < qty) PREFETCH(ppObj[i + 2]->buffer(), _MM_HINT_T0);
+      pDist[i] = HiddenDistanceQuery(ppObj[i], pQuery, pState, bound);
+    }
+  }
  private:
   bool mutable bIndexPhase = true;
   
@@ -18,6 +18,7 @@
 #include <string>
 #include <map>
 #include <stdexcept>
+#include <algorithm>
 
 #include <string.h>
 #include "global.h"
@@ -51,6 +52,32 @@ class SpaceBitHamming : public SpaceBitVector<dist_t,dist_uint_t> {
     return BitHamming(x, y, length);
   }
 
+  /*
+   * Word pointers are collected on the stack in chunks of this size,
+   * so that the query code is loaded only once per chunk.
+   */
+  static const size_t kBatchChunkQty = 64;
+
+  virtual void HiddenDistanceBatch(const Object* pQuery, const QueryState* pState,
+                                   const Object* const* ppObj, size_t qty,
+                                   dist_t bound, dist_t* pDist) const {
+    CHECK(pQuery->datalength() > 0);
+    const size_t length = pQuery->datalength() / sizeof(dist_uint_t)
+                          - 1; // the last integer is an original number of elements
+    const dist_uint_t* pQueryVect = reinterpret_cast<const dist_uint_t*>(pQuery->data());
+    const dist_uint_t* vects[kBatchChunkQty];
+    unsigned           dists[kBatchChunkQty];
+    for (size_t start = 0; start < qty; start += kBatchChunkQty) {
+      const size_t chunkQty = std::min(qty - start, kBatchChunkQty);
+      for (size_t i = 0; i < chunkQty; ++i) {
+        CHECK(ppObj[start + i]->datalength() == pQuery->datalength());
+        vects[i] = reinterpret_cast<const dist_uint_t*>(ppObj[start + i]->data());
+      }
+      BitHammingBatch(pQueryVect, vects, chunkQty, length, dists);
+      for (size_t i = 0; i < chunkQty; ++i) pDist[start + i] = dist_t(dists[i]);
+    }
+  }
+
   DISABLE_COPY_AND_ASSIGN(SpaceBitHamming);
 };
 
@@ -69,20 +69,18 @@ class SpaceBitVector : public VectorSpaceSimpleStorage<dist_t, dist_uint_t> {
   }
 
   // Create a string representation of an object.
-  // virtual string CreateStrFromObj(const Object* pObj, const string& externId /* ignored */) const {
-  //   stringstream out;
-  //   const dist_uint_t* p = reinterpret_cast<const dist_uint_t*>(pObj->data());
-  //   const size_t length = pObj->datalength() / sizeof(dist_uint_t)
-  //                         - 1; // the last integer is an original number of elements
-  //   const size_t elemQty = p[length]; // last elem
-
-  //   for (size_t i = 0; i < elemQty; ++i) {
-  //     if (i) out << " ";
-  //     out << ((p[i/32] >> (i & 31)) & 1);
-  //   }
+  virtual string CreateStrFromObj(const Object* pObj, const string& externId /* ignored */) const {
+    stringstream out;
+    const dist_uint_t* p = reinterpret_cast<const dist_uint_t*>(pObj->data());
+    const size_t elemQty = GetBitQty(pObj);
+
+    for (size_t i = 0; i < elemQty; ++i) {
+      if (i) out << " ";
+      out << ((p[i / kWordBitQty] >> (i % kWordBitQty)) & 1);
+    }
 
-  //   return out.str();
-  // }
+    return out.str();
+  }
 
   /** End of standard functions to read/write/create objects */
 
@@ -93,23 +91,36 @@ class SpaceBitVector : public VectorSpaceSimpleStorage<dist_t, dist_uint_t> {
   virtual bool ApproxEqual(const Object& obj1, const Object& obj2) const {
     const dist_uint_t* p1 = reinterpret_cast<const dist_uint_t*>(obj1.data());
     const dist_uint_t* p2 = reinterpret_cast<const dist_uint_t*>(obj2.data());
-    const size_t len1 = obj1.datalength() / sizeof(dist_uint_t)
-                          - 1; // the last integer is an original number of elements
-    const size_t len2 = obj2.datalength() / sizeof(dist_uint_t)
-                          - 1; // the last integer is an original number of elements
+    const size_t len1 = GetBitQty(&obj1);
+    const size_t len2 = GetBitQty(&obj2);
     if (len1 != len2) {
       PREPARE_RUNTIME_ERR(err) << "Bug: comparing vectors of different lengths: " << len1 << " and " << len2;
       THROW_RUNTIME_ERR(err);
     }
     for (size_t i = 0; i < len1; ++i) {
-      dist_uint_t v1 =  ((p1[i/32] >> (i & 31)) & 1);
-      dist_uint_t v2 =  ((p2[i/32] >> (i & 31)) & 1);
+      dist_uint_t v1 =  ((p1[i / kWordBitQty] >> (i % kWordBitQty)) & 1);
+      dist_uint_t v2 =  ((p2[i / kWordBitQty] >> (i % kWordBitQty)) & 1);
       if (v1 != v2) return false;
     }
 
     return true;
   }
 
+  /*
+   * Creates an object from bits packed into bytes: the bit i is the bit (i % 8) of the byte i / 8,
+   * where bits of a byte are numbered starting from the least significant one
+   * (e.g., numpy.packbits(..., bitorder='little') produces such bytes).
+   */
+  virtual Object* CreateObjFromPackedBits(IdType id, LabelType label, const uint8_t* pBytes, size_t byteQty) const {
+    const size_t wordQty = (byteQty + sizeof(dist_uint_t) - 1) / sizeof(dist_uint_t);
+    // The last word keeps the number of elements (bits)
+    std::vector<dist_uint_t> binVect(wordQty + 1);
+    // Words are little-endian on all supported platforms
+    memcpy(&binVect[0], pBytes, byteQty);
+    binVect[wordQty] = byteQty * 8;
+    return CreateObjFromVectInternal(id, label, binVect);
+  }
+
   virtual std::string StrDesc() const { return "Vector (bit-storage) space"; }
   virtual void CreateDenseVectFromObj(const Object* obj, dist_t* pVect,
                                       size_t nElem) const {
@@ -121,6 +132,14 @@ class SpaceBitVector : public VectorSpaceSimpleStorage<dist_t, dist_uint_t> {
     return CreateObjFromVectInternal(id, label, InpVect);
   }
  protected:
+  static const size_t kWordBitQty = 8 * sizeof(dist_uint_t);
+
+  // The number of vector elements (bits) is stored in the last word
+  static size_t GetBitQty(const Object* pObj) {
+    const dist_uint_t* p = reinterpret_cast<const dist_uint_t*>(pObj->data());
+    return p[pObj->datalength() / sizeof(dist_uint_t) - 1];
+  }
+
   virtual Object* CreateObjFromVectInternal(IdType id, LabelType label, const std::vector<dist_uint_t>& InpVect) const {
     return new Object(id, label, InpVect.size() * sizeof(dist_uint_t), &InpVect[0]);
   }
@@ -175,8 +194,6 @@ class SpaceBitVector : public VectorSpaceSimpleStorage<dist_t, dist_uint_t> {
     }
   #endif
     Binarize(v, 1, binVect);      // Create the binary vector
-    std::cout << "c'est une ligne: " << line << ", taille:" << v.size() << std::endl;
-    // std::cout << v.size() << std::endl;
     binVect.push_back(v.size());   // Put the number of elements in the end
   }
 
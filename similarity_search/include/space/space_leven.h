@@ -19,6 +19,7 @@
 #include <map>
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
 
 #include <string.h>
 #include "distcomp.h"
@@ -45,6 +46,16 @@ class SpaceLevenshtein : public StringSpace<int> {
 
     return levenshtein(x, len1, y, len2);
   }
+  virtual int HiddenDistanceBounded(const Object* obj1, const Object* obj2, int bound) const {
+    CHECK(obj1->datalength() > 0);
+    CHECK(obj2->datalength() > 0);
+    const char* x = reinterpret_cast<const char*>(obj1->data());
+    const char* y = reinterpret_cast<const char*>(obj2->data());
+    const size_t len1 = obj1->datalength() / sizeof(char);
+    const size_t len2 = obj2->datalength() / sizeof(char);
+
+    return levenshteinBounded(x, len1, y, len2, bound);
+  }
   DISABLE_COPY_AND_ASSIGN(SpaceLevenshtein);
 };
 
@@ -66,6 +77,27 @@ class SpaceLevenshteinNormalized : public StringSpace<float> {
     CHECK(len1 || len2);
     return float(levenshtein(x, len1, y, len2))/std::max(len1, len2);
   }
+  virtual float HiddenDistanceBounded(const Object* obj1, const Object* obj2, float bound) const {
+    CHECK(obj1->datalength() > 0);
+    CHECK(obj2->datalength() > 0);
+    const char* x = reinterpret_cast<const char*>(obj1->data());
+    const char* y = reinterpret_cast<const char*>(obj2->data());
+    const size_t len1 = obj1->datalength() / sizeof(char);
+    const size_t len2 = obj2->datalength() / sizeof(char);
+
+    if (0 == len1 && 0 == len2) return 0;
+    CHECK(len1 || len2);
+    const size_t maxLen = std::max(len1, len2);
+    // The normalized distance never exceeds one
+    if (bound >= 1) return float(levenshtein(x, len1, y, len2))/maxLen;
+    /*
+     * The bound for the unnormalized distance is increased by one
+     * to compensate for rounding errors. If the distance exceeds it,
+     * the normalized distance is larger than the bound.
+     */
+    const int maxDist = bound < 0 ? -1 : int(std::floor(bound * maxLen)) + 1;
+    return float(levenshteinBounded(x, len1, y, len2, maxDist))/maxLen;
+  }
   DISABLE_COPY_AND_ASSIGN(SpaceLevenshteinNormalized);
 };
 
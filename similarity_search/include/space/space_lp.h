@@ -65,6 +65,32 @@ public:
      */
     return LPGenericDistanceOptim(x, y, length, dist_t(pf_));
   }
+  // Only L1 and L2 distances stop early (see Space::HiddenDistanceBounded)
+  dist_t operator()(const dist_t* x, const dist_t* y, size_t length, dist_t bound) const {
+    if (custom_) {
+      if (p_ == 1) {
+        return L1NormSIMDBounded(x, y, length, bound);
+      } else if (p_ == 2) {
+        return L2NormSIMDBounded(x, y, length, bound);
+      }
+    }
+    return (*this)(x, y, length);
+  }
+  // Computes distances from qty vectors to the query: L1 and L2 distances are computed for several vectors at a time
+  void operator()(const dist_t* pQuery, const dist_t* const* ppVect, size_t qty, size_t length, dist_t* pDist) const {
+    if (custom_) {
+      if (p_ == 1) {
+        L1NormSIMDBatch(pQuery, ppVect, qty, length, pDist);
+        return;
+      } else if (p_ == 2) {
+        L2NormSIMDBatch(pQuery, ppVect, qty, length, pDist);
+        return;
+      }
+    }
+    for (size_t i = 0; i < qty; ++i) {
+      pDist[i] = (*this)(ppVect[i], pQuery, length);
+    }
+  }
   dist_t getP() const { return pf_; }
   bool getCustom() const { return custom_; }
 private:
@@ -73,6 +99,32 @@ private:
   bool    custom_; // Do we use a custom implementation for l=0,1,2?
 };
 
+/*
+ * An efficient all-pivot distance computation for dense Lp spaces.
+ * Pivots are copied to a contiguous array. At index time, distances are computed
+ * for tiles (blocks of objects x blocks of pivots), where a block of pivots fits into the L1/L2 cache.
+ * Query-time distances are computed via the query object (so that they are counted).
+ */
+template <typename dist_t>
+class SpaceLpPivotIndex : public PivotIndex<dist_t> {
+ public:
+  SpaceLpPivotIndex(const ObjectVector& pivots, const SpaceLpDist<dist_t>& distObj);
+
+  virtual void ComputePivotDistancesIndexTime(const Object* pObj, vector<dist_t>& vResDist) const override {
+    ComputePivotDistancesIndexTimeBatch(&pObj, 1, vResDist);
+  }
+  virtual void ComputePivotDistancesQueryTime(const Query<dist_t>* pQuery, vector<dist_t>& vResDist) const override;
+  virtual void ComputePivotDistancesIndexTimeBatch(const Object* const* ppObj, size_t qty,
+                                                   vector<dist_t>& vResDist) const override;
+ private:
+  ObjectVector          pivots_;
+  SpaceLpDist<dist_t>   distObj_;
+  size_t                dim_;
+  vector<dist_t>        pivotData_;
+  // The number of pivots in one tile
+  size_t                pivotBlockQty_;
+};
+
 template <typename dist_t>
 class SpaceLp : public VectorSpaceSimpleStorage<dist_t> {
  public:
@@ -81,9 +133,18 @@ class SpaceLp : public VectorSpaceSimpleStorage<dist_t> {
 
   dist_t getP() const { return distObj_.getP(); }
 
+  virtual PivotIndex<dist_t>* CreatePivotIndex(const ObjectVector& pivots,
+                                               size_t hashTrickDim = 0) const override {
+    return new SpaceLpPivotIndex<dist_t>(pivots, distObj_);
+  }
+
   virtual std::string StrDesc() const;
  protected:
   virtual dist_t HiddenDistance(const Object* obj1, const Object* obj2) const;
+  virtual dist_t HiddenDistanceBounded(const Object* obj1, const Object* obj2, dist_t bound) const;
+  virtual void HiddenDistanceBatch(const Object* pQuery, const QueryState* pState,
+                                   const Object* const* ppObj, size_t qty,
+                                   dist_t bound, dist_t* pDist) const;
  private:
   SpaceLpDist<dist_t> distObj_;
   DISABLE_COPY_AND_ASSIGN(SpaceLp);
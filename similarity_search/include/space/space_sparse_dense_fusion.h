@@ -59,6 +59,7 @@ private:
   void UpdateParamsFromFile(DataFileInputState& inpStateBase) override {
     DataFileInputStateSparseDenseFusion& inpState = dynamic_cast<DataFileInputStateSparseDenseFusion&>(inpStateBase);
     vCompDesc_ = inpState.vCompDesc_;
+    compilePlans();
   }
 
   // Read a string representation of the next object in a file
@@ -91,9 +92,31 @@ private:
 protected:
   DISABLE_COPY_AND_ASSIGN(SpaceSparseDenseFusion);
 
+  /*
+   * Each object starts with a table of component locations (one entry per component),
+   * which is followed by component data. Sparse components are stored in the format
+   * of sparse fast spaces and are padded to a 4-byte boundary, dense components are
+   * arrays of floats. Thus, computing a distance requires no parsing.
+   */
+  struct CompOffset {
+    uint32_t start_;
+    uint32_t dataLen_;
+  };
+
+  /*
+   * Components with non-zero weights (for either query-time or index-time distances):
+   * only these are compared, weights are applied to all the products at the end.
+   */
+  struct CompPlan {
+    vector<uint32_t>  vCompIds_;
+    vector<char>      vIsSparse_;
+    vector<float>     vWeights_;
+  };
+
   virtual float HiddenDistance(const Object *obj1, const Object *obj2) const override;
 
-  float compDistance(const Object *obj1, const Object *obj2, bool isIndex) const;
+  float compDistance(const Object *obj1, const Object *obj2, const CompPlan& plan) const;
+  void compilePlans();
 
   vector<CompDesc>  vCompDesc_;
 
@@ -101,6 +124,8 @@ protected:
   vector<float>     vHeaderIndexWeights_;
   vector<float>     vHeaderQueryWeights_;
 
+  CompPlan          queryPlan_;
+  CompPlan          indexPlan_;
 
 };
 
@@ -0,0 +1,268 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _SPACE_SPARSE_QUANT_H_
+#define _SPACE_SPARSE_QUANT_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include <string.h>
+
+#include "global.h"
+#include "object.h"
+#include "utils.h"
+#include "logging.h"
+#include "space.h"
+#include "distcomp.h"
+#include "space_sparse_vector.h"
+
+#define SPACE_SPARSE_COSINE_SIMILARITY_Q8   "cosinesimil_sparse_q8"
+#define SPACE_SPARSE_COSINE_SIMILARITY_Q16  "cosinesimil_sparse_q16"
+#define SPACE_SPARSE_ANGULAR_DISTANCE_Q8    "angulardist_sparse_q8"
+#define SPACE_SPARSE_ANGULAR_DISTANCE_Q16   "angulardist_sparse_q16"
+#define SPACE_SPARSE_NEGATIVE_SCALAR_Q8     "negdotprod_sparse_q8"
+#define SPACE_SPARSE_NEGATIVE_SCALAR_Q16    "negdotprod_sparse_q16"
+
+namespace similarity {
+
+using std::vector;
+
+/*
+ * A compressed format of sparse vectors:
+ *
+ * i)   A header (SparseQuantHeader).
+ * ii)  Element values quantized to qval_t (int8_t or int16_t): a value is
+ *      restored by multiplying the quantized value by the scale from the header.
+ * iii) Differences between consecutive element ids (the first id is stored as is)
+ *      bit-packed in chunks of SPARSE_QUANT_CHUNK_QTY differences. A chunk starts
+ *      with a byte that keeps the number of bits necessary to store the largest
+ *      difference in the chunk. Differences follow, each occupying this number of bits.
+ *
+ * For 8-bit values and ids whose differences are smaller than 256,
+ * an element occupies about two bytes instead of six bytes in the format of fast sparse spaces.
+ * Unlike the variable-byte code, the bit-packed differences are decoded without branches.
+ */
+struct SparseQuantHeader {
+  uint32_t  elemQty_;
+  uint32_t  idByteQty_;   // the size of packed id differences in bytes
+  float     scale_;
+  float     normCoeff_;   // (sum of squared restored values)^(-0.5) or zero for an all-zero vector
+};
+
+const size_t SPARSE_QUANT_CHUNK_QTY = 64;
+
+// The name of the format, which is used as a suffix of space names
+inline const char* SparseQuantFormatName(const int8_t*)  { return "q8"; }
+inline const char* SparseQuantFormatName(const int16_t*) { return "q16"; }
+
+inline void PackSparseQuantIdChunk(const uint32_t* pDiffs, size_t qty, vector<uint8_t>& out) {
+  uint32_t maxDiff = 0;
+  for (size_t i = 0; i < qty; ++i) maxDiff = std::max(maxDiff, pDiffs[i]);
+  unsigned bitQty = 0;
+  while (bitQty < 32 && (maxDiff >> bitQty)) ++bitQty;
+
+  out.push_back(uint8_t(bitQty));
+  size_t start = out.size();
+  out.resize(start + (qty * bitQty + 7) / 8, 0);
+  for (size_t i = 0; i < qty; ++i) {
+    // Bits are written in the order they are read by a little-endian 64-bit load
+    uint64_t bits = uint64_t(pDiffs[i]) << (i * bitQty % 8);
+    for (size_t pos = start + i * bitQty / 8; bits; ++pos, bits >>= 8) out[pos] |= uint8_t(bits & 255);
+  }
+}
+
+/*
+ * Decodes a chunk of qty ids into pIds and moves pChunk to the next chunk.
+ * pEnd is the end of the packed data: 64-bit loads don't go beyond it.
+ */
+inline void UnpackSparseQuantIdChunk(const uint8_t*& pChunk, const uint8_t* pEnd, size_t qty,
+                                     uint32_t& prevId, uint32_t* pIds) {
+  const unsigned  bitQty = *pChunk++;
+  const uint64_t  mask = (uint64_t(1) << bitQty) - 1;
+  const size_t    byteQty = (qty * bitQty + 7) / 8;
+
+  size_t i = 0;
+  for (size_t bitPos = 0; i < qty && pChunk + bitPos / 8 + sizeof(uint64_t) <= pEnd; ++i, bitPos += bitQty) {
+    uint64_t word;
+    memcpy(&word, pChunk + bitPos / 8, sizeof(word));
+    prevId += uint32_t((word >> (bitPos % 8)) & mask);
+    pIds[i] = prevId;
+  }
+  for (size_t bitPos = i * bitQty; i < qty; ++i, bitPos += bitQty) {
+    uint64_t word = 0;
+    memcpy(&word, pChunk + bitPos / 8, std::min<size_t>(sizeof(word), pEnd - (pChunk + bitPos / 8)));
+    prevId += uint32_t((word >> (bitPos % 8)) & mask);
+    pIds[i] = prevId;
+  }
+  pChunk += byteQty;
+}
+
+// A view of the vector packed by PackSparseQuantElements
+template <typename qval_t>
+struct SparseQuantView {
+  size_t          qty_;
+  float           scale_;
+  float           normCoeff_;
+  const qval_t*   pVals_;
+  const uint8_t*  pIds_;
+  const uint8_t*  pEnd_;
+};
+
+template <typename qval_t>
+inline SparseQuantView<qval_t> ParseSparseQuantElements(const char* pBuff, size_t dataLen) {
+  const SparseQuantHeader* pHeader = reinterpret_cast<const SparseQuantHeader*>(pBuff);
+  SparseQuantView<qval_t> res;
+  res.qty_       = pHeader->elemQty_;
+  res.scale_     = pHeader->scale_;
+  res.normCoeff_ = pHeader->normCoeff_;
+  res.pVals_     = reinterpret_cast<const qval_t*>(pHeader + 1);
+  res.pIds_      = reinterpret_cast<const uint8_t*>(res.pVals_ + res.qty_);
+  res.pEnd_      = res.pIds_ + pHeader->idByteQty_;
+  CHECK(sizeof(SparseQuantHeader) + sizeof(qval_t) * res.qty_ + pHeader->idByteQty_ == dataLen);
+  return res;
+}
+
+template <typename qval_t>
+inline void UnpackSparseQuantElements(const char* pBuff, size_t dataLen,
+                                      vector<SparseVectElem<float>>& OutVect) {
+  const SparseQuantView<qval_t> v = ParseSparseQuantElements<qval_t>(pBuff, dataLen);
+  const uint8_t* pIds = v.pIds_;
+
+  vector<uint32_t> ids(v.qty_);
+  uint32_t prevId = 0;
+  for (size_t start = 0; start < v.qty_; start += SPARSE_QUANT_CHUNK_QTY) {
+    UnpackSparseQuantIdChunk(pIds, v.pEnd_, std::min(SPARSE_QUANT_CHUNK_QTY, v.qty_ - start), prevId, &ids[start]);
+  }
+  CHECK(pIds == v.pEnd_);
+
+  OutVect.resize(v.qty_);
+  for (size_t i = 0; i < v.qty_; ++i) {
+    OutVect[i] = SparseVectElem<float>(ids[i], v.scale_ * v.pVals_[i]);
+  }
+}
+
+/*
+ * Values are quantized symmetrically: the largest absolute value is mapped
+ * to the largest value of qval_t. Ids must be sorted and unique.
+ */
+template <typename qval_t>
+inline void PackSparseQuantElements(const vector<SparseVectElem<float>>& InpVect,
+                                    char*& prBuff, size_t& dataSize) {
+  const float maxQuant = static_cast<float>(std::numeric_limits<qval_t>::max());
+
+  float maxAbs = 0;
+  for (const SparseVectElem<float>& e : InpVect) maxAbs = std::max(maxAbs, std::fabs(e.val_));
+
+  SparseQuantHeader header;
+  header.elemQty_ = static_cast<uint32_t>(InpVect.size());
+  header.scale_ = maxAbs > 0 ? maxAbs / maxQuant : 0;
+
+  vector<qval_t>    vals(InpVect.size());
+  vector<uint32_t>  diffs(InpVect.size());
+  int64_t           sqSumQuant = 0;
+
+  for (size_t i = 0; i < InpVect.size(); ++i) {
+    if (i && InpVect[i].id_ <= InpVect[i-1].id_) {
+      PREPARE_RUNTIME_ERR(err) << "Sparse vector ids should be unique and sorted, id: "
+                               << InpVect[i].id_ << " follows id: " << InpVect[i-1].id_;
+      THROW_RUNTIME_ERR(err);
+    }
+    diffs[i] = i ? InpVect[i].id_ - InpVect[i-1].id_ : InpVect[i].id_;
+    float q = header.scale_ > 0 ? std::round(InpVect[i].val_ / header.scale_) : 0;
+    vals[i] = static_cast<qval_t>(std::max(-maxQuant, std::min(maxQuant, q)));
+    sqSumQuant += int64_t(vals[i]) * vals[i];
+  }
+  vector<uint8_t> idBytes;
+  for (size_t start = 0; start < diffs.size(); start += SPARSE_QUANT_CHUNK_QTY) {
+    PackSparseQuantIdChunk(&diffs[start], std::min(SPARSE_QUANT_CHUNK_QTY, diffs.size() - start), idBytes);
+  }
+  header.idByteQty_ = static_cast<uint32_t>(idBytes.size());
+  header.normCoeff_ = sqSumQuant > 0 ?
+                      static_cast<float>(1.0 / (std::sqrt(double(sqSumQuant)) * header.scale_)) : 0;
+
+  dataSize = sizeof(SparseQuantHeader) + sizeof(qval_t) * vals.size() + idBytes.size();
+  prBuff = new char[dataSize];
+
+  *reinterpret_cast<SparseQuantHeader*>(prBuff) = header;
+  char* p = prBuff + sizeof(SparseQuantHeader);
+  if (!vals.empty()) memcpy(p, &vals[0], sizeof(qval_t) * vals.size());
+  p += sizeof(qval_t) * vals.size();
+  if (!idBytes.empty()) memcpy(p, &idBytes[0], idBytes.size());
+}
+
+/*
+ * A sparse vector space that stores vectors in the compressed format (see above).
+ * Distances are computed directly on compressed vectors: ids are decoded
+ * during the intersection and quantized values are multiplied as integers.
+ * Thus, only the vector element values are approximate.
+ */
+template <typename qval_t>
+class SpaceSparseVectorQuant : public SpaceSparseVector<float> {
+ public:
+  explicit SpaceSparseVectorQuant() {}
+  virtual ~SpaceSparseVectorQuant() {}
+
+  virtual bool ApproxEqual(const Object& obj1, const Object& obj2) const override;
+
+  virtual Object* CreateObjFromVect(IdType id, LabelType label, const vector<ElemType>& InpVect) const override;
+  virtual void CreateVectFromObj(const Object* obj, vector<ElemType>& v) const override {
+    UnpackSparseQuantElements<qval_t>(obj->data(), obj->datalength(), v);
+  }
+  virtual void CreateDenseVectFromObj(const Object* obj, float* pVect, size_t nElem) const override;
+  virtual size_t GetElemQty(const Object* object) const override {
+    return reinterpret_cast<const SparseQuantHeader*>(object->data())->elemQty_;
+  }
+ protected:
+  DISABLE_COPY_AND_ASSIGN(SpaceSparseVectorQuant);
+};
+
+template <typename qval_t>
+class SpaceSparseCosineSimilarityQuant : public SpaceSparseVectorQuant<qval_t> {
+ public:
+  explicit SpaceSparseCosineSimilarityQuant() {}
+  virtual std::string StrDesc() const override;
+ protected:
+  virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  DISABLE_COPY_AND_ASSIGN(SpaceSparseCosineSimilarityQuant);
+};
+
+template <typename qval_t>
+class SpaceSparseAngularDistanceQuant : public SpaceSparseVectorQuant<qval_t> {
+ public:
+  explicit SpaceSparseAngularDistanceQuant() {}
+  virtual std::string StrDesc() const override;
+ protected:
+  virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  DISABLE_COPY_AND_ASSIGN(SpaceSparseAngularDistanceQuant);
+};
+
+template <typename qval_t>
+class SpaceSparseNegativeScalarProductQuant : public SpaceSparseVectorQuant<qval_t> {
+ public:
+  explicit SpaceSparseNegativeScalarProductQuant() {}
+  virtual std::string StrDesc() const override;
+ protected:
+  virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  DISABLE_COPY_AND_ASSIGN(SpaceSparseNegativeScalarProductQuant);
+};
+
+}  // namespace similarity
+
+#endif
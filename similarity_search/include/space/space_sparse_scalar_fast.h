@@ -70,7 +70,26 @@ private:
   void GenVectElems(const Object& obj, bool bNorm, vector<SparseVectElem<float>>& pivElems) const;
 };
 
-class SpaceSparseCosineSimilarityFast : public SpaceSparseVectorInter<float> {
+/*
+ * A base class of fast sparse spaces that compute scalar products. Long queries
+ * are scattered into a lookup table once (see SparseScatteredQuery). Then,
+ * for every data vector, we choose between the SIMD intersection and
+ * the gather pass over data vector elements, depending on vector lengths.
+ */
+class SpaceSparseScalarFastBase : public SpaceSparseVectorInter<float> {
+public:
+  explicit SpaceSparseScalarFastBase(){}
+  virtual unique_ptr<QueryState> CreateQueryState(const Object* pQuery) const override;
+protected:
+  virtual float HiddenDistanceQuery(const Object* obj, const Object* pQuery,
+                                    const QueryState* pState, float bound) const override;
+  // Computes the distance between a data object and the scattered query
+  virtual float HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const = 0;
+
+  DISABLE_COPY_AND_ASSIGN(SpaceSparseScalarFastBase);
+};
+
+class SpaceSparseCosineSimilarityFast : public SpaceSparseScalarFastBase {
 public:
   explicit SpaceSparseCosineSimilarityFast(){}
   virtual std::string StrDesc() const override {
@@ -81,6 +100,7 @@ public:
   }
 protected:
   virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  virtual float HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const override;
 
   class PivotIndexLocal : public SpaceDotProdPivotIndexBase {
   public:
@@ -97,7 +117,7 @@ protected:
   DISABLE_COPY_AND_ASSIGN(SpaceSparseCosineSimilarityFast);
 };
 
-class SpaceSparseAngularDistanceFast : public SpaceSparseVectorInter<float> {
+class SpaceSparseAngularDistanceFast : public SpaceSparseScalarFastBase {
 public:
   explicit SpaceSparseAngularDistanceFast(){}
   virtual std::string StrDesc() const override {
@@ -109,6 +129,7 @@ public:
   }
 protected:
   virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  virtual float HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const override;
 
   class PivotIndexLocal : public SpaceDotProdPivotIndexBase {
   public:
@@ -126,7 +147,7 @@ protected:
   DISABLE_COPY_AND_ASSIGN(SpaceSparseAngularDistanceFast);
 };
 
-class SpaceSparseNegativeScalarProductFast : public SpaceSparseVectorInter<float> {
+class SpaceSparseNegativeScalarProductFast : public SpaceSparseScalarFastBase {
 public:
   explicit SpaceSparseNegativeScalarProductFast(){}
   virtual std::string StrDesc() const override {
@@ -138,6 +159,7 @@ public:
   }
 protected:
   virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  virtual float HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const override;
 
   class PivotIndexLocal : public SpaceDotProdPivotIndexBase {
   public:
@@ -154,7 +176,7 @@ protected:
   DISABLE_COPY_AND_ASSIGN(SpaceSparseNegativeScalarProductFast);
 };
 
-class SpaceSparseQueryNormNegativeScalarProductFast : public SpaceSparseVectorInter<float> {
+class SpaceSparseQueryNormNegativeScalarProductFast : public SpaceSparseScalarFastBase {
 public:
   explicit SpaceSparseQueryNormNegativeScalarProductFast(){}
   virtual std::string StrDesc() const override {
@@ -166,6 +188,7 @@ public:
   }
 protected:
   virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  virtual float HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const override;
 
   class PivotIndexLocal : public SpaceDotProdPivotIndexBase {
   public:
@@ -83,12 +83,12 @@ public:
    * well as extract elements from an Object.
    */
   virtual Object* CreateObjFromVect(IdType id, LabelType label, const vector<ElemType>& InpVect) const = 0;
+  virtual void CreateVectFromObj(const Object* obj, vector<ElemType>& v) const  = 0;
   // Sparse vectors have no fixed dimensionality
   virtual size_t GetElemQty(const Object* object) const {return 0;}
 
 protected:
   void ReadSparseVec(std::string line, size_t line_num, LabelType& label, vector<ElemType>& v) const;
-  virtual void CreateVectFromObj(const Object* obj, vector<ElemType>& v) const  = 0;
   DISABLE_COPY_AND_ASSIGN(SpaceSparseVector);
 };
 
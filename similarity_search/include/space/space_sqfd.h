@@ -41,6 +41,10 @@ class SqfdFunction {
  public:
   virtual ~SqfdFunction() {}
   virtual dist_t f(const dist_t* p1, const dist_t* p2, const int sz) const = 0;
+  // Computes pRes[i] = f(p, pp[i], sz) for qty vectors
+  virtual void fBatch(const dist_t* p, const dist_t* const* pp, size_t qty, const int sz, dist_t* pRes) const {
+    for (size_t i = 0; i < qty; ++i) pRes[i] = f(p, pp[i], sz);
+  }
   virtual std::string StrDesc() const = 0;
   virtual SqfdFunction<dist_t>* Clone() const = 0;
 };
@@ -51,6 +55,10 @@ class SqfdMinusFunction : public SqfdFunction<dist_t> {
   dist_t f(const dist_t* p1, const dist_t* p2, const int sz) const {
     return -L2NormSIMD(p1, p2, sz);
   }
+  void fBatch(const dist_t* p, const dist_t* const* pp, size_t qty, const int sz, dist_t* pRes) const {
+    L2NormSIMDBatch(p, pp, qty, sz, pRes);
+    for (size_t i = 0; i < qty; ++i) pRes[i] = -pRes[i];
+  }
   std::string StrDesc() const {
     return "minus function";
   }
@@ -66,6 +74,10 @@ class SqfdHeuristicFunction : public SqfdFunction<dist_t> {
   dist_t f(const dist_t* p1, const dist_t* p2, const int sz) const {
     return 1.0 / (alpha_ + L2NormSIMD(p1, p2, sz));
   }
+  void fBatch(const dist_t* p, const dist_t* const* pp, size_t qty, const int sz, dist_t* pRes) const {
+    L2NormSIMDBatch(p, pp, qty, sz, pRes);
+    for (size_t i = 0; i < qty; ++i) pRes[i] = 1.0 / (alpha_ + pRes[i]);
+  }
   std::string StrDesc() const {
     std::stringstream stream;
     stream << "heuristic function alpha=" << alpha_;
@@ -86,6 +98,10 @@ class SqfdGaussianFunction : public SqfdFunction<dist_t> {
     const dist_t d = L2NormSIMD(p1, p2, sz);
     return exp(-alpha_ * d * d);
   }
+  void fBatch(const dist_t* p, const dist_t* const* pp, size_t qty, const int sz, dist_t* pRes) const {
+    L2NormSIMDBatch(p, pp, qty, sz, pRes);
+    for (size_t i = 0; i < qty; ++i) pRes[i] = exp(-alpha_ * pRes[i] * pRes[i]);
+  }
   std::string StrDesc() const {
     std::stringstream stream;
     stream << "gaussian function alpha=" << alpha_;
@@ -98,6 +114,14 @@ class SqfdGaussianFunction : public SqfdFunction<dist_t> {
   float alpha_;
 };
 
+/*
+ * An object consists of a header (the number of clusters and the feature dimensionality),
+ * clusters (each cluster is followed by its weight), and the self-similarity term
+ * (a double value: the quadratic form of the object with itself). The self-similarity term 
+ * is computed when the object is created, so that a distance computation 
+ * needs to evaluate only the cross-object part of the quadratic form.
+ * The term is optional: for objects without this term, it is computed on the fly.
+ */
 template <typename dist_t>
 class SpaceSqfd : public Space<dist_t> {
  public:
@@ -150,13 +174,36 @@ class SpaceSqfd : public Space<dist_t> {
     throw runtime_error("Cannot create vector for the space: " + StrDesc());
   }
   virtual size_t GetElemQty(const Object* object) const {return 0;}
+
+  // The state keeps the self-similarity term of the query
+  virtual unique_ptr<QueryState> CreateQueryState(const Object* pQuery) const;
  protected:
   DISABLE_COPY_AND_ASSIGN(SpaceSqfd);
 
   dist_t HiddenDistance(
       const Object* obj1,
       const Object* obj2) const;
+  dist_t HiddenDistanceQuery(const Object* obj, const Object* pQuery,
+                             const QueryState* pState, dist_t bound) const;
  private:
+  struct SqfdObject {
+    uint32_t      num_clusters_;
+    uint32_t      feature_dimension_;
+    const dist_t* pElems_;
+    bool          hasSelfTerm_;
+    double        selfTerm_;
+  };
+  struct SqfdQueryState;
+
+  void   ParseObject(const Object* obj, SqfdObject& res) const;
+  // Computes sum_{i,j} w1_i * w2_j * f(x1_i, x2_j) without allocating memory
+  double CrossTerm(const SqfdObject& obj1, const SqfdObject& obj2) const;
+  double SelfTerm(const SqfdObject& obj) const {
+    return obj.hasSelfTerm_ ? obj.selfTerm_ : CrossTerm(obj, obj);
+  }
+  dist_t ComputeDistance(const SqfdObject& obj1, double selfTerm1, 
+                         const SqfdObject& obj2, double selfTerm2) const;
+
   SqfdFunction<dist_t>* func_;
 };
 
@@ -0,0 +1,97 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#ifndef _SPACE_VECTOR_HALF_H_
+#define _SPACE_VECTOR_HALF_H_
+
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "object.h"
+#include "utils.h"
+#include "space.h"
+#include "space_vector.h"
+#include "half_float.h"
+#include "distcomp.h"
+
+#define SPACE_L2_FP16                 "l2_fp16"
+#define SPACE_L2_BF16                 "l2_bf16"
+#define SPACE_COSINE_SIMILARITY_FP16  "cosinesimil_fp16"
+#define SPACE_COSINE_SIMILARITY_BF16  "cosinesimil_bf16"
+#define SPACE_NEGATIVE_SCALAR_FP16    "negdotprod_fp16"
+#define SPACE_NEGATIVE_SCALAR_BF16    "negdotprod_bf16"
+
+namespace similarity {
+
+/*
+ * A dense vector space whose elements are stored in a 16-bit floating-point format
+ * (half_t is either Float16 or BFloat16). Vectors are read and created from
+ * 32-bit floats, which are converted on load. Thus, the memory footprint is half
+ * of the footprint of regular dense spaces, while the interface is the same.
+ */
+template <typename half_t>
+class VectorSpaceHalf : public VectorSpace<float> {
+ public:
+  explicit VectorSpaceHalf() {}
+  virtual ~VectorSpaceHalf() {}
+
+  virtual string CreateStrFromObj(const Object* pObj, const string& externId /* ignored */) const override;
+  virtual bool ApproxEqual(const Object& obj1, const Object& obj2) const override;
+
+  virtual Object* CreateObjFromVect(IdType id, LabelType label, const std::vector<float>& InpVect) const override;
+  virtual size_t GetElemQty(const Object* object) const override {
+    return object->datalength() / sizeof(half_t);
+  }
+  virtual void CreateDenseVectFromObj(const Object* obj, float* pVect, size_t nElem) const override;
+ protected:
+  static const half_t* GetHalfVect(const Object* obj) {
+    return reinterpret_cast<const half_t*>(obj->data());
+  }
+  DISABLE_COPY_AND_ASSIGN(VectorSpaceHalf);
+};
+
+template <typename half_t>
+class SpaceL2Half : public VectorSpaceHalf<half_t> {
+ public:
+  SpaceL2Half() {}
+  virtual std::string StrDesc() const override;
+ protected:
+  virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  DISABLE_COPY_AND_ASSIGN(SpaceL2Half);
+};
+
+template <typename half_t>
+class SpaceCosineSimilarityHalf : public VectorSpaceHalf<half_t> {
+ public:
+  SpaceCosineSimilarityHalf() {}
+  virtual std::string StrDesc() const override;
+ protected:
+  virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  DISABLE_COPY_AND_ASSIGN(SpaceCosineSimilarityHalf);
+};
+
+template <typename half_t>
+class SpaceNegativeScalarProductHalf : public VectorSpaceHalf<half_t> {
+ public:
+  SpaceNegativeScalarProductHalf() {}
+  virtual std::string StrDesc() const override;
+ protected:
+  virtual float HiddenDistance(const Object* obj1, const Object* obj2) const override;
+  DISABLE_COPY_AND_ASSIGN(SpaceNegativeScalarProductHalf);
+};
+
+}  // namespace similarity
+
+#endif
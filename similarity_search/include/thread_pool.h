@@ -12,13 +12,27 @@
  * Apache License Version 2.0 http://www.apache.org/licenses/.
  *
  */
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <algorithm>
 #include <atomic>
 #include <thread>
 #include <queue>
+#include <deque>
 #include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <exception>
 
-namespace similarity {
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
+namespace similarity {
   // See sample usage below
   template <class T>
   bool GetNextQueueObj(std::mutex &mtx, std::queue<T>& queue, T& obj) {
@@ -53,64 +67,304 @@ namespace similarity {
 
 */
 
+  /*
+   * A process-wide pool of persistent worker threads with work stealing.
+   *
+   * Each worker has its own deque of tasks. A task submitted from a worker
+   * goes to the worker's own deque, a task submitted from any other thread
+   * goes to the deques in a round-robin fashion. A worker takes tasks
+   * from the back of its own deque (LIFO, which is cache-friendly for nested tasks)
+   * and, when its deque is empty, steals from the front of other deques.
+   * A thread waiting for its tasks to finish doesn't block: it helps to execute
+   * pending tasks (see RunPendingTask). Hence, nested parallelism
+   * neither deadlocks nor oversubscribes cores.
+   */
+  class ThreadPool {
+   public:
+    // threadQty == 0 means one thread per core
+    explicit ThreadPool(size_t threadQty = 0, bool pinThreads = false) : 
+        pendingQty_(0), stop_(false), nextQueue_(0) {
+      if (threadQty == 0) threadQty = std::max(1u, std::thread::hardware_concurrency());
+      for (size_t i = 0; i < threadQty; ++i) {
+        queues_.emplace_back(new WorkerQueue());
+      }
+      for (size_t i = 0; i < threadQty; ++i) {
+        threads_.push_back(std::thread([this, i] { workerLoop(i); }));
+#if defined(__linux__)
+        if (pinThreads) {
+          cpu_set_t cpuSet;
+          CPU_ZERO(&cpuSet);
+          CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cpuSet);
+          // This is only a hint: a failure isn't fatal
+          pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpu_set_t), &cpuSet);
+        }
+#endif
+      }
+    }
+
+    ~ThreadPool() {
+      {
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+      }
+      sleepCond_.notify_all();
+      for (auto& thread : threads_) thread.join();
+    }
+
+    size_t GetThreadQty() const { return threads_.size(); }
+
+    void Submit(std::function<void()> task) {
+      size_t queueId = getWorkerId();
+      if (queueId == kNotWorker) {
+        queueId = nextQueue_.fetch_add(1) % queues_.size();
+      }
+      // Incrementing the counter first ensures it never goes below zero
+      ++pendingQty_;
+      {
+        WorkerQueue& q = *queues_[queueId];
+        std::unique_lock<std::mutex> lock(q.mutex_);
+        q.tasks_.push_back(std::move(task));
+      }
+      {
+        // Taking the lock ensures that a worker can't miss the notification
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+      }
+      sleepCond_.notify_one();
+    }
+
+    /*
+     * Executes one pending task (if there is any) in the calling thread.
+     * Returns false if no task was found.
+     */
+    bool RunPendingTask() {
+      std::function<void()> task;
+      size_t workerId = getWorkerId();
+      if (!getTask(workerId == kNotWorker ? 0 : workerId, workerId != kNotWorker, task)) return false;
+      task();
+      return true;
+    }
+
+    /*
+     * The global pool, which is created on first use. Its configuration
+     * can be changed by calling SetGlobalConfig before the first use.
+     */
+    static ThreadPool& Global() {
+      std::unique_lock<std::mutex> lock(globalMutex());
+      std::unique_ptr<ThreadPool>& pool = globalPool();
+      if (!pool) {
+        const GlobalConfig& conf = globalConfig();
+        pool.reset(new ThreadPool(conf.threadQty_, conf.pinThreads_));
+      }
+      return *pool;
+    }
+
+    // Returns false if the global pool has already been created
+    static bool SetGlobalConfig(size_t threadQty, bool pinThreads) {
+      std::unique_lock<std::mutex> lock(globalMutex());
+      if (globalPool()) return false;
+      globalConfig().threadQty_ = threadQty;
+      globalConfig().pinThreads_ = pinThreads;
+      return true;
+    }
+
+   private:
+    struct WorkerQueue {
+      std::mutex                          mutex_;
+      std::deque<std::function<void()>>   tasks_;
+    };
+    struct GlobalConfig {
+      size_t  threadQty_ = 0;
+      bool    pinThreads_ = false;
+    };
+
+    static const size_t kNotWorker = static_cast<size_t>(-1);
+
+    static std::mutex& globalMutex() { static std::mutex m; return m; }
+    static std::unique_ptr<ThreadPool>& globalPool() { static std::unique_ptr<ThreadPool> p; return p; }
+    static GlobalConfig& globalConfig() { static GlobalConfig c; return c; }
+
+    // The pool and the worker id of the current thread
+    static const ThreadPool*& currentPool() { static thread_local const ThreadPool* p = nullptr; return p; }
+    static size_t& currentWorkerId() { static thread_local size_t id = kNotWorker; return id; }
+
+    size_t getWorkerId() const {
+      return currentPool() == this ? currentWorkerId() : kNotWorker;
+    }
+
+    // Pops from the back of the own queue (if isWorker is true), then steals from the front of other queues
+    bool getTask(size_t startId, bool isWorker, std::function<void()>& task) {
+      if (pendingQty_ == 0) return false;
+      const size_t qty = queues_.size();
+      for (size_t k = 0; k < qty; ++k) {
+        WorkerQueue& q = *queues_[(startId + k) % qty];
+        std::unique_lock<std::mutex> lock(q.mutex_);
+        if (q.tasks_.empty()) continue;
+        if (isWorker && k == 0) {
+          task = std::move(q.tasks_.back());
+          q.tasks_.pop_back();
+        } else {
+          task = std::move(q.tasks_.front());
+          q.tasks_.pop_front();
+        }
+        --pendingQty_;
+        return true;
+      }
+      return false;
+    }
+
+    void workerLoop(size_t workerId) {
+      currentPool() = this;
+      currentWorkerId() = workerId;
+      std::function<void()> task;
+      while (true) {
+        if (getTask(workerId, true, task)) {
+          task();
+          task = nullptr;
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepCond_.wait(lock, [this] { return stop_ || pendingQty_ > 0; });
+        if (stop_ && pendingQty_ == 0) break;
+      }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>>   queues_;
+    std::vector<std::thread>                    threads_;
+    std::mutex                                  sleepMutex_;
+    std::condition_variable                     sleepCond_;
+    std::atomic<size_t>                         pendingQty_;
+    bool                                        stop_;
+    std::atomic<size_t>                         nextQueue_;
+  };
+
   /* 
    * replacement for the openmp '#pragma omp parallel for' directive
    * only handles a subset of functionality (no reductions etc)
    * Process ids from start (inclusive) to end (EXCLUSIVE)
+   *
+   * NOTE: numThreads is an upper bound rather than the exact number of threads.
+   * The work is carried out by the global thread pool and the calling thread:
+   * the number of concurrently working threads is at most min(numThreads, pool size + 1).
+   * The pool size is set by ThreadPool::SetGlobalConfig (all cores by default).
+   * If exactly numThreads threads have to run concurrently (e.g., to generate load),
+   * use RunInDedicatedThreads instead.
+   *
+   * The function fn is called as fn(id, threadId), where threadId < numThreads
+   * and no two concurrent calls have the same threadId (so, threadId can be used to access
+   * thread-specific data). Calls of ParallelFor can be nested,
+   * but fn shouldn't hold a (non-recursive) lock while calling ParallelFor:
+   * while waiting, the thread may execute other tasks of the outer ParallelFor.
    */
   template <class Function>
   inline void ParallelFor(size_t start, size_t end, size_t numThreads, Function fn) {
     if (numThreads <= 0) {
       numThreads = std::thread::hardware_concurrency();
     }
+    if (end <= start) return;
 
-    if (numThreads == 1) {
+    if (numThreads <= 1 || end - start == 1) {
       for (size_t id = start; id < end; id++) {
         fn(id, 0);
       }
     } else {
-      std::vector<std::thread>  threads;
+      ThreadPool&               pool = ThreadPool::Global();
+      const size_t              taskQty = std::min(numThreads, end - start);
       std::atomic<size_t>       current(start);
+      std::atomic<size_t>       remainQty(taskQty - 1);
+      std::mutex                doneMutex;
+      std::condition_variable   doneCond;
 
       // keep track of exceptions in threads
       // https://stackoverflow.com/a/32428427/1713196
       std::exception_ptr lastException = nullptr;
       std::mutex         lastExceptMutex;
 
-      for (size_t threadId = 0; threadId < numThreads; ++threadId) {
-        threads.push_back(std::thread([&, threadId] {
-          while (true) {
-            size_t id = current.fetch_add(1);
+      auto worker = [&](size_t threadId) {
+        while (true) {
+          size_t id = current.fetch_add(1);
 
-            if ((id >= end)) {
-              break;
-            }
+          if ((id >= end)) {
+            break;
+          }
 
-            try {
-              fn(id, threadId);
-            } catch (...) {
-              std::unique_lock<std::mutex> lastExcepLock(lastExceptMutex);
-              lastException = std::current_exception();
-              /* 
-               * This will work even when current is the largest value that
-               * size_t can fit, because fetch_add returns the previous value
-               * before the increment (what will result in overflow 
-               * and produce 0 instead of current + 1).
-               */
-              current = end;
-              break;
-            }
+          try {
+            fn(id, threadId);
+          } catch (...) {
+            std::unique_lock<std::mutex> lastExcepLock(lastExceptMutex);
+            lastException = std::current_exception();
+            /* 
+             * This will work even when current is the largest value that
+             * size_t can fit, because fetch_add returns the previous value
+             * before the increment (what will result in overflow 
+             * and produce 0 instead of current + 1).
+             */
+            current = end;
+            break;
           }
-        }));
+        }
+      };
+
+      for (size_t threadId = 1; threadId < taskQty; ++threadId) {
+        pool.Submit([&, threadId] {
+          worker(threadId);
+          std::unique_lock<std::mutex> lock(doneMutex);
+          if (--remainQty == 0) doneCond.notify_all();
+        });
       }
-      for (auto & thread : threads) {
-        thread.join();
+      // The calling thread does its share of work too
+      worker(0);
+      /*
+       * While there are unfinished tasks, help to execute pending ones.
+       * If there are no pending tasks, all our tasks are already being executed,
+       * so we can simply wait.
+       */
+      while (remainQty > 0) {
+        if (!pool.RunPendingTask()) {
+          std::unique_lock<std::mutex> lock(doneMutex);
+          doneCond.wait(lock, [&] { return remainQty == 0; });
+        }
       }
+      /*
+       * The last task decrements remainQty and notifies while holding doneMutex.
+       * Acquiring the mutex ensures that the task has released it, before
+       * doneMutex and doneCond are destroyed.
+       */
+      { std::lock_guard<std::mutex> lock(doneMutex); }
       if (lastException) {
         std::rethrow_exception(lastException);
       }
     }
+  }
 
+  /*
+   * Calls fn(threadId) for each threadId < threadQty in a separate, newly created thread
+   * and waits until all the calls finish. Unlike ParallelFor, this guarantees that exactly
+   * threadQty calls run concurrently (e.g., load generators in efficiency tests), which
+   * makes sense only when fn runs for a long time. An exception is re-thrown in the calling thread.
+   */
+  template <class Function>
+  inline void RunInDedicatedThreads(size_t threadQty, Function fn) {
+    std::vector<std::thread>  threads;
+    std::exception_ptr        lastException = nullptr;
+    std::mutex                lastExceptMutex;
 
+    for (size_t threadId = 0; threadId < threadQty; ++threadId) {
+      threads.push_back(std::thread([&, threadId] {
+        try {
+          fn(threadId);
+        } catch (...) {
+          std::unique_lock<std::mutex> lastExcepLock(lastExceptMutex);
+          lastException = std::current_exception();
+        }
+      }));
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (lastException) {
+      std::rethrow_exception(lastException);
+    }
   }
 };
+
+#endif     // _THREAD_POOL_H_
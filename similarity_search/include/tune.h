@@ -44,6 +44,47 @@ using std::cout;
 using std::end;
 using std::stringstream;
 
+/*
+ * A measurement of a graph-based method (see tune_graph) with a given
+ * combination of index-time and query-time parameters for a given k.
+ */
+struct TunePoint {
+  unsigned  K;
+  string    IndexParams;
+  string    QueryTimeParams;
+  size_t    Ef;
+  double    Recall;
+  double    QueryTime;      // average query time (msec)
+  double    QueryTimeP99;   // the 99th percentile of the query time (msec)
+  double    Mem;            // memory used by the index (MB)
+  double    IndexTime;      // index creation time (sec)
+};
+
+/*
+ * Returns ids of points that are Pareto-optimal among points with the same k,
+ * i.e., there's no other point that is at least as good in each of the
+ * following criteria and strictly better in at least one of them:
+ * (1) a higher recall, (2) a lower 99th percentile of the query time, (3) a lower memory usage.
+ * The index creation time is not used, because it is affected by a random noise.
+ */
+inline vector<size_t> ComputeParetoFrontier(const vector<TunePoint>& points) {
+  vector<size_t> res;
+  for (size_t i = 0; i < points.size(); ++i) {
+    const TunePoint& p = points[i];
+    bool dominated = false;
+    for (size_t j = 0; j < points.size() && !dominated; ++j) {
+      const TunePoint& o = points[j];
+      if (j == i || o.K != p.K) continue;
+      if (o.Recall >= p.Recall && o.QueryTimeP99 <= p.QueryTimeP99 && o.Mem <= p.Mem &&
+          (o.Recall > p.Recall || o.QueryTimeP99 < p.QueryTimeP99 || o.Mem < p.Mem)) {
+        dominated = true;
+      }
+    }
+    if (!dominated) res.push_back(i);
+  }
+  return res;
+}
+
 template <typename dist_t>
 void GetOptimalAlphas(bool bPrintProgres,
                       ExperimentConfig<dist_t>&     config, 
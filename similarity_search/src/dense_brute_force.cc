@@ -0,0 +1,218 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#include "portable_intrinsics.h"
+#include "dense_brute_force.h"
+#include "space/space_lp.h"
+#include "space/space_scalar.h"
+#include "logging.h"
+
+namespace similarity {
+
+using std::numeric_limits;
+
+const size_t DenseBruteForce::BLOCK_QTY;
+
+// The padded dimensionality is a multiple of this number (the number of floats in an AVX register)
+const size_t DENSE_BF_PAD_QTY = 8;
+
+bool DenseBruteForce::GetDistType(const Space<float>& space, DistType& distType) {
+  const SpaceLp<float>* pLp = dynamic_cast<const SpaceLp<float>*>(&space);
+  if (pLp != nullptr && pLp->getP() == 2) {
+    distType = kL2;
+    return true;
+  }
+  if (dynamic_cast<const SpaceCosineSimilarity<float>*>(&space) != nullptr) {
+    distType = kCosine;
+    return true;
+  }
+  if (dynamic_cast<const SpaceNegativeScalarProduct<float>*>(&space) != nullptr) {
+    distType = kNegDotProd;
+    return true;
+  }
+  return false;
+}
+
+DenseBruteForce::DenseBruteForce(const ObjectVector& data, DistType distType) :
+    data_(data), distType_(distType), dim_(0) {
+  if (!data_.empty()) dim_ = data_[0]->datalength() / sizeof(float);
+  paddedDim_ = (dim_ + DENSE_BF_PAD_QTY - 1) / DENSE_BF_PAD_QTY * DENSE_BF_PAD_QTY;
+  /*
+   * The error of the floating-point dot product is bounded by
+   * ~ dim * machine-epsilon * ||x|| * ||y||. We use an extra safety factor of four,
+   * which takes into account errors in norms and in the final expression.
+   */
+  relErr_ = 4 * (paddedDim_ + DENSE_BF_PAD_QTY) * numeric_limits<float>::epsilon();
+
+  matrix_.resize(data_.size() * paddedDim_);
+  norms_.resize(data_.size());
+
+  for (size_t i = 0; i < data_.size(); ++i) {
+    CHECK_MSG(data_[i]->datalength() == dim_ * sizeof(float),
+              "All data vectors should have the same dimensionality!");
+    float* pRow = &matrix_[i * paddedDim_];
+    memcpy(pRow, data_[i]->data(), dim_ * sizeof(float));
+    float norm2 = 0;
+    for (size_t k = 0; k < dim_; ++k) norm2 += pRow[k] * pRow[k];
+    norms_[i] = sqrt(norm2);
+  }
+}
+
+void DenseBruteForce::ComputeDotProducts(const float* pQuery, size_t start, size_t end, float* pRes) const {
+  size_t i = start;
+  // Four rows are processed at once: the query is loaded once for all of them and
+  // independent accumulators hide the latency of additions.
+#if defined(PORTABLE_AVX)
+  for (; i + 4 <= end; i += 4) {
+    const float* pRow0 = &matrix_[i * paddedDim_];
+    const float* pRow1 = pRow0 + paddedDim_;
+    const float* pRow2 = pRow1 + paddedDim_;
+    const float* pRow3 = pRow2 + paddedDim_;
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps(),
+           sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+    for (size_t k = 0; k < paddedDim_; k += 8) {
+      __m256 q = _mm256_loadu_ps(pQuery + k);
+      sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(q, _mm256_loadu_ps(pRow0 + k)));
+      sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(q, _mm256_loadu_ps(pRow1 + k)));
+      sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(q, _mm256_loadu_ps(pRow2 + k)));
+      sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(q, _mm256_loadu_ps(pRow3 + k)));
+    }
+    // Horizontal sums of four registers: the result is [sum0 sum1 sum2 sum3]
+    __m256 s01 = _mm256_hadd_ps(sum0, sum1);
+    __m256 s23 = _mm256_hadd_ps(sum2, sum3);
+    __m256 s = _mm256_hadd_ps(s01, s23);
+    __m128 res = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+    _mm_storeu_ps(pRes + (i - start), res);
+  }
+#elif defined(PORTABLE_SSE2)
+  for (; i + 4 <= end; i += 4) {
+    const float* pRow0 = &matrix_[i * paddedDim_];
+    const float* pRow1 = pRow0 + paddedDim_;
+    const float* pRow2 = pRow1 + paddedDim_;
+    const float* pRow3 = pRow2 + paddedDim_;
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(),
+           sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+    for (size_t k = 0; k < paddedDim_; k += 4) {
+      __m128 q = _mm_loadu_ps(pQuery + k);
+      sum0 = _mm_add_ps(sum0, _mm_mul_ps(q, _mm_loadu_ps(pRow0 + k)));
+      sum1 = _mm_add_ps(sum1, _mm_mul_ps(q, _mm_loadu_ps(pRow1 + k)));
+      sum2 = _mm_add_ps(sum2, _mm_mul_ps(q, _mm_loadu_ps(pRow2 + k)));
+      sum3 = _mm_add_ps(sum3, _mm_mul_ps(q, _mm_loadu_ps(pRow3 + k)));
+    }
+    // Transpose & add: the result is [sum0 sum1 sum2 sum3]
+    _MM_TRANSPOSE4_PS(sum0, sum1, sum2, sum3);
+    _mm_storeu_ps(pRes + (i - start), _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+  }
+#endif
+  for (; i < end; ++i) {
+    const float* pRow = &matrix_[i * paddedDim_];
+    float sum = 0;
+    for (size_t k = 0; k < paddedDim_; ++k) sum += pQuery[k] * pRow[k];
+    pRes[i - start] = sum;
+  }
+}
+
+bool DenseBruteForce::PrepareQuery(const Object* pQueryObj, PreparedQuery& query) const {
+  if (pQueryObj->datalength() != dim_ * sizeof(float)) return false;
+
+  query.paddedVect.assign(paddedDim_, 0.0f);
+  memcpy(&query.paddedVect[0], pQueryObj->data(), dim_ * sizeof(float));
+  query.norm2 = 0;
+  for (size_t k = 0; k < dim_; ++k) query.norm2 += query.paddedVect[k] * query.paddedVect[k];
+  query.norm = sqrt(query.norm2);
+  return true;
+}
+
+void DenseBruteForce::ComputeLowerBounds(const PreparedQuery& query, size_t start, size_t end, float* pBounds) const {
+  CHECK(end - start <= BLOCK_QTY);
+  // See NormScalarProductSIMD: vectors with nearly zero norms are orthogonal to everything
+  const float normEps = sqrt(numeric_limits<float>::min() * 2);
+
+  float dotProd[BLOCK_QTY];
+  ComputeDotProducts(&query.paddedVect[0], start, end, dotProd);
+
+  for (size_t i = start; i < end; ++i) {
+    const float dp = dotProd[i - start];
+    const float normProd = query.norm * norms_[i];
+    float& bound = pBounds[i - start];
+    switch (distType_) {
+      case kL2: {
+        float distSqr = query.norm2 + norms_[i] * norms_[i] - 2 * dp;
+        float tol = relErr_ * (query.norm + norms_[i]) * (query.norm + norms_[i]);
+        bound = sqrt(std::max(0.0f, distSqr - tol));
+        break;
+      }
+      case kCosine: {
+        float cosine = (query.norm < normEps || norms_[i] < normEps) ? 0 : dp / normProd;
+        bound = 1 - cosine - relErr_;
+        break;
+      }
+      case kNegDotProd: {
+        bound = -dp - relErr_ * normProd;
+        break;
+      }
+    }
+  }
+}
+
+template <typename QueryType>
+void DenseBruteForce::GenSearch(QueryType* query, size_t start, size_t end) const {
+  const Object* pQueryObj = query->QueryObject();
+  end = std::min(end, data_.size());
+  if (start >= end) return;
+
+  PreparedQuery preparedQuery;
+
+  if (!PrepareQuery(pQueryObj, preparedQuery)) {
+    // Let the space deal with (e.g., report) the dimensionality mismatch
+    for (size_t i = start; i < end; ++i) query->CheckAndAddToResult(data_[i]);
+    return;
+  }
+
+  float       bounds[BLOCK_QTY];
+  uint64_t    checkQty = 0;
+  float       thresh = GetThreshold(query);
+
+  for (size_t blockStart = start; blockStart < end; blockStart += BLOCK_QTY) {
+    size_t blockEnd = std::min(end, blockStart + BLOCK_QTY);
+    ComputeLowerBounds(preparedQuery, blockStart, blockEnd, bounds);
+
+    for (size_t i = blockStart; i < blockEnd; ++i) {
+      // Should we skip this data point, b/c its distance is surely not below the threshold?
+      if (bounds[i - blockStart] <= thresh) {
+        ++checkQty;
+        if (query->CheckAndAddToResult(data_[i])) {
+          thresh = GetThreshold(query);
+        }
+      }
+    }
+  }
+  // CheckAndAddToResult(const Object*) counts a distance computation, let's add the remaining ones
+  query->AddDistanceComputations((end - start) - checkQty);
+}
+
+void DenseBruteForce::Search(KNNQuery<float>* query, size_t start, size_t end) const {
+  GenSearch(query, start, end);
+}
+
+void DenseBruteForce::Search(RangeQuery<float>* query, size_t start, size_t end) const {
+  GenSearch(query, start, end);
+}
+
+}   // namespace similarity
@@ -14,6 +14,7 @@
  */
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
 
 #include "distcomp.h"
@@ -24,7 +25,7 @@ namespace similarity {
 
 using namespace std;
 
-template <class T> int levenshtein(const T* p1, size_t len1, const T* p2, size_t len2) {
+template <class T> int levenshteinSimple(const T* p1, size_t len1, const T* p2, size_t len2) {
   int aStackBuf[2 * MAX_LEVEN_BUFFER_QTY];
   int *pMemBuf = NULL;
   int *pBuff;
@@ -73,7 +74,257 @@ template <class T> int levenshtein(const T* p1, size_t len1, const T* p2, size_t
   return res;
 }
 
+const size_t   LEVEN_BLOCK_SIZE = 64;
+const uint64_t LEVEN_HIGH_BIT   = uint64_t(1) << (LEVEN_BLOCK_SIZE - 1);
+// The number of strings processed simultaneously by LevenshteinPattern::Distances
+const size_t   LEVEN_LANE_QTY   = 4;
+
+/*
+ * Advances a block of 64 rows (of the dynamic programming matrix) by one column.
+ * Pv and Mv encode positive and negative vertical differences, Eq is the bit-vector
+ * of the current symbol, and hin is the horizontal difference in the row
+ * right above the block. The function returns the horizontal difference
+ * in the row defined by outBit (which is normally the last row of the block).
+ * The code follows the block-based version of H. Hyyro (see also the edlib library).
+ */
+inline int advanceLevenBlock(uint64_t& Pv, uint64_t& Mv, uint64_t Eq, int hin, uint64_t outBit) {
+  const uint64_t Xv = Eq | Mv;
+  if (hin < 0) Eq |= 1;
+  const uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+  uint64_t Ph = Mv | ~(Xh | Pv);
+  uint64_t Mh = Pv & Xh;
+
+  int hout = 0;
+  if (Ph & outBit) hout = 1;
+  else if (Mh & outBit) hout = -1;
+
+  Ph <<= 1;
+  Mh <<= 1;
+  if (hin < 0) Mh |= 1;
+  else if (hin > 0) Ph |= 1;
+
+  Pv = Mh | ~(Xv | Ph);
+  Mv = Ph & Xv;
+  return hout;
+}
+
+/*
+ * The single-word version: the pattern length 0 < m <= 64.
+ * The row above the first one contains values 0, 1, 2, ..., i.e., 
+ * the horizontal difference is always one.
+ */
+template <class T, class EqFunc> 
+int levenWord(size_t m, const EqFunc& getEq, const T* pText, size_t n, int maxDist) {
+  uint64_t  Pv = ~uint64_t(0), Mv = 0;
+  const uint64_t lastBit = uint64_t(1) << (m - 1);
+  int score = m;
+
+  for (size_t j = 0; j < n; ++j) {
+    score += advanceLevenBlock(Pv, Mv, *getEq(pText[j]), 1, lastBit);
+    // Each of the remaining n - j - 1 symbols can decrease the score by at most one
+    if (score - int(n - j - 1) > maxDist) return maxDist + 1;
+  }
+
+  return score;
+}
+
+/*
+ * The multi-block version with Ukkonen's cut-off: blocks after lastBlock 
+ * contain only values larger than maxDist. Hence, they are not computed.
+ * A block is added once it may contain values not exceeding maxDist. Its previous column
+ * is (virtually) initialized with values increasing by one in each row. They can be larger
+ * than actual values, but this does not affect values that do not exceed maxDist.
+ */
+template <class T, class EqFunc> 
+int levenBlocks(size_t m, size_t blockQty, const EqFunc& getEq, const T* pText, size_t n, int maxDist) {
+  vector<uint64_t>  vPv(blockQty, ~uint64_t(0)), vMv(blockQty, 0);
+  vector<int>       vScore(blockQty); // values in the last rows of blocks
+
+  for (size_t b = 0; b < blockQty; ++b) {
+    vScore[b] = min(LEVEN_BLOCK_SIZE * (b + 1), m);
+  }
+  const uint64_t lastBit = uint64_t(1) << ((m - 1) % LEVEN_BLOCK_SIZE);
+  auto outBit = [&](size_t b) { return b + 1 == blockQty ? lastBit : LEVEN_HIGH_BIT; };
+  auto rowQty = [&](size_t b) { return int(min(LEVEN_BLOCK_SIZE, m - b * LEVEN_BLOCK_SIZE)); };
+
+  // A block is needed only if its first row doesn't exceed maxDist
+  size_t lastBlock = min(blockQty - 1, size_t(maxDist) / LEVEN_BLOCK_SIZE);
+
+  for (size_t j = 0; j < n; ++j) {
+    const uint64_t* pEq = getEq(pText[j]);
+
+    int hout = 1;
+    for (size_t b = 0; b <= lastBlock; ++b) {
+      hout = advanceLevenBlock(vPv[b], vMv[b], pEq[b], hout, outBit(b));
+      vScore[b] += hout;
+    }
+
+    int prevScore = vScore[lastBlock] - hout;
+    while (lastBlock + 1 < blockQty && (prevScore <= maxDist || vScore[lastBlock] <= maxDist)) {
+      const int prevUpperScore = prevScore;
+      ++lastBlock;
+      vPv[lastBlock] = ~uint64_t(0);
+      vMv[lastBlock] = 0;
+      prevScore = prevUpperScore + rowQty(lastBlock);
+      hout = advanceLevenBlock(vPv[lastBlock], vMv[lastBlock], pEq[lastBlock], hout, outBit(lastBlock));
+      vScore[lastBlock] = prevScore + hout;
+    }
+
+    // The minimum value of the block is at least vScore - 63
+    while (lastBlock > 0 && vScore[lastBlock] - int(LEVEN_BLOCK_SIZE) >= maxDist) --lastBlock;
+    /* 
+     * An optimal path passes through each column. Thus, if all values
+     * in the column (including j + 1 in the row 0) exceed maxDist, so does the distance.
+     */
+    if (lastBlock == 0 && vScore[0] - int(LEVEN_BLOCK_SIZE) >= maxDist && int(j + 1) > maxDist) {
+      return maxDist + 1;
+    }
+    if (lastBlock + 1 == blockQty && vScore[lastBlock] - int(n - j - 1) > maxDist) {
+      return maxDist + 1;
+    }
+  }
+
+  return lastBlock + 1 == blockQty ? vScore[lastBlock] : maxDist + 1;
+}
+
+template <class T> 
+LevenshteinPattern<T>::LevenshteinPattern(const T* p, size_t len) : 
+                        len_(len), blockQty_((len + LEVEN_BLOCK_SIZE - 1) / LEVEN_BLOCK_SIZE) {
+  size_t symbQty = 256;
+  if (sizeof(T) > 1) {
+    alphabet_.assign(p, p + len);
+    sort(alphabet_.begin(), alphabet_.end());
+    alphabet_.erase(unique(alphabet_.begin(), alphabet_.end()), alphabet_.end());
+    symbQty = alphabet_.size() + 1;
+  }
+  peq_.resize(symbQty * blockQty_);
+  for (size_t i = 0; i < len; ++i) {
+    uint64_t* pEq = const_cast<uint64_t*>(getEq(p[i]));
+    pEq[i / LEVEN_BLOCK_SIZE] |= uint64_t(1) << (i % LEVEN_BLOCK_SIZE);
+  }
+}
+
+template <class T> 
+const uint64_t* LevenshteinPattern<T>::getEq(T c) const {
+  if (sizeof(T) == 1) {
+    return &peq_[static_cast<unsigned char>(c) * blockQty_];
+  }
+  auto it = lower_bound(alphabet_.begin(), alphabet_.end(), c);
+  size_t id = it != alphabet_.end() && *it == c ? (it - alphabet_.begin()) + 1 : 0;
+  return &peq_[id * blockQty_];
+}
+
+template <class T> 
+int LevenshteinPattern<T>::Distance(const T* p, size_t len, int maxDist) const {
+  // The distance cannot be smaller than the difference in lengths
+  if (int(max(len, len_) - min(len, len_)) > maxDist) return maxDist + 1;
+  if (!len_ || !len) return len + len_;
+
+  auto getEq = [this](T c) { return this->getEq(c); };
+  if (blockQty_ == 1) return levenWord(len_, getEq, p, len, maxDist);
+  return levenBlocks(len_, blockQty_, getEq, p, len, maxDist);
+}
+
+/*
+ * Several strings are processed in an interleaved fashion: the recurrences
+ * for different strings are independent and a CPU can execute them in parallel.
+ * Unfortunately, vector registers are of little help here: each step requires
+ * a table lookup for every string.
+ */
+template <class T> 
+void LevenshteinPattern<T>::Distances(const T* const* ppStr, const size_t* pLen, size_t qty, 
+                                      int* pDist, int maxDist) const {
+  if (blockQty_ != 1) {
+    for (size_t i = 0; i < qty; ++i) pDist[i] = Distance(ppStr[i], pLen[i], maxDist);
+    return;
+  }
+
+  const uint64_t lastBit = uint64_t(1) << (len_ - 1);
+
+  for (size_t start = 0; start < qty; start += LEVEN_LANE_QTY) {
+    const size_t laneQty = min(LEVEN_LANE_QTY, qty - start);
+    uint64_t     aPv[LEVEN_LANE_QTY], aMv[LEVEN_LANE_QTY];
+    int          aScore[LEVEN_LANE_QTY];
+    size_t       aLen[LEVEN_LANE_QTY];
+    const T*     apStr[LEVEN_LANE_QTY];
+    size_t       maxLen = 0;
+
+    for (size_t l = 0; l < LEVEN_LANE_QTY; ++l) {
+      aPv[l] = ~uint64_t(0);
+      aMv[l] = 0;
+      aScore[l] = len_;
+      // Unused lanes are processed like empty strings
+      aLen[l] = l < laneQty ? pLen[start + l] : 0;
+      apStr[l] = l < laneQty ? ppStr[start + l] : nullptr;
+      // The bound is not achievable: there is no need to process this string
+      if (int(max(aLen[l], len_) - min(aLen[l], len_)) > maxDist) aLen[l] = 0;
+      maxLen = max(maxLen, aLen[l]);
+    }
+
+    for (size_t j = 0; j < maxLen; ++j) {
+      for (size_t l = 0; l < LEVEN_LANE_QTY; ++l) {
+        if (j < aLen[l]) {
+          aScore[l] += advanceLevenBlock(aPv[l], aMv[l], *getEq(apStr[l][j]), 1, lastBit);
+          // Stop processing the string once the bound cannot be achieved
+          if (aScore[l] - int(aLen[l] - j - 1) > maxDist) aLen[l] = 0;
+        }
+      }
+    }
+
+    for (size_t l = 0; l < laneQty; ++l) {
+      const size_t len = pLen[start + l];
+      if (int(max(len, len_) - min(len, len_)) > maxDist) {
+        pDist[start + l] = maxDist + 1;
+      } else if (!len) {
+        pDist[start + l] = len_;
+      } else {
+        pDist[start + l] = aLen[l] ? aScore[l] : maxDist + 1;
+      }
+    }
+  }
+}
+
+namespace {
+// Patterns that fit into a single word are processed without memory allocation
+int levenshteinShortChar(const char* p1, size_t len1, const char* p2, size_t len2, int maxDist) {
+  uint64_t aEq[256];
+  memset(aEq, 0, sizeof aEq);
+  for (size_t i = 0; i < len1; ++i) aEq[static_cast<unsigned char>(p1[i])] |= uint64_t(1) << i;
+  auto getEq = [&aEq](char c) { return &aEq[static_cast<unsigned char>(c)]; };
+  return levenWord(len1, getEq, p2, len2, maxDist);
+}
+}
+
+template <class T> int levenshteinBounded(const T* p1, size_t len1, const T* p2, size_t len2, int maxDist) {
+  // The shorter string is used as a pattern, which minimizes the number of blocks
+  if (len1 > len2) {
+    swap(p1, p2);
+    swap(len1, len2);
+  }
+  if (int(len2 - len1) > maxDist) return maxDist + 1;
+  if (!len1) return len2;
+
+  if (sizeof(T) == 1 && len1 <= LEVEN_BLOCK_SIZE) {
+    return levenshteinShortChar(reinterpret_cast<const char*>(p1), len1, 
+                                reinterpret_cast<const char*>(p2), len2, maxDist);
+  }
+  return LevenshteinPattern<T>(p1, len1).Distance(p2, len2, maxDist);
+}
+
+template <class T> int levenshtein(const T* p1, size_t len1, const T* p2, size_t len2) {
+  return levenshteinBounded(p1, len1, p2, len2, INT_MAX);
+}
+
+template class LevenshteinPattern<char>;
+template class LevenshteinPattern<char32_t>;
+
 template int levenshtein<char>(const char* p1, size_t len1, const char* p2, size_t len2);
 template int levenshtein<char32_t>(const char32_t* p1, size_t len1, const char32_t* p2, size_t len2);
 
+template int levenshteinBounded<char>(const char* p1, size_t len1, const char* p2, size_t len2, int maxDist);
+template int levenshteinBounded<char32_t>(const char32_t* p1, size_t len1, const char32_t* p2, size_t len2, int maxDist);
+
+template int levenshteinSimple<char>(const char* p1, size_t len1, const char* p2, size_t len2);
+template int levenshteinSimple<char32_t>(const char32_t* p1, size_t len1, const char32_t* p2, size_t len2);
+
 }
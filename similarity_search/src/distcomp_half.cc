@@ -0,0 +1,202 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include "portable_intrinsics.h"
+#include "half_float.h"
+#include "distcomp.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+namespace similarity {
+
+using namespace std;
+
+/*
+ * Loading eight 16-bit values as a vector of 32-bit floats. Float16 values are converted
+ * using F16C instructions, BFloat16 values are simply shifted (this requires AVX2).
+ * If the conversion isn't supported, kAvailable is false and Load8 is never called.
+ */
+template <class T>
+struct HalfSIMD {
+  static const bool kAvailable = false;
+#if defined(PORTABLE_AVX)
+  static __m256 Load8(const T*) { return _mm256_setzero_ps(); }
+#endif
+};
+
+#if defined(PORTABLE_F16C)
+template <>
+struct HalfSIMD<Float16> {
+  static const bool kAvailable = true;
+  static __m256 Load8(const Float16* p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+  }
+};
+#endif
+
+#if defined(PORTABLE_AVX2)
+template <>
+struct HalfSIMD<BFloat16> {
+  static const bool kAvailable = true;
+  static __m256 Load8(const BFloat16* p) {
+    const __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(v, 16));
+  }
+};
+#endif
+
+#if defined(PORTABLE_AVX)
+inline float HorizontalSum8(__m256 v) {
+  float PORTABLE_ALIGN32 TmpRes[8];
+  _mm256_store_ps(TmpRes, v);
+  return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+}
+#endif
+
+template <class T>
+float L2NormHalf(const T* p1, const T* p2, size_t qty) {
+  float  res = 0;
+  size_t i = 0;
+#if defined(PORTABLE_AVX)
+  if (HalfSIMD<T>::kAvailable) {
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    for (; i + 16 <= qty; i += 16) {
+      const __m256 d1 = _mm256_sub_ps(HalfSIMD<T>::Load8(p1 + i), HalfSIMD<T>::Load8(p2 + i));
+      const __m256 d2 = _mm256_sub_ps(HalfSIMD<T>::Load8(p1 + i + 8), HalfSIMD<T>::Load8(p2 + i + 8));
+      sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(d1, d1));
+      sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(d2, d2));
+    }
+    for (; i + 8 <= qty; i += 8) {
+      const __m256 d = _mm256_sub_ps(HalfSIMD<T>::Load8(p1 + i), HalfSIMD<T>::Load8(p2 + i));
+      sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(d, d));
+    }
+    res = HorizontalSum8(_mm256_add_ps(sum1, sum2));
+  }
+#endif
+  for (; i < qty; ++i) {
+    const float d = ToFloat(p1[i]) - ToFloat(p2[i]);
+    res += d * d;
+  }
+  return sqrt(res);
+}
+
+template float L2NormHalf<Float16>(const Float16* p1, const Float16* p2, size_t qty);
+template float L2NormHalf<BFloat16>(const BFloat16* p1, const BFloat16* p2, size_t qty);
+
+/*
+ * Computes the scalar product of two vectors and, if normalized is true,
+ * squared Euclidean norms of these vectors.
+ */
+template <class T, bool normalized>
+void ScalarProductHalfSums(const T* p1, const T* p2, size_t qty,
+                           float& sum, float& norm1, float& norm2) {
+  sum = norm1 = norm2 = 0;
+  size_t i = 0;
+#if defined(PORTABLE_AVX512_BF16)
+  /*
+   * Products of bfloat16 values are exact 32-bit floats,
+   * so the scalar-product instruction loses no precision.
+   */
+  if (is_same<T, BFloat16>::value) {
+    __m512 sumProd = _mm512_setzero_ps();
+    __m512 sumSquare1 = sumProd;
+    __m512 sumSquare2 = sumProd;
+    for (; i + 32 <= qty; i += 32) {
+      const __m512bh v1 = (__m512bh)_mm512_loadu_si512(reinterpret_cast<const void*>(p1 + i));
+      const __m512bh v2 = (__m512bh)_mm512_loadu_si512(reinterpret_cast<const void*>(p2 + i));
+      sumProd = _mm512_dpbf16_ps(sumProd, v1, v2);
+      if (normalized) {
+        sumSquare1 = _mm512_dpbf16_ps(sumSquare1, v1, v1);
+        sumSquare2 = _mm512_dpbf16_ps(sumSquare2, v2, v2);
+      }
+    }
+    sum = _mm512_reduce_add_ps(sumProd);
+    if (normalized) {
+      norm1 = _mm512_reduce_add_ps(sumSquare1);
+      norm2 = _mm512_reduce_add_ps(sumSquare2);
+    }
+  }
+#endif
+#if defined(PORTABLE_AVX)
+  if (HalfSIMD<T>::kAvailable) {
+    __m256 sumProd = _mm256_setzero_ps();
+    __m256 sumSquare1 = sumProd;
+    __m256 sumSquare2 = sumProd;
+    for (; i + 8 <= qty; i += 8) {
+      const __m256 v1 = HalfSIMD<T>::Load8(p1 + i);
+      const __m256 v2 = HalfSIMD<T>::Load8(p2 + i);
+      sumProd = _mm256_add_ps(sumProd, _mm256_mul_ps(v1, v2));
+      if (normalized) {
+        sumSquare1 = _mm256_add_ps(sumSquare1, _mm256_mul_ps(v1, v1));
+        sumSquare2 = _mm256_add_ps(sumSquare2, _mm256_mul_ps(v2, v2));
+      }
+    }
+    sum += HorizontalSum8(sumProd);
+    if (normalized) {
+      norm1 += HorizontalSum8(sumSquare1);
+      norm2 += HorizontalSum8(sumSquare2);
+    }
+  }
+#endif
+  for (; i < qty; ++i) {
+    const float v1 = ToFloat(p1[i]);
+    const float v2 = ToFloat(p2[i]);
+    sum += v1 * v2;
+    if (normalized) {
+      norm1 += v1 * v1;
+      norm2 += v2 * v2;
+    }
+  }
+}
+
+template <class T>
+float ScalarProductHalf(const T* p1, const T* p2, size_t qty) {
+  float sum, norm1, norm2;
+  ScalarProductHalfSums<T, false>(p1, p2, qty, sum, norm1, norm2);
+  return sum;
+}
+
+template float ScalarProductHalf<Float16>(const Float16* p1, const Float16* p2, size_t qty);
+template float ScalarProductHalf<BFloat16>(const BFloat16* p1, const BFloat16* p2, size_t qty);
+
+template <class T>
+float NormScalarProductHalf(const T* p1, const T* p2, size_t qty) {
+  float sum, norm1, norm2;
+  ScalarProductHalfSums<T, true>(p1, p2, qty, sum, norm1, norm2);
+
+  const float eps = numeric_limits<float>::min() * 2;
+
+  if (norm1 < eps || norm2 < eps) {
+    // The same convention as in NormScalarProduct: return 0 if at least one vector has nearly zero norm
+    return 0;
+  }
+  return max(float(-1), min(float(1), sum / sqrt(norm1) / sqrt(norm2)));
+}
+
+template float NormScalarProductHalf<Float16>(const Float16* p1, const Float16* p2, size_t qty);
+template float NormScalarProductHalf<BFloat16>(const BFloat16* p1, const BFloat16* p2, size_t qty);
+
+template <class T>
+float CosineSimilarityHalf(const T* p1, const T* p2, size_t qty) {
+  return max(float(0), 1 - NormScalarProductHalf(p1, p2, qty));
+}
+
+template float CosineSimilarityHalf<Float16>(const Float16* p1, const Float16* p2, size_t qty);
+template float CosineSimilarityHalf<BFloat16>(const BFloat16* p1, const BFloat16* p2, size_t qty);
+
+}  // namespace similarity
@@ -0,0 +1,137 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include "portable_intrinsics.h"
+#include "portable_prefetch.h"
+#include "distcomp.h"
+
+#include <cstdint>
+
+namespace similarity {
+
+using namespace std;
+
+#if defined(PORTABLE_AVX512_POPCNT)
+
+// A mask to load the remaining (less than eight) words
+inline __mmask8 TailMask(size_t qty) {
+  return __mmask8((1u << qty) - 1);
+}
+
+// For short codes, the scalar popcnt instruction is faster than vector reductions
+const size_t BIT_HAMMING_MIN_VECTOR_WORDS = 8;
+
+inline unsigned BitHammingScalar(const uint64_t* a, const uint64_t* b, size_t qty) {
+  unsigned res = 0;
+  for (size_t i = 0; i < qty; ++i) {
+    res += BitPopCount(a[i] ^ b[i]);
+  }
+  return res;
+}
+
+unsigned BitHamming(const uint64_t* a, const uint64_t* b, size_t qty) {
+  if (qty < BIT_HAMMING_MIN_VECTOR_WORDS) return BitHammingScalar(a, b, qty);
+  __m512i sum = _mm512_setzero_si512();
+  size_t  i = 0;
+  for (; i + 8 <= qty; i += 8) {
+    const __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+    sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+  }
+  if (i < qty) {
+    const __mmask8 mask = TailMask(qty - i);
+    const __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i));
+    sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+  }
+  return unsigned(_mm512_reduce_add_epi64(sum));
+}
+
+// Query codes of at most this number of words are kept in registers
+const size_t BIT_HAMMING_BATCH_MAX_REG_WORDS = 16;
+
+void BitHammingBatch(const uint64_t* pQuery, const uint64_t* const* ppVect, size_t qty, size_t wordQty, unsigned* pDist) {
+  if (wordQty < BIT_HAMMING_MIN_VECTOR_WORDS || wordQty > BIT_HAMMING_BATCH_MAX_REG_WORDS) {
+    for (size_t i = 0; i < qty; ++i) {
+      if (i + 2 < qty) PREFETCH(reinterpret_cast<const char*>(ppVect[i + 2]), _MM_HINT_T0);
+      pDist[i] = BitHamming(ppVect[i], pQuery, wordQty);
+    }
+    return;
+  }
+  // The code occupies one full register and one partially filled (or empty) register
+  const __mmask8 mask1 = __mmask8(0xff);
+  const __mmask8 mask2 = TailMask(wordQty - 8);
+  const __m512i  q1 = _mm512_maskz_loadu_epi64(mask1, pQuery);
+  const __m512i  q2 = _mm512_maskz_loadu_epi64(mask2, pQuery + 8);
+
+  for (size_t i = 0; i < qty; ++i) {
+    if (i + 2 < qty) PREFETCH(reinterpret_cast<const char*>(ppVect[i + 2]), _MM_HINT_T0);
+    const uint64_t* p = ppVect[i];
+    __m512i sum = _mm512_popcnt_epi64(_mm512_xor_si512(q1, _mm512_maskz_loadu_epi64(mask1, p)));
+    if (mask2) {
+      sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(_mm512_xor_si512(q2, _mm512_maskz_loadu_epi64(mask2, p + 8))));
+    }
+    pDist[i] = unsigned(_mm512_reduce_add_epi64(sum));
+  }
+}
+
+#else
+
+#if defined(PORTABLE_AVX2)
+/*
+ * The number of 1s in each byte is computed using a lookup table of 4-bit values (Mula's method),
+ * byte counts are then summed up into 64-bit values.
+ */
+inline __m256i PopCount256(__m256i v) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i lowMask = _mm256_set1_epi8(0x0f);
+  const __m256i lo = _mm256_and_si256(v, lowMask);
+  const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+  const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+  return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+#endif
+
+unsigned BitHamming(const uint64_t* a, const uint64_t* b, size_t qty) {
+  unsigned res = 0;
+  size_t   i = 0;
+#if defined(PORTABLE_AVX2)
+  if (qty >= 8) {
+    __m256i sum = _mm256_setzero_si256();
+    for (; i + 4 <= qty; i += 4) {
+      const __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+      sum = _mm256_add_epi64(sum, PopCount256(x));
+    }
+    uint64_t PORTABLE_ALIGN32 TmpRes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(TmpRes), sum);
+    res = unsigned(TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3]);
+  }
+#endif
+  // For short codes, the popcnt instruction is at least as fast as the lookup
+  for (; i < qty; ++i) {
+    res += BitPopCount(a[i] ^ b[i]);
+  }
+  return res;
+}
+
+void BitHammingBatch(const uint64_t* pQuery, const uint64_t* const* ppVect, size_t qty, size_t wordQty, unsigned* pDist) {
+  for (size_t i = 0; i < qty; ++i) {
+    if (i + 2 < qty) PREFETCH(reinterpret_cast<const char*>(ppVect[i + 2]), _MM_HINT_T0);
+    pDist[i] = BitHamming(ppVect[i], pQuery, wordQty);
+  }
+}
+
+#endif
+
+}  // namespace similarity
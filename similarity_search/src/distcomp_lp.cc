@@ -17,6 +17,7 @@
 #include "utils.h"
 #include "pow.h"
 #include "portable_intrinsics.h"
+#include "portable_prefetch.h"
 
 #include <cstdlib>
 #include <limits>
@@ -252,6 +253,89 @@ float L1NormSIMD(const float* pVect1, const float* pVect2, size_t qty) {
 
 template float L1NormSIMD<float>(const float* pVect1, const float* pVect2, size_t qty);
 
+/*
+ * The number of vector elements processed between two checks of a partial sum.
+ */
+const size_t LP_BOUND_CHECK_QTY = 64;
+
+/*
+ * The computation is exactly the same as in L1NormSIMD: absolute values are non-negative
+ * and the rounding is monotonic. Hence, the final sum is never smaller than a partial one.
+ */
+template <> 
+float L1NormSIMDBounded(const float* pVect1, const float* pVect2, size_t qty, float bound) {
+#ifndef PORTABLE_SSE2
+    return L1NormSIMD(pVect1, pVect2, qty);
+#else
+    // Short vectors are processed without checks
+    if (qty <= LP_BOUND_CHECK_QTY) return L1NormSIMD(pVect1, pVect2, qty);
+
+    size_t qty4  = qty/4;
+    size_t qty16 = qty/16;
+
+    const float* pEnd1 = pVect1 + 16 * qty16;
+    const float* pEnd2 = pVect1 + 4  * qty4;
+    const float* pEnd3 = pVect1 + qty;
+
+    __m128  diff, v1, v2; 
+    __m128  sum = _mm_setzero_ps();
+
+    __m128 mask_sign = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffffu));
+
+    float PORTABLE_ALIGN16 TmpRes[4];
+
+    while (pVect1 < pEnd1) {
+        const float* pChunkEnd = pVect1 + std::min(LP_BOUND_CHECK_QTY, size_t(pEnd1 - pVect1));
+
+        while (pVect1 < pChunkEnd) {
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_and_ps(diff, mask_sign));
+
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_and_ps(diff, mask_sign));
+
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_and_ps(diff, mask_sign));
+
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_and_ps(diff, mask_sign));
+        }
+
+        if (pVect1 < pEnd3) {
+            _mm_store_ps(TmpRes, sum);
+            float partial = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+            if (partial > bound) return partial;
+        }
+    }
+
+    while (pVect1 < pEnd2) {
+        v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+        v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+        diff = _mm_sub_ps(v1, v2);
+        sum  = _mm_add_ps(sum, _mm_and_ps(diff, mask_sign));
+    }
+
+    _mm_store_ps(TmpRes, sum);
+    double res= TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+
+    while (pVect1 < pEnd3) {
+        res += fabs(*pVect1++ - *pVect2++);
+    }
+
+    return res;
+#endif
+}
+
+template float L1NormSIMDBounded<float>(const float* pVect1, const float* pVect2, size_t qty, float bound);
+
 /*
  * L2-norm.
  */
@@ -372,6 +456,207 @@ float L2NormSIMD(const float* pVect1, const float* pVect2, size_t qty) {
 
 template float  L2NormSIMD<float>(const float* pVect1, const float* pVect2, size_t qty);
 
+/*
+ * The computation is exactly the same as in L2NormSIMD (see also L1NormSIMDBounded).
+ * To avoid computing square roots, partial sums are compared with the squared bound first.
+ */
+template <> 
+float L2NormSIMDBounded(const float* pVect1, const float* pVect2, size_t qty, float bound) {
+#ifndef PORTABLE_SSE2
+    return L2NormSIMD(pVect1, pVect2, qty);
+#else
+    // Short vectors are processed without checks
+    if (qty <= LP_BOUND_CHECK_QTY) return L2NormSIMD(pVect1, pVect2, qty);
+
+    size_t qty4  = qty/4;
+    size_t qty16 = qty/16;
+
+    const float* pEnd1 = pVect1 + 16 * qty16;
+    const float* pEnd2 = pVect1 + 4  * qty4;
+    const float* pEnd3 = pVect1 + qty;
+
+    const float boundSqr = bound * bound;
+
+    __m128  diff, v1, v2; 
+    __m128  sum = _mm_set1_ps(0); 
+
+    float PORTABLE_ALIGN16 TmpRes[4];
+
+    while (pVect1 < pEnd1) {
+        const float* pChunkEnd = pVect1 + std::min(LP_BOUND_CHECK_QTY, size_t(pEnd1 - pVect1));
+
+        while (pVect1 < pChunkEnd) {
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+
+            v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+            v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+            diff = _mm_sub_ps(v1, v2);
+            sum  = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+        }
+
+        if (pVect1 < pEnd3) {
+            _mm_store_ps(TmpRes, sum);
+            float partial = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+            if (partial > boundSqr && sqrt(partial) > bound) return sqrt(partial);
+        }
+    }
+
+    while (pVect1 < pEnd2) {
+        v1   = _mm_loadu_ps(pVect1); pVect1 += 4;
+        v2   = _mm_loadu_ps(pVect2); pVect2 += 4;
+        diff = _mm_sub_ps(v1, v2);
+        sum  = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+    }
+
+    _mm_store_ps(TmpRes, sum);
+    float res= TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+
+    while (pVect1 < pEnd3) {
+        float diff = *pVect1++ - *pVect2++; 
+        res += diff * diff;
+    }
+
+    return sqrt(res);
+#endif
+}
+
+template float  L2NormSIMDBounded<float>(const float* pVect1, const float* pVect2, size_t qty, float bound);
+
+#ifdef PORTABLE_SSE2
+/*
+ * The number of vectors processed together by LpNormSIMDBatch.
+ * Independent sums hide the latency of additions.
+ */
+const size_t LP_BATCH_GROUP_QTY = 4;
+// The maximum number of bytes of each vector in the next group that are prefetched
+const size_t LP_BATCH_PREFETCH_BYTES = 256;
+
+template <bool isL1>
+inline __m128 LpNormSIMDTerm(__m128 v1, __m128 v2, __m128 mask_sign) {
+    __m128 diff = _mm_sub_ps(v1, v2);
+    return isL1 ? _mm_and_ps(diff, mask_sign) : _mm_mul_ps(diff, diff);
+}
+
+// The same sequence of operations as in the 16-element loop of L1NormSIMD and L2SqrSIMD
+template <bool isL1>
+inline void LpNormSIMDStep16(const float* pQuery, const float* pVect, __m128& sum, __m128 mask_sign) {
+    sum = _mm_add_ps(sum, LpNormSIMDTerm<isL1>(_mm_loadu_ps(pVect), _mm_loadu_ps(pQuery), mask_sign));
+    sum = _mm_add_ps(sum, LpNormSIMDTerm<isL1>(_mm_loadu_ps(pVect + 4), _mm_loadu_ps(pQuery + 4), mask_sign));
+    sum = _mm_add_ps(sum, LpNormSIMDTerm<isL1>(_mm_loadu_ps(pVect + 8), _mm_loadu_ps(pQuery + 8), mask_sign));
+    sum = _mm_add_ps(sum, LpNormSIMDTerm<isL1>(_mm_loadu_ps(pVect + 12), _mm_loadu_ps(pQuery + 12), mask_sign));
+}
+
+/*
+ * Computes L1 or L2 distances from qty vectors to the query, processing
+ * LP_BATCH_GROUP_QTY vectors at a time. For each vector, the sequence of operations 
+ * is the same as in L1NormSIMD and L2SqrSIMD. Hence, the results are exactly the same.
+ */
+template <bool isL1>
+void LpNormSIMDBatch(const float* pQuery, const float* const* ppVect, size_t qty, size_t dim, float* pDist) {
+    const size_t dim4  = dim / 4 * 4;
+    const size_t dim16 = dim / 16 * 16;
+    const size_t prefetchBytes = std::min(LP_BATCH_PREFETCH_BYTES, dim * sizeof(float));
+
+    __m128 mask_sign = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffffu));
+
+    float PORTABLE_ALIGN16 TmpRes[4];
+
+    size_t start = 0;
+    for (; start + LP_BATCH_GROUP_QTY <= qty; start += LP_BATCH_GROUP_QTY) {
+        for (size_t i = start + LP_BATCH_GROUP_QTY; i < std::min(qty, start + 2 * LP_BATCH_GROUP_QTY); ++i) {
+            const char* p = reinterpret_cast<const char*>(ppVect[i]);
+            for (size_t off = 0; off < prefetchBytes; off += 64) {
+                PREFETCH(p + off, _MM_HINT_T0);
+            }
+        }
+
+        const float* p0 = ppVect[start];
+        const float* p1 = ppVect[start + 1];
+        const float* p2 = ppVect[start + 2];
+        const float* p3 = ppVect[start + 3];
+
+        __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(),
+               sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+
+        size_t k = 0;
+        for (; k < dim16; k += 16) {
+            LpNormSIMDStep16<isL1>(pQuery + k, p0 + k, sum0, mask_sign);
+            LpNormSIMDStep16<isL1>(pQuery + k, p1 + k, sum1, mask_sign);
+            LpNormSIMDStep16<isL1>(pQuery + k, p2 + k, sum2, mask_sign);
+            LpNormSIMDStep16<isL1>(pQuery + k, p3 + k, sum3, mask_sign);
+        }
+        for (; k < dim4; k += 4) {
+            __m128 q = _mm_loadu_ps(pQuery + k);
+            sum0 = _mm_add_ps(sum0, LpNormSIMDTerm<isL1>(_mm_loadu_ps(p0 + k), q, mask_sign));
+            sum1 = _mm_add_ps(sum1, LpNormSIMDTerm<isL1>(_mm_loadu_ps(p1 + k), q, mask_sign));
+            sum2 = _mm_add_ps(sum2, LpNormSIMDTerm<isL1>(_mm_loadu_ps(p2 + k), q, mask_sign));
+            sum3 = _mm_add_ps(sum3, LpNormSIMDTerm<isL1>(_mm_loadu_ps(p3 + k), q, mask_sign));
+        }
+
+        const float* pp[LP_BATCH_GROUP_QTY] = {p0, p1, p2, p3};
+        const __m128 sums[LP_BATCH_GROUP_QTY] = {sum0, sum1, sum2, sum3};
+
+        for (size_t j = 0; j < LP_BATCH_GROUP_QTY; ++j) {
+            const float* pVect = pp[j];
+            _mm_store_ps(TmpRes, sums[j]);
+            if (isL1) {
+                double res= TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+                for (size_t k = dim4; k < dim; ++k) {
+                    res += fabs(pVect[k] - pQuery[k]);
+                }
+                pDist[start + j] = res;
+            } else {
+                float res= TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+                for (size_t k = dim4; k < dim; ++k) {
+                    float diff = pVect[k] - pQuery[k];
+                    res += diff * diff;
+                }
+                pDist[start + j] = sqrt(res);
+            }
+        }
+    }
+
+    for (; start < qty; ++start) {
+        pDist[start] = isL1 ? L1NormSIMD(ppVect[start], pQuery, dim) : L2NormSIMD(ppVect[start], pQuery, dim);
+    }
+}
+#endif
+
+template <> 
+void L1NormSIMDBatch(const float* pQuery, const float* const* ppVect, size_t qty, size_t dim, float* pDist) {
+#ifndef PORTABLE_SSE2
+    for (size_t i = 0; i < qty; ++i) pDist[i] = L1NormSIMD(ppVect[i], pQuery, dim);
+#else
+    LpNormSIMDBatch<true>(pQuery, ppVect, qty, dim, pDist);
+#endif
+}
+
+template void L1NormSIMDBatch<float>(const float* pQuery, const float* const* ppVect, size_t qty, size_t dim, float* pDist);
+
+template <> 
+void L2NormSIMDBatch(const float* pQuery, const float* const* ppVect, size_t qty, size_t dim, float* pDist) {
+#ifndef PORTABLE_SSE2
+    for (size_t i = 0; i < qty; ++i) pDist[i] = L2NormSIMD(ppVect[i], pQuery, dim);
+#else
+    LpNormSIMDBatch<false>(pQuery, ppVect, qty, dim, pDist);
+#endif
+}
+
+template void L2NormSIMDBatch<float>(const float* pQuery, const float* const* ppVect, size_t qty, size_t dim, float* pDist);
+
 /*
  * Slower versions of LP-distance
  */
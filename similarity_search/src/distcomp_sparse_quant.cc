@@ -0,0 +1,152 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cstdint>
+#include <algorithm>
+
+#include "utils.h"
+#include "logging.h"
+#include "portable_intrinsics.h"
+#include "distcomp.h"
+
+#include "space/space_sparse_quant.h"
+
+namespace similarity {
+
+using namespace std;
+
+/*
+ * Decoding delta-encoded ids chunk by chunk: the decoding is fused with the intersection
+ * in that the next chunk is decoded only when the intersection has consumed the previous one.
+ * Hence, there are no heap-allocated buffers and each id byte is read only once.
+ */
+template <class T>
+class SparseQuantDecoder {
+ public:
+  explicit SparseQuantDecoder(const SparseQuantView<T>& v) :
+           pIds_(v.pIds_), pEnd_(v.pEnd_), pVals_(v.pVals_), leftQty_(v.qty_) {}
+
+  // Decodes the next chunk, returns the number of decoded ids (zero when all ids are decoded)
+  size_t Next() {
+    pVals_ += chunkQty_;
+    chunkQty_ = min(leftQty_, SPARSE_QUANT_CHUNK_QTY);
+    leftQty_ -= chunkQty_;
+    if (chunkQty_) UnpackSparseQuantIdChunk(pIds_, pEnd_, chunkQty_, prevId_, ids_);
+    return chunkQty_;
+  }
+  const uint32_t* Ids() const { return ids_; }
+  const T*        Vals() const { return pVals_; }
+ private:
+  const uint8_t*  pIds_;
+  const uint8_t*  pEnd_;
+  const T*        pVals_;
+  size_t          leftQty_;
+  size_t          chunkQty_ = 0;
+  uint32_t        prevId_ = 0;
+  uint32_t        ids_[SPARSE_QUANT_CHUNK_QTY];
+};
+
+/*
+ * Decoded chunks are intersected using SIMD (if available) and the remaining ids are merged
+ * without branches (except for the rarely taken branch on a match): which list advances
+ * is hard to predict, so a branch would be mispredicted often.
+ * Products of quantized values are summed up as integers, which is exact.
+ */
+template <class T>
+int64_t SparseQuantIntersect(const SparseQuantView<T>& v1, const SparseQuantView<T>& v2) {
+  SparseQuantDecoder<T> dec1(v1), dec2(v2);
+
+  size_t qty1 = dec1.Next(), qty2 = dec2.Next();
+  size_t i1 = 0, i2 = 0;
+  // Even for 16-bit values, the sum of less than 2^33 products can't overflow
+  int64_t sum = 0;
+
+  while (qty1 && qty2) {
+    const uint32_t* pIds1 = dec1.Ids();
+    const uint32_t* pIds2 = dec2.Ids();
+    const T*        pVals1 = dec1.Vals();
+    const T*        pVals2 = dec2.Vals();
+
+#if defined(PORTABLE_AVX2)
+    /*
+     * Blocks of eight ids are compared all against all (rotating one of the blocks),
+     * then the block with the smaller last id is skipped (or both blocks if last ids are equal).
+     * Matching ids are rare, so they are located with scalar code.
+     */
+    const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (i1 + 8 <= qty1 && i2 + 8 <= qty2) {
+      const __m256i ids1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIds1 + i1));
+      __m256i       ids2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIds2 + i2));
+      __m256i       eq = _mm256_cmpeq_epi32(ids1, ids2);
+      for (unsigned k = 1; k < 8; ++k) {
+        ids2 = _mm256_permutevar8x32_epi32(ids2, rotate);
+        eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(ids1, ids2));
+      }
+      if (_mm256_movemask_ps(_mm256_castsi256_ps(eq))) {
+        for (size_t k1 = i1; k1 < i1 + 8; ++k1)
+        for (size_t k2 = i2; k2 < i2 + 8; ++k2) {
+          if (pIds1[k1] == pIds2[k2]) sum += int32_t(pVals1[k1]) * int32_t(pVals2[k2]);
+        }
+      }
+      const uint32_t last1 = pIds1[i1 + 7];
+      const uint32_t last2 = pIds2[i2 + 7];
+      i1 += (last1 <= last2) * 8;
+      i2 += (last2 <= last1) * 8;
+    }
+#endif
+    while (i1 < qty1 && i2 < qty2) {
+      const uint32_t id1 = pIds1[i1];
+      const uint32_t id2 = pIds2[i2];
+      if (id1 == id2) sum += int32_t(pVals1[i1]) * int32_t(pVals2[i2]);
+      i1 += id1 <= id2;
+      i2 += id2 <= id1;
+    }
+    if (i1 == qty1) {
+      qty1 = dec1.Next();
+      i1 = 0;
+    }
+    if (i2 == qty2) {
+      qty2 = dec2.Next();
+      i2 = 0;
+    }
+  }
+
+  return sum;
+}
+
+template <class T>
+float SparseQuantScalarProduct(const char* pData1, size_t len1, const char* pData2, size_t len2) {
+  const SparseQuantView<T> v1 = ParseSparseQuantElements<T>(pData1, len1);
+  const SparseQuantView<T> v2 = ParseSparseQuantElements<T>(pData2, len2);
+
+  return float(SparseQuantIntersect(v1, v2)) * v1.scale_ * v2.scale_;
+}
+
+template float SparseQuantScalarProduct<int8_t>(const char* pData1, size_t len1, const char* pData2, size_t len2);
+template float SparseQuantScalarProduct<int16_t>(const char* pData1, size_t len1, const char* pData2, size_t len2);
+
+template <class T>
+float NormSparseQuantScalarProduct(const char* pData1, size_t len1, const char* pData2, size_t len2) {
+  const SparseQuantView<T> v1 = ParseSparseQuantElements<T>(pData1, len1);
+  const SparseQuantView<T> v2 = ParseSparseQuantElements<T>(pData2, len2);
+
+  float val = float(SparseQuantIntersect(v1, v2)) * v1.scale_ * v2.scale_ * v1.normCoeff_ * v2.normCoeff_;
+
+  return max(float(-1), min(float(1), val));
+}
+
+template float NormSparseQuantScalarProduct<int8_t>(const char* pData1, size_t len1, const char* pData2, size_t len2);
+template float NormSparseQuantScalarProduct<int16_t>(const char* pData1, size_t len1, const char* pData2, size_t len2);
+
+}  // namespace similarity
@@ -322,5 +322,174 @@ float SparseScalarProductFast(const char* pData1, size_t len1, const char* pData
   return SparseScalarProductFastIntern(pData1, len1, pData2, len2).prod_;
 }
 
+/*
+ * A dense array is used if its size doesn't exceed SPARSE_SCATTER_DENSE_MIN_QTY or
+ * SPARSE_SCATTER_DENSE_QTY_RATIO times the number of query elements: even when the array
+ * doesn't fit into L1 cache, a lookup is cheaper than probing the hash table.
+ * Otherwise, the hash table is at most a quarter full, so that most misses need one probe.
+ */
+const size_t SPARSE_SCATTER_DENSE_MIN_QTY   = 1 << 18;
+const size_t SPARSE_SCATTER_DENSE_QTY_RATIO = 256;
+const size_t SPARSE_SCATTER_HASH_MIN_QTY    = 16;
+/*
+ * A gather step (a table lookup) is more expensive than a step of the SIMD intersection,
+ * which, however, has to go over elements of both vectors. Hence, the gathering is used
+ * only if the query is at least this many times longer than the data vector.
+ */
+const size_t SPARSE_GATHER_DENSE_MIN_RATIO  = 1;
+const size_t SPARSE_GATHER_HASH_MIN_RATIO   = 4;
+
+// Fibonacci hashing: the top bits of the product are well mixed
+inline uint32_t SparseHashSlot(uint32_t id, uint32_t shift) {
+  return (id * 2654435769u) >> shift;
+}
+
+SparseScatteredQuery::SparseScatteredQuery(const char* pQuery, size_t lenQuery) {
+  size_t        blockQty = 0;
+  float         sqSum = 0;
+  const size_t* pBlockQtys = NULL;
+  const size_t* pBlockOffs = NULL;
+  const char*   pBlockBeg = NULL;
+
+  ParseSparseElementHeader(pQuery, blockQty, sqSum, normCoeff_, pBlockQtys, pBlockOffs, pBlockBeg);
+
+  const size_t elemSize = 2 + sizeof(float);
+
+  size_t maxId = 0;
+  const char* p = pBlockBeg;
+  for (size_t bid = 0; bid < blockQty; ++bid) {
+    size_t qty = pBlockQtys[bid];
+    if (qty) {
+      const uint16_t* pBlockIds = reinterpret_cast<const uint16_t*>(p);
+      maxId = max(maxId, pBlockOffs[bid] + pBlockIds[qty - 1]);
+    }
+    elemQty_ += qty;
+    p += elemSize * qty;
+  }
+  CHECK(p - pQuery == (ptrdiff_t) lenQuery);
+
+  const bool bDense = maxId < max(SPARSE_SCATTER_DENSE_MIN_QTY, SPARSE_SCATTER_DENSE_QTY_RATIO * elemQty_);
+  size_t hashMask = 0;
+  if (bDense) {
+    denseVals_.resize(maxId + 1);
+  } else {
+    size_t tableQty = SPARSE_SCATTER_HASH_MIN_QTY;
+    hashShift_ = 32 - 4;
+    while (tableQty < 4 * elemQty_) {
+      tableQty *= 2;
+      --hashShift_;
+    }
+    hashTable_.resize(tableQty, HashEntry{0, 0});
+    hashMask = tableQty - 1;
+  }
+
+  p = pBlockBeg;
+  for (size_t bid = 0; bid < blockQty; ++bid) {
+    size_t qty = pBlockQtys[bid];
+    const uint16_t* pBlockIds = reinterpret_cast<const uint16_t*>(p);
+    const float*    pBlockVals = reinterpret_cast<const float*>(pBlockIds + qty);
+    for (size_t k = 0; k < qty; ++k) {
+      uint32_t id = pBlockOffs[bid] + pBlockIds[k];
+      if (bDense) {
+        denseVals_[id] = pBlockVals[k];
+      } else {
+        size_t slot = SparseHashSlot(id, hashShift_);
+        while (hashTable_[slot].id_ != 0) slot = (slot + 1) & hashMask;
+        hashTable_[slot].id_ = id;
+        hashTable_[slot].val_ = pBlockVals[k];
+      }
+    }
+    p += elemSize * qty;
+  }
+}
+
+bool SparseScatteredQuery::PreferGather(const char* pData, size_t lenData) const {
+  size_t        blockQty = 0;
+  float         sqSum = 0, normCoeff = 0;
+  const size_t* pBlockQtys = NULL;
+  const size_t* pBlockOffs = NULL;
+  const char*   pBlockBeg = NULL;
+
+  ParseSparseElementHeader(pData, blockQty, sqSum, normCoeff, pBlockQtys, pBlockOffs, pBlockBeg);
+
+  size_t dataQty = 0;
+  for (size_t bid = 0; bid < blockQty; ++bid) dataQty += pBlockQtys[bid];
+
+  return elemQty_ >= dataQty * (IsDense() ? SPARSE_GATHER_DENSE_MIN_RATIO : SPARSE_GATHER_HASH_MIN_RATIO);
+}
+
+float SparseScatteredQuery::ScalarProduct(const char* pData, size_t lenData, float& dataNormCoeff) const {
+  size_t        blockQty = 0;
+  float         sqSum = 0;
+  const size_t* pBlockQtys = NULL;
+  const size_t* pBlockOffs = NULL;
+  const char*   pBlockBeg = NULL;
+
+  ParseSparseElementHeader(pData, blockQty, sqSum, dataNormCoeff, pBlockQtys, pBlockOffs, pBlockBeg);
+
+  const size_t elemSize = 2 + sizeof(float);
+
+  float sum = 0;
+  const char* p = pBlockBeg;
+
+  for (size_t bid = 0; bid < blockQty; ++bid) {
+    const size_t    qty = pBlockQtys[bid];
+    const size_t    off = pBlockOffs[bid];
+    const uint16_t* pBlockIds = reinterpret_cast<const uint16_t*>(p);
+    const float*    pBlockVals = reinterpret_cast<const float*>(pBlockIds + qty);
+
+    if (IsDense()) {
+      const size_t  denseQty = denseVals_.size();
+      const float*  pDense = denseVals_.data();
+      if (off >= denseQty) {
+        // No query element can be in this block
+      } else if (off + 65536 <= denseQty) {
+        // All block elements are within the array
+        for (size_t k = 0; k < qty; ++k) {
+          sum += pBlockVals[k] * pDense[off + pBlockIds[k]];
+        }
+      } else {
+        for (size_t k = 0; k < qty; ++k) {
+          size_t id = off + pBlockIds[k];
+          if (id < denseQty) sum += pBlockVals[k] * pDense[id];
+        }
+      }
+    } else {
+      const HashEntry* pTable = hashTable_.data();
+      const size_t     hashMask = hashTable_.size() - 1;
+      for (size_t k = 0; k < qty; ++k) {
+        const uint32_t id = off + pBlockIds[k];
+        for (size_t slot = SparseHashSlot(id, hashShift_); pTable[slot].id_ != 0; slot = (slot + 1) & hashMask) {
+          if (pTable[slot].id_ == id) {
+            sum += pBlockVals[k] * pTable[slot].val_;
+            break;
+          }
+        }
+      }
+    }
+    p += elemSize * qty;
+  }
+
+  CHECK(p - pData == (ptrdiff_t) lenData);
+
+  return sum;
+}
+
+float NormSparseScalarProductFastGather(const char* pData, size_t lenData, const SparseScatteredQuery& query) {
+  float dataNormCoeff = 0;
+  float val = query.ScalarProduct(pData, lenData, dataNormCoeff) * dataNormCoeff * query.NormCoeff();
+  return max(float(-1), min(float(1), val));
+}
+
+float QueryNormSparseScalarProductFastGather(const char* pData, size_t lenData, const SparseScatteredQuery& query) {
+  float dataNormCoeff = 0;
+  return query.ScalarProduct(pData, lenData, dataNormCoeff) * query.NormCoeff();
+}
+
+float SparseScalarProductFastGather(const char* pData, size_t lenData, const SparseScatteredQuery& query) {
+  float dataNormCoeff = 0;
+  return query.ScalarProduct(pData, lenData, dataNormCoeff);
+}
+
 
 }
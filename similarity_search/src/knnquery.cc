@@ -58,6 +58,12 @@ dist_t KNNQuery<dist_t>::Radius() const {
       : static_cast<dist_t>(result_->TopDistance() / (static_cast<dist_t>(1) + eps_));
 }
 
+template <typename dist_t>
+dist_t KNNQuery<dist_t>::ResultBound() const {
+  // Unlike Radius(), this doesn't take eps into account: see CheckAndAddToResult
+  return result_->Size() < static_cast<size_t>(K_) ? DistMax<dist_t>() : result_->TopDistance();
+}
+
 template <typename dist_t>
 unsigned KNNQuery<dist_t>::ResultSize() const {
   return result_->Size();
@@ -76,18 +82,12 @@ bool KNNQuery<dist_t>::CheckAndAddToResult(const dist_t distance,
 
 template <typename dist_t>
 bool KNNQuery<dist_t>::CheckAndAddToResult(const Object* object) {
-  return this->CheckAndAddToResult(this->DistanceObjLeft(object), object);
+  return this->CheckAndAddToResult(this->DistanceObjLeftBounded(object, ResultBound()), object);
 }
 
 template <typename dist_t>
 size_t KNNQuery<dist_t>::CheckAndAddToResult(const ObjectVector& bucket) {
-  size_t res = 0;
-  for (size_t i = 0; i < bucket.size(); ++i) {
-    if (CheckAndAddToResult(bucket[i])) {
-      ++res;
-    }
-  }
-  return res;
+  return this->CheckAndAddToResultBatch(bucket.data(), bucket.size());
 }
 
 template <typename dist_t>
@@ -119,6 +119,7 @@ namespace similarity {
         , data_level0_memory_(nullptr)
         , linkLists_(nullptr)
         , fstdistfunc_(nullptr)
+        , queryTimeParams_(std::make_shared<SearchParams>())
     {
     }
 
@@ -474,14 +475,19 @@ namespace similarity {
     Hnsw<dist_t>::SetQueryTimeParams(const AnyParams &QueryTimeParams)
     {
         AnyParamManager pmgr(QueryTimeParams);
+        std::shared_ptr<SearchParams> params = std::make_shared<SearchParams>();
 
         if (pmgr.hasParam("ef") && pmgr.hasParam("efSearch")) {
             throw runtime_error("The user shouldn't specify parameters ef and efSearch at the same time (they are synonyms)");
         }
 
         // ef and efSearch are going to be parameter-synonyms with the default value 20
-        pmgr.GetParamOptional("ef", ef_, 20);
-        pmgr.GetParamOptional("efSearch", ef_, ef_);
+        pmgr.GetParamOptional("ef", params->ef, 20);
+        pmgr.GetParamOptional("efSearch", params->ef, params->ef);
+
+        string efByK;
+        pmgr.GetParamOptional(EF_BY_K_PARAM, efByK, "");
+        params->efSchedule.Parse(efByK);
 
         int tmp;
         pmgr.GetParamOptional(
@@ -491,19 +497,23 @@ namespace similarity {
         pmgr.GetParamOptional("algoType", tmps, "hybrid");
         ToLower(tmps);
         if (tmps == "v1merge")
-            searchAlgoType_ = kV1Merge;
+            params->searchAlgoType = kV1Merge;
         else if (tmps == "old")
-            searchAlgoType_ = kOld;
+            params->searchAlgoType = kOld;
         else if (tmps == "hybrid")
-            searchAlgoType_ = kHybrid;
+            params->searchAlgoType = kHybrid;
         else {
             throw runtime_error("algoType should be one of the following: old, v1merge");
         }
 
         pmgr.CheckUnused();
+        std::atomic_store(&queryTimeParams_, std::shared_ptr<const SearchParams>(params));
         LOG(LIB_INFO) << "Set HNSW query-time parameters:";
-        LOG(LIB_INFO) << "ef(Search)         =" << ef_;
-        LOG(LIB_INFO) << "algoType           =" << searchAlgoType_;
+        LOG(LIB_INFO) << "ef(Search)         =" << params->ef;
+        if (!params->efSchedule.Empty()) {
+          LOG(LIB_INFO) << "ef by k            =" << params->efSchedule.ToString();
+        }
+        LOG(LIB_INFO) << "algoType           =" << params->searchAlgoType;
     }
 
     template <typename dist_t>
@@ -721,23 +731,26 @@ namespace similarity {
         if (this->data_.empty() && this->data_rearranged_.empty()) {
           return;
         }
-        bool useOld = searchAlgoType_ == kOld || (searchAlgoType_ == kHybrid && ef_ >= 1000);
-        // cout << "Ef = " << ef_ << " use old = " << useOld << endl;
+        // The snapshot of parameters is obtained once: it can be replaced during the search
+        const std::shared_ptr<const SearchParams> params = std::atomic_load(&queryTimeParams_);
+        const size_t ef = params->efSchedule.GetEf(query->GetK(), params->ef);
+        bool useOld = params->searchAlgoType == kOld || (params->searchAlgoType == kHybrid && ef >= 1000);
+        // cout << "Ef = " << ef << " use old = " << useOld << endl;
         switch (searchMethod_) {
         case 0:
             /// Basic search using Nmslib data structure:
             if (useOld)
-                const_cast<Hnsw *>(this)->baseSearchAlgorithmOld(query);
+                const_cast<Hnsw *>(this)->baseSearchAlgorithmOld(query, ef);
             else
-                const_cast<Hnsw *>(this)->baseSearchAlgorithmV1Merge(query);
+                const_cast<Hnsw *>(this)->baseSearchAlgorithmV1Merge(query, ef);
             break;
         case 3:
         case 4:
             /// Basic search using optimized index for l2, cosine, negative dot product
             if (useOld)
-                const_cast<Hnsw *>(this)->SearchOld(query, iscosine_);
+                const_cast<Hnsw *>(this)->SearchOld(query, ef, iscosine_);
             else
-                const_cast<Hnsw *>(this)->SearchV1Merge(query, iscosine_);
+                const_cast<Hnsw *>(this)->SearchV1Merge(query, ef, iscosine_);
             break;
         default:
                 throw runtime_error("Invalid searchMethod: " + ConvertToString(searchMethod_));
@@ -1075,7 +1088,7 @@ namespace similarity {
 
     template <typename dist_t>
     void
-    Hnsw<dist_t>::baseSearchAlgorithmOld(KNNQuery<dist_t> *query)
+    Hnsw<dist_t>::baseSearchAlgorithmOld(KNNQuery<dist_t> *query, size_t ef)
     {
         VisitedList *vl = visitedlistpool->getFreeVisitedList();
         vl_type *massVisited = vl->mass;
@@ -1087,6 +1100,11 @@ namespace similarity {
 
         const Object *currObj = provider->getData();
 
+        // Buffers to compute distances to several neighbors in one call
+        vector<HnswNode *>     batchNodes(1 + max(maxM_, maxM0_));
+        vector<const Object *> batchObjs(batchNodes.size());
+        vector<dist_t>         batchDists(batchNodes.size());
+
         dist_t d = query->DistanceObjLeft(currObj);
         dist_t curdist = d;
         HnswNode *curNode = provider;
@@ -1096,15 +1114,21 @@ namespace similarity {
                 changed = false;
 
                 const vector<HnswNode *> &neighbor = curNode->getAllFriends(i);
-                for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter) {
-                    PREFETCH((char *)(*iter)->getData(), _MM_HINT_T0);
+                if (neighbor.size() > batchObjs.size()) {
+                    batchObjs.resize(neighbor.size());
+                    batchDists.resize(neighbor.size());
+                }
+                for (size_t k = 0; k < neighbor.size(); ++k) {
+                    PREFETCH((char *)neighbor[k]->getData(), _MM_HINT_T0);
+                    batchObjs[k] = neighbor[k]->getData();
                 }
-                for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter) {
-                    currObj = (*iter)->getData();
-                    d = query->DistanceObjLeft(currObj);
+                // curdist only decreases, so it remains a valid bound for the whole batch
+                query->DistanceObjLeftBatch(&batchObjs[0], neighbor.size(), curdist, &batchDists[0]);
+                for (size_t k = 0; k < neighbor.size(); ++k) {
+                    d = batchDists[k];
                     if (d < curdist) {
                         curdist = d;
-                        curNode = *iter;
+                        curNode = neighbor[k];
                         changed = true;
                     }
                 }
@@ -1147,22 +1171,37 @@ namespace similarity {
                 PREFETCH((char *)(*iter)->getData(), _MM_HINT_T0);
                 PREFETCH((char *)(massVisited + (*iter)->getId()), _MM_HINT_T0);
             }
-            // calculate distance to each neighbor
+            // Unvisited neighbors are collected to compute all distances in one call
+            size_t batchQty = 0;
+            if (neighbor.size() > batchNodes.size()) {
+                batchNodes.resize(neighbor.size());
+                batchObjs.resize(neighbor.size());
+                batchDists.resize(neighbor.size());
+            }
             for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter) {
                 curId = (*iter)->getId();
 
                 if (!(massVisited[curId] == currentV)) {
                     massVisited[curId] = currentV;
-                    currObj = (*iter)->getData();
-                    d = query->DistanceObjLeft(currObj);
-                    if (closestDistQueue1.top().getDistance() > d || closestDistQueue1.size() < ef_) {
-                        {
-                            query->CheckAndAddToResult(d, currObj);
-                            candidateQueue.emplace(d, *iter);
-                            closestDistQueue1.emplace(d, *iter);
-                            if (closestDistQueue1.size() > ef_) {
-                                closestDistQueue1.pop();
-                            }
+                    batchNodes[batchQty] = *iter;
+                    batchObjs[batchQty++] = (*iter)->getData();
+                }
+            }
+            /*
+             * Objects farther than the worst queue element are discarded.
+             * This distance only decreases while the batch is processed.
+             */
+            query->DistanceObjLeftBatch(&batchObjs[0], batchQty, closestDistQueue1.size() < ef ?
+                                        DistMax<dist_t>() : closestDistQueue1.top().getDistance(), &batchDists[0]);
+            for (size_t k = 0; k < batchQty; ++k) {
+                d = batchDists[k];
+                if (closestDistQueue1.top().getDistance() > d || closestDistQueue1.size() < ef) {
+                    {
+                        query->CheckAndAddToResult(d, batchObjs[k]);
+                        candidateQueue.emplace(d, batchNodes[k]);
+                        closestDistQueue1.emplace(d, batchNodes[k]);
+                        if (closestDistQueue1.size() > ef) {
+                            closestDistQueue1.pop();
                         }
                     }
                 }
@@ -1173,7 +1212,7 @@ namespace similarity {
 
     template <typename dist_t>
     void
-    Hnsw<dist_t>::baseSearchAlgorithmV1Merge(KNNQuery<dist_t> *query)
+    Hnsw<dist_t>::baseSearchAlgorithmV1Merge(KNNQuery<dist_t> *query, size_t ef)
     {
         VisitedList *vl = visitedlistpool->getFreeVisitedList();
         vl_type *massVisited = vl->mass;
@@ -1185,6 +1224,11 @@ namespace similarity {
 
         const Object *currObj = provider->getData();
 
+        // Buffers to compute distances to several neighbors in one call
+        vector<HnswNode *>     batchNodes(1 + max(maxM_, maxM0_));
+        vector<const Object *> batchObjs(batchNodes.size());
+        vector<dist_t>         batchDists(batchNodes.size());
+
         dist_t d = query->DistanceObjLeft(currObj);
         dist_t curdist = d;
         HnswNode *curNode = provider;
@@ -1194,22 +1238,28 @@ namespace similarity {
                 changed = false;
 
                 const vector<HnswNode *> &neighbor = curNode->getAllFriends(i);
-                for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter) {
-                    PREFETCH((char *)(*iter)->getData(), _MM_HINT_T0);
+                if (neighbor.size() > batchObjs.size()) {
+                    batchObjs.resize(neighbor.size());
+                    batchDists.resize(neighbor.size());
                 }
-                for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter) {
-                    currObj = (*iter)->getData();
-                    d = query->DistanceObjLeft(currObj);
+                for (size_t k = 0; k < neighbor.size(); ++k) {
+                    PREFETCH((char *)neighbor[k]->getData(), _MM_HINT_T0);
+                    batchObjs[k] = neighbor[k]->getData();
+                }
+                // curdist only decreases, so it remains a valid bound for the whole batch
+                query->DistanceObjLeftBatch(&batchObjs[0], neighbor.size(), curdist, &batchDists[0]);
+                for (size_t k = 0; k < neighbor.size(); ++k) {
+                    d = batchDists[k];
                     if (d < curdist) {
                         curdist = d;
-                        curNode = *iter;
+                        curNode = neighbor[k];
                         changed = true;
                     }
                 }
             }
         }
 
-        SortArrBI<dist_t, HnswNode *> sortedArr(max<size_t>(ef_, query->GetK()));
+        SortArrBI<dist_t, HnswNode *> sortedArr(max<size_t>(ef, query->GetK()));
         sortedArr.push_unsorted_grow(curdist, curNode);
 
         int_fast32_t currElem = 0;
@@ -1226,7 +1276,7 @@ namespace similarity {
         // Extraction of the neighborhood to find k nearest neighbors.
         ////////////////////////////////////////////////////////////////////////////////
 
-        while (currElem < min(sortedArr.size(), ef_)) {
+        while (currElem < min(sortedArr.size(), ef)) {
             auto &e = queueData[currElem];
             CHECK(!e.used);
             e.used = true;
@@ -1246,21 +1296,32 @@ namespace similarity {
                 CHECK(curId >= 0 && curId < this->data_.size());
                 PREFETCH((char *)(massVisited + curId), _MM_HINT_T0);
             }
-            // calculate distance to each neighbor
+            // Unvisited neighbors are collected to compute all distances in one call
+            size_t batchQty = 0;
+            if (neighbor.size() > batchNodes.size()) {
+                batchNodes.resize(neighbor.size());
+                batchObjs.resize(neighbor.size());
+                batchDists.resize(neighbor.size());
+            }
             for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter) {
                 curId = (*iter)->getId();
 
                 if (!(massVisited[curId] == currentV)) {
                     massVisited[curId] = currentV;
-                    currObj = (*iter)->getData();
-                    d = query->DistanceObjLeft(currObj);
-
-                    if (d < topKey || sortedArr.size() < ef_) {
-                        CHECK_MSG(itemBuff.size() > itemQty,
-                                  "Perhaps a bug: buffer size is not enough " + 
-                                  ConvertToString(itemQty) + " >= " + ConvertToString(itemBuff.size()));
-                        itemBuff[itemQty++] = QueueItem(d, *iter);
-                    }
+                    batchNodes[batchQty] = *iter;
+                    batchObjs[batchQty++] = (*iter)->getData();
+                }
+            }
+            // Objects farther than the worst queue element are discarded
+            query->DistanceObjLeftBatch(&batchObjs[0], batchQty,
+                                        sortedArr.size() < ef ? DistMax<dist_t>() : topKey, &batchDists[0]);
+            for (size_t k = 0; k < batchQty; ++k) {
+                d = batchDists[k];
+                if (d < topKey || sortedArr.size() < ef) {
+                    CHECK_MSG(itemBuff.size() > itemQty,
+                              "Perhaps a bug: buffer size is not enough " + 
+                              ConvertToString(itemQty) + " >= " + ConvertToString(itemBuff.size()));
+                    itemBuff[itemQty++] = QueueItem(d, batchNodes[k]);
                 }
             }
 
@@ -45,14 +45,18 @@ namespace similarity {
 
     template <typename dist_t>
     void
-    Hnsw<dist_t>::SearchOld(KNNQuery<dist_t> *query, bool normalize)
+    Hnsw<dist_t>::SearchOld(KNNQuery<dist_t> *query, size_t ef, bool normalize)
     {
-        float *pVectq = (float *)((char *)query->QueryObject()->data());
+        const float *pVectq = (const float *)query->QueryObject()->data();
         TMP_RES_ARRAY(TmpRes);
         size_t qty = query->QueryObject()->datalength() >> 2;
 
+        // The query object isn't modified: a normalized copy is used instead
+        vector<float> normQuery;
         if (normalize) {
-            NormalizeVect(pVectq, qty);
+            normQuery.assign(pVectq, pVectq + qty);
+            NormalizeVect(&normQuery[0], qty);
+            pVectq = &normQuery[0];
         }
 
         VisitedList *vl = visitedlistpool->getFreeVisitedList();
@@ -131,7 +135,7 @@ namespace similarity {
                     massVisited[tnum] = currentV;
                     char *currObj1 = (data_level0_memory_ + tnum * memoryPerObject_ + offsetData_);
                     dist_t d = (fstdistfunc_(pVectq, (float *)(currObj1 + 16), qty, TmpRes));
-                    if (closestDistQueuei.top().getDistance() > d || closestDistQueuei.size() < ef_) {
+                    if (closestDistQueuei.top().getDistance() > d || closestDistQueuei.size() < ef) {
                         candidateQueuei.emplace(-d, tnum);
                         PREFETCH(data_level0_memory_ + candidateQueuei.top().element * memoryPerObject_ + offsetLevel0_,
                                      _MM_HINT_T0);
@@ -139,7 +143,7 @@ namespace similarity {
                         query->CheckAndAddToResult(d, data_rearranged_[tnum]);
                         closestDistQueuei.emplace(d, tnum);
 
-                        if (closestDistQueuei.size() > ef_) {
+                        if (closestDistQueuei.size() > ef) {
                             closestDistQueuei.pop();
                         }
                     }
@@ -151,14 +155,18 @@ namespace similarity {
 
     template <typename dist_t>
     void
-    Hnsw<dist_t>::SearchV1Merge(KNNQuery<dist_t> *query, bool normalize)
+    Hnsw<dist_t>::SearchV1Merge(KNNQuery<dist_t> *query, size_t ef, bool normalize)
     {
-        float *pVectq = (float *)((char *)query->QueryObject()->data());
+        const float *pVectq = (const float *)query->QueryObject()->data();
         TMP_RES_ARRAY(TmpRes);
         size_t qty = query->QueryObject()->datalength() >> 2;
 
+        // The query object isn't modified: a normalized copy is used instead
+        vector<float> normQuery;
         if (normalize) {
-            NormalizeVect(pVectq, qty);
+            normQuery.assign(pVectq, pVectq + qty);
+            NormalizeVect(&normQuery[0], qty);
+            pVectq = &normQuery[0];
         }
 
         VisitedList *vl = visitedlistpool->getFreeVisitedList();
@@ -197,7 +205,7 @@ namespace similarity {
             }
         }
 
-        SortArrBI<dist_t, int> sortedArr(max<size_t>(ef_, query->GetK()));
+        SortArrBI<dist_t, int> sortedArr(max<size_t>(ef, query->GetK()));
         sortedArr.push_unsorted_grow(curdist, curNodeNum);
 
         int_fast32_t currElem = 0;
@@ -208,7 +216,7 @@ namespace similarity {
 
         massVisited[curNodeNum] = currentV;
 
-        while (currElem < min(sortedArr.size(), ef_)) {
+        while (currElem < min(sortedArr.size(), ef)) {
             auto &e = queueData[currElem];
             CHECK(!e.used);
             e.used = true;
@@ -237,7 +245,7 @@ namespace similarity {
                     char *currObj1 = (data_level0_memory_ + tnum * memoryPerObject_ + offsetData_);
                     dist_t d = (fstdistfunc_(pVectq, (float *)(currObj1 + 16), qty, TmpRes));
 
-                    if (d < topKey || sortedArr.size() < ef_) {
+                    if (d < topKey || sortedArr.size() < ef) {
                         CHECK_MSG(itemBuff.size() > itemQty,
                                   "Perhaps a bug: buffer size is not enough " + 
                                   ConvertToString(itemQty) + " >= " + ConvertToString(itemBuff.size()));
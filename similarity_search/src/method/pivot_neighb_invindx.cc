@@ -20,14 +20,15 @@
 #include <thread>
 #include <unordered_map>
 
-#include "portable_prefetch.h"
 #include "portable_simd.h"
 #include "space.h"
 #include "rangequery.h"
 #include "knnquery.h"
 #include "incremental_quick_select.h"
+#include "galloping_search.h"
 #include "method/pivot_neighb_invindx.h"
 #include "utils.h"
+#include "thread_pool.h"
 
 #include "falconn_heap_mod.h"
 
@@ -37,43 +38,6 @@ using std::vector;
 using std::pair;
 using std::mutex;
 
-template <typename dist_t>
-struct IndexThreadParamsPNII {
-  PivotNeighbInvertedIndex<dist_t>&           index_;
-  size_t                                      chunk_qty_;
-  size_t                                      index_every_;
-  size_t                                      out_of_;
-  ProgressDisplay*                            progress_bar_;
-  mutex&                                      display_mutex_;
-
-  IndexThreadParamsPNII(
-                     PivotNeighbInvertedIndex<dist_t>&  index,
-                     size_t                             chunk_qty,
-                     size_t                             index_every,
-                     size_t                             out_of,
-                     ProgressDisplay*                   progress_bar,
-                     mutex&                             display_mutex
-                      ) :
-                     index_(index),
-                     chunk_qty_(chunk_qty),
-                     index_every_(index_every),
-                     out_of_(out_of),
-                     progress_bar_(progress_bar),
-                     display_mutex_(display_mutex)
-                     { }
-};
-
-template <typename dist_t>
-struct IndexThreadPNII {
-  void operator()(IndexThreadParamsPNII<dist_t>& prm) {
-    for (size_t i = 0; i < prm.chunk_qty_; ++i) {
-      if (prm.index_every_ == i % prm.out_of_) {
-        prm.index_.IndexChunk(i, prm.progress_bar_, prm.display_mutex_);
-      }
-    }
-  }
-};
-
 template <typename dist_t>
 PivotNeighbInvertedIndex<dist_t>::PivotNeighbInvertedIndex(
     bool  PrintProgress,
@@ -154,49 +118,25 @@ void PivotNeighbInvertedIndex<dist_t>::CreateIndex(const AnyParams& IndexParams)
     posting_lists_[chunkId] = shared_ptr<vector<PostingListInt>>(new vector<PostingListInt>());
   }
 
-  // Don't need more thread than you have chunks
-  index_thread_qty_ = min(index_thread_qty_, indexQty);
-
   mutex                                               progressBarMutex;
 
-  if (index_thread_qty_ <= 1) {
-    unique_ptr<ProgressDisplay> progress_bar(PrintProgress_ ?
-                                new ProgressDisplay(this->data_.size(), cerr)
-                                :NULL);
-    for (size_t chunkId = 0; chunkId < indexQty; ++chunkId) {
-      IndexChunk(chunkId, progress_bar.get(), progressBarMutex);
-    }
-
-    if (progress_bar) {
-      (*progress_bar) += (progress_bar->expected_count() - progress_bar->count());
-    }
-  } else {
-    vector<thread>                                      threads(index_thread_qty_);
-    vector<shared_ptr<IndexThreadParamsPNII<dist_t>>>   threadParams;
-
-    LOG(LIB_INFO) << "Will create " << index_thread_qty_ << " indexing threads";;
+  unique_ptr<ProgressDisplay> progress_bar(PrintProgress_ ?
+                              new ProgressDisplay(this->data_.size(), cerr)
+                              :NULL);
 
-    unique_ptr<ProgressDisplay> progress_bar(PrintProgress_ ?
-                                new ProgressDisplay(this->data_.size(), cerr)
-                                :NULL);
-
-    for (size_t i = 0; i < index_thread_qty_; ++i) {
-      threadParams.push_back(shared_ptr<IndexThreadParamsPNII<dist_t>>(
-                              new IndexThreadParamsPNII<dist_t>(*this, indexQty, i, index_thread_qty_,
-                                                               progress_bar.get(), progressBarMutex)));
-    }
-
-    for (size_t i = 0; i < index_thread_qty_; ++i) {
-      threads[i] = thread(IndexThreadPNII<dist_t>(), ref(*threadParams[i]));
-    }
-
-    for (size_t i = 0; i < index_thread_qty_; ++i) {
-      threads[i].join();
-    }
+  if (index_thread_qty_ > 1) {
+    LOG(LIB_INFO) << "Will use " << index_thread_qty_ << " indexing threads";
+  }
+  /*
+   * Chunks are processed one by one, but pivot distances (which is the most expensive part)
+   * are computed in parallel for batches of objects within each chunk.
+   */
+  for (size_t chunkId = 0; chunkId < indexQty; ++chunkId) {
+    IndexChunk(chunkId, progress_bar.get(), progressBarMutex);
+  }
 
-    if (progress_bar) {
-      (*progress_bar) += (progress_bar->expected_count() - progress_bar->count());
-    }
+  if (progress_bar) {
+    (*progress_bar) += (progress_bar->expected_count() - progress_bar->count());
   }
 
   // Let's collect pivot occurrence statistics
@@ -234,6 +174,12 @@ void PivotNeighbInvertedIndex<dist_t>::GetPermutationPPIndexEfficiently(const Qu
 
 template <typename dist_t>
 void PivotNeighbInvertedIndex<dist_t>::GetPermutationPPIndexEfficiently(Permutation &p, const vector <dist_t> &vDst) const {
+  CHECK(vDst.size() >= pivot_.size());
+  GetPermutationPPIndexEfficiently(p, vDst.data());
+}
+
+template <typename dist_t>
+void PivotNeighbInvertedIndex<dist_t>::GetPermutationPPIndexEfficiently(Permutation &p, const dist_t* vDst) const {
   vector<DistInt<dist_t>> dists;
   p.clear();
 
@@ -248,47 +194,65 @@ void PivotNeighbInvertedIndex<dist_t>::GetPermutationPPIndexEfficiently(Permutat
   }
 }
 
+// The number of objects for which we compute pivot distances in one batch
+const size_t PNII_INDEX_BATCH_QTY = 64;
+
 template <typename dist_t>
 void 
 PivotNeighbInvertedIndex<dist_t>::IndexChunk(size_t chunkId, ProgressDisplay* progress_bar, mutex& display_mutex) {
   size_t minId = chunkId * chunk_index_size_;
   size_t maxId = min(this->data_.size(), minId + chunk_index_size_);
-
+  size_t chunkQty = maxId - minId;
 
   auto & chunkPostLists = *posting_lists_[chunkId];
   chunkPostLists.resize(num_pivot_);
-  string externId;
 
-  for (size_t id = 0; id < maxId - minId; ++id) {
-    Permutation perm;
-    const Object* pObj = this->data_[minId + id];
+  // Closest pivots of each object are computed in parallel and memorized here
+  vector<PivotIdType> prefixes(chunkQty * num_prefix_);
+  size_t batchQty = (chunkQty + PNII_INDEX_BATCH_QTY - 1) / PNII_INDEX_BATCH_QTY;
+
+  ParallelFor(0, batchQty, index_thread_qty_, [&](size_t batchId, size_t threadId) {
+    size_t batchStart = batchId * PNII_INDEX_BATCH_QTY;
+    size_t batchEnd = min(chunkQty, batchStart + PNII_INDEX_BATCH_QTY);
 
-    unique_ptr<Object> extObj;
-    if (recreate_points_) {
-      extObj=space_.CreateObjFromStr(-1, -1, space_.CreateStrFromObj(pObj, externId), NULL);
-      pObj=extObj.get();
+    vector<const Object*>       batchObjs;
+    vector<unique_ptr<Object>>  extObjs;
+    string                      externId;
+
+    for (size_t id = batchStart; id < batchEnd; ++id) {
+      const Object* pObj = this->data_[minId + id];
+      if (recreate_points_) {
+        extObjs.emplace_back(space_.CreateObjFromStr(-1, -1, space_.CreateStrFromObj(pObj, externId), NULL));
+        pObj = extObjs.back().get();
+      }
+      batchObjs.push_back(pObj);
     }
 
-    GetPermutationPPIndexEfficiently(pObj, perm);
-    for (size_t j = 0; j < num_prefix_; ++j) {
-      chunkPostLists[perm[j]].push_back(id);
+    vector<dist_t> vDst;
+    pivot_index_->ComputePivotDistancesIndexTimeBatch(batchObjs.data(), batchObjs.size(), vDst);
+
+    Permutation perm;
+    for (size_t i = 0; i < batchObjs.size(); ++i) {
+      GetPermutationPPIndexEfficiently(perm, &vDst[i * pivot_.size()]);
+      for (size_t j = 0; j < num_prefix_; ++j) {
+        prefixes[(batchStart + i) * num_prefix_ + j] = perm[j];
+      }
     }
-        
-    if (id % 1000) {
+
+    if (progress_bar) {
       unique_lock<mutex> lock(display_mutex);
-      if (progress_bar) ++(*progress_bar);
+      (*progress_bar) += batchObjs.size();
     }
-  }
+  });
 
-  // Sorting is essential for merging algos
-  for (auto & p:chunkPostLists) {
-    sort(p.begin(), p.end());
+  // Ids are added in the increasing order, hence, posting lists are sorted, which is essential for merging algos
+  for (size_t id = 0; id < chunkQty; ++id) {
+    for (size_t j = 0; j < num_prefix_; ++j) {
+      chunkPostLists[prefixes[id * num_prefix_ + j]].push_back(id);
+    }
   }
 }
     
-
-    
-    
 template <typename dist_t>
 void 
 PivotNeighbInvertedIndex<dist_t>::SetQueryTimeParams(const AnyParams& QueryTimeParams) {
@@ -643,14 +607,7 @@ void PivotNeighbInvertedIndex<dist_t>::GenSearch(QueryType* query, size_t K) con
           }
         }
         if (!skip_checking_) {
-          for (size_t i = 0; i < cand_tmp_qty; ++i) {
-            query->CheckAndAddToResult(tmp_cand[i]);
-            if (i + 3 < cand_tmp_qty) {
-              PREFETCH(tmp_cand[i+1]->buffer(), _MM_HINT_T0);
-              PREFETCH(tmp_cand[i+2]->buffer(), _MM_HINT_T0);
-              PREFETCH(tmp_cand[i+3]->buffer(), _MM_HINT_T0);
-            }
-          }
+          query->CheckAndAddToResultBatch(tmp_cand.data(), cand_tmp_qty);
         }
       } else if (inv_proc_alg_ == kWAND) {
         vector<unique_ptr<PostListQueryState>>      queryStates(num_prefix_search_);
@@ -676,23 +633,30 @@ void PivotNeighbInvertedIndex<dist_t>::GenSearch(QueryType* query, size_t K) con
             postListQueue.extract_top(state_ids[ii].first, state_ids[ii].second);
           }
           size_t sqty = min_times_;
-          IdType minDocIdNeg = state_ids[0].first; 
-          if (minDocIdNeg == state_ids[min_times_idx].first) {
+          IdType minDocIdNeg = state_ids[0].first;
+          // The pivot is the min_times_-th smallest current document id
+          IdType pivotDocIdNeg = state_ids[min_times_idx].first;
+          /*
+           * If there's no match, no document preceding the pivot can occur in min_times_ lists.
+           * Hence, we can skip directly to the pivot. Otherwise, we move past the matched document.
+           */
+          IdTypeUnsign target = -pivotDocIdNeg;
+          if (minDocIdNeg == pivotDocIdNeg) {
             // match found, extract all remaining posting states with the !
-            while (!postListQueue.empty() && postListQueue.top_key() == minDocIdNeg) { 
+            while (!postListQueue.empty() && postListQueue.top_key() == minDocIdNeg) {
               postListQueue.extract_top(state_ids[sqty].first, state_ids[sqty].second);
               ++sqty;
             }
             //if (!skip_checking_) query->CheckAndAddToResult(data_start[-minDocIdNeg]);
             tmp_cand[cand_tmp_qty++]=data_start[-minDocIdNeg];
+            target++;
           }
-          // Advance pointers
+          // Advance pointers using the galloping search
           for (size_t ii = 0; ii < sqty; ++ii) {
             unsigned qsi = state_ids[ii].second;
             PostListQueryState& queryState = *queryStates[qsi];
             const PostingListInt& pl = *queryState.post_;
-            size_t pos = queryState.post_pos_;
-            while (pos < pl.size() && pl[pos] <= -minDocIdNeg) pos++;
+            size_t pos = GallopLowerBound(&pl[0], queryState.post_pos_, pl.size(), target);
             if (pos < pl.size()) {
                queryState.post_pos_ = pos;
                postListQueue.push(-pl[pos], qsi);
@@ -701,14 +665,7 @@ void PivotNeighbInvertedIndex<dist_t>::GenSearch(QueryType* query, size_t K) con
         }
 
         if (!skip_checking_) {
-          for (size_t i = 0; i < cand_tmp_qty; ++i) {
-            query->CheckAndAddToResult(tmp_cand[i]);
-            if (i + 3 < cand_tmp_qty) {
-              PREFETCH(tmp_cand[i+1]->buffer(), _MM_HINT_T0);
-              PREFETCH(tmp_cand[i+2]->buffer(), _MM_HINT_T0);
-              PREFETCH(tmp_cand[i+3]->buffer(), _MM_HINT_T0);
-            }
-          }
+          query->CheckAndAddToResultBatch(tmp_cand.data(), cand_tmp_qty);
         }
       } else if (inv_proc_alg_ == kPriorQueue) {
         vector<unique_ptr<PostListQueryState>>      queryStates(num_prefix_search_);
@@ -748,14 +705,7 @@ void PivotNeighbInvertedIndex<dist_t>::GenSearch(QueryType* query, size_t K) con
         }
 
         if (!skip_checking_) {
-          for (size_t i = 0; i < cand_tmp_qty; ++i) {
-            query->CheckAndAddToResult(tmp_cand[i]);
-            if (i + 3 < cand_tmp_qty) {
-              PREFETCH(tmp_cand[i+1]->buffer(), _MM_HINT_T0);
-              PREFETCH(tmp_cand[i+2]->buffer(), _MM_HINT_T0);
-              PREFETCH(tmp_cand[i+3]->buffer(), _MM_HINT_T0);
-            }
-          }
+          query->CheckAndAddToResultBatch(tmp_cand.data(), cand_tmp_qty);
         }
 
       } else if (inv_proc_alg_ == kMerge) {
@@ -19,37 +19,79 @@
 #include "knnquery.h"
 #include "knnqueue.h"
 #include "method/seqsearch.h"
+#include "thread_pool.h"
 
 namespace similarity {
 
-template <typename dist_t, typename QueryType>
-struct SearchThreadParamSeqSearch {
-  const Space<dist_t>&      space_;
-  const ObjectVector&       data_;
-  IdTypeUnsign              threadId_;
-  QueryType&                query_;
-
-  SearchThreadParamSeqSearch(
-      const Space<dist_t>&             space,
-      const ObjectVector&              data,
-      IdTypeUnsign                     threadId,
-      QueryType&                       query
-  ) :
-      space_(space),
-      data_(data),
-      threadId_(threadId),
-      query_(query) {}
-};
-
-template <typename dist_t, typename QueryType>
-struct SearchThreadSeqSearch {
-  void operator()(SearchThreadParamSeqSearch<dist_t, QueryType> &prm) {
-    for (const Object* o: prm.data_) {
-      prm.query_.CheckAndAddToResult(o);
-    }
+/*
+ * The dense fast path exists only for floats: these helpers
+ * return false if the fast path isn't applicable.
+ */
+template <typename QueryType>
+bool DenseSearch(const DenseBruteForce* pDenseBF, QueryType* query, size_t start, size_t end) {
+  return false;
+}
+
+template <>
+bool DenseSearch<KNNQuery<float>>(const DenseBruteForce* pDenseBF, KNNQuery<float>* query, size_t start, size_t end) {
+  if (pDenseBF == nullptr) return false;
+  pDenseBF->Search(query, start, end);
+  return true;
+}
+
+template <>
+bool DenseSearch<RangeQuery<float>>(const DenseBruteForce* pDenseBF, RangeQuery<float>* query, size_t start, size_t end) {
+  if (pDenseBF == nullptr) return false;
+  pDenseBF->Search(query, start, end);
+  return true;
+}
+
+template <typename dist_t>
+bool CreateDenseBruteForce(const Space<dist_t>& space, const ObjectVector& data, unique_ptr<DenseBruteForce>& denseBF) {
+  return false;
+}
+
+template <>
+bool CreateDenseBruteForce<float>(const Space<float>& space, const ObjectVector& data, unique_ptr<DenseBruteForce>& denseBF) {
+  DenseBruteForce::DistType distType;
+  if (!DenseBruteForce::GetDistType(space, distType)) return false;
+  for (const Object* o : data) {
+    if (o->datalength() != data[0]->datalength()) return false;
+  }
+  denseBF.reset(new DenseBruteForce(data, distType));
+  return true;
+}
+
+template <typename dist_t>
+unique_ptr<KNNQuery<dist_t>> CreateThreadQuery(const Space<dist_t>& space, const KNNQuery<dist_t>* query) {
+  return unique_ptr<KNNQuery<dist_t>>(new KNNQuery<dist_t>(space, query->QueryObject(), query->GetK(), query->GetEPS()));
+}
+
+template <typename dist_t>
+unique_ptr<RangeQuery<dist_t>> CreateThreadQuery(const Space<dist_t>& space, const RangeQuery<dist_t>* query) {
+  return unique_ptr<RangeQuery<dist_t>>(new RangeQuery<dist_t>(space, query->QueryObject(), query->Radius()));
+}
+
+template <typename dist_t>
+void MergeThreadResult(RangeQuery<dist_t>* query, const RangeQuery<dist_t>& threadQuery) {
+  const ObjectVector& res          = *threadQuery.Result();
+  const std::vector<dist_t>& dists = *threadQuery.ResultDists();
+  query->AddDistanceComputations(threadQuery.DistanceComputations());
+  for (size_t k = 0; k < res.size(); ++k) {
+    query->CheckAndAddToResult(dists[k], res[k]);
   }
-};
+}
 
+template <typename dist_t>
+void MergeThreadResult(KNNQuery<dist_t>* query, const KNNQuery<dist_t>& threadQuery) {
+  unique_ptr<KNNQueue<dist_t>> ResQ(threadQuery.Result()->Clone());
+  query->AddDistanceComputations(threadQuery.DistanceComputations());
+  while(!ResQ->Empty()) {
+    const Object *pObj = reinterpret_cast<const Object *>(ResQ->TopObject());
+    query->CheckAndAddToResult(ResQ->TopDistance(), pObj);
+    ResQ->Pop();
+  }
+}
 
 template <typename dist_t>
 SeqSearch<dist_t>::SeqSearch(Space<dist_t>& space, const ObjectVector& origData) :
@@ -65,6 +107,8 @@ void SeqSearch<dist_t>::CreateIndex(const AnyParams& IndexParams) {
   pmgr.GetParamOptional("multiThread", multiThread_, false);
   pmgr.GetParamOptional("threadQty", threadQty_, thread::hardware_concurrency()/2);
   if (threadQty_ < 2) multiThread_ = false;
+  bool bDenseFastPath;
+  pmgr.GetParamOptional("denseFastPath", bDenseFastPath, true);
   pmgr.CheckUnused();
 
   LOG(LIB_INFO) << "copyMem       = " << bCopyMem;
@@ -72,22 +116,6 @@ void SeqSearch<dist_t>::CreateIndex(const AnyParams& IndexParams) {
 
   if (multiThread_) {
     CHECK(threadQty_ > 1);
-    const ObjectVector& data = getData();
-    vvThreadData.resize(threadQty_);
-    for (size_t i = 0; i < threadQty_; ++i)
-      vvThreadData.reserve((data.size() + threadQty_ - 1)/threadQty_);
-
-    size_t D = (data.size() + threadQty_ - 1)/threadQty_;
-
-    for (size_t i = 0; i < data.size(); ++i) {
-      //vvThreadData[i % threadQty_].push_back(data[i]);
-      vvThreadData[i / D].push_back(data[i]); // This version seems to be working much better
-    }
-    /*
-    for (size_t i = 0; i < threadQty_; ++i) {
-      cout << "#######@@@" << vvThreadData[i].size() << endl;
-    }
-     */
     LOG(LIB_INFO) << "threadQty     = " << threadQty_;
   }
 
@@ -96,6 +124,12 @@ void SeqSearch<dist_t>::CreateIndex(const AnyParams& IndexParams) {
   if (bCopyMem) {
     CreateCacheOptimizedBucket(this->data_, cacheOptimizedBucket_, pData_);
   }
+
+  denseBF_.reset();
+  if (bDenseFastPath) {
+    bool bDense = CreateDenseBruteForce(space_, getData(), denseBF_);
+    LOG(LIB_INFO) << "dense fast path = " << bDense;
+  }
 }
 
 template <typename dist_t>
@@ -106,74 +140,46 @@ SeqSearch<dist_t>::~SeqSearch() {
 }
 
 template <typename dist_t>
-void SeqSearch<dist_t>::Search(RangeQuery<dist_t>* query, IdType) const {
+template <typename QueryType>
+void SeqSearch<dist_t>::GenSearch(QueryType* query) const {
   const ObjectVector& data = getData();
 
   if (!multiThread_) {
-    for (size_t i = 0; i < data.size(); ++i) {
-      query->CheckAndAddToResult(data[i]);
+    if (!DenseSearch(denseBF_.get(), query, 0, data.size())) {
+      query->CheckAndAddToResultBatch(data.data(), data.size());
     }
   } else {
-    vector<unique_ptr<RangeQuery<dist_t>>>                    vQueries(threadQty_);
-    vector<thread>                                            vThreads(threadQty_);
-    vector<unique_ptr<SearchThreadParamSeqSearch<dist_t, RangeQuery<dist_t>>>>    vThreadParams(threadQty_);
+    vector<unique_ptr<QueryType>> vQueries(threadQty_);
 
     for (size_t i = 0; i < threadQty_; ++i) {
-      vQueries[i].reset(new RangeQuery<dist_t>(space_, query->QueryObject(), query->Radius()));
-      vThreadParams[i].reset(new SearchThreadParamSeqSearch<dist_t,RangeQuery<dist_t>>(space_, vvThreadData[i], i, *vQueries[i]));
-    }
-    for (size_t i = 0; i < threadQty_; ++i) {
-      vThreads[i] = thread(SearchThreadSeqSearch<dist_t,RangeQuery<dist_t>>(), ref(*vThreadParams[i]));
+      vQueries[i] = CreateThreadQuery(space_, query);
     }
-    for (size_t i = 0; i < threadQty_; ++i) {
-      vThreads[i].join();
-    }
-    for (size_t i = 0; i < threadQty_; ++i) {
-      RangeQuery<dist_t>& threadQuery = vThreadParams[i]->query_;
-      const ObjectVector& res          = *threadQuery.Result();
-      const std::vector<dist_t>& dists = *threadQuery.ResultDists();
-      query->AddDistanceComputations(threadQuery.DistanceComputations());
-      for (size_t k = 0; k < res.size(); ++k) {
-        query->CheckAndAddToResult(dists[k], res[k]);
+    // Each thread processes a contiguous range of data points
+    size_t D = (data.size() + threadQty_ - 1)/threadQty_;
+
+    ParallelFor(0, threadQty_, threadQty_, [&](size_t i, size_t threadId) {
+      QueryType*  threadQuery = vQueries[i].get();
+      size_t      start = std::min(data.size(), i * D);
+      size_t      end = std::min(data.size(), start + D);
+      if (!DenseSearch(denseBF_.get(), threadQuery, start, end)) {
+        threadQuery->CheckAndAddToResultBatch(data.data() + start, end - start);
       }
+    });
+
+    for (size_t i = 0; i < threadQty_; ++i) {
+      MergeThreadResult(query, *vQueries[i]);
     }
   }
 }
 
 template <typename dist_t>
-void SeqSearch<dist_t>::Search(KNNQuery<dist_t>* query, IdType) const {
-  const ObjectVector& data = getData();
-
-  if (!multiThread_) {
-    for (size_t i = 0; i < data.size(); ++i) {
-      query->CheckAndAddToResult(data[i]);
-    }
-  } else {
-    vector<unique_ptr<KNNQuery<dist_t>>> vQueries(threadQty_);
-    vector<thread>                       vThreads(threadQty_);
-    vector<unique_ptr<SearchThreadParamSeqSearch<dist_t, KNNQuery<dist_t>>>>    vThreadParams(threadQty_);
+void SeqSearch<dist_t>::Search(RangeQuery<dist_t>* query, IdType) const {
+  GenSearch(query);
+}
 
-    for (size_t i = 0; i < threadQty_; ++i) {
-      vQueries[i].reset(new KNNQuery<dist_t>(space_, query->QueryObject(), query->GetK(), query->GetEPS()));
-      vThreadParams[i].reset(new SearchThreadParamSeqSearch<dist_t,KNNQuery<dist_t>>(space_, vvThreadData[i], i, *vQueries[i]));
-    }
-    for (size_t i = 0; i < threadQty_; ++i) {
-      vThreads[i] = thread(SearchThreadSeqSearch<dist_t,KNNQuery<dist_t>>(), ref(*vThreadParams[i]));
-    }
-    for (size_t i = 0; i < threadQty_; ++i) {
-      vThreads[i].join();
-    }
-    for (size_t i = 0; i < threadQty_; ++i) {
-      KNNQuery<dist_t>& threadQuery = vThreadParams[i]->query_;
-      unique_ptr<KNNQueue<dist_t>> ResQ(threadQuery.Result()->Clone());
-      query->AddDistanceComputations(threadQuery.DistanceComputations());
-      while(!ResQ->Empty()) {
-        const Object *pObj = reinterpret_cast<const Object *>(ResQ->TopObject());
-        query->CheckAndAddToResult(ResQ->TopDistance(), pObj);
-        ResQ->Pop();
-      }
-    }
-  }
+template <typename dist_t>
+void SeqSearch<dist_t>::Search(KNNQuery<dist_t>* query, IdType) const {
+  GenSearch(query);
 }
 
 template class SeqSearch<float>;
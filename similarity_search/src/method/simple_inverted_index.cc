@@ -14,12 +14,19 @@
  */
 #include <unordered_map>
 #include <queue>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <mutex>
 
 #include "space.h"
 #include "knnquery.h"
 #include "method/simple_inverted_index.h"
 #include "falconn_heap_mod.h"
 #include "ported_boost_progress.h"
+#include "thread_pool.h"
 
 #define SANITY_CHECKS
 
@@ -29,6 +36,78 @@ using namespace std;
 
 template <typename dist_t>
 void SimplInvIndex<dist_t>::Search(KNNQuery<dist_t>* query, IdType) const {
+  // The snapshot of parameters is obtained once: it can be replaced during the search
+  const shared_ptr<const SearchParams> params = atomic_load(&query_time_params_);
+  switch (params->inv_proc_alg_) {
+    case kDAAT: SearchDAAT(query); break;
+    case kWAND: SearchWAND(query, false); break;
+    case kBMW:  SearchWAND(query, true); break;
+    case kSAAT: SearchSAAT(query, params->saat_post_qty_); break;
+    default:
+      PREPARE_RUNTIME_ERR(err) << "Bug, unknown inv_proc_alg_: " << params->inv_proc_alg_;
+      THROW_RUNTIME_ERR(err);
+  }
+}
+
+template <typename dist_t>
+bool SimplInvIndex<dist_t>::FindPostList(unsigned termId, PostList& pl) const {
+  const TermEntry* it = std::lower_bound(terms_, terms_ + term_qty_, termId,
+                                         [](const TermEntry& e, unsigned id) -> bool { return e.term_id_ < id; });
+  if (it == terms_ + term_qty_ || it->term_id_ != termId) return false;
+
+  if (post_checked_) {
+    const size_t termIndex = it - terms_;
+    // Several threads may validate the same list concurrently, which is harmless
+    if (!post_checked_[termIndex].load(std::memory_order_acquire)) {
+      checkPostList(termIndex);
+      post_checked_[termIndex].store(true, std::memory_order_release);
+    }
+  }
+
+  pl.qty_             = it->post_qty_;
+  pl.entries_         = posts_ + it->post_offset_;
+  pl.impact_entries_  = impact_posts_ ? impact_posts_ + it->post_offset_ : nullptr;
+  pl.block_qty_       = it->block_qty_;
+  pl.blocks_          = blocks_ + it->block_offset_;
+  pl.min_val_         = it->min_val_;
+  pl.max_val_         = it->max_val_;
+  return true;
+}
+
+/*
+ * Search algorithms trust the index: they rely on sorted posting lists and use
+ * document ids as indices in the data array. Posting lists of a memory-mapped index
+ * are validated on first use: reading the whole file in LoadIndex would defeat the purpose
+ * of memory-mapping. The dictionary is validated in LoadIndex, so the offsets are within bounds.
+ */
+template <typename dist_t>
+void SimplInvIndex<dist_t>::checkPostList(size_t termIndex) const {
+  const TermEntry& e = terms_[termIndex];
+  const IdType dataQty = static_cast<IdType>(this->data_.size());
+  auto checkDocId = [&](IdType docId) {
+    if (docId < 0 || docId >= dataQty) {
+      PREPARE_RUNTIME_ERR(err) << "The index file '" << mmap_file_->fileName() << "' is corrupt: document id " << docId
+                               << " of the term #" << termIndex << " is out of range [0, " << dataQty << ")";
+      THROW_RUNTIME_ERR(err);
+    }
+  };
+  const PostEntry* entries = posts_ + e.post_offset_;
+  for (size_t k = 0; k < e.post_qty_; ++k) {
+    checkDocId(entries[k].doc_id_);
+    if (k > 0 && entries[k - 1].doc_id_ >= entries[k].doc_id_) {
+      PREPARE_RUNTIME_ERR(err) << "The index file '" << mmap_file_->fileName() << "' is corrupt: the posting list of the term #"
+                               << termIndex << " isn't sorted by document ids";
+      THROW_RUNTIME_ERR(err);
+    }
+  }
+  for (size_t k = 0; k < e.block_qty_; ++k) checkDocId(blocks_[e.block_offset_ + k].last_doc_id_);
+  if (impact_posts_) {
+    for (size_t k = 0; k < e.post_qty_; ++k) checkDocId(impact_posts_[e.post_offset_ + k].doc_id_);
+  }
+}
+
+template <typename dist_t>
+void SimplInvIndex<dist_t>::SearchDAAT(KNNQuery<dist_t>* query) const {
   // the query vector, its size is the number of query terms (non-zero dimensions of the query vector)
   vector<SparseVectElem<dist_t>>    query_vect;
   const Object* o = query->QueryObject();
@@ -48,12 +127,8 @@ void SimplInvIndex<dist_t>::Search(KNNQuery<dist_t>* query, IdType) const {
   unsigned qsi = 0;
   // initialize queryStates and postListQueue variables
   for (auto eQuery : query_vect) {
-    auto it = index_.find(eQuery.id_);
-    if (it != index_.end()) { // There may be out-of-vocabulary words
-#ifdef SANITY_CHECKS
-      CHECK(it->second.get() != nullptr);
-#endif
-      const PostList& pl = *it->second;
+    PostList pl;
+    if (FindPostList(eQuery.id_, pl)) { // There may be out-of-vocabulary words
       CHECK(pl.qty_ > 0);
       ++wordQty;
       // initialize the queryStates[query_term_index]  to the first position in the posting list
@@ -81,7 +156,7 @@ void SimplInvIndex<dist_t>::Search(KNNQuery<dist_t>* query, IdType) const {
     while (!postListQueue.empty() && postListQueue.top_key() == minDocIdNeg) {
       unsigned qsi = postListQueue.top_data();
       PostListQueryState& queryState = *queryStates[qsi];
-      const PostList& pl = *queryState.post_;
+      const PostList& pl = queryState.post_;
       accum += queryState.qval_x_docval_;
       //accum += queryState.qval_ * pl.entries_[queryState.post_pos_].val_;
 
@@ -139,6 +214,244 @@ void SimplInvIndex<dist_t>::Search(KNNQuery<dist_t>* query, IdType) const {
   }
 }
 
+template <typename dist_t>
+void SimplInvIndex<dist_t>::SearchWAND(KNNQuery<dist_t>* query, bool useBlockMax) const {
+  vector<SparseVectElem<dist_t>>    query_vect;
+  const Object* o = query->QueryObject();
+  UnpackSparseElements(o->data(), o->datalength(), query_vect);
+
+  const int_fast32_t K = query->GetK(); // the same type as FalconnHeapMod1::size()
+  if (0 == K) return;
+
+  vector<PostListWANDState>   queryStates;
+  queryStates.reserve(query_vect.size());
+  for (auto eQuery : query_vect) {
+    PostList pl;
+    if (FindPostList(eQuery.id_, pl)) { // There may be out-of-vocabulary words
+      queryStates.push_back(PostListWANDState(pl, eQuery.val_));
+    }
+  }
+  if (queryStates.empty()) return;
+
+  // Pointers to the states of non-exhausted posting lists sorted by the current document id
+  vector<PostListWANDState*>  sortedStates;
+  for (auto& s : queryStates) sortedStates.push_back(&s);
+  auto cmpDocId = [](const PostListWANDState* s1, const PostListWANDState* s2) -> bool {
+    return s1->CurrDocId() < s2->CurrDocId();
+  };
+  sort(sortedStates.begin(), sortedStates.end(), cmpDocId);
+
+  /*
+   * Only states [0, lastMoved] could have been moved forward. We restore
+   * the order using the insertion sort (this is cheap b/c the rest of the array
+   * is sorted) and evict states of exhausted lists (they move to the end).
+   */
+  auto restoreOrder = [&sortedStates, &cmpDocId](size_t lastMoved) {
+    for (size_t k = lastMoved + 1; k-- > 0;) {
+      for (size_t i = k; i + 1 < sortedStates.size() && cmpDocId(sortedStates[i + 1], sortedStates[i]); ++i) {
+        std::swap(sortedStates[i], sortedStates[i + 1]);
+      }
+    }
+    while (!sortedStates.empty() && sortedStates.back()->CurrDocId() == PostListWANDState::EndDocId()) {
+      sortedStates.pop_back();
+    }
+  };
+
+  // The same MAX-QUEUE of negated dot products as in SearchDAAT
+  FalconnHeapMod1<dist_t, IdType>             tmpResQueue;
+  // a document must have a larger dot product than theta to get into the top-K
+  dist_t theta = std::numeric_limits<dist_t>::lowest();
+
+  while (!sortedStates.empty()) {
+    // Find the pivot: the first list where the sum of contribution upper bounds exceeds the threshold
+    dist_t ubSum = 0;
+    size_t pivot = sortedStates.size();
+    for (size_t i = 0; i < sortedStates.size(); ++i) {
+      ubSum += sortedStates[i]->max_contrib_;
+      if (ubSum > theta) {
+        pivot = i;
+        break;
+      }
+    }
+    // None of the remaining documents can get into the top-K
+    if (pivot == sortedStates.size()) break;
+
+    IdType pivotDocId = sortedStates[pivot]->CurrDocId();
+    // All the lists sharing the pivot document should be considered
+    while (pivot + 1 < sortedStates.size() && sortedStates[pivot + 1]->CurrDocId() == pivotDocId) ++pivot;
+
+    if (useBlockMax) {
+      dist_t blockUbSum = 0;
+      for (size_t i = 0; i <= pivot; ++i) {
+        sortedStates[i]->ShallowAdvance(pivotDocId);
+        blockUbSum += sortedStates[i]->BlockMaxContrib();
+      }
+      if (blockUbSum <= theta) {
+        /*
+         * No document in [pivotDocId, nextDocId) can get into the top-K,
+         * b/c all such documents are covered by current blocks of lists [0, pivot].
+         * Documents preceding the pivot cannot get into the top-K either.
+         */
+        IdType nextDocId = pivot + 1 < sortedStates.size() ?
+                           sortedStates[pivot + 1]->CurrDocId() : PostListWANDState::EndDocId();
+        for (size_t i = 0; i <= pivot; ++i) {
+          IdType blockLastDocId = sortedStates[i]->BlockLastDocId();
+          if (blockLastDocId < nextDocId - 1) nextDocId = blockLastDocId + 1;
+        }
+        for (size_t i = 0; i <= pivot; ++i) {
+          sortedStates[i]->Advance(nextDocId);
+        }
+        restoreOrder(pivot);
+        continue;
+      }
+    }
+
+    if (sortedStates[0]->CurrDocId() == pivotDocId) {
+      // All lists [0, pivot] point to the pivot document, let's compute the dot product
+      dist_t accum = 0;
+      for (size_t i = 0; i <= pivot; ++i) {
+        accum += sortedStates[i]->CurrContrib();
+        sortedStates[i]->Advance(pivotDocId + 1);
+      }
+      dist_t negAccum = -accum;
+      if (tmpResQueue.size() < K) {
+        tmpResQueue.push(negAccum, pivotDocId);
+        if (tmpResQueue.size() == K) theta = -tmpResQueue.top_key();
+      } else if (tmpResQueue.top_key() > negAccum) {
+        tmpResQueue.replace_top(negAccum, pivotDocId);
+        theta = -tmpResQueue.top_key();
+      }
+      restoreOrder(pivot);
+    } else {
+      // Documents preceding the pivot cannot get into the top-K, so we skip them
+      size_t i = 0;
+      for (; i < pivot && sortedStates[i]->CurrDocId() < pivotDocId; ++i) {
+        sortedStates[i]->Advance(pivotDocId);
+      }
+      restoreOrder(i);
+    }
+  }
+
+  while (!tmpResQueue.empty()) {
+#ifdef SANITY_CHECKS
+    CHECK(tmpResQueue.top_data() >= 0);
+#endif
+    // This recomputes the distance, but it normally has a negligibly small effect on the run-time
+    query->CheckAndAddToResult(this->data_[tmpResQueue.top_data()]);
+    tmpResQueue.pop();
+  }
+}
+
+template <typename dist_t>
+void SimplInvIndex<dist_t>::SearchSAAT(KNNQuery<dist_t>* query, size_t maxPostQty) const {
+  if (impact_posts_ == nullptr) {
+    PREPARE_RUNTIME_ERR(err) << "The algorithm " << SIMPL_INV_PROC_SAAT << " requires the index to be created "
+                             << "with impactOrdered=1";
+    THROW_RUNTIME_ERR(err);
+  }
+  vector<SparseVectElem<dist_t>>    query_vect;
+  const Object* o = query->QueryObject();
+  UnpackSparseElements(o->data(), o->datalength(), query_vect);
+
+  const int_fast32_t K = query->GetK(); // the same type as FalconnHeapMod1::size()
+  if (0 == K) return;
+
+  /*
+   * Impact-ordered lists are sorted in the order of decreasing values.
+   * Hence, for negative query values, largest contributions are at the end of the list,
+   * which is traversed backwards in this case.
+   */
+  struct SAATState {
+    const PostEntry*  curr_;
+    const PostEntry*  end_;
+    ptrdiff_t         step_;
+    dist_t            qval_;
+  };
+  vector<SAATState>   queryStates;
+  // A MAX-QUEUE of contributions of the next unprocessed postings
+  FalconnHeapMod1<dist_t, int32_t>   postListQueue;
+  size_t totalQty = 0;
+
+  for (auto eQuery : query_vect) {
+    PostList pl;
+    if (FindPostList(eQuery.id_, pl)) { // There may be out-of-vocabulary words
+      CHECK(pl.qty_ > 0);
+      SAATState st;
+      st.qval_ = eQuery.val_;
+      if (eQuery.val_ >= 0) {
+        st.curr_ = pl.impact_entries_;
+        st.end_  = pl.impact_entries_ + pl.qty_;
+        st.step_ = 1;
+      } else {
+        st.curr_ = pl.impact_entries_ + pl.qty_ - 1;
+        st.end_  = pl.impact_entries_ - 1;
+        st.step_ = -1;
+      }
+      postListQueue.push(st.qval_ * st.curr_->val_, queryStates.size());
+      queryStates.push_back(st);
+      totalQty += pl.qty_;
+    }
+  }
+  if (queryStates.empty()) return;
+
+  maxPostQty = maxPostQty ? std::min(maxPostQty, totalQty) : totalQty;
+
+  /*
+   * Accumulators are kept in a dense per-thread array, which is reused across queries.
+   * Accumulators of the documents in touchedDocs are reset after the query is processed,
+   * so the cost of resetting doesn't depend on the size of the data set.
+   */
+  struct SAATAccum {
+    vector<dist_t>    accum_;
+    vector<bool>      touched_;
+    vector<IdType>    touchedDocs_;
+  };
+  static thread_local SAATAccum saatAccum;
+  vector<dist_t>& accum       = saatAccum.accum_;
+  vector<bool>&   touched     = saatAccum.touched_;
+  vector<IdType>& touchedDocs = saatAccum.touchedDocs_;
+  if (accum.size() < this->data_.size()) {
+    accum.resize(this->data_.size());
+    touched.resize(this->data_.size());
+  }
+  touchedDocs.clear();
+
+  for (size_t postQty = 0; postQty < maxPostQty; ++postQty) {
+    SAATState& st = queryStates[postListQueue.top_data()];
+    const IdType docId = st.curr_->doc_id_;
+    if (!touched[docId]) {
+      touched[docId] = true;
+      touchedDocs.push_back(docId);
+    }
+    accum[docId] += postListQueue.top_key();
+    st.curr_ += st.step_;
+    if (st.curr_ != st.end_) {
+      postListQueue.replace_top_key(st.qval_ * st.curr_->val_);
+    } else postListQueue.pop();
+  }
+
+  // The same MAX-QUEUE of negated dot products as in SearchDAAT
+  FalconnHeapMod1<dist_t, IdType>             tmpResQueue;
+  for (IdType docId : touchedDocs) {
+    dist_t negAccum = -accum[docId];
+    accum[docId] = 0;
+    touched[docId] = false;
+    if (tmpResQueue.size() < K)
+      tmpResQueue.push(negAccum, docId);
+    else if (tmpResQueue.top_key() > negAccum)
+      tmpResQueue.replace_top(negAccum, docId);
+  }
+
+  while (!tmpResQueue.empty()) {
+#ifdef SANITY_CHECKS
+    CHECK(tmpResQueue.top_data() >= 0);
+#endif
+    // Distances are recomputed, b/c accumulated values can be incomplete
+    query->CheckAndAddToResult(this->data_[tmpResQueue.top_data()]);
+    tmpResQueue.pop();
+  }
+}
+
 template <typename dist_t>
 void SimplInvIndex<dist_t>::CreateIndex(const AnyParams& IndexParams) {
   AnyParamManager pmgr(IndexParams);
@@ -147,81 +460,333 @@ void SimplInvIndex<dist_t>::CreateIndex(const AnyParams& IndexParams) {
 
 template <typename dist_t>
 void SimplInvIndex<dist_t>::CreateIndex(AnyParamManager& ParamManager) {
+  // The size of the block used to compute block-max values (Block-Max WAND)
+  ParamManager.GetParamOptional("blockSize", block_size_, 64);
+  CHECK_MSG(block_size_ > 0, "blockSize should be > 0");
+  // Should we additionally create impact-ordered posting lists (for score-at-a-time processing)?
+  ParamManager.GetParamOptional("impactOrdered", impact_ordered_, false);
+  ParamManager.GetParamOptional("indexThreadQty", index_thread_qty_, thread::hardware_concurrency());
   ParamManager.CheckUnused();
+  LOG(LIB_INFO) << "# blockSize                   = " << block_size_;
+  LOG(LIB_INFO) << "# impactOrdered               = " << impact_ordered_;
+  LOG(LIB_INFO) << "# indexThreadQty              = " << index_thread_qty_;
   // Always call ResetQueryTimeParams() to set query-time parameters to their default values
   this->ResetQueryTimeParams();
 
-  // Let's first calculate memory requirements
-  unordered_map<unsigned, size_t>   dict_qty;
-  vector<SparseVectElem<dist_t>>    tmp_vect;
-  LOG(LIB_INFO) << "Collecting dictionary stat";
+  /*
+   * Documents are split into contiguous ranges, one range per thread.
+   * The index is created in two passes. In the first pass, each thread
+   * computes term frequencies for its range. Then, these partial dictionaries
+   * are merged and each range obtains its own starting position in each
+   * posting list. Because ranges are ordered, in the second pass, each
+   * thread can fill its part of posting lists independently: document ids
+   * come out sorted without any additional merging or locking.
+   */
+  const size_t dataQty = this->data_.size();
+  const size_t rangeQty = std::max<size_t>(1, std::min<size_t>(index_thread_qty_, dataQty));
+  const size_t rangeSize = (dataQty + rangeQty - 1) / rangeQty;
+
+  // In the first pass, the values are term frequencies, in the second pass, they are current positions in post_store_
+  vector<unordered_map<unsigned, size_t>>   range_dict(rangeQty);
+  mutex                                     pbarMutex;
+  const size_t                              pbarStep = 1000;
 
+  LOG(LIB_INFO) << "Collecting dictionary stat";
   {
     unique_ptr<ProgressDisplay> pbar(printProgress_ ?
-                                     new ProgressDisplay(this->data_.size(), cerr) : nullptr);
+                                     new ProgressDisplay(dataQty, cerr) : nullptr);
+
+    ParallelFor(0, rangeQty, rangeQty, [&](size_t rangeId, size_t threadId) {
+      vector<SparseVectElem<dist_t>>    tmp_vect;
+      auto&                             dict_qty = range_dict[rangeId];
+      const size_t                      end = std::min(dataQty, (rangeId + 1) * rangeSize);
 
-    for (const Object* o : this->data_) {
-      tmp_vect.clear();
-      UnpackSparseElements(o->data(), o->datalength(), tmp_vect);
-      for (const auto& e : tmp_vect) dict_qty[e.id_] ++;
-      if (pbar) ++(*pbar);
+      for (size_t did = rangeId * rangeSize; did < end; ++did) {
+        tmp_vect.clear();
+        UnpackSparseElements(this->data_[did]->data(), this->data_[did]->datalength(), tmp_vect);
+        for (const auto& e : tmp_vect) dict_qty[e.id_] ++;
+        if (pbar && (did + 1) % pbarStep == 0) {
+          unique_lock<mutex> lock(pbarMutex);
+          (*pbar) += pbarStep;
+        }
+      }
+    });
+    if (pbar) {
+      (*pbar) += (pbar->expected_count() - pbar->count());
+      pbar->finish();
     }
-    if (pbar) pbar->finish();
   }
 
   LOG(LIB_INFO) << "Actually creating the index";
-  // post_pos is a map of positions in the postings lists? (initialized as zeros)
-  unordered_map<unsigned, size_t> post_pos;
-  // Create posting-list place holders
-  for (const auto dictEntry : dict_qty) {
-    unsigned wordId = dictEntry.first;
-    size_t   qty = dictEntry.second;
-    post_pos.insert(make_pair(wordId, 0));
-    // insert into index_ PostLists with pre-allocated number of PostEntries
-    index_.insert(make_pair(wordId, unique_ptr<PostList>(new PostList(qty))));
+  // Merge partial dictionaries and create the sorted term dictionary
+  {
+    unordered_map<unsigned, size_t>   dict_qty;
+    for (const auto& rd : range_dict) {
+      for (const auto& dictEntry : rd) dict_qty[dictEntry.first] += dictEntry.second;
+    }
+    term_store_.clear();
+    term_store_.reserve(dict_qty.size());
+    for (const auto dictEntry : dict_qty) {
+      TermEntry e;
+      memset(&e, 0, sizeof(e));
+      e.term_id_ = dictEntry.first;
+      e.post_qty_ = dictEntry.second;
+      term_store_.push_back(e);
+    }
+  }
+  sort(term_store_.begin(), term_store_.end(),
+       [](const TermEntry& e1, const TermEntry& e2) -> bool { return e1.term_id_ < e2.term_id_; });
+
+  // Assign offsets in contiguous posting and block arrays
+  size_t postQty = 0, blockQty = 0;
+  for (TermEntry& e : term_store_) {
+    e.post_offset_ = postQty;
+    e.block_offset_ = blockQty;
+    e.block_qty_ = (e.post_qty_ + block_size_ - 1) / block_size_;
+    postQty += e.post_qty_;
+    blockQty += e.block_qty_;
   }
+  post_store_.resize(postQty);
+  block_store_.resize(blockQty);
+  impact_store_.clear();
+  setStoragePointers();
+
+  // post_pos keeps the number of postings assigned to preceding document ranges
+  vector<size_t> post_pos(term_qty_);
+  for (auto& rd : range_dict) {
+    for (auto& dictEntry : rd) {
+      const TermEntry* it = std::lower_bound(terms_, terms_ + term_qty_, dictEntry.first,
+                                             [](const TermEntry& e, unsigned id) -> bool { return e.term_id_ < id; });
+      CHECK(it != terms_ + term_qty_ && it->term_id_ == dictEntry.first);
+      size_t termIndex = it - terms_;
+      size_t qty = dictEntry.second;
+      // From now on, this is the position where the range's next posting of the term goes
+      dictEntry.second = it->post_offset_ + post_pos[termIndex];
+      post_pos[termIndex] += qty;
+    }
+  }
+#ifdef SANITY_CHECKS
+  // Sanity check
+  for (size_t i = 0; i < term_qty_; ++i) {
+    CHECK(term_store_[i].post_qty_ == post_pos[i]);
+  }
+#endif
 
   {
     unique_ptr<ProgressDisplay> pbar(printProgress_ ?
-                                     new ProgressDisplay(this->data_.size(), cerr) : nullptr);
+                                     new ProgressDisplay(dataQty, cerr) : nullptr);
 
     // Fill posting lists
-    for (size_t did = 0; did < this->data_.size(); ++did) {
-      tmp_vect.clear();
-      UnpackSparseElements(this->data_[did]->data(), this->data_[did]->datalength(), tmp_vect);
-      // iterate over all terms in the document (non-zero values in the sparse vector)
-      for (const auto& e : tmp_vect) {
-        const auto wordId = e.id_;
-        // posting list for given term (the value is probably a pair [position/key, value] ?)
-        auto itPost     = index_.find(wordId);
-        // actual position in the posting list
-        auto itPostPos  = post_pos.find(wordId);
+    ParallelFor(0, rangeQty, rangeQty, [&](size_t rangeId, size_t threadId) {
+      vector<SparseVectElem<dist_t>>    tmp_vect;
+      auto&                             curr_pos = range_dict[rangeId];
+      const size_t                      end = std::min(dataQty, (rangeId + 1) * rangeSize);
+
+      for (size_t did = rangeId * rangeSize; did < end; ++did) {
+        tmp_vect.clear();
+        UnpackSparseElements(this->data_[did]->data(), this->data_[did]->datalength(), tmp_vect);
+        // iterate over all terms in the document (non-zero values in the sparse vector)
+        for (const auto& e : tmp_vect) {
+          auto it = curr_pos.find(e.id_);
   #ifdef SANITY_CHECKS
-        CHECK(itPost != index_.end());
-        CHECK(itPostPos != post_pos.end());
-        CHECK(itPost->second.get() != nullptr);
+          CHECK(it != curr_pos.end());
   #endif
-        // the actual posting list
-        PostList& pl = *itPost->second;
-        // get actual position in the list (and shift it by +1)
-        size_t curr_pos = itPostPos->second++;;
-        CHECK(curr_pos < pl.qty_);
-        pl.entries_[curr_pos] = PostEntry(did, e.val_);
+          // get actual position in the list (and shift it by +1)
+          post_store_[it->second++] = PostEntry(did, e.val_);
+        }
+        if (pbar && (did + 1) % pbarStep == 0) {
+          unique_lock<mutex> lock(pbarMutex);
+          (*pbar) += pbarStep;
+        }
       }
-      if (pbar) ++(*pbar);
+    });
+
+    if (pbar) {
+      (*pbar) += (pbar->expected_count() - pbar->count());
+      pbar->finish();
     }
+  }
+  range_dict.clear();
+
+  LOG(LIB_INFO) << "Computing block-max values";
+  ParallelFor(0, term_store_.size(), index_thread_qty_, [&](size_t termIndex, size_t threadId) {
+    computeBlockMax(term_store_[termIndex]);
+  });
 
-    if (pbar) pbar->finish();
+  if (impact_ordered_) {
+    LOG(LIB_INFO) << "Creating impact-ordered posting lists";
+    impact_store_ = post_store_;
+    ParallelFor(0, term_store_.size(), index_thread_qty_, [&](size_t termIndex, size_t threadId) {
+      const TermEntry& e = term_store_[termIndex];
+      auto start = impact_store_.begin() + e.post_offset_;
+      stable_sort(start, start + e.post_qty_,
+                  [](const PostEntry& e1, const PostEntry& e2) -> bool { return e1.val_ > e2.val_; });
+    });
   }
-#ifdef SANITY_CHECKS
-  // Sanity check
-  LOG(LIB_INFO) << "Sanity check";
-  for (const auto dictEntry : dict_qty) {
-    unsigned wordId = dictEntry.first;
-    size_t qty = dictEntry.second;
-    CHECK(qty == post_pos[wordId]);
+  setStoragePointers();
+  LOG(LIB_INFO) << "# of terms: " << term_qty_ << " # of postings: " << postQty;
+}
+
+template <typename dist_t>
+void SimplInvIndex<dist_t>::computeBlockMax(TermEntry& e) {
+  CHECK(block_size_ > 0);
+  const PostEntry* entries = &post_store_[e.post_offset_];
+  PostBlock*       blocks  = &block_store_[e.block_offset_];
+  size_t           qty = e.post_qty_;
+  if (!qty) return;
+
+  e.min_val_ = e.max_val_ = entries[0].val_;
+  for (size_t start = 0, bid = 0; start < qty; start += block_size_, ++bid) {
+    size_t end = std::min(qty, start + block_size_);
+    PostBlock b(entries[end - 1].doc_id_, entries[start].val_, entries[start].val_);
+    for (size_t i = start + 1; i < end; ++i) {
+      b.min_val_ = std::min(b.min_val_, entries[i].val_);
+      b.max_val_ = std::max(b.max_val_, entries[i].val_);
+    }
+    e.min_val_ = std::min(e.min_val_, b.min_val_);
+    e.max_val_ = std::max(e.max_val_, b.max_val_);
+    CHECK(bid < e.block_qty_);
+    blocks[bid] = b;
   }
-#endif
+}
+
+const char   SIMPL_INV_INDEX_MAGIC[] = "NMSLIBII";
+const size_t SIMPL_INV_INDEX_MAGIC_LEN = 8;
+const uint32_t SIMPL_INV_INDEX_VERSION = 1;
+
+/*
+ * The header of the binary index file. It is followed by the
+ * term dictionary, postings, blocks, and (optionally) impact-ordered postings.
+ * Each section starts at the offset that is a multiple of 8.
+ */
+struct SimplInvIndexHeader {
+  char     magic_[SIMPL_INV_INDEX_MAGIC_LEN];
+  uint32_t version_;
+  uint32_t impact_ordered_;
+  uint32_t post_entry_size_;
+  uint32_t dist_size_;
+  uint64_t data_qty_;
+  uint64_t block_size_;
+  uint64_t term_qty_;
+  uint64_t post_qty_;
+  uint64_t block_qty_;
+};
+
+inline size_t alignSectionOffset(size_t off) {
+  return (off + 7) & ~size_t(7);
+}
+
+template <typename dist_t>
+void SimplInvIndex<dist_t>::SaveIndex(const string& location) {
+  ofstream out(location, std::ios::binary);
+  CHECK_MSG(out, "Cannot open file '" + location + "' for writing");
+  out.exceptions(ios::badbit | ios::failbit);
+
+  size_t postQty = 0, blockQty = 0;
+  for (size_t i = 0; i < term_qty_; ++i) {
+    postQty += terms_[i].post_qty_;
+    blockQty += terms_[i].block_qty_;
+  }
+
+  SimplInvIndexHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic_, SIMPL_INV_INDEX_MAGIC, SIMPL_INV_INDEX_MAGIC_LEN);
+  h.version_          = SIMPL_INV_INDEX_VERSION;
+  h.impact_ordered_   = impact_posts_ != nullptr;
+  h.post_entry_size_  = sizeof(PostEntry);
+  h.dist_size_        = sizeof(dist_t);
+  h.data_qty_         = this->data_.size();
+  h.block_size_       = block_size_;
+  h.term_qty_         = term_qty_;
+  h.post_qty_         = postQty;
+  h.block_qty_        = blockQty;
+
+  size_t off = 0;
+  auto writeSection = [&out, &off](const void* p, size_t len) {
+    size_t alignedOff = alignSectionOffset(off);
+    for (; off < alignedOff; ++off) out.put(0);
+    if (len) out.write(static_cast<const char*>(p), len);
+    off += len;
+  };
+  writeSection(&h, sizeof(h));
+  writeSection(terms_, term_qty_ * sizeof(TermEntry));
+  writeSection(posts_, postQty * sizeof(PostEntry));
+  writeSection(blocks_, blockQty * sizeof(PostBlock));
+  if (impact_posts_) writeSection(impact_posts_, postQty * sizeof(PostEntry));
+  out.close();
+}
+
+template <typename dist_t>
+void SimplInvIndex<dist_t>::LoadIndex(const string& location) {
+  unique_ptr<MemMappedFile> mmapFile(new MemMappedFile(location));
+  const char* p = mmapFile->data();
+  size_t      fileSize = mmapFile->size();
+
+  SimplInvIndexHeader h;
+  CHECK_MSG(fileSize >= sizeof(h), "The index file '" + location + "' is truncated");
+  memcpy(&h, p, sizeof(h));
+  CHECK_MSG(memcmp(h.magic_, SIMPL_INV_INDEX_MAGIC, SIMPL_INV_INDEX_MAGIC_LEN) == 0,
+            "Looks like the file '" + location + "' isn't created by the method " + StrDesc());
+  CHECK_MSG(h.version_ == SIMPL_INV_INDEX_VERSION,
+            "Unsupported index version: " + ConvertToString(h.version_));
+  CHECK_MSG(h.post_entry_size_ == sizeof(PostEntry) && h.dist_size_ == sizeof(dist_t),
+            "The index file '" + location + "' was created for a different distance type");
+  CHECK_MSG(h.data_qty_ == this->data_.size(),
+            DATA_MUTATION_ERROR_MSG + " (the number of data points in the index " + ConvertToString(h.data_qty_) +
+            " doesn't match the number of loaded data points: " + ConvertToString(this->data_.size()) + ")");
+
+  CHECK_MSG(h.block_size_ > 0, "The index file '" + location + "' is corrupt: the block size is zero");
+
+  size_t off = sizeof(h);
+  // qty is validated before it is multiplied by the element size, which therefore can't overflow
+  auto getSection = [&](size_t qty, size_t elemSize) -> const char* {
+    off = alignSectionOffset(off);
+    CHECK_MSG(off <= fileSize && qty <= (fileSize - off) / elemSize,
+              "The index file '" + location + "' is truncated");
+    const char* res = p + off;
+    off += qty * elemSize;
+    return res;
+  };
+
+  const TermEntry* terms       = reinterpret_cast<const TermEntry*>(getSection(h.term_qty_, sizeof(TermEntry)));
+  const PostEntry* posts       = reinterpret_cast<const PostEntry*>(getSection(h.post_qty_, sizeof(PostEntry)));
+  const PostBlock* blocks      = reinterpret_cast<const PostBlock*>(getSection(h.block_qty_, sizeof(PostBlock)));
+  const PostEntry* impactPosts = h.impact_ordered_ ?
+                                 reinterpret_cast<const PostEntry*>(getSection(h.post_qty_, sizeof(PostEntry))) : nullptr;
+
+  // Posting lists are validated lazily (see checkPostList), but the dictionary is checked right away
+  for (size_t i = 0; i < h.term_qty_; ++i) {
+    const TermEntry& e = terms[i];
+    if ((i > 0 && terms[i - 1].term_id_ >= e.term_id_) ||
+        e.post_qty_ == 0 || // empty lists are never saved, search algorithms don't expect them
+        e.post_offset_ > h.post_qty_ || e.post_qty_ > h.post_qty_ - e.post_offset_ ||
+        e.block_offset_ > h.block_qty_ || e.block_qty_ > h.block_qty_ - e.block_offset_ ||
+        e.block_qty_ != (e.post_qty_ + h.block_size_ - 1) / h.block_size_) {
+      PREPARE_RUNTIME_ERR(err) << "The index file '" << location << "' is corrupt: invalid dictionary entry #" << i;
+      THROW_RUNTIME_ERR(err);
+    }
+  }
+
+  term_store_.clear();
+  post_store_.clear();
+  block_store_.clear();
+  impact_store_.clear();
+
+  block_size_     = h.block_size_;
+  impact_ordered_ = impactPosts != nullptr;
+  term_qty_       = h.term_qty_;
+  terms_          = terms;
+  posts_          = posts;
+  blocks_         = blocks;
+  impact_posts_   = impactPosts;
+  post_checked_.reset(new std::atomic<bool>[term_qty_]());
+  mmap_file_.reset(mmapFile.release());
+
+  // Always call ResetQueryTimeParams() to set query-time parameters to their default values
+  this->ResetQueryTimeParams();
+
+  LOG(LIB_INFO) << "Memory-mapped the index from '" << location << "' # of terms: " << term_qty_
+                << " # of postings: " << h.post_qty_;
 }
 
 template <typename dist_t>
@@ -234,11 +799,29 @@ void
 SimplInvIndex<dist_t>::SetQueryTimeParams(const AnyParams& QueryTimeParams) {
   // Check if a user specified extra parameters, which can be also misspelled variants of existing ones
   AnyParamManager pmgr(QueryTimeParams);
-  int dummy;
+  shared_ptr<SearchParams> params = make_shared<SearchParams>();
+  string inv_proc_alg;
   // Note that GetParamOptional() should always have a default value
-  pmgr.GetParamOptional("dummyParam", dummy, -1);
-  LOG(LIB_INFO) << "Set dummy = " << dummy;
+  pmgr.GetParamOptional("invProcAlg", inv_proc_alg, SIMPL_INV_PROC_DAAT);
+
+  if (inv_proc_alg == SIMPL_INV_PROC_DAAT) {
+    params->inv_proc_alg_ = kDAAT;
+  } else if (inv_proc_alg == SIMPL_INV_PROC_WAND) {
+    params->inv_proc_alg_ = kWAND;
+  } else if (inv_proc_alg == SIMPL_INV_PROC_BMW) {
+    params->inv_proc_alg_ = kBMW;
+  } else if (inv_proc_alg == SIMPL_INV_PROC_SAAT) {
+    params->inv_proc_alg_ = kSAAT;
+  } else {
+    PREPARE_RUNTIME_ERR(err) << "Unknown value of parameter for the inverted file processing algorithm: " << inv_proc_alg;
+    THROW_RUNTIME_ERR(err);
+  }
+  // The maximum number of postings processed by score-at-a-time algorithm (0 means no limit)
+  pmgr.GetParamOptional("saatPostQty", params->saat_post_qty_, 0);
   pmgr.CheckUnused();
+  atomic_store(&query_time_params_, shared_ptr<const SearchParams>(params));
+  LOG(LIB_INFO) << "invProcAlg (code)             = " << params->inv_proc_alg_ << "(" << toString(params->inv_proc_alg_) << ")";
+  LOG(LIB_INFO) << "# saatPostQty                 = " << params->saat_post_qty_;
 }
 
 
@@ -114,7 +114,8 @@ template <typename dist_t>
 SmallWorldRand<dist_t>::SmallWorldRand(bool PrintProgress,
                                        const Space<dist_t>& space,
                                        const ObjectVector& data) : 
-                                       Index<dist_t>(data), space_(space), PrintProgress_(PrintProgress), use_proxy_dist_(false) {}
+                                       Index<dist_t>(data), space_(space), PrintProgress_(PrintProgress), use_proxy_dist_(false),
+                                       queryTimeParams_(std::make_shared<SearchParams>()) {}
 
 template <typename dist_t>
 void SmallWorldRand<dist_t>::UpdateNextNodeId(size_t newNextNodeId)
@@ -180,7 +181,6 @@ void SmallWorldRand<dist_t>::AddBatch(const ObjectVector& batchData,
       if (progress_bar) ++(*progress_bar);
     }
   } else {
-    vector<thread>                                    threads(indexThreadQty_);
     vector<shared_ptr<IndexThreadParamsSW<dist_t>>>   threadParams; 
     mutex                                             progressBarMutex;
 
@@ -191,12 +191,9 @@ void SmallWorldRand<dist_t>::AddBatch(const ObjectVector& batchData,
                                                               i, indexThreadQty_,
                                                               progress_bar.get(), progressBarMutex, 200)));
     }
-    for (size_t i = 0; i < indexThreadQty_; ++i) {
-      threads[i] = thread(IndexThreadSW<dist_t>(), ref(*threadParams[i]));
-    }
-    for (size_t i = 0; i < indexThreadQty_; ++i) {
-      threads[i].join();
-    }
+    ParallelFor(0, indexThreadQty_, indexThreadQty_, [&](size_t i, size_t threadId) {
+      IndexThreadSW<dist_t>()(*threadParams[i]);
+    });
     LOG(LIB_INFO) << indexThreadQty_ << " indexing threads have finished";
   }
   UpdateNextNodeId(futureNextNodeId);
@@ -259,37 +256,18 @@ void SmallWorldRand<dist_t>::DeleteBatch(const vector<IdType>& batchData, int de
   CHECK_MSG(patchStrat == kNone || patchStrat == kNeighborsOnly,
             "Unsupported patching strategy code: " + ConvertToString(delStrategyCode));
 
-  queue<MSWNode*> toPatchQueue;
-  for (MSWNode* node : vToPatchNodes) toPatchQueue.push(node);
-  mutex mtx;
-  vector<thread> threads;
+  // Same as in AddBatch: indexThreadQty_ <= 1 means that nodes are patched in a single thread
+  size_t threadQty = max<size_t>(1, indexThreadQty_);
+  LOG(LIB_INFO) << "Patching nodes using " << threadQty << " thread(s): " << vToPatchNodes.size();
+  // Each thread has its own cache
+  vector<vector<MSWNode*>> cacheDelNodes(threadQty);
 
-  if (indexThreadQty_ <= 1) {
-    LOG(LIB_INFO) << "Single threaded batch delete: " << vToPatchNodes.size();
-    MSWNode* node = nullptr;
-    vector<MSWNode*> cacheDelNode;
-    while(GetNextQueueObj(mtx, toPatchQueue, node)) {
-      if (kNone == patchStrat) node->removeGivenFriends(delNodesBitset);
-      else node->removeGivenFriendsPatchWithClosestNeighbor<dist_t>(space_, use_proxy_dist_,
-                                                                    delNodesBitset, cacheDelNode);
-    }
-
-  } else {
-    for (size_t i = 0; i < indexThreadQty_; ++i) {
-      threads.push_back(thread(
-        [&]() {
-          MSWNode* node = nullptr;
-          vector<MSWNode*> cacheDelNode;
-          while(GetNextQueueObj(mtx, toPatchQueue, node)) {
-            if (kNone == patchStrat) node->removeGivenFriends(delNodesBitset);
-            else node->removeGivenFriendsPatchWithClosestNeighbor<dist_t>(space_, use_proxy_dist_,
-                                                                          delNodesBitset, cacheDelNode);
-          }
-        }
-      ));
-    }
-    for (auto& thread : threads) thread.join();
-  }
+  ParallelFor(0, vToPatchNodes.size(), threadQty, [&](size_t i, size_t threadId) {
+    MSWNode* node = vToPatchNodes[i];
+    if (kNone == patchStrat) node->removeGivenFriends(delNodesBitset);
+    else node->removeGivenFriendsPatchWithClosestNeighbor<dist_t>(space_, use_proxy_dist_,
+                                                                  delNodesBitset, cacheDelNodes[threadId]);
+  });
 
   if (checkIDs) {
     for (auto it : ElList_) {
@@ -369,7 +347,6 @@ void SmallWorldRand<dist_t>::InitParamsManually(const AnyParams& IndexParams)
 
   pmgr.GetParamOptional("NN",                 NN_,                  10);
   pmgr.GetParamOptional("efConstruction",     efConstruction_,      NN_);
-  efSearch_ = NN_;
   pmgr.GetParamOptional("indexThreadQty",     indexThreadQty_,      thread::hardware_concurrency());
   pmgr.GetParamOptional("useProxyDist",       use_proxy_dist_,      false);
 
@@ -379,6 +356,9 @@ void SmallWorldRand<dist_t>::InitParamsManually(const AnyParams& IndexParams)
   LOG(LIB_INFO) << "useProxyDist        = " << use_proxy_dist_;
 
   pmgr.CheckUnused();
+
+  // The default efSearch depends on NN
+  SetQueryTimeParams(getEmptyParams());
 }
 
 
@@ -389,7 +369,6 @@ void SmallWorldRand<dist_t>::CreateIndex(const AnyParams& IndexParams)
 
   pmgr.GetParamOptional("NN",                 NN_,                  10);
   pmgr.GetParamOptional("efConstruction",     efConstruction_,      NN_);
-  efSearch_ = NN_;
   pmgr.GetParamOptional("indexThreadQty",     indexThreadQty_,      thread::hardware_concurrency());
   pmgr.GetParamOptional("useProxyDist",       use_proxy_dist_,      false);
 
@@ -411,20 +390,28 @@ template <typename dist_t>
 void 
 SmallWorldRand<dist_t>::SetQueryTimeParams(const AnyParams& QueryTimeParams) {
   AnyParamManager pmgr(QueryTimeParams);
-  pmgr.GetParamOptional("efSearch", efSearch_, NN_);
+  std::shared_ptr<SearchParams> params = std::make_shared<SearchParams>();
+  pmgr.GetParamOptional("efSearch", params->efSearch, NN_);
+  string efByK;
+  pmgr.GetParamOptional(EF_BY_K_PARAM, efByK, "");
+  params->efSchedule.Parse(efByK);
   string tmp;
   //pmgr.GetParamOptional("algoType", tmp, "v1merge");
   pmgr.GetParamOptional("algoType", tmp, "old");
   ToLower(tmp);
-  if (tmp == "v1merge") searchAlgoType_ = kV1Merge;
-  else if (tmp == "old") searchAlgoType_ = kOld;
+  if (tmp == "v1merge") params->searchAlgoType = kV1Merge;
+  else if (tmp == "old") params->searchAlgoType = kOld;
   else {
     throw runtime_error("algoType should be one of the following: old, v1merge");
   }
   pmgr.CheckUnused();
+  std::atomic_store(&queryTimeParams_, std::shared_ptr<const SearchParams>(params));
   LOG(LIB_INFO) << "Set SmallWorldRand query-time parameters:";
-  LOG(LIB_INFO) << "efSearch           =" << efSearch_;
-  LOG(LIB_INFO) << "algoType           =" << searchAlgoType_;
+  LOG(LIB_INFO) << "efSearch           =" << params->efSearch;
+  if (!params->efSchedule.Empty()) {
+    LOG(LIB_INFO) << "efSearch by k      =" << params->efSchedule.ToString();
+  }
+  LOG(LIB_INFO) << "algoType           =" << params->searchAlgoType;
 }
 
 template <typename dist_t>
@@ -605,14 +592,17 @@ void SmallWorldRand<dist_t>::Search(RangeQuery<dist_t>* query, IdType) const {
 
 template <typename dist_t>
 void SmallWorldRand<dist_t>::Search(KNNQuery<dist_t>* query, IdType) const {
-  if (searchAlgoType_ == kV1Merge) SearchV1Merge(query);
-  else SearchOld(query);
+  // The snapshot of parameters is obtained once: it can be replaced during the search
+  const std::shared_ptr<const SearchParams> params = std::atomic_load(&queryTimeParams_);
+  const size_t efSearch = params->efSchedule.GetEf(query->GetK(), params->efSearch);
+  if (params->searchAlgoType == kV1Merge) SearchV1Merge(query, efSearch);
+  else SearchOld(query, efSearch);
 }
 
 template <typename dist_t>
-void SmallWorldRand<dist_t>::SearchV1Merge(KNNQuery<dist_t>* query) const {
+void SmallWorldRand<dist_t>::SearchV1Merge(KNNQuery<dist_t>* query, size_t efSearch) const {
   if (ElList_.empty()) return;
-  CHECK_MSG(efSearch_ > 0, "efSearch should be > 0");
+  CHECK_MSG(efSearch > 0, "efSearch should be > 0");
 /*
  * The trick of using large dense bitsets instead of unordered_set was
  * borrowed from Wei Dong's kgraph: https://github.com/aaalgo/kgraph
@@ -630,7 +620,7 @@ void SmallWorldRand<dist_t>::SearchV1Merge(KNNQuery<dist_t>* query) const {
   MSWNode* currNode = pEntryPoint_;
   CHECK_MSG(currNode != nullptr, "Bug: there is not entry point set!")
 
-  SortArrBI<dist_t,MSWNode*> sortedArr(max<size_t>(efSearch_, query->GetK()));
+  SortArrBI<dist_t,MSWNode*> sortedArr(max<size_t>(efSearch, query->GetK()));
 
   const Object* currObj = currNode->getData();
   dist_t d = query->DistanceObjLeft(currObj);
@@ -647,10 +637,13 @@ void SmallWorldRand<dist_t>::SearchV1Merge(KNNQuery<dist_t>* query) const {
 
   vector<QueueItem>& queueData = sortedArr.get_data();
   vector<QueueItem>  itemBuff(8*NN_);
+  vector<MSWNode*>      batchNodes(itemBuff.size());
+  vector<const Object*> batchObjs(itemBuff.size());
+  vector<dist_t>        batchDists(itemBuff.size());
 
-  // efSearch_ is always <= # of elements in the queueData.size() (the size of the BUFFER), but it can be
+  // efSearch is always <= # of elements in the queueData.size() (the size of the BUFFER), but it can be
   // larger than sortedArr.size(), which returns the number of actual elements in the buffer
-  while(currElem < min(sortedArr.size(),efSearch_)){
+  while(currElem < min(sortedArr.size(),efSearch)){
     auto& e = queueData[currElem];
     CHECK(!e.used);
     e.used = true;
@@ -664,24 +657,34 @@ void SmallWorldRand<dist_t>::SearchV1Merge(KNNQuery<dist_t>* query) const {
       PREFETCH(const_cast<const char*>(neighbor->getData()->data()), _MM_HINT_T0);
     }
 
-    if (currNode->getAllFriends().size() > itemBuff.size())
+    if (currNode->getAllFriends().size() > itemBuff.size()) {
       itemBuff.resize(currNode->getAllFriends().size());
+      batchNodes.resize(itemBuff.size());
+      batchObjs.resize(itemBuff.size());
+      batchDists.resize(itemBuff.size());
+    }
 
     size_t itemQty = 0;
+    size_t batchQty = 0;
 
     dist_t topKey = sortedArr.top_key();
-    //calculate distance to each neighbor
+    // Unvisited neighbors are collected to compute all distances in one call
     for (MSWNode* neighbor : currNode->getAllFriends()) {
       nodeId = neighbor->getId();
       CHECK_MSG(nodeId < NextNodeId_, "Bug: nodeId (" + ConvertToString(nodeId) +  ") > NextNodeId_ (" +ConvertToString(NextNodeId_));
 
       if (!visitedBitset[nodeId]) {
-        currObj = neighbor->getData();
-        d = query->DistanceObjLeft(currObj);
         visitedBitset[nodeId] = true;
-        if (sortedArr.size() < efSearch_ || d < topKey) {
-          itemBuff[itemQty++]=QueueItem(d, neighbor);
-        }
+        batchNodes[batchQty] = neighbor;
+        batchObjs[batchQty++] = neighbor->getData();
+      }
+    }
+    // Objects farther than the worst queue element are discarded
+    query->DistanceObjLeftBatch(&batchObjs[0], batchQty,
+                                sortedArr.size() < efSearch ? DistMax<dist_t>() : topKey, &batchDists[0]);
+    for (size_t i = 0; i < batchQty; ++i) {
+      if (sortedArr.size() < efSearch || batchDists[i] < topKey) {
+        itemBuff[itemQty++]=QueueItem(batchDists[i], batchNodes[i]);
       }
     }
 
@@ -719,10 +722,10 @@ void SmallWorldRand<dist_t>::SearchV1Merge(KNNQuery<dist_t>* query) const {
 
 
 template <typename dist_t>
-void SmallWorldRand<dist_t>::SearchOld(KNNQuery<dist_t>* query) const {
+void SmallWorldRand<dist_t>::SearchOld(KNNQuery<dist_t>* query, size_t efSearch) const {
 
   if (ElList_.empty()) return;
-  CHECK_MSG(efSearch_ > 0, "efSearch should be > 0");
+  CHECK_MSG(efSearch > 0, "efSearch should be > 0");
 /*
  * The trick of using large dense bitsets instead of unordered_set was
  * borrowed from Wei Dong's kgraph: https://github.com/aaalgo/kgraph
@@ -740,6 +743,10 @@ void SmallWorldRand<dist_t>::SearchOld(KNNQuery<dist_t>* query) const {
   priority_queue <dist_t>                          closestDistQueue; //The set of all elements which distance was calculated
   priority_queue <EvaluatedMSWNodeReverse<dist_t>> candidateQueue; //the set of elements which we can use to evaluate
 
+  vector<MSWNode*>      batchNodes;
+  vector<const Object*> batchObjs;
+  vector<dist_t>        batchDists;
+
   const Object* currObj = provider->getData();
   dist_t d = query->DistanceObjLeft(currObj);
   query->CheckAndAddToResult(d, currObj); // This should be done before the object goes to the queue: otherwise it will not be compared to the query at all!
@@ -774,26 +781,41 @@ void SmallWorldRand<dist_t>::SearchOld(KNNQuery<dist_t>* query) const {
     // Can't access curEv anymore! The reference would become invalid
     candidateQueue.pop();
 
-    //calculate distance to each neighbor
+    // Unvisited neighbors are collected to compute all distances in one call
+    batchNodes.clear();
+    batchObjs.clear();
     for (auto iter = neighbor.begin(); iter != neighbor.end(); ++iter){
       nodeId = (*iter)->getId();
       CHECK_MSG(nodeId < NextNodeId_, "Bug: nodeId (" + ConvertToString(nodeId) +  ") > NextNodeId_ (" +ConvertToString(NextNodeId_));
       if (!visitedBitset[nodeId]) {
-        currObj = (*iter)->getData();
-        d = query->DistanceObjLeft(currObj);
         visitedBitset[nodeId] = true;
-
-        if (closestDistQueue.size() < efSearch_ || d < closestDistQueue.top()) {
-          closestDistQueue.emplace(d);
-          if (closestDistQueue.size() > efSearch_) {
-            closestDistQueue.pop();
-          }
-
-          candidateQueue.emplace(d, *iter);
+        batchNodes.push_back(*iter);
+        batchObjs.push_back((*iter)->getData());
+      }
+    }
+    /*
+     * If the distance is larger than both the largest distance in the queue
+     * and the result bound, the object is discarded: its exact distance isn't needed.
+     * Both values only decrease while the batch is processed.
+     */
+    dist_t bound = closestDistQueue.size() < efSearch ? 
+                   DistMax<dist_t>() : max(closestDistQueue.top(), query->ResultBound());
+    batchDists.resize(batchObjs.size());
+    query->DistanceObjLeftBatch(batchObjs.data(), batchObjs.size(), bound, batchDists.data());
+
+    for (size_t i = 0; i < batchObjs.size(); ++i) {
+      d = batchDists[i];
+
+      if (closestDistQueue.size() < efSearch || d < closestDistQueue.top()) {
+        closestDistQueue.emplace(d);
+        if (closestDistQueue.size() > efSearch) {
+          closestDistQueue.pop();
         }
 
-        query->CheckAndAddToResult(d, currObj);
+        candidateQueue.emplace(d, batchNodes[i]);
       }
+
+      query->CheckAndAddToResult(d, batchObjs[i]);
     }
   }
 }
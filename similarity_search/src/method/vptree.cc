@@ -255,11 +255,11 @@ void VPTree<dist_t, SearchOracle>::VPNode::GenericSearch(QueryType* query,
       PREFETCH(CacheOptimizedBucket_, _MM_HINT_T0);
     }
 
-    for (unsigned i = 0; i < bucket_->size(); ++i) {
-      const Object* Obj = (*bucket_)[i];
-      dist_t distQC = query->DistanceObjLeft(Obj);
-      query->CheckAndAddToResult(distQC, Obj);
-    }
+    /*
+     * Distances to bucket objects aren't used for pruning: they can be bounded by the result radius
+     * and computed in batches.
+     */
+    query->CheckAndAddToResult(*bucket_);
     return;
   }
 
@@ -0,0 +1,83 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+
+#include "mmap_file.h"
+#include "logging.h"
+
+#if defined(_WIN32) || defined(WIN32)
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace similarity {
+
+#if defined(_WIN32) || defined(WIN32)
+
+MemMappedFile::MemMappedFile(const string& fileName) : fileName_(fileName), data_(nullptr), size_(0) {
+  std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+  CHECK_MSG(in, "Cannot open file '" + fileName + "' for reading");
+  in.exceptions(std::ios::badbit | std::ios::failbit);
+  size_ = static_cast<size_t>(in.tellg());
+  in.seekg(0);
+  buf_.resize(size_);
+  if (size_) in.read(&buf_[0], size_);
+  data_ = buf_.empty() ? nullptr : &buf_[0];
+}
+
+MemMappedFile::~MemMappedFile() {}
+
+#else
+
+MemMappedFile::MemMappedFile(const string& fileName) : fileName_(fileName), data_(nullptr), size_(0) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    PREPARE_RUNTIME_ERR(err) << "Cannot open file '" << fileName << "' for reading: " << strerror(errno);
+    THROW_RUNTIME_ERR(err);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int errCode = errno;
+    close(fd);
+    PREPARE_RUNTIME_ERR(err) << "Cannot obtain the size of file '" << fileName << "': " << strerror(errCode);
+    THROW_RUNTIME_ERR(err);
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_) {
+    void* p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      int errCode = errno;
+      close(fd);
+      PREPARE_RUNTIME_ERR(err) << "Cannot memory-map file '" << fileName << "': " << strerror(errCode);
+      THROW_RUNTIME_ERR(err);
+    }
+    data_ = static_cast<const char*>(p);
+  }
+  // The mapping remains valid after the descriptor is closed
+  close(fd);
+}
+
+MemMappedFile::~MemMappedFile() {
+  if (data_) munmap(const_cast<char*>(data_), size_);
+}
+
+#endif
+
+}   // namespace similarity
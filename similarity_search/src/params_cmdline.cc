@@ -40,6 +40,9 @@ void ParseCommandLine(int argc, char* argv[], bool& bPrintProgress,
                       string&                 SpaceType,
                       shared_ptr<AnyParams>&  SpaceParams,
                       unsigned&               ThreadTestQty,
+                      unsigned&               PoolThreadQty,
+                      bool&                   PinThreads,
+                      vector<double>&         LoadQPS,
                       bool&                   AppendToResFile,
                       string&                 ResFilePrefix,
                       unsigned&               TestSetQty,
@@ -57,6 +60,7 @@ void ParseCommandLine(int argc, char* argv[], bool& bPrintProgress,
                       shared_ptr<AnyParams>&          IndexTimeParams,
                       vector<shared_ptr<AnyParams>>&  QueryTimeParams) {
   knn.clear();
+  LoadQPS.clear();
   RangeArg.clear();
   QueryTimeParams.clear();
 
@@ -64,6 +68,7 @@ void ParseCommandLine(int argc, char* argv[], bool& bPrintProgress,
   vector<string>  vQueryTimeParamStr;
   string          spaceParamStr;
   string          knnArg;
+  string          loadQPSArg;
   // Conversion to double is due to an Intel's bug with __builtin_signbit being undefined for float
   double          epsTmp;
 
@@ -113,6 +118,12 @@ void ParseCommandLine(int argc, char* argv[], bool& bPrintProgress,
                                &MethodName, false));
   cmd_options.Add(new CmdParam(THREAD_TEST_QTY_PARAM_OPT, THREAD_TEST_QTY_PARAM_MSG,
                                &ThreadTestQty, false, THREAD_TEST_QTY_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(POOL_THREAD_QTY_PARAM_OPT, POOL_THREAD_QTY_PARAM_MSG,
+                               &PoolThreadQty, false, POOL_THREAD_QTY_PARAM_DEFAULT));
+  cmd_options.Add(new CmdParam(PIN_THREADS_PARAM_OPT, PIN_THREADS_PARAM_MSG,
+                               &PinThreads, false));
+  cmd_options.Add(new CmdParam(LOAD_QPS_PARAM_OPT, LOAD_QPS_PARAM_MSG,
+                               &loadQPSArg, false));
   cmd_options.Add(new CmdParam(OUT_FILE_PREFIX_PARAM_OPT, OUT_FILE_PREFIX_PARAM_MSG,
                                &ResFilePrefix, false, OUT_FILE_PREFIX_PARAM_DEFAULT));
   cmd_options.Add(new CmdParam(APPEND_TO_RES_FILE_PARAM_OPT, APPEND_TO_RES_FILE_PARAM_MSG,
@@ -171,6 +182,13 @@ void ParseCommandLine(int argc, char* argv[], bool& bPrintProgress,
       LOG(LIB_FATAL) << "Wrong format of the KNN argument: '" << knnArg;
     }
 
+    if (!loadQPSArg.empty() && !SplitStr(loadQPSArg, LoadQPS, ',')) {
+      LOG(LIB_FATAL) << "Wrong format of the load QPS argument: '" << loadQPSArg;
+    }
+    for (double qps : LoadQPS) {
+      CHECK_MSG(qps > 0, "Query arrival rates should be positive");
+    }
+
     if (DataFile.empty()) {
       LOG(LIB_FATAL) << "data file is not specified!";
     }
@@ -26,6 +26,7 @@ template <typename dist_t>
 Query<dist_t>::Query(const Space<dist_t>& space, const Object* query_object)
     : space_(space),
       query_object_(query_object),
+      query_state_(space.CreateQueryState(query_object)),
       distance_computations_(0) {
 }
 
@@ -58,7 +59,35 @@ dist_t Query<dist_t>::Distance(
 
 template <typename dist_t>
 dist_t Query<dist_t>::DistanceObjLeft(const Object* object) const {
-  return Distance(object, query_object_);
+  ++distance_computations_;
+  return space_.HiddenDistanceQuery(object, query_object_, query_state_.get(), DistMax<dist_t>());
+}
+
+template <typename dist_t>
+dist_t Query<dist_t>::DistanceObjLeftBounded(const Object* object, dist_t bound) const {
+  ++distance_computations_;
+  return space_.HiddenDistanceQuery(object, query_object_, query_state_.get(), bound);
+}
+
+template <typename dist_t>
+void Query<dist_t>::DistanceObjLeftBatch(const Object* const* ppObj, size_t qty,
+                                         dist_t bound, dist_t* pDist) const {
+  distance_computations_ += qty;
+  space_.HiddenDistanceBatch(query_object_, query_state_.get(), ppObj, qty, bound, pDist);
+}
+
+template <typename dist_t>
+size_t Query<dist_t>::CheckAndAddToResultBatch(const Object* const* ppObj, size_t qty) {
+  dist_t dists[QUERY_BATCH_QTY];
+  size_t res = 0;
+  for (size_t start = 0; start < qty; start += QUERY_BATCH_QTY) {
+    size_t batchQty = std::min(qty - start, QUERY_BATCH_QTY);
+    DistanceObjLeftBatch(ppObj + start, batchQty, ResultBound(), dists);
+    for (size_t i = 0; i < batchQty; ++i) {
+      if (CheckAndAddToResult(dists[i], ppObj[start + i])) ++res;
+    }
+  }
+  return res;
 }
 
 template <typename dist_t>
@@ -12,6 +12,9 @@
  * Apache License Version 2.0 http://www.apache.org/licenses/.
  *
  */
+#include <utility>
+#include <cstdint>
+
 #include <space.h>
 #include <query.h>
 
@@ -19,6 +22,8 @@ namespace similarity {
 
 using std::vector;
 using std::string;
+using std::pair;
+using std::make_pair;
 
 template <typename dist_t>
 unique_ptr<DataFileInputState> Space<dist_t>::ReadDataset(ObjectVector& dataset,
@@ -104,6 +109,63 @@ void Space<dist_t>::WriteObjectVectorBinData(const ObjectVector& data,
   output.close();
 }
 
+template <typename dist_t>
+unique_ptr<MemMappedFile> Space<dist_t>::MapObjectVectorFromBinData(ObjectVector& dataset,
+                                                                    const std::string& fileName,
+                                                                    const IdTypeUnsign maxQty) const {
+  unique_ptr<MemMappedFile> file(new MemMappedFile(fileName));
+  const char* p = file->data();
+  const char* pEnd = p + file->size();
+  size_t qty;
+  size_t objSize;
+
+  CHECK_MSG(file->size() >= sizeof qty, "The file '" + fileName + "' is too short");
+  memcpy(&qty, p, sizeof qty);
+  p += sizeof qty;
+
+  qty = std::min(qty, size_t(maxQty));
+  // Objects are created only after the whole file is validated
+  vector<pair<const char*, size_t>> vObjs;
+  vObjs.reserve(qty);
+  for (size_t i = 0; i < qty; ++i) {
+    if (size_t(pEnd - p) < sizeof objSize) {
+      PREPARE_RUNTIME_ERR(err) << "The file '" << fileName << "' is truncated, object #" << i;
+      THROW_RUNTIME_ERR(err);
+    }
+    memcpy(&objSize, p, sizeof objSize);
+    p += sizeof objSize;
+    size_t dataLen = 0;
+    if (size_t(pEnd - p) >= ID_SIZE + LABEL_SIZE + DATALENGTH_SIZE) {
+      memcpy(&dataLen, p + ID_SIZE + LABEL_SIZE, DATALENGTH_SIZE);
+    }
+    if (size_t(pEnd - p) < objSize || objSize != ID_SIZE + LABEL_SIZE + DATALENGTH_SIZE + dataLen) {
+      PREPARE_RUNTIME_ERR(err) << "The file '" << fileName << "' is truncated or corrupt, object #" << i;
+      THROW_RUNTIME_ERR(err);
+    }
+    vObjs.push_back(make_pair(p, objSize));
+    p += objSize;
+  }
+
+  dataset.reserve(dataset.size() + qty);
+  size_t copyQty = 0;
+  for (const auto& obj : vObjs) {
+    if (reinterpret_cast<uintptr_t>(obj.first) % 8 == 0) {
+      // The object neither modifies nor owns the buffer
+      dataset.push_back(new Object(const_cast<char*>(obj.first)));
+    } else {
+      // The object data would be unaligned, so the object is copied (new[] returns aligned memory)
+      char* buf = new char[obj.second];
+      memcpy(buf, obj.first, obj.second);
+      dataset.push_back(new Object(buf, true));
+      ++copyQty;
+    }
+  }
+  if (copyQty) {
+    LOG(LIB_INFO) << "Copied " << copyQty << " unaligned objects out of " << vObjs.size() << " memory-mapped ones";
+  }
+
+  return file;
+}
 
 template class Space<int>;
 template class Space<float>;
@@ -124,6 +186,17 @@ void DummyPivotIndex<dist_t>::ComputePivotDistancesQueryTime(const Query<dist_t>
 template <class dist_t>
 DummyPivotIndex<dist_t>::~DummyPivotIndex() {}
 
+template <class dist_t>
+void PivotIndex<dist_t>::ComputePivotDistancesIndexTimeBatch(const Object* const* ppObj, size_t qty,
+                                                             vector<dist_t>& vResDist) const {
+  vector<dist_t> vDist;
+  vResDist.clear();
+  for (size_t i = 0; i < qty; ++i) {
+    ComputePivotDistancesIndexTime(ppObj[i], vDist);
+    vResDist.insert(vResDist.end(), vDist.begin(), vDist.end());
+  }
+}
+
 template <class dist_t>
 PivotIndex<dist_t>::~PivotIndex() {}
 
@@ -13,6 +13,7 @@
  *
  */
 #include <cmath>
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <sstream>
@@ -20,9 +21,62 @@
 #include "space/space_lp.h"
 #include "logging.h"
 #include "experimentconf.h"
+#include "query.h"
 
 namespace similarity {
 
+// A tile of pivots should fit into (roughly) a half of the L2 cache
+const size_t LP_PIVOT_BLOCK_BYTES = 128 * 1024;
+const size_t LP_OBJ_BLOCK_QTY     = 8;
+
+template <typename dist_t>
+SpaceLpPivotIndex<dist_t>::SpaceLpPivotIndex(const ObjectVector& pivots, const SpaceLpDist<dist_t>& distObj) :
+    pivots_(pivots), distObj_(distObj), dim_(0) {
+  if (!pivots_.empty()) {
+    dim_ = pivots_[0]->datalength() / sizeof(dist_t);
+  }
+  pivotData_.resize(dim_ * pivots_.size());
+  for (size_t i = 0; i < pivots_.size(); ++i) {
+    CHECK_MSG(pivots_[i]->datalength() == dim_ * sizeof(dist_t), "All pivots should have the same dimensionality!");
+    memcpy(&pivotData_[i * dim_], pivots_[i]->data(), dim_ * sizeof(dist_t));
+  }
+  pivotBlockQty_ = std::max<size_t>(1, LP_PIVOT_BLOCK_BYTES / std::max<size_t>(1, dim_ * sizeof(dist_t)));
+}
+
+template <typename dist_t>
+void SpaceLpPivotIndex<dist_t>::ComputePivotDistancesQueryTime(const Query<dist_t>* pQuery,
+                                                               vector<dist_t>& vResDist) const {
+  vResDist.resize(pivots_.size());
+  for (size_t i = 0; i < pivots_.size(); ++i) vResDist[i] = pQuery->DistanceObjLeft(pivots_[i]);
+}
+
+template <typename dist_t>
+void SpaceLpPivotIndex<dist_t>::ComputePivotDistancesIndexTimeBatch(const Object* const* ppObj, size_t qty,
+                                                                    vector<dist_t>& vResDist) const {
+  const size_t pivotQty = pivots_.size();
+  vResDist.resize(qty * pivotQty);
+
+  for (size_t i = 0; i < qty; ++i) {
+    CHECK_MSG(ppObj[i]->datalength() == dim_ * sizeof(dist_t), "Object and pivot dimensionalities don't match!");
+  }
+  // Pivot is a left argument (the same way as in DummyPivotIndex)
+  for (size_t pivStart = 0; pivStart < pivotQty; pivStart += pivotBlockQty_) {
+    const size_t pivEnd = std::min(pivotQty, pivStart + pivotBlockQty_);
+    for (size_t objStart = 0; objStart < qty; objStart += LP_OBJ_BLOCK_QTY) {
+      const size_t objEnd = std::min(qty, objStart + LP_OBJ_BLOCK_QTY);
+      for (size_t pivId = pivStart; pivId < pivEnd; ++pivId) {
+        const dist_t* pPiv = &pivotData_[pivId * dim_];
+        for (size_t objId = objStart; objId < objEnd; ++objId) {
+          const dist_t* pObj = reinterpret_cast<const dist_t*>(ppObj[objId]->data());
+          vResDist[objId * pivotQty + pivId] = distObj_(pPiv, pObj, dim_);
+        }
+      }
+    }
+  }
+}
+
+template class SpaceLpPivotIndex<float>;
+
 template <typename dist_t>
 dist_t SpaceLp<dist_t>::HiddenDistance(const Object* obj1, const Object* obj2) const {
   CHECK(obj1->datalength() > 0);
@@ -34,6 +88,48 @@ dist_t SpaceLp<dist_t>::HiddenDistance(const Object* obj1, const Object* obj2) c
   return distObj_(x, y, length);
 }
 
+template <typename dist_t>
+dist_t SpaceLp<dist_t>::HiddenDistanceBounded(const Object* obj1, const Object* obj2, dist_t bound) const {
+  CHECK(obj1->datalength() > 0);
+  CHECK(obj1->datalength() == obj2->datalength());
+  const dist_t* x = reinterpret_cast<const dist_t*>(obj1->data());
+  const dist_t* y = reinterpret_cast<const dist_t*>(obj2->data());
+  const size_t length = obj1->datalength() / sizeof(dist_t);
+
+  return distObj_(x, y, length, bound);
+}
+
+/*
+ * Long vectors are compared one by one, because the early termination
+ * (see HiddenDistanceBounded) is more useful for them than the interleaving.
+ */
+const size_t LP_BATCH_MAX_INTERLEAVED_DIM = 128;
+// The number of vector pointers collected on the stack before computing distances
+const size_t LP_BATCH_CHUNK_QTY = 64;
+
+template <typename dist_t>
+void SpaceLp<dist_t>::HiddenDistanceBatch(const Object* pQuery, const QueryState* pState,
+                                          const Object* const* ppObj, size_t qty,
+                                          dist_t bound, dist_t* pDist) const {
+  const size_t length = pQuery->datalength() / sizeof(dist_t);
+  if (bound < DistMax<dist_t>() && length > LP_BATCH_MAX_INTERLEAVED_DIM) {
+    for (size_t i = 0; i < qty; ++i) {
+      pDist[i] = HiddenDistanceBounded(ppObj[i], pQuery, bound);
+    }
+    return;
+  }
+  const dist_t* pQueryVect = reinterpret_cast<const dist_t*>(pQuery->data());
+  const dist_t* vects[LP_BATCH_CHUNK_QTY];
+  for (size_t start = 0; start < qty; start += LP_BATCH_CHUNK_QTY) {
+    const size_t chunkQty = std::min(qty - start, LP_BATCH_CHUNK_QTY);
+    for (size_t i = 0; i < chunkQty; ++i) {
+      CHECK(ppObj[start + i]->datalength() == pQuery->datalength());
+      vects[i] = reinterpret_cast<const dist_t*>(ppObj[start + i]->data());
+    }
+    distObj_(pQueryVect, vects, chunkQty, length, pDist + start);
+  }
+}
+
 template <typename dist_t>
 std::string SpaceLp<dist_t>::StrDesc() const {
   std::stringstream stream;
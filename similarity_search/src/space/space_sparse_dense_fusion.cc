@@ -192,134 +192,124 @@ SpaceSparseDenseFusion::CreateObjFromStr(IdType id, LabelType label, const strin
     pCompDesc = &vCompDesc_;
   }
 
-  vector<float> vDataBuff; // The buffer stores 4-byte floats and 4-byte unsigned ints
   vector<float> vDense;
   vector<SparseVectElem<float>> vSparse;
 
   unsigned extractStart = 0;
 
-  vector<char> buf;
+  // The buffer starts with the table of component locations
+  const size_t tableSize = pCompDesc->size() * sizeof(CompOffset);
+  vector<char> buf(tableSize);
+  vector<CompOffset> vOffsets;
 
   for (const auto e : *pCompDesc) {
+    size_t oldSize = buf.size();
+    CHECK_MSG((oldSize & 3) == 0, "old buffer size: " + ConvertToString(oldSize));
+
+    size_t dataLen = 0;
+
     if (e.isSparse_) {
       parseSparseBinVect(objStr, vSparse, extractStart); // modifies extractStart
 
       char *pData = NULL;
-      size_t dataLen = 0;
 
       PackSparseElements(vSparse, pData, dataLen);
       unique_ptr<char[]> data(pData); // data needs to be deleted when out of scope
 
-      size_t oldSize = buf.size();
-      CHECK((oldSize & 3) == 0);
       size_t padSize = getPad4(dataLen); // To align on 4-byte boundary
 
-      size_t currElemBuffSize = dataLen + 4 + padSize;
-
-      buf.resize(oldSize + currElemBuffSize);
-      CHECK((buf.size() & 3) == 0);
-
-      CHECK_MSG(dataLen <= numeric_limits<uint32_t>::max(),
-                "The size of the data is huge: " + ConvertToString(dataLen) + " this is likely an bug!");
-
-      char *pCurrBuffStart = &buf[oldSize];
-      writeBinaryPOD(pCurrBuffStart, (uint32_t) dataLen);
-      memcpy(pCurrBuffStart + 4, pData, dataLen);
-      memset(pCurrBuffStart + dataLen, 0, padSize); // zero padded area
+      buf.resize(oldSize + dataLen + padSize);
 
+      memcpy(&buf[oldSize], pData, dataLen);
+      memset(&buf[oldSize + dataLen], 0, padSize); // zero padded area
     } else {
-
       parseDenseBinVect(objStr, vDense, extractStart, e.dim_);  // modifies extractStart
-      size_t oldSize = buf.size();
-      CHECK_MSG((oldSize & 3) == 0, "old buffer size: " + ConvertToString(oldSize));
-
-      size_t vectSize = e.dim_ * sizeof(float);
-      buf.resize(oldSize + vectSize);
-      CHECK((buf.size() & 3) == 0);
 
-      char *pCurrBuffStart = &buf[oldSize];
-      memcpy(pCurrBuffStart, &vDense[0], vectSize);
+      dataLen = e.dim_ * sizeof(float);
+      buf.resize(oldSize + dataLen);
 
+      memcpy(&buf[oldSize], &vDense[0], dataLen);
     }
+    CHECK((buf.size() & 3) == 0);
+    CHECK_MSG(buf.size() <= numeric_limits<uint32_t>::max(),
+              "The size of the data is huge: " + ConvertToString(buf.size()) + " this is likely an bug!");
+
+    CompOffset off;
+    off.start_   = oldSize;
+    off.dataLen_ = dataLen;
+    vOffsets.push_back(off);
   }
 
-  return unique_ptr<Object>(new Object(id, label, buf.size(), &buf[0]));
+  if (tableSize) memcpy(&buf[0], &vOffsets[0], tableSize);
+
+  return unique_ptr<Object>(new Object(id, label, buf.size(), buf.data()));
 }
 
-float SpaceSparseDenseFusion::compDistance(const Object* obj1, const Object* obj2, bool isQueryTime) const {
-  float res = 0;
+void SpaceSparseDenseFusion::compilePlans() {
+  queryPlan_ = CompPlan();
+  indexPlan_ = CompPlan();
+
+  for (size_t i = 0; i < vCompDesc_.size(); ++i) {
+    const auto& e = vCompDesc_[i];
+    // Components with zero weights are ignored
+    if (e.queryWeight_ > numeric_limits<float>::min()) {
+      queryPlan_.vCompIds_.push_back(i);
+      queryPlan_.vIsSparse_.push_back(e.isSparse_);
+      queryPlan_.vWeights_.push_back(e.queryWeight_);
+    }
+    if (e.indexWeight_ > numeric_limits<float>::min()) {
+      indexPlan_.vCompIds_.push_back(i);
+      indexPlan_.vIsSparse_.push_back(e.isSparse_);
+      indexPlan_.vWeights_.push_back(e.indexWeight_);
+    }
+  }
+}
+
+// Component products are computed in chunks of this size, then they are weighted and summed up
+const size_t FUSION_CHUNK_QTY = 16;
 
-  unsigned start1 = 0, start2 = 0;
+float SpaceSparseDenseFusion::compDistance(const Object* obj1, const Object* obj2, const CompPlan& plan) const {
+  const size_t tableSize = vCompDesc_.size() * sizeof(CompOffset);
+  CHECK(obj1->datalength() >= tableSize && obj2->datalength() >= tableSize);
 
   const char* const pBeg1 = obj1->data();
   const char* const pBeg2 = obj2->data();
+  const CompOffset* pOffsets1 = reinterpret_cast<const CompOffset*>(pBeg1);
+  const CompOffset* pOffsets2 = reinterpret_cast<const CompOffset*>(pBeg2);
 
-  uint32_t dataLen1, dataLen2 = 0;
-
-  for (const auto e : vCompDesc_) {
-
-    float weight = (isQueryTime ? e.queryWeight_ : e.indexWeight_);
-    float val = 0;
-
-    size_t pad1 = 0, pad2 = 0;
-
-    if (e.isSparse_) {
-      readBinaryPOD(pBeg1 + start1, dataLen1);
-      start1 += 4;
-      readBinaryPOD(pBeg2 + start2, dataLen2);
-      start2 += 4;
-
-      pad1 = getPad4(dataLen1);
-      pad2 = getPad4(dataLen2);
-
-    } else {
-      dataLen1 = 4 * e.dim_;
-      dataLen2 = 4 * e.dim_;
-    }
+  const size_t qty = plan.vCompIds_.size();
+  float vals[FUSION_CHUNK_QTY];
+  float res = 0;
 
-    CHECK_MSG(start1 + dataLen1 + pad1 <= obj1->datalength(),
-              " start1="   + ConvertToString(start1) +
-              " pad1="  + ConvertToString(pad1) +
-              " dataLen1=" + ConvertToString(dataLen1)+
-              " obj1->datalength():" + ConvertToString(obj1->datalength())
-    );
-    CHECK_MSG(start2 + dataLen2 <= obj2->datalength(),
-              " start2=" + ConvertToString(start2) +
-              " pad2=" + ConvertToString(pad2) +
-              " dataLen2=" + ConvertToString(dataLen2) +
-              " obj2->datalength():" + ConvertToString(obj2->datalength())
-    );
-
-    if (weight > numeric_limits<float>::min()) {
-      if (e.isSparse_) {
-        val = SparseScalarProductFast(pBeg1 + start1, dataLen1,
-                                      pBeg2 + start2, dataLen2);
+  for (size_t start = 0; start < qty; start += FUSION_CHUNK_QTY) {
+    const size_t chunkQty = min(qty - start, FUSION_CHUNK_QTY);
+    for (size_t k = 0; k < chunkQty; ++k) {
+      const CompOffset& off1 = pOffsets1[plan.vCompIds_[start + k]];
+      const CompOffset& off2 = pOffsets2[plan.vCompIds_[start + k]];
+      if (plan.vIsSparse_[start + k]) {
+        vals[k] = SparseScalarProductFast(pBeg1 + off1.start_, off1.dataLen_,
+                                          pBeg2 + off2.start_, off2.dataLen_);
       } else {
-        val = ScalarProductSIMD(reinterpret_cast<const float*>(pBeg1 + start1),
-                                reinterpret_cast<const float*>(pBeg2 + start2), e.dim_);
+        vals[k] = ScalarProductSIMD(reinterpret_cast<const float*>(pBeg1 + off1.start_),
+                                    reinterpret_cast<const float*>(pBeg2 + off2.start_),
+                                    off1.dataLen_ / sizeof(float));
       }
     }
-
-    res += val * weight;
-
-    start1 += dataLen1 + pad1;
-    start2 += dataLen2 + pad2;
+    const float* pWeights = &plan.vWeights_[start];
+    for (size_t k = 0; k < chunkQty; ++k) {
+      res += vals[k] * pWeights[k];
+    }
   }
 
-  CHECK_MSG(start1 == obj1->datalength(),
-            "start1="+ConvertToString(start1) + " datalength()=" + ConvertToString(obj1->datalength()));
-  CHECK_MSG(start2 == obj2->datalength(),
-            "start1="+ConvertToString(start2) + " datalength()=" + ConvertToString(obj2->datalength()));
-
   return -res;
 }
 
 float SpaceSparseDenseFusion::ProxyDistance(const Object* obj1, const Object* obj2) const {
- return compDistance(obj1, obj2, false /* false for index-time distance */);
+ return compDistance(obj1, obj2, indexPlan_);
 }
 
 float SpaceSparseDenseFusion::HiddenDistance(const Object* obj1, const Object* obj2) const {
-  return compDistance(obj1, obj2, true /* true for query-time distance */);
+  return compDistance(obj1, obj2, queryPlan_);
 }
 
 
@@ -0,0 +1,125 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+
+#include "object.h"
+#include "utils.h"
+#include "logging.h"
+#include "space/space_sparse_quant.h"
+
+namespace similarity {
+
+using namespace std;
+
+template <typename qval_t>
+bool SpaceSparseVectorQuant<qval_t>::ApproxEqual(const Object& obj1, const Object& obj2) const {
+  vector<ElemType> target1, target2;
+  CreateVectFromObj(&obj1, target1);
+  CreateVectFromObj(&obj2, target2);
+  if (target1.size() != target2.size()) return false;
+  // Re-quantizing restored values may change the scale slightly
+  for (size_t i = 0; i < target1.size(); ++i) {
+    if (target1[i].id_ != target2[i].id_ ||
+        !similarity::ApproxEqual(target1[i].val_, target2[i].val_)) return false;
+  }
+  return true;
+}
+
+template <typename qval_t>
+Object* SpaceSparseVectorQuant<qval_t>::CreateObjFromVect(IdType id, LabelType label,
+                                                          const vector<ElemType>& InpVect) const {
+  char    *pData = NULL;
+  size_t  dataLen = 0;
+  PackSparseQuantElements<qval_t>(InpVect, pData, dataLen);
+  unique_ptr<char[]> data(pData);
+  return new Object(id, label, dataLen, pData);
+}
+
+template <typename qval_t>
+void SpaceSparseVectorQuant<qval_t>::CreateDenseVectFromObj(const Object* obj, float* pVect, size_t nElem) const {
+  static std::hash<size_t>   indexHash;
+  fill(pVect, pVect + nElem, 0.0f);
+
+  vector<ElemType> target;
+  CreateVectFromObj(obj, target);
+
+  for (const ElemType& e: target) {
+    size_t idx = indexHash(e.id_) % nElem;
+    pVect[idx] += e.val_;
+  }
+}
+
+template class SpaceSparseVectorQuant<int8_t>;
+template class SpaceSparseVectorQuant<int16_t>;
+
+template <typename qval_t>
+string SpaceSparseCosineSimilarityQuant<qval_t>::StrDesc() const {
+  return string("cosinesimil_sparse_") + SparseQuantFormatName(static_cast<const qval_t*>(nullptr));
+}
+
+template <typename qval_t>
+float SpaceSparseCosineSimilarityQuant<qval_t>::HiddenDistance(const Object* obj1, const Object* obj2) const {
+  CHECK(obj1->datalength() > 0);
+  CHECK(obj2->datalength() > 0);
+
+  float val = 1 - NormSparseQuantScalarProduct<qval_t>(obj1->data(), obj1->datalength(),
+                                                       obj2->data(), obj2->datalength());
+  return max(val, float(0));
+}
+
+template class SpaceSparseCosineSimilarityQuant<int8_t>;
+template class SpaceSparseCosineSimilarityQuant<int16_t>;
+
+template <typename qval_t>
+string SpaceSparseAngularDistanceQuant<qval_t>::StrDesc() const {
+  return string("angulardist_sparse_") + SparseQuantFormatName(static_cast<const qval_t*>(nullptr));
+}
+
+template <typename qval_t>
+float SpaceSparseAngularDistanceQuant<qval_t>::HiddenDistance(const Object* obj1, const Object* obj2) const {
+  CHECK(obj1->datalength() > 0);
+  CHECK(obj2->datalength() > 0);
+
+  // NormSparseQuantScalarProduct ensures ret value is in [-1,1]
+  return acos(NormSparseQuantScalarProduct<qval_t>(obj1->data(), obj1->datalength(),
+                                                   obj2->data(), obj2->datalength()));
+}
+
+template class SpaceSparseAngularDistanceQuant<int8_t>;
+template class SpaceSparseAngularDistanceQuant<int16_t>;
+
+template <typename qval_t>
+string SpaceSparseNegativeScalarProductQuant<qval_t>::StrDesc() const {
+  return string("negdotprod_sparse_") + SparseQuantFormatName(static_cast<const qval_t*>(nullptr));
+}
+
+template <typename qval_t>
+float SpaceSparseNegativeScalarProductQuant<qval_t>::HiddenDistance(const Object* obj1, const Object* obj2) const {
+  CHECK(obj1->datalength() > 0);
+  CHECK(obj2->datalength() > 0);
+
+  return -SparseQuantScalarProduct<qval_t>(obj1->data(), obj1->datalength(),
+                                           obj2->data(), obj2->datalength());
+}
+
+template class SpaceSparseNegativeScalarProductQuant<int8_t>;
+template class SpaceSparseNegativeScalarProductQuant<int16_t>;
+
+}  // namespace similarity
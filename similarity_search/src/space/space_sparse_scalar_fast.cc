@@ -69,6 +69,57 @@ SpaceSparseQueryNormNegativeScalarProductFast::HiddenDistance(const Object* obj1
 }
 
 
+/*
+ * Scattering a short query isn't worth it: the SIMD intersection is fast enough,
+ * in particular, because the gather pass is used only for much shorter data vectors.
+ */
+const size_t SPARSE_SCATTER_MIN_QUERY_QTY = 64;
+
+struct SparseScatteredQueryState : public QueryState {
+  SparseScatteredQueryState(const Object* pQuery) : query_(pQuery->data(), pQuery->datalength()) {}
+  SparseScatteredQuery query_;
+};
+
+unique_ptr<QueryState> SpaceSparseScalarFastBase::CreateQueryState(const Object* pQuery) const {
+  if (GetElemQty(pQuery) < SPARSE_SCATTER_MIN_QUERY_QTY) return nullptr;
+  return unique_ptr<QueryState>(new SparseScatteredQueryState(pQuery));
+}
+
+float SpaceSparseScalarFastBase::HiddenDistanceQuery(const Object* obj, const Object* pQuery,
+                                                     const QueryState* pState, float bound) const {
+  if (pState != nullptr) {
+    const SparseScatteredQuery& query = static_cast<const SparseScatteredQueryState*>(pState)->query_;
+    CHECK(obj->datalength() > 0);
+    if (query.PreferGather(obj->data(), obj->datalength())) {
+      return HiddenDistanceGather(obj, query);
+    }
+  }
+  return HiddenDistance(obj, pQuery);
+}
+
+float
+SpaceSparseCosineSimilarityFast::HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const {
+  float val = 1 - NormSparseScalarProductFastGather(obj->data(), obj->datalength(), query);
+
+  return max(val, float(0));
+}
+
+float
+SpaceSparseAngularDistanceFast::HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const {
+  // NormSparseScalarProductFastGather ensures ret value is in [-1,1]
+  return acos(NormSparseScalarProductFastGather(obj->data(), obj->datalength(), query));
+}
+
+float
+SpaceSparseNegativeScalarProductFast::HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const {
+  return -SparseScalarProductFastGather(obj->data(), obj->datalength(), query);
+}
+
+float
+SpaceSparseQueryNormNegativeScalarProductFast::HiddenDistanceGather(const Object* obj, const SparseScatteredQuery& query) const {
+  return -QueryNormSparseScalarProductFastGather(obj->data(), obj->datalength(), query);
+}
+
 void SpaceDotProdPivotIndexBase::GenVectElems(const Object& obj, bool bNorm, vector<SparseVectElem<float>>& pivElems) const {
   pivElems.clear();
   if (hashTrickDim_) {
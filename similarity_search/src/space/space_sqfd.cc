@@ -21,7 +21,6 @@
 #include <iomanip>
 #include <limits>
 #include <algorithm>
-#include <Eigen/Dense>
 
 #include "object.h"
 #include "logging.h"
@@ -31,11 +30,11 @@
 
 namespace similarity {
 
-using Eigen::MatrixXd;
-using Eigen::VectorXd;
-
 using namespace std;
 
+// The number of clusters processed in one call of SqfdFunction::fBatch
+const size_t SQFD_BATCH_QTY = 64;
+
 template <typename dist_t>
 SpaceSqfd<dist_t>::SpaceSqfd(SqfdFunction<dist_t>* func)
     : func_(func) {
@@ -233,7 +232,7 @@ unique_ptr<Object> SpaceSqfd<dist_t>::CreateObjFromStr(IdType id, LabelType labe
         2 * sizeof(uint32_t) + // num_clusters & feature_dimension
         num_clusters * feature_weight * sizeof(dist_t);
 
-  vector<char> buf(object_size);
+  vector<char> buf(object_size + sizeof(double));
   uint32_t* h = reinterpret_cast<uint32_t*>(&buf[0]);
   h[0] = num_clusters;
   h[1] = feature_weight - 1;
@@ -241,7 +240,12 @@ unique_ptr<Object> SpaceSqfd<dist_t>::CreateObjFromStr(IdType id, LabelType labe
   dist_t* pVect = reinterpret_cast<dist_t*>(h+2);
   copy(obj.begin(), obj.end(), pVect);
 
-  return unique_ptr<Object>(new Object(id, label, object_size, &buf[0]));
+  // The self-similarity term is stored after the clusters
+  SqfdObject parsed = {num_clusters, feature_weight - 1, pVect, false, 0};
+  const double selfTerm = CrossTerm(parsed, parsed);
+  memcpy(&buf[object_size], &selfTerm, sizeof(selfTerm));
+
+  return unique_ptr<Object>(new Object(id, label, buf.size(), &buf[0]));
 }
 
 template <typename dist_t>
@@ -278,55 +282,108 @@ bool SpaceSqfd<dist_t>::ReadNextObjStr(DataFileInputState &inpState, string& str
 }
 
 template <typename dist_t>
-dist_t SpaceSqfd<dist_t>::HiddenDistance(
-    const Object* obj1, const Object* obj2) const {
-  if (obj1->datalength() < 8) {
-    PREPARE_RUNTIME_ERR(err) << "Bug: object size " << obj1->datalength() << " is smaller than 8 bytes!";
+void SpaceSqfd<dist_t>::ParseObject(const Object* obj, SqfdObject& res) const {
+  if (obj->datalength() < 8) {
+    PREPARE_RUNTIME_ERR(err) << "Bug: object size " << obj->datalength() << " is smaller than 8 bytes!";
     THROW_RUNTIME_ERR(err);
   }
-  if (obj2->datalength() < 8) {
-    PREPARE_RUNTIME_ERR(err) << "Bug: object size " << obj2->datalength() << " is smaller than 8 bytes!";
+  const uint32_t* h = reinterpret_cast<const uint32_t*>(obj->data());
+  res.num_clusters_ = h[0];
+  res.feature_dimension_ = h[1];
+  res.pElems_ = reinterpret_cast<const dist_t*>(obj->data() + 2*sizeof(uint32_t));
+
+  const size_t clustSize = 2 * sizeof(uint32_t) + 
+                           size_t(res.num_clusters_) * (res.feature_dimension_ + 1) * sizeof(dist_t);
+  if (obj->datalength() == clustSize + sizeof(double)) {
+    res.hasSelfTerm_ = true;
+    memcpy(&res.selfTerm_, obj->data() + clustSize, sizeof(res.selfTerm_));
+  } else if (obj->datalength() == clustSize) {
+    res.hasSelfTerm_ = false;
+    res.selfTerm_ = 0;
+  } else {
+    PREPARE_RUNTIME_ERR(err) << "Bug: object size " << obj->datalength() << " doesn't match" 
+                             << " the number of clusters " << res.num_clusters_ 
+                             << " and the feature dimensionality " << res.feature_dimension_;
     THROW_RUNTIME_ERR(err);
   }
-  const uint32_t* h1 = reinterpret_cast<const uint32_t*>(obj1->data());
-  const uint32_t* h2 = reinterpret_cast<const uint32_t*>(obj2->data());
-  const uint32_t num_clusters1 = h1[0], feature_dimension1 = h1[1];
-  const uint32_t num_clusters2 = h2[0], feature_dimension2 = h2[1];
-  const dist_t* x = reinterpret_cast<const dist_t*>(
-      obj1->data() + 2*sizeof(uint32_t));
-  const dist_t* y = reinterpret_cast<const dist_t*>(
-      obj2->data() + 2*sizeof(uint32_t));
-  if (feature_dimension1 != feature_dimension2) {
+}
+
+template <typename dist_t>
+double SpaceSqfd<dist_t>::CrossTerm(const SqfdObject& obj1, const SqfdObject& obj2) const {
+  const size_t        step = obj1.feature_dimension_ + 1;
+  const dist_t*       pClust[SQFD_BATCH_QTY];
+  dist_t              vals[SQFD_BATCH_QTY];
+  double              res = 0;
+
+  for (size_t start = 0; start < obj2.num_clusters_; start += SQFD_BATCH_QTY) {
+    const size_t qty = min(size_t(obj2.num_clusters_) - start, SQFD_BATCH_QTY);
+    for (size_t k = 0; k < qty; ++k) {
+      pClust[k] = obj2.pElems_ + (start + k) * step;
+    }
+    for (size_t i = 0; i < obj1.num_clusters_; ++i) {
+      const dist_t* p1 = obj1.pElems_ + i * step;
+      func_->fBatch(p1, pClust, qty, obj1.feature_dimension_, vals);
+      double sum = 0;
+      for (size_t k = 0; k < qty; ++k) {
+        // The weight is the last element of the cluster
+        sum += double(pClust[k][obj1.feature_dimension_]) * vals[k];
+      }
+      res += double(p1[obj1.feature_dimension_]) * sum;
+    }
+  }
+  return res;
+}
+
+/*
+ * The distance is sqrt(w^T A w), where w is the concatenation of weights of the 
+ * first object and negated weights of the second one. This quadratic form 
+ * is equal to S1 + S2 - 2*C, where S1 and S2 are self-similarity terms of 
+ * respective objects and C is the cross-object term.
+ */
+template <typename dist_t>
+dist_t SpaceSqfd<dist_t>::ComputeDistance(const SqfdObject& obj1, double selfTerm1, 
+                                          const SqfdObject& obj2, double selfTerm2) const {
+  if (obj1.feature_dimension_ != obj2.feature_dimension_) {
     PREPARE_RUNTIME_ERR(err) << "Bug: different feature dimensions: " 
-               << feature_dimension1 << " vs " << feature_dimension2;
+               << obj1.feature_dimension_ << " vs " << obj2.feature_dimension_;
     THROW_RUNTIME_ERR(err);
   }
-  const uint32_t sz = num_clusters1 + num_clusters2;
-  VectorXd W(sz);
-  size_t pos = feature_dimension1;
-  for (uint32_t i = 0; i < num_clusters1; ++i) {
-    W(i) = x[pos];
-    pos += feature_dimension1 + 1;
-  }
-  pos = feature_dimension2;
-  for (uint32_t i = 0; i < num_clusters2; ++i) {
-    W(num_clusters1 + i) = -y[pos];
-    pos += feature_dimension2 + 1;
-  }
-  MatrixXd A(sz,sz);
-  for (uint32_t i = 0; i < sz; ++i) {
-    for (uint32_t j = i; j < sz; ++j) {
-      const dist_t* p1 = i < num_clusters1
-          ? x + i * (feature_dimension1 + 1)
-          : y + (i - num_clusters1) * (feature_dimension1 + 1);
-      const dist_t* p2 = j < num_clusters1
-          ? x + j * (feature_dimension1 + 1)
-          : y + (j - num_clusters1) * (feature_dimension1 + 1);
-      A(i,j) = A(j,i) = func_->f(p1, p2, feature_dimension1);
-    }
-  }
-  auto res = W.transpose() * A * W;
-  return sqrt(res(0,0));
+  const double res = selfTerm1 + selfTerm2 - 2 * CrossTerm(obj1, obj2);
+  // Rounding errors can make a (nearly) zero value negative
+  return sqrt(max(res, 0.0));
+}
+
+template <typename dist_t>
+dist_t SpaceSqfd<dist_t>::HiddenDistance(
+    const Object* obj1, const Object* obj2) const {
+  SqfdObject x, y;
+  ParseObject(obj1, x);
+  ParseObject(obj2, y);
+  return ComputeDistance(x, SelfTerm(x), y, SelfTerm(y));
+}
+
+template <typename dist_t>
+struct SpaceSqfd<dist_t>::SqfdQueryState : public QueryState {
+  double selfTerm_;
+};
+
+template <typename dist_t>
+unique_ptr<QueryState> SpaceSqfd<dist_t>::CreateQueryState(const Object* pQuery) const {
+  SqfdObject q;
+  ParseObject(pQuery, q);
+  unique_ptr<SqfdQueryState> res(new SqfdQueryState());
+  res->selfTerm_ = SelfTerm(q);
+  return unique_ptr<QueryState>(res.release());
+}
+
+template <typename dist_t>
+dist_t SpaceSqfd<dist_t>::HiddenDistanceQuery(const Object* obj, const Object* pQuery,
+                                              const QueryState* pState, dist_t /* bound is ignored */) const {
+  if (pState == nullptr) return HiddenDistance(obj, pQuery);
+  SqfdObject x, q;
+  ParseObject(obj, x);
+  ParseObject(pQuery, q);
+  return ComputeDistance(x, SelfTerm(x), q, static_cast<const SqfdQueryState*>(pState)->selfTerm_);
 }
 
 template <typename dist_t>
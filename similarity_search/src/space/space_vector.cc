@@ -145,8 +145,10 @@ Object* VectorSpace<dist_t, dist_uint_t>::CreateObjFromVect(IdType id, LabelType
 
 template class VectorSpace<float, int32_t>;
 template class VectorSpace<float, uint32_t>;
+template class VectorSpace<float, uint64_t>;
 template class VectorSpace<float>;
 template class VectorSpace<int32_t, int32_t>;
 template class VectorSpace<int32_t, uint32_t>;
+template class VectorSpace<int32_t, uint64_t>;
 
 }  // namespace similarity
@@ -0,0 +1,133 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <iomanip>
+#include <limits>
+#include <memory>
+
+#include "object.h"
+#include "utils.h"
+#include "logging.h"
+#include "space/space_vector_half.h"
+#include "my_isnan_isinf.h"
+
+namespace similarity {
+
+using namespace std;
+
+template <typename half_t>
+string VectorSpaceHalf<half_t>::CreateStrFromObj(const Object* pObj, const string& externId /* ignored */) const {
+  stringstream out;
+  const half_t* p = GetHalfVect(pObj);
+  const size_t length = GetElemQty(pObj);
+  for (size_t i = 0; i < length; ++i) {
+    if (i) out << " ";
+    // Clear all previous flags & set to the maximum precision available
+    out.unsetf(ios_base::floatfield);
+    out << setprecision(numeric_limits<float>::max_digits10) << noshowpoint << ToFloat(p[i]);
+  }
+
+  return out.str();
+}
+
+template <typename half_t>
+bool VectorSpaceHalf<half_t>::ApproxEqual(const Object& obj1, const Object& obj2) const {
+  const half_t* p1 = GetHalfVect(&obj1);
+  const half_t* p2 = GetHalfVect(&obj2);
+  const size_t len1 = GetElemQty(&obj1);
+  const size_t len2 = GetElemQty(&obj2);
+  if (len1 != len2) {
+    PREPARE_RUNTIME_ERR(err) << "Bug: comparing vectors of different lengths: " << len1 << " and " << len2;
+    THROW_RUNTIME_ERR(err);
+  }
+  for (size_t i = 0; i < len1; ++i)
+  if (!similarity::ApproxEqual(ToFloat(p1[i]), ToFloat(p2[i]))) return false;
+  return true;
+}
+
+template <typename half_t>
+Object* VectorSpaceHalf<half_t>::CreateObjFromVect(IdType id, LabelType label, const vector<float>& InpVect) const {
+  vector<half_t> vect(InpVect.size());
+  for (size_t i = 0; i < InpVect.size(); ++i) {
+    vect[i] = FromFloat<half_t>(InpVect[i]);
+  }
+  return new Object(id, label, vect.size() * sizeof(half_t), vect.data());
+}
+
+template <typename half_t>
+void VectorSpaceHalf<half_t>::CreateDenseVectFromObj(const Object* obj, float* pVect, size_t nElem) const {
+  const half_t* p = GetHalfVect(obj);
+  const size_t len = GetElemQty(obj);
+  if (nElem > len) {
+    PREPARE_RUNTIME_ERR(err) << __func__ << " The number of requested elements "
+                             << nElem << " is larger than the actual number of elements " << len;
+    THROW_RUNTIME_ERR(err);
+  }
+  for (size_t i = 0; i < nElem; ++i) pVect[i] = ToFloat(p[i]);
+}
+
+template class VectorSpaceHalf<Float16>;
+template class VectorSpaceHalf<BFloat16>;
+
+template <typename half_t>
+string SpaceL2Half<half_t>::StrDesc() const {
+  return string("l2_") + HalfFormatName(static_cast<const half_t*>(nullptr));
+}
+
+template <typename half_t>
+float SpaceL2Half<half_t>::HiddenDistance(const Object* obj1, const Object* obj2) const {
+  CHECK(obj1->datalength() > 0);
+  CHECK(obj1->datalength() == obj2->datalength());
+  return L2NormHalf(this->GetHalfVect(obj1), this->GetHalfVect(obj2), this->GetElemQty(obj1));
+}
+
+template class SpaceL2Half<Float16>;
+template class SpaceL2Half<BFloat16>;
+
+template <typename half_t>
+string SpaceCosineSimilarityHalf<half_t>::StrDesc() const {
+  return string("cosinesimil_") + HalfFormatName(static_cast<const half_t*>(nullptr));
+}
+
+template <typename half_t>
+float SpaceCosineSimilarityHalf<half_t>::HiddenDistance(const Object* obj1, const Object* obj2) const {
+  CHECK(obj1->datalength() > 0);
+  CHECK(obj1->datalength() == obj2->datalength());
+  float val = CosineSimilarityHalf(this->GetHalfVect(obj1), this->GetHalfVect(obj2), this->GetElemQty(obj1));
+  if (my_isnan(val)) throw runtime_error("Bug: NAN dist! (SpaceCosineSimilarityHalf)");
+  return val;
+}
+
+template class SpaceCosineSimilarityHalf<Float16>;
+template class SpaceCosineSimilarityHalf<BFloat16>;
+
+template <typename half_t>
+string SpaceNegativeScalarProductHalf<half_t>::StrDesc() const {
+  return string("negdotprod_") + HalfFormatName(static_cast<const half_t*>(nullptr));
+}
+
+template <typename half_t>
+float SpaceNegativeScalarProductHalf<half_t>::HiddenDistance(const Object* obj1, const Object* obj2) const {
+  CHECK(obj1->datalength() > 0);
+  CHECK(obj1->datalength() == obj2->datalength());
+  return -ScalarProductHalf(this->GetHalfVect(obj1), this->GetHalfVect(obj2), this->GetElemQty(obj1));
+}
+
+template class SpaceNegativeScalarProductHalf<Float16>;
+template class SpaceNegativeScalarProductHalf<BFloat16>;
+
+}  // namespace similarity
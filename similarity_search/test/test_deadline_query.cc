@@ -0,0 +1,81 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "bunit.h"
+#include "genrand_vect.h"
+#include "deadline_query.h"
+#include "knnquery.h"
+#include "rangequery.h"
+#include "params.h"
+#include "method/seqsearch.h"
+#include "space/space_lp.h"
+
+namespace similarity {
+
+using std::unique_ptr;
+using std::vector;
+
+typedef std::chrono::steady_clock SteadyClock;
+
+/*
+ * The sequential search computes distances in batches (see CheckAndAddToResultBatch).
+ * L1 is used, because the dense fast path (which bypasses the query object) supports only L2.
+ */
+TEST(DeadlineQueryBatchedSearch) {
+  const size_t dim = 16, dataQty = 1000, K = 10;
+  SpaceLp<float> space(1);
+
+  ObjectVector data;
+  vector<float> vect(dim);
+  for (size_t i = 0; i < dataQty; ++i) {
+    GenRandVect(&vect[0], dim, -1.0f, 1.0f);
+    data.push_back(new Object(i, -1, dim * sizeof(float), &vect[0]));
+  }
+  GenRandVect(&vect[0], dim, -1.0f, 1.0f);
+  unique_ptr<Object> queryObj(new Object(dataQty, -1, dim * sizeof(float), &vect[0]));
+
+  SeqSearch<float> index(space, data);
+  index.CreateIndex(AnyParams());
+
+  // The deadline doesn't expire: the result is the same as without deadlines
+  KNNQuery<float> knnExp(space, queryObj.get(), K);
+  DeadlineQuery<KNNQuery, float> knnAct(SteadyClock::time_point::max(), space, queryObj.get(), K);
+  index.Search(&knnExp, -1);
+  index.Search(&knnAct, -1);
+  EXPECT_FALSE(knnAct.Expired());
+  EXPECT_EQ(uint64_t(dataQty), knnAct.DistanceComputations());
+  EXPECT_TRUE(knnExp.Equals(&knnAct));
+
+  // The deadline expires before the first batch: no distances are computed
+  const SteadyClock::time_point past = SteadyClock::now() - std::chrono::seconds(1);
+  DeadlineQuery<KNNQuery, float> knnExpired(past, space, queryObj.get(), K);
+  index.Search(&knnExpired, -1);
+  EXPECT_TRUE(knnExpired.Expired());
+  EXPECT_EQ(uint64_t(0), knnExpired.DistanceComputations());
+  // The result isn't padded with "infinitely" distant objects
+  EXPECT_EQ(0U, knnExpired.ResultSize());
+
+  DeadlineQuery<RangeQuery, float> rangeExpired(past, space, queryObj.get(), 1e6f);
+  index.Search(&rangeExpired, -1);
+  EXPECT_TRUE(rangeExpired.Expired());
+  EXPECT_EQ(0U, rangeExpired.ResultSize());
+
+  for (const Object* o : data) delete o;
+}
+
+}  // namespace similarity
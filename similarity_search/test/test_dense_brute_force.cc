@@ -0,0 +1,115 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <memory>
+#include <vector>
+
+#include "bunit.h"
+#include "genrand_vect.h"
+#include "dense_brute_force.h"
+#include "space/space_lp.h"
+#include "space/space_scalar.h"
+
+namespace similarity {
+
+using std::unique_ptr;
+using std::vector;
+
+/*
+ * The fast path should produce exactly the same results
+ * (and count the same number of distance computations)
+ * as the vanilla brute-force search.
+ */
+bool TestDenseBruteForce(const Space<float>& space, size_t dim, size_t dataQty, size_t queryQty) {
+  DenseBruteForce::DistType distType;
+  EXPECT_TRUE(DenseBruteForce::GetDistType(space, distType));
+
+  ObjectVector data, queries;
+  vector<float> vect(dim);
+  for (size_t i = 0; i < dataQty + queryQty; ++i) {
+    GenRandVect(&vect[0], dim, -1.0f, 1.0f);
+    // Let's have some duplicates and zero vectors
+    if (i % 50 == 1) fill(vect.begin(), vect.end(), 0.0f);
+    Object* o = new Object(i, -1, dim * sizeof(float), &vect[0]);
+    if (i < dataQty) data.push_back(o); else queries.push_back(o);
+    if (i % 100 == 3 && i + 1 < dataQty) {
+      data.push_back(new Object(i, -1, dim * sizeof(float), &vect[0]));
+      ++i;
+    }
+  }
+
+  DenseBruteForce denseBF(data, distType);
+  bool res = true;
+
+  for (const Object* q : queries) {
+    for (unsigned K : {1, 10}) {
+      KNNQuery<float> queryExp(space, q, K);
+      KNNQuery<float> queryAct(space, q, K);
+      for (const Object* o : data) queryExp.CheckAndAddToResult(o);
+      denseBF.Search(&queryAct, 0, data.size());
+
+      EXPECT_EQ(queryExp.DistanceComputations(), queryAct.DistanceComputations());
+      unique_ptr<KNNQueue<float>> resExp(queryExp.Result()->Clone());
+      unique_ptr<KNNQueue<float>> resAct(queryAct.Result()->Clone());
+      EXPECT_EQ(resExp->Size(), resAct->Size());
+      while (!resExp->Empty() && !resAct->Empty()) {
+        if (resExp->TopDistance() != resAct->TopDistance()) {
+          LOG(LIB_ERROR) << "Distance mismatch, expected: " << resExp->TopDistance()
+                         << " actual: " << resAct->TopDistance();
+          res = false;
+        }
+        resExp->Pop();
+        resAct->Pop();
+      }
+    }
+    // Range search: let's take the radius from the 10-NN search
+    KNNQuery<float> queryKNN(space, q, 10);
+    for (const Object* o : data) queryKNN.CheckAndAddToResult(o);
+    float radius = queryKNN.Result()->TopDistance();
+
+    RangeQuery<float> queryExp(space, q, radius);
+    RangeQuery<float> queryAct(space, q, radius);
+    for (const Object* o : data) queryExp.CheckAndAddToResult(o);
+    denseBF.Search(&queryAct, 0, data.size());
+    EXPECT_EQ(queryExp.ResultSize(), queryAct.ResultSize());
+    EXPECT_EQ(queryExp.DistanceComputations(), queryAct.DistanceComputations());
+  }
+
+  for (const Object* o : data) delete o;
+  for (const Object* o : queries) delete o;
+  return res;
+}
+
+TEST(DenseBruteForceL2) {
+  SpaceLp<float> space(2);
+  for (size_t dim : {1, 7, 16, 33, 128}) {
+    EXPECT_TRUE(TestDenseBruteForce(space, dim, 1000, 20));
+  }
+}
+
+TEST(DenseBruteForceCosine) {
+  SpaceCosineSimilarity<float> space;
+  for (size_t dim : {1, 7, 16, 33, 128}) {
+    EXPECT_TRUE(TestDenseBruteForce(space, dim, 1000, 20));
+  }
+}
+
+TEST(DenseBruteForceNegDotProd) {
+  SpaceNegativeScalarProduct<float> space;
+  for (size_t dim : {1, 7, 16, 33, 128}) {
+    EXPECT_TRUE(TestDenseBruteForce(space, dim, 1000, 20));
+  }
+}
+
+}  // namespace similarity
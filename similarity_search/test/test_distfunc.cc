@@ -30,10 +30,14 @@
 #include "space/space_sparse_scalar.h"
 #include "space/space_sparse_vector_inter.h"
 #include "space/space_sparse_scalar_fast.h"
+#include "space/space_sparse_quant.h"
 #include "space/space_sparse_vector.h"
 #include "space/space_scalar.h"
+#include "space/space_lp.h"
+#include "knnquery.h"
 #include "testdataset.h"
 #include "distcomp.h"
+#include "half_float.h"
 #include "genrand_vect.h"
 #include "permutation_utils.h"
 #include "ztimer.h"
@@ -158,6 +162,156 @@ TEST(SparsePackUnpack) {
   TestSparsePackUnpack<float>();
 }
 
+// Generates qty (at most maxId / 2) sparse vector elements with distinct ids in [0, maxId)
+void GenSparseVectUniform(size_t qty, size_t maxId, vector<SparseVectElem<float>>& res) {
+  qty = min(qty, maxId / 2);
+  vector<IdType> ids;
+  while (ids.size() < qty) {
+    ids.push_back(RandomInt() % maxId);
+    if (ids.size() == qty) {
+      sort(ids.begin(), ids.end());
+      ids.erase(unique(ids.begin(), ids.end()), ids.end());
+    }
+  }
+  res.clear();
+  for (IdType id : ids) res.push_back(SparseVectElem<float>(id, RandomReal<float>() - 0.5f));
+}
+
+/*
+ * Distances computed using the scattered query (the gather pass)
+ * should agree with distances computed via the SIMD intersection.
+ */
+TEST(SparseScatteredQueryAgree) {
+  vector<unique_ptr<SpaceSparseVectorInter<float>>> spaces;
+  spaces.emplace_back(new SpaceSparseCosineSimilarityFast());
+  spaces.emplace_back(new SpaceSparseAngularDistanceFast());
+  spaces.emplace_back(new SpaceSparseNegativeScalarProductFast());
+  spaces.emplace_back(new SpaceSparseQueryNormNegativeScalarProductFast());
+
+  // Small ranges of ids produce dense arrays, large ranges (with many blocks) produce hash tables
+  for (size_t maxId : {2000, 20000, 5000000})
+  for (size_t queryQty : {16, 300, 1500}) {
+    vector<SparseVectElem<float>> elems;
+    GenSparseVectUniform(queryQty, maxId, elems);
+    // Queries share some elements with data vectors
+    vector<SparseVectElem<float>> queryElems = elems;
+
+    for (const auto& space : spaces) {
+      unique_ptr<Object> pQuery(space->CreateObjFromVect(0, -1, queryElems));
+      {
+        SparseScatteredQuery scattered(pQuery->data(), pQuery->datalength());
+        EXPECT_EQ(queryElems.size(), scattered.ElemQty());
+        EXPECT_EQ(maxId <= (1 << 18) || maxId <= 256 * queryElems.size(), scattered.IsDense());
+      }
+      KNNQuery<float> query(*space, pQuery.get(), 10);
+
+      for (size_t dataQty : {0, 1, 5, 40, 200, 3000}) {
+        vector<SparseVectElem<float>> dataElems;
+        GenSparseVectUniform(dataQty, maxId, dataElems);
+        // Let's make sure that vectors overlap
+        for (size_t i = 0; i < dataElems.size(); i += 2) {
+          dataElems[i].id_ = queryElems[RandomInt() % queryElems.size()].id_;
+        }
+        sort(dataElems.begin(), dataElems.end());
+        dataElems.erase(unique(dataElems.begin(), dataElems.end(),
+                               [](const SparseVectElem<float>& a, const SparseVectElem<float>& b) { return a.id_ == b.id_; }),
+                        dataElems.end());
+        unique_ptr<Object> pData(space->CreateObjFromVect(1, -1, dataElems));
+
+        float dist1 = query.DistanceObjLeft(pData.get());
+        float dist2 = space->IndexTimeDistance(pData.get(), pQuery.get());
+        if (fabs(dist1 - dist2) > 1e-4f * max(1.0f, fabs(dist2))) {
+          LOG(LIB_ERROR) << space->StrDesc() << " maxId: " << maxId << " query qty: " << queryQty
+                         << " data qty: " << dataQty << " gather distance: " << dist1 << " intersection distance: " << dist2;
+          EXPECT_TRUE(false);
+        }
+      }
+    }
+  }
+}
+
+// The scalar product of two sorted sparse vectors computed in double precision
+double SparseScalarProductReference(const vector<SparseVectElem<float>>& v1, const vector<SparseVectElem<float>>& v2) {
+  double sum = 0;
+  for (size_t i1 = 0, i2 = 0; i1 < v1.size() && i2 < v2.size(); ) {
+    if (v1[i1].id_ < v2[i2].id_) ++i1;
+    else if (v2[i2].id_ < v1[i1].id_) ++i2;
+    else sum += double(v1[i1++].val_) * v2[i2++].val_;
+  }
+  return sum;
+}
+
+/*
+ * Vectors in the compressed format should be restored with the quantization error
+ * of about half the scale (plus rounding errors). Distances computed on compressed vectors
+ * should agree with distances between restored vectors.
+ */
+template <typename qval_t>
+bool TestSparseQuantAgree() {
+  SpaceSparseNegativeScalarProductQuant<qval_t> spaceNegDot;
+  SpaceSparseCosineSimilarityQuant<qval_t>      spaceCosine;
+  bool bOk = true;
+
+  // Large ranges of ids produce differences that need several bytes
+  for (size_t maxId : {1000, 100000, 5000000})
+  for (size_t qty1 : {0, 1, 10, 300})
+  for (size_t qty2 : {1, 40, 1000}) {
+    vector<SparseVectElem<float>> elems1, elems2;
+    GenSparseVectUniform(qty1, maxId, elems1);
+    GenSparseVectUniform(qty2, maxId, elems2);
+    for (size_t i = 0; i < elems2.size() && !elems1.empty(); i += 2) {
+      elems2[i].id_ = elems1[RandomInt() % elems1.size()].id_;
+    }
+    sort(elems2.begin(), elems2.end());
+    elems2.erase(unique(elems2.begin(), elems2.end(),
+                        [](const SparseVectElem<float>& a, const SparseVectElem<float>& b) { return a.id_ == b.id_; }),
+                 elems2.end());
+
+    unique_ptr<Object> pObj1(spaceNegDot.CreateObjFromVect(0, -1, elems1));
+    unique_ptr<Object> pObj2(spaceNegDot.CreateObjFromVect(1, -1, elems2));
+    EXPECT_EQ(elems2.size(), spaceNegDot.GetElemQty(pObj2.get()));
+
+    vector<SparseVectElem<float>> restored1, restored2;
+    spaceNegDot.CreateVectFromObj(pObj1.get(), restored1);
+    spaceNegDot.CreateVectFromObj(pObj2.get(), restored2);
+
+    float maxAbs = 0;
+    for (const auto& e : elems2) maxAbs = max(maxAbs, fabs(e.val_));
+    const float scale = maxAbs / numeric_limits<qval_t>::max();
+
+    EXPECT_EQ(elems2.size(), restored2.size());
+    for (size_t i = 0; i < min(elems2.size(), restored2.size()); ++i) {
+      EXPECT_EQ(elems2[i].id_, restored2[i].id_);
+      if (fabs(elems2[i].val_ - restored2[i].val_) > 0.6f * scale) {
+        LOG(LIB_ERROR) << "Quantization error is too large: " << elems2[i].val_ << " restored: " << restored2[i].val_;
+        bOk = false;
+      }
+    }
+
+    const double prod = SparseScalarProductReference(restored1, restored2);
+    const double norm = sqrt(SparseScalarProductReference(restored1, restored1) *
+                             SparseScalarProductReference(restored2, restored2));
+    const float  expNegDot = float(-prod);
+    const float  expCosine = norm > 0 ? float(max(0.0, 1 - prod / norm)) : 1.0f;
+
+    const float negDot = spaceNegDot.IndexTimeDistance(pObj1.get(), pObj2.get());
+    const float cosine = spaceCosine.IndexTimeDistance(pObj1.get(), pObj2.get());
+
+    if (fabs(negDot - expNegDot) > 1e-4f * max(1.0f, fabs(expNegDot)) || fabs(cosine - expCosine) > 1e-4f) {
+      LOG(LIB_ERROR) << spaceNegDot.StrDesc() << " maxId: " << maxId << " qty1: " << qty1 << " qty2: " << qty2
+                     << " negdotprod: " << negDot << " expected: " << expNegDot
+                     << " cosine: " << cosine << " expected: " << expCosine;
+      bOk = false;
+    }
+  }
+  return bOk;
+}
+
+TEST(SparseQuantAgree) {
+  EXPECT_TRUE(TestSparseQuantAgree<int8_t>());
+  EXPECT_TRUE(TestSparseQuantAgree<int16_t>());
+}
+
 TEST(TestEfficientPower) {
   double f = 2.0;
 
@@ -416,6 +570,206 @@ bool TestL2Agree(size_t N, size_t dim, size_t Rep) {
     return true;
 }
 
+/*
+ * Early-abandoning versions should return exactly the same value as unbounded ones
+ * if the distance doesn't exceed the bound. Otherwise, they should return a value
+ * larger than the bound (but not larger than the actual distance).
+ */
+bool TestLpBoundedAgree(size_t N, size_t dim) {
+    vector<float> vect1(dim), vect2(dim);
+    float* pVect1 = &vect1[0]; 
+    float* pVect2 = &vect2[0];
+
+    for (size_t j = 1; j < N; ++j) {
+        GenRandVect(pVect1, dim, -float(RANGE), float(RANGE));
+        GenRandVect(pVect2, dim, -float(RANGE), float(RANGE));
+
+        float val1 = L1NormSIMD(pVect1, pVect2, dim);
+        float val2 = L2NormSIMD(pVect1, pVect2, dim);
+
+        for (float coeff : {0.0f, 0.1f, 0.5f, 0.9f, 1.0f, 1.5f}) {
+            float bound1 = val1 * coeff, bound2 = val2 * coeff;
+            float res1 = L1NormSIMDBounded(pVect1, pVect2, dim, bound1);
+            float res2 = L2NormSIMDBounded(pVect1, pVect2, dim, bound2);
+
+            if (val1 <= bound1 ? res1 != val1 : (res1 <= bound1 || res1 > val1)) {
+                cerr << "Bug L1 bounded !!! Dim = " << dim << " val = " << val1 
+                     << " bound = " << bound1 << " res = " << res1 << endl;
+                return false;
+            }
+            if (val2 <= bound2 ? res2 != val2 : (res2 <= bound2 || res2 > val2)) {
+                cerr << "Bug L2 bounded !!! Dim = " << dim << " val = " << val2 
+                     << " bound = " << bound2 << " res = " << res2 << endl;
+                return false;
+            }
+        }
+        if (L1NormSIMDBounded(pVect1, pVect2, dim, DistMax<float>()) != val1 ||
+            L2NormSIMDBounded(pVect1, pVect2, dim, DistMax<float>()) != val2) {
+            cerr << "Bug Lp bounded !!! Dim = " << dim << " mismatch for the infinite bound" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TEST(LpBoundedAgree) {
+    for (size_t dim = 1; dim <= 300; dim += 7) {
+        EXPECT_TRUE(TestLpBoundedAgree(200, dim));
+    }
+}
+
+/*
+ * Checks that batched distances are exactly the same as distances computed one by one.
+ * The number of vectors is varied so that the last group is incomplete.
+ */
+bool TestLpBatchAgree(size_t N, size_t dim) {
+    for (size_t qty = 1; qty <= N; ++qty) {
+        vector<vector<float>> vects(qty, vector<float>(dim));
+        vector<const float*>  ppVect(qty);
+        vector<float>         query(dim), dist1(qty), dist2(qty);
+
+        GenRandVect(&query[0], dim, -float(RANGE), float(RANGE));
+        for (size_t i = 0; i < qty; ++i) {
+            GenRandVect(&vects[i][0], dim, -float(RANGE), float(RANGE));
+            ppVect[i] = &vects[i][0];
+        }
+
+        L1NormSIMDBatch(&query[0], &ppVect[0], qty, dim, &dist1[0]);
+        L2NormSIMDBatch(&query[0], &ppVect[0], qty, dim, &dist2[0]);
+
+        for (size_t i = 0; i < qty; ++i) {
+            if (dist1[i] != L1NormSIMD(ppVect[i], &query[0], dim) ||
+                dist2[i] != L2NormSIMD(ppVect[i], &query[0], dim)) {
+                cerr << "Bug Lp batch !!! Dim = " << dim << " qty = " << qty << " i = " << i << endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(LpBatchAgree) {
+    for (size_t dim = 1; dim <= 70; ++dim) {
+        EXPECT_TRUE(TestLpBatchAgree(11, dim));
+    }
+}
+
+/*
+ * Checks that batched distances computed via a query satisfy the contract
+ * of Space::HiddenDistanceBatch: a distance is exact if it doesn't exceed the bound.
+ */
+bool TestSpaceLpBatch(float p, size_t dim, size_t qty) {
+    SpaceLp<float> space(p);
+    vector<float>  vect(dim);
+    ObjectVector   data;
+
+    GenRandVect(&vect[0], dim, -float(RANGE), float(RANGE));
+    unique_ptr<Object> queryObj(new Object(-1, -1, dim * sizeof(float), &vect[0]));
+    for (size_t i = 0; i < qty; ++i) {
+        GenRandVect(&vect[0], dim, -float(RANGE), float(RANGE));
+        data.push_back(new Object(i, -1, dim * sizeof(float), &vect[0]));
+    }
+
+    KNNQuery<float> query(space, queryObj.get(), 1);
+    vector<float>   exact(qty), dists(qty);
+    for (size_t i = 0; i < qty; ++i) {
+      exact[i] = query.DistanceObjLeft(data[i]);
+    }
+
+    bool res = true;
+    float bound = exact[qty / 2];
+    for (float b : {DistMax<float>(), bound}) {
+        query.DistanceObjLeftBatch(&data[0], qty, b, &dists[0]);
+        for (size_t i = 0; i < qty; ++i) {
+            if (exact[i] <= b ? dists[i] != exact[i] : dists[i] <= b) {
+                cerr << "Bug space Lp batch !!! p = " << p << " dim = " << dim << " i = " << i
+                     << " bound = " << b << " exact = " << exact[i] << " res = " << dists[i] << endl;
+                res = false;
+            }
+        }
+    }
+    EXPECT_EQ(uint64_t(3 * qty), query.DistanceComputations());
+
+    for (const Object* o : data) delete o;
+    return res;
+}
+
+TEST(SpaceLpBatch) {
+    for (float p : {1.0f, 2.0f, 3.0f}) {
+        for (size_t dim : {3, 16, 100, 300}) {
+            EXPECT_TRUE(TestSpaceLpBatch(p, dim, 37));
+            EXPECT_TRUE(TestSpaceLpBatch(p, dim, 100));
+        }
+    }
+}
+
+TEST(HalfFloatConversion) {
+    // Values that are exactly representable by both formats
+    for (float v : {0.0f, -0.0f, 1.0f, -2.5f, 0.375f, 256.0f, -1024.0f}) {
+        EXPECT_EQ(v, ToFloat(FromFloat<Float16>(v)));
+        EXPECT_EQ(v, ToFloat(FromFloat<BFloat16>(v)));
+    }
+    // Largest half, overflow, and the smallest subnormal half
+    EXPECT_EQ(65504.0f, ToFloat(FromFloat<Float16>(65504.0f)));
+    EXPECT_EQ(numeric_limits<float>::infinity(), ToFloat(FromFloat<Float16>(1e6f)));
+    EXPECT_EQ(ldexp(1.0f, -24), ToFloat(FromFloat<Float16>(ldexp(1.0f, -24))));
+    EXPECT_EQ(3 * ldexp(1.0f, -24), ToFloat(FromFloat<Float16>(3 * ldexp(1.0f, -24))));
+    // Ties are rounded to even
+    EXPECT_EQ(1.0f, ToFloat(FromFloat<Float16>(1.0f + ldexp(1.0f, -11))));
+    EXPECT_EQ(1.0f + ldexp(1.0f, -9), ToFloat(FromFloat<Float16>(1.0f + 3 * ldexp(1.0f, -11))));
+    EXPECT_EQ(1.0f, ToFloat(FromFloat<BFloat16>(1.0f + ldexp(1.0f, -8))));
+    EXPECT_EQ(1.0f + ldexp(1.0f, -6), ToFloat(FromFloat<BFloat16>(1.0f + 3 * ldexp(1.0f, -8))));
+    // Rounding errors are within a half of the unit in the last place
+    for (size_t i = 0; i < 1000; ++i) {
+        float v = RANGE * (2 * RandomReal<float>() - 1);
+        EXPECT_TRUE(fabs(ToFloat(FromFloat<Float16>(v)) - v) <= fabs(v) * ldexp(1.0f, -11));
+        EXPECT_TRUE(fabs(ToFloat(FromFloat<BFloat16>(v)) - v) <= fabs(v) * ldexp(1.0f, -8));
+    }
+}
+
+/*
+ * Distances between 16-bit vectors should be (nearly) the same
+ * as distances between the same vectors converted to 32-bit floats.
+ */
+template <class T>
+bool TestHalfDistAgree(size_t N, size_t dim) {
+    vector<float> vect1(dim), vect2(dim);
+    vector<T>     half1(dim), half2(dim);
+
+    for (size_t i = 0; i < N; ++i) {
+        GenRandVect(&vect1[0], dim, -float(RANGE), float(RANGE));
+        GenRandVect(&vect2[0], dim, -float(RANGE), float(RANGE));
+        for (size_t k = 0; k < dim; ++k) {
+            half1[k] = FromFloat<T>(vect1[k]);
+            half2[k] = FromFloat<T>(vect2[k]);
+            vect1[k] = ToFloat(half1[k]);
+            vect2[k] = ToFloat(half2[k]);
+        }
+        float dists[3][2] = {
+          {L2NormHalf(&half1[0], &half2[0], dim), L2NormStandard(&vect1[0], &vect2[0], dim)},
+          {ScalarProductHalf(&half1[0], &half2[0], dim), ScalarProduct(&vect1[0], &vect2[0], dim)},
+          {NormScalarProductHalf(&half1[0], &half2[0], dim), NormScalarProduct(&vect1[0], &vect2[0], dim)}
+        };
+        for (size_t k = 0; k < 3; ++k) {
+            // Scalar products of long vectors can nearly cancel out, so the tolerance is absolute
+            if (fabs(dists[k][0] - dists[k][1]) > 1e-5f * dim * RANGE * RANGE) {
+                cerr << "Bug half-float distance " << k << " !!! Dim = " << dim
+                     << " res = " << dists[k][0] << " expected = " << dists[k][1] << endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(HalfDistAgree) {
+    for (size_t dim = 1; dim <= 100; ++dim) {
+        EXPECT_TRUE(TestHalfDistAgree<Float16>(20, dim));
+        EXPECT_TRUE(TestHalfDistAgree<BFloat16>(20, dim));
+    }
+}
+
 bool TestL2SqrExtSSEAgree(size_t N, size_t dim, size_t Rep) {
     vector<float> vect1(dim), vect2(dim);
     float* pVect1 = &vect1[0];
@@ -960,42 +1314,52 @@ bool TestLPGenericAgree(size_t N, size_t dim, size_t Rep, T power) {
     return true;
 }
 
+template <class uint_t>
 bool TestBitHammingAgree(size_t N, size_t dim, size_t Rep) {
-    size_t WordQty = (dim + 31)/32; 
-    vector<uint32_t> arr(N * WordQty);
-    uint32_t*        pArr = &arr[0];
+    const size_t WordBitQty = 8 * sizeof(uint_t);
+    size_t WordQty = (dim + WordBitQty - 1)/WordBitQty;
+    vector<uint_t> arr(N * WordQty);
+    uint_t*        pArr = &arr[0];
 
-    uint32_t *p = pArr;
+    uint_t *p = pArr;
     for (size_t i = 0; i < N; ++i, p+= WordQty) {
         vector<PivotIdType> perm(dim);
         GenRandIntVect(&perm[0], dim);
         for (unsigned j = 0; j < dim; ++j)
           perm[j] = perm[j] % 2;
-        vector<uint32_t> h;
+        vector<uint_t> h;
         Binarize(perm, 1, h); 
         CHECK(h.size() == WordQty);
         memcpy(p, &h[0], WordQty * sizeof(h[0]));
     }
 
-    WallClockTimer  t;
-
-    t.reset();
+    vector<const uint_t*> vects(N);
+    vector<unsigned>      batchDists(N);
+    for (size_t j = 0; j < N; ++j) vects[j] = pArr + j*WordQty;
+    // The query is the first vector
+    BitHammingBatch(pArr, &vects[0], N, WordQty, &batchDists[0]);
 
     bool res = true;
 
     for (size_t j = 1; j < N; ++j) {
-        uint32_t* pVect1 = pArr + j*WordQty;
-        uint32_t* pVect2 = pArr + (j-1)*WordQty;
+        uint_t* pVect1 = pArr + j*WordQty;
+        uint_t* pVect2 = pArr + (j-1)*WordQty;
         int d1 =  BitHamming(pVect1, pVect2, WordQty);
         int d2 = 0;
 
         for (unsigned t = 0; t < WordQty; ++t) {
-          for (unsigned k = 0; k < 32; ++k) {
+          for (unsigned k = 0; k < WordBitQty; ++k) {
             d2 += ((pVect1[t]>>k)&1) != ((pVect2[t]>>k)&1);
           }
         }
         if (d1 != d2) {
-          cerr << "Bug bit hamming, WordQty = " << WordQty << " d1 = " << d1 << " d2 = " << d2 << endl;
+          cerr << "Bug bit hamming, WordBitQty = " << WordBitQty << " WordQty = " << WordQty << " d1 = " << d1 << " d2 = " << d2 << endl;
+          res = false;
+          break;
+        }
+        int d3 = BitHamming(pVect1, pArr, WordQty);
+        if (int(batchDists[j]) != d3) {
+          cerr << "Bug batch bit hamming, WordBitQty = " << WordBitQty << " WordQty = " << WordQty << " d1 = " << batchDists[j] << " d2 = " << d3 << endl;
           res = false;
           break;
         }
@@ -1308,7 +1672,8 @@ TEST(TestAgree) {
     for (unsigned dim = 1; dim <= 1024; dim+=2) {
         LOG(LIB_INFO) << "Dim = " << dim;
 
-        nFail += !TestBitHammingAgree(1000, dim, 1000);
+        nFail += !TestBitHammingAgree<uint32_t>(1000, dim, 1000);
+        nFail += !TestBitHammingAgree<uint64_t>(1000, dim, 1000);
     }
 
     for (unsigned dim = 16; dim <= 256; dim += 16) {
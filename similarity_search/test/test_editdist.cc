@@ -14,8 +14,12 @@
  */
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "space/space_leven.h"
+#include "knnquery.h"
+#include "knnqueue.h"
+#include "rangequery.h"
 #include "distcomp_edist.h"
 #include "bunit.h"
 #include "testdataset.h"
@@ -115,4 +119,131 @@ TEST(EditDistanceLong) {
 
 }
 
+template <class T>
+basic_string<T> GenRandEditDistStr(size_t maxLen, size_t alphabetSize) {
+  basic_string<T> res(RandomInt() % (maxLen + 1), T(0));
+  for (size_t i = 0; i < res.size(); ++i) res[i] = T('a' + RandomInt() % alphabetSize);
+  return res;
+}
+
+/*
+ * Compares the bit-parallel algorithm (including the bounded version
+ * and the version that processes several strings at once) with the classic one.
+ * Strings with both short and long patterns (i.e., more than 64 symbols) are generated.
+ */
+template <class T>
+bool TestBitParallelEditDist(size_t maxLen, size_t alphabetSize, size_t qty) {
+  const size_t BATCH_QTY = 7;
+  bool res = true;
+  for (size_t iter = 0; iter < qty; ++iter) {
+    basic_string<T> pattern = GenRandEditDistStr<T>(maxLen, alphabetSize);
+    vector<basic_string<T>> vStr;
+    for (size_t i = 0; i < BATCH_QTY; ++i) {
+      // Let's have some strings that are close to the pattern
+      if (i % 2 && !pattern.empty()) {
+        basic_string<T> s = pattern;
+        for (size_t k = 0; k < 3; ++k) s[RandomInt() % s.size()] = T('a' + RandomInt() % alphabetSize);
+        vStr.push_back(s.substr(RandomInt() % min(s.size(), size_t(3))));
+      } else {
+        vStr.push_back(GenRandEditDistStr<T>(maxLen, alphabetSize));
+      }
+    }
+
+    LevenshteinPattern<T> pat(pattern.c_str(), pattern.size());
+    vector<const T*>      vpStr;
+    vector<size_t>        vLen;
+    vector<int>           vExp;
+    for (const auto& s : vStr) {
+      vpStr.push_back(s.c_str());
+      vLen.push_back(s.size());
+      vExp.push_back(levenshteinSimple(pattern.c_str(), pattern.size(), s.c_str(), s.size()));
+    }
+    for (size_t i = 0; i < BATCH_QTY; ++i) {
+      const basic_string<T>& s = vStr[i];
+      int d1 = levenshtein(pattern.c_str(), pattern.size(), s.c_str(), s.size());
+      int d2 = levenshtein(s.c_str(), s.size(), pattern.c_str(), pattern.size());
+      int d3 = pat.Distance(s.c_str(), s.size());
+      if (d1 != vExp[i] || d2 != vExp[i] || d3 != vExp[i]) {
+        LOG(LIB_ERROR) << "Bug, expected: " << vExp[i] << " got " << d1 << " " << d2 << " " << d3 
+                       << " lengths: " << pattern.size() << " " << s.size();
+        res = false;
+      }
+    }
+    for (int maxDist : {0, 1, 2, 5, 10, 50, 100}) {
+      vector<int> vDist(BATCH_QTY);
+      pat.Distances(&vpStr[0], &vLen[0], BATCH_QTY, &vDist[0], maxDist);
+      for (size_t i = 0; i < BATCH_QTY; ++i) {
+        const basic_string<T>& s = vStr[i];
+        int d1 = levenshteinBounded(pattern.c_str(), pattern.size(), s.c_str(), s.size(), maxDist);
+        int d2 = pat.Distance(s.c_str(), s.size(), maxDist);
+        for (int d : {d1, d2, vDist[i]}) {
+          if (vExp[i] <= maxDist ? d != vExp[i] : d <= maxDist) {
+            LOG(LIB_ERROR) << "Bug, expected: " << vExp[i] << " got " << d << " maxDist: " << maxDist 
+                           << " lengths: " << pattern.size() << " " << s.size();
+            res = false;
+          }
+        }
+      }
+    }
+  }
+  return res;
+}
+
+TEST(EditDistanceBitParallel) {
+  EXPECT_TRUE(TestBitParallelEditDist<char>(10, 3, 500));
+  EXPECT_TRUE(TestBitParallelEditDist<char>(70, 2, 300));
+  EXPECT_TRUE(TestBitParallelEditDist<char>(300, 4, 100));
+  EXPECT_TRUE(TestBitParallelEditDist<char32_t>(70, 5, 300));
+  EXPECT_TRUE(TestBitParallelEditDist<char32_t>(300, 26, 100));
+}
+
+/*
+ * Queries compute bounded distances (see Space::HiddenDistanceBounded), 
+ * but the results should be the same as the results obtained using complete distances.
+ */
+template <class dist_t>
+bool TestBoundedEditDistSearch(const StringSpace<dist_t>& space, size_t maxLen, size_t qty) {
+  ObjectVector data;
+  for (size_t i = 0; i < qty; ++i) {
+    data.push_back(space.CreateObjFromStr(i, -1, GenRandEditDistStr<char>(maxLen, 4) + "a", NULL).release());
+  }
+  bool res = true;
+  for (size_t q = 0; q < 10; ++q) {
+    unique_ptr<Object> queryObj(space.CreateObjFromStr(-1, -1, GenRandEditDistStr<char>(maxLen, 4) + "a", NULL));
+    vector<pair<dist_t, const Object*>> vExp;
+    for (const Object* o : data) vExp.push_back(make_pair(space.IndexTimeDistance(o, queryObj.get()), o));
+    sort(vExp.begin(), vExp.end());
+
+    const unsigned K = 10;
+    KNNQuery<dist_t> knn(space, queryObj.get(), K);
+    RangeQuery<dist_t> range(space, queryObj.get(), vExp[K].first);
+    for (const Object* o : data) {
+      knn.CheckAndAddToResult(o);
+      range.CheckAndAddToResult(o);
+    }
+    unique_ptr<KNNQueue<dist_t>> knnRes(knn.Result()->Clone());
+    for (int i = K - 1; i >= 0; --i) {
+      res = res && !knnRes->Empty() && knnRes->TopDistance() == vExp[i].first;
+      knnRes->Pop();
+    }
+    size_t rangeQty = 0;
+    while (rangeQty < vExp.size() && vExp[rangeQty].first <= range.Radius()) ++rangeQty;
+    res = res && range.ResultSize() == rangeQty;
+    for (size_t i = 0; i < range.ResultSize(); ++i) {
+      res = res && (*range.ResultDists())[i] == space.IndexTimeDistance((*range.Result())[i], queryObj.get());
+    }
+  }
+  for (const Object* o : data) delete o;
+  return res;
+}
+
+TEST(EditDistanceBoundedSearch) {
+  SpaceLevenshtein space1;
+  SpaceLevenshteinNormalized space2;
+  EXPECT_TRUE(TestBoundedEditDistSearch(space1, 20, 1000));
+  EXPECT_TRUE(TestBoundedEditDistSearch(space1, 150, 300));
+  EXPECT_TRUE(TestBoundedEditDistSearch(space2, 20, 1000));
+  EXPECT_TRUE(TestBoundedEditDistSearch(space2, 150, 300));
+}
+
 }  // namespace similarity
@@ -0,0 +1,184 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+#include "bunit.h"
+#include "genrand_vect.h"
+#include "experimentconf.h"
+#include "gold_standard.h"
+#include "space/space_lp.h"
+
+namespace similarity {
+
+using std::vector;
+using std::stringstream;
+
+const float GS_TEST_KEEP_COEFF = 3;
+
+// Compares gold standard entries with ones obtained by a straightforward sequential search
+bool CheckGoldStandard(const Space<float>& space, const ObjectVector& data, const Object* pQuery,
+                       size_t K, float radius, const GoldStandard<float>& gs) {
+  vector<ResultEntry<float>> expEntries;
+  size_t resultQty = 0;
+  for (const Object* o : data) {
+    float dist = space.IndexTimeDistance(o, pQuery);
+    expEntries.push_back(ResultEntry<float>(o->id(), o->label(), dist));
+    resultQty += K ? 0 : dist <= radius;
+  }
+  std::sort(expEntries.begin(), expEntries.end());
+  if (K) resultQty = std::min(K, data.size());
+  size_t keepQty = std::min(expEntries.size(), (size_t)std::round(resultQty * GS_TEST_KEEP_COEFF));
+  if (keepQty) expEntries.resize(keepQty);
+
+  const vector<ResultEntry<float>>& actEntries = gs.GetSortedEntries();
+  if (expEntries.size() != actEntries.size()) {
+    LOG(LIB_ERROR) << "Size mismatch, expected: " << expEntries.size() << " actual: " << actEntries.size();
+    return false;
+  }
+  for (size_t i = 0; i < expEntries.size(); ++i) {
+    if (!(expEntries[i] == actEntries[i])) {
+      LOG(LIB_ERROR) << "Entry mismatch, expected: " << expEntries[i] << " actual: " << actEntries[i];
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CheckGoldStandardManager(const ExperimentConfig<float>& config, const GoldStandardManager<float>& managerGS) {
+  bool res = true;
+  const ObjectVector& queries = config.GetQueryObjects();
+  for (size_t q = 0; q < queries.size(); ++q) {
+    for (size_t i = 0; i < config.GetRange().size(); ++i) {
+      res = res && CheckGoldStandard(config.GetSpace(), config.GetDataObjects(), queries[q],
+                                     0, config.GetRange()[i], *managerGS.GetRangeGS(i)[q]);
+    }
+    for (size_t i = 0; i < config.GetKNN().size(); ++i) {
+      res = res && CheckGoldStandard(config.GetSpace(), config.GetDataObjects(), queries[q],
+                                     config.GetKNN()[i], 0, *managerGS.GetKNNGS(i)[q]);
+    }
+  }
+  return res;
+}
+
+/*
+ * Computes the gold standard for the first oldDataQty points, saves and reads it,
+ * extends it to all data points, and compares results with the straightforward search.
+ */
+bool TestGoldStandard(Space<float>& space, size_t dim, size_t dataQty, size_t oldDataQty, size_t queryQty) {
+  ObjectVector data, queries;
+  vector<float> vect(dim);
+  for (size_t i = 0; i < dataQty + queryQty; ++i) {
+    GenRandVect(&vect[0], dim, 0.0f, 1.0f);
+    // Let's have some duplicates, which have the same distances to queries
+    if (i % 100 == 7 && i < dataQty) {
+      data.push_back(new Object(i, -1, dim * sizeof(float), data.back()->data()));
+      continue;
+    }
+    Object* o = new Object(i, -1, dim * sizeof(float), &vect[0]);
+    if (i < dataQty) data.push_back(o); else queries.push_back(o);
+  }
+
+  vector<unsigned> knn = {1, 10};
+  vector<float>    range = {0.5f};
+
+  ExperimentConfig<float> oldConfig(space, data, queries, 0, oldDataQty, queryQty, knn, 0, range);
+  ExperimentConfig<float> config(space, data, queries, 0, dataQty, queryQty, knn, 0, range);
+  oldConfig.ReadDataset();
+  config.ReadDataset();
+
+  GoldStandardManager<float> oldManagerGS(oldConfig);
+  oldManagerGS.Compute(3, GS_TEST_KEEP_COEFF);
+  bool res = CheckGoldStandardManager(oldConfig, oldManagerGS);
+
+  stringstream controlStream, binaryStream;
+  oldManagerGS.Write(controlStream, binaryStream, 0, 3);
+
+  GoldStandardManager<float> managerGS(config);
+  size_t testSetId = 0, threadQty = 0;
+  managerGS.Read(controlStream, binaryStream, queryQty, testSetId, threadQty);
+  EXPECT_EQ(size_t(3), threadQty);
+
+  managerGS.Extend(2, GS_TEST_KEEP_COEFF, oldDataQty);
+  /*
+   * For range queries, the extended gold standard may have fewer entries
+   * beyond the radius, so only k-NN queries are checked.
+   */
+  for (size_t q = 0; q < queryQty; ++q) {
+    for (size_t i = 0; i < knn.size(); ++i) {
+      res = res && CheckGoldStandard(space, config.GetDataObjects(), config.GetQueryObjects()[q],
+                                     knn[i], 0, *managerGS.GetKNNGS(i)[q]);
+    }
+  }
+
+  for (const Object* o : data) delete o;
+  for (const Object* o : queries) delete o;
+  return res;
+}
+
+TEST(GoldStandardL2) {
+  SpaceLp<float> space(2);
+  for (size_t dim : {1, 4, 33}) {
+    EXPECT_TRUE(TestGoldStandard(space, dim, 2000, 1500, 40));
+  }
+}
+
+TEST(GoldStandardL1) {
+  SpaceLp<float> space(1);
+  for (size_t dim : {1, 4, 33}) {
+    EXPECT_TRUE(TestGoldStandard(space, dim, 2000, 1500, 40));
+  }
+}
+
+TEST(GoldStandardCorruptCache) {
+  SpaceLp<float> space(2);
+  ObjectVector data, queries;
+  vector<float> vect(8);
+  for (size_t i = 0; i < 110; ++i) {
+    GenRandVect(&vect[0], vect.size(), 0.0f, 1.0f);
+    Object* o = new Object(i, -1, vect.size() * sizeof(float), &vect[0]);
+    if (i < 100) data.push_back(o); else queries.push_back(o);
+  }
+  vector<unsigned> knn = {5};
+  ExperimentConfig<float> config(space, data, queries, 0, data.size(), queries.size(), knn, 0, vector<float>());
+  config.ReadDataset();
+
+  GoldStandardManager<float> managerGS(config);
+  managerGS.Compute(1, GS_TEST_KEEP_COEFF);
+
+  stringstream controlStream, binaryStream;
+  managerGS.Write(controlStream, binaryStream, 0, 1);
+
+  string binaryData = binaryStream.str();
+  binaryData[binaryData.size() / 2] ^= 1;
+  stringstream corruptBinaryStream(binaryData);
+
+  bool thrown = false;
+  try {
+    size_t testSetId = 0, threadQty = 0;
+    managerGS.Read(controlStream, corruptBinaryStream, queries.size(), testSetId, threadQty);
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  EXPECT_TRUE(thrown);
+
+  for (const Object* o : data) delete o;
+  for (const Object* o : queries) delete o;
+}
+
+}  // namespace similarity
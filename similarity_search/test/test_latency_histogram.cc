@@ -0,0 +1,71 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+#include "bunit.h"
+#include "latency_histogram.h"
+
+namespace similarity {
+
+using std::vector;
+
+TEST(LatencyHistogramBuckets) {
+  // Bucket upper bounds should be consistent with bucket indices
+  for (uint64_t val : {uint64_t(0), uint64_t(1), uint64_t(255), uint64_t(256), uint64_t(257),
+                       uint64_t(1000), uint64_t(123456789), UINT64_MAX}) {
+    size_t bucketId = LatencyHistogram::BucketIndex(val);
+    uint64_t upper = LatencyHistogram::BucketUpperBound(bucketId);
+    EXPECT_TRUE(upper >= val);
+    EXPECT_EQ(bucketId, LatencyHistogram::BucketIndex(upper));
+    if (upper < UINT64_MAX) {
+      EXPECT_EQ(bucketId + 1, LatencyHistogram::BucketIndex(upper + 1));
+    }
+  }
+}
+
+TEST(LatencyHistogramPercentiles) {
+  std::mt19937 gen(0);
+  std::exponential_distribution<double> distr(1e-4);
+
+  vector<uint64_t> vals;
+  LatencyHistogram hist1, hist2;
+  for (size_t i = 0; i < 20000; ++i) {
+    uint64_t val = static_cast<uint64_t>(distr(gen));
+    vals.push_back(val);
+    // Let's check merging as well
+    if (i % 3) hist1.Record(val); else hist2.Record(val);
+  }
+  hist1.Merge(hist2);
+  EXPECT_EQ(uint64_t(vals.size()), hist1.Count());
+
+  std::sort(vals.begin(), vals.end());
+  EXPECT_EQ(vals.back(), hist1.Max());
+  for (double pct : {1.0, 50.0, 90.0, 99.0, 99.9, 100.0}) {
+    size_t rank = std::max<size_t>(1, static_cast<size_t>(pct / 100 * vals.size() + 0.5));
+    uint64_t exact = vals[rank - 1];
+    uint64_t approx = hist1.Percentile(pct);
+    EXPECT_TRUE(approx >= exact);
+    EXPECT_TRUE(approx <= exact + exact / LatencyHistogram::SUB_BUCKET_QTY);
+  }
+
+  hist1.Clear();
+  EXPECT_EQ(uint64_t(0), hist1.Count());
+  EXPECT_EQ(uint64_t(0), hist1.Percentile(50));
+}
+
+}  // namespace similarity
@@ -0,0 +1,115 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bunit.h"
+#include "genrand_vect.h"
+#include "knnquery.h"
+#include "params.h"
+#include "method/hnsw.h"
+#include "method/small_world_rand.h"
+#include "space/space_lp.h"
+
+namespace similarity {
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+/*
+ * Searches run concurrently with changes of query-time parameters.
+ * Each search should use a consistent set of parameters and find K answers.
+ */
+void TestConcurrentQueryTimeParams(Index<float>& index, const Space<float>& space,
+                                   const vector<string>& paramSets) {
+  const size_t dim = 16, queryQty = 100, K = 10, threadQty = 4;
+
+  EXPECT_TRUE(index.ConcurrentQueryTimeParams());
+
+  ObjectVector queries;
+  vector<float> vect(dim);
+  for (size_t i = 0; i < queryQty; ++i) {
+    GenRandVect(&vect[0], dim, -1.0f, 1.0f);
+    queries.push_back(new Object(i, -1, dim * sizeof(float), &vect[0]));
+  }
+
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> badQty(0), searchQty(0);
+  vector<std::thread> threads;
+  for (size_t t = 0; t < threadQty; ++t) {
+    threads.emplace_back([&]() {
+      while (!stop) {
+        for (const Object* q : queries) {
+          KNNQuery<float> knn(space, q, K);
+          index.Search(&knn, -1);
+          if (knn.ResultSize() != K) ++badQty;
+          ++searchQty;
+        }
+      }
+    });
+  }
+
+  for (size_t i = 0; i < 20; ++i) {
+    vector<string> desc;
+    ParseArg(paramSets[i % paramSets.size()], desc);
+    index.SetQueryTimeParams(AnyParams(desc));
+    // Let searches run with these parameters
+    const size_t startQty = searchQty;
+    while (searchQty < startQty + queryQty) std::this_thread::yield();
+  }
+  stop = true;
+  for (auto& t : threads) t.join();
+
+  EXPECT_EQ(size_t(0), badQty.load());
+  for (const Object* o : queries) delete o;
+}
+
+void CreateRandomData(size_t dim, size_t qty, ObjectVector& data) {
+  vector<float> vect(dim);
+  for (size_t i = 0; i < qty; ++i) {
+    GenRandVect(&vect[0], dim, -1.0f, 1.0f);
+    data.push_back(new Object(i, -1, dim * sizeof(float), &vect[0]));
+  }
+}
+
+TEST(HnswConcurrentQueryTimeParams) {
+  SpaceLp<float> space(2);
+  ObjectVector data;
+  CreateRandomData(16, 2000, data);
+
+  Hnsw<float> index(false, space, data);
+  index.CreateIndex(AnyParams({"M=8", "efConstruction=50"}));
+  TestConcurrentQueryTimeParams(index, space, {"ef=10,algoType=old", "ef=100,algoType=v1merge", "efByK=1:20;10:50"});
+
+  for (const Object* o : data) delete o;
+}
+
+TEST(SmallWorldRandConcurrentQueryTimeParams) {
+  SpaceLp<float> space(2);
+  ObjectVector data;
+  CreateRandomData(16, 2000, data);
+
+  SmallWorldRand<float> index(false, space, data);
+  index.CreateIndex(AnyParams({"NN=10", "efConstruction=50"}));
+  TestConcurrentQueryTimeParams(index, space, {"efSearch=10,algoType=old", "efSearch=100,algoType=v1merge", "efByK=1:20;10:50"});
+
+  for (const Object* o : data) delete o;
+}
+
+}  // namespace similarity
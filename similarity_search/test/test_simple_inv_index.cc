@@ -0,0 +1,195 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bunit.h"
+#include "genrand_vect.h"
+#include "knnquery.h"
+#include "knnqueue.h"
+#include "params.h"
+#include "method/simple_inverted_index.h"
+#include "space/space_sparse_scalar_fast.h"
+
+namespace similarity {
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+/*
+ * Offsets of the binary index format (see simple_inverted_index.cc): the 64-byte header
+ * is followed by the dictionary (48-byte entries for float) and 8-byte postings.
+ */
+const size_t SIMPL_INV_HEADER_SIZE        = 64;
+const size_t SIMPL_INV_TERM_QTY_OFFSET    = 40;
+const size_t SIMPL_INV_TERM_ENTRY_SIZE    = 48;
+const size_t SIMPL_INV_TERM_POST_QTY_OFF  = 16;
+const size_t SIMPL_INV_TERM_BLOCK_QTY_OFF = 32;
+
+const char* SIMPL_INV_TMP_FILE = "tmp_simple_invindx.bin";
+
+string ReadFileBytes(const string& fileName) {
+  std::ifstream in(fileName, std::ios::binary);
+  return string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void WriteFileBytes(const string& fileName, const string& bytes) {
+  std::ofstream out(fileName, std::ios::binary);
+  out.write(bytes.data(), bytes.size());
+}
+
+template <typename T>
+T GetBytes(const string& bytes, size_t off) {
+  T res;
+  memcpy(&res, bytes.data() + off, sizeof(T));
+  return res;
+}
+
+template <typename T>
+void SetBytes(string& bytes, size_t off, T val) {
+  memcpy(&bytes[off], &val, sizeof(T));
+}
+
+// Returns (distance, id) pairs sorted from the farthest to the closest
+vector<std::pair<float, IdType>> RunQuery(const Index<float>& index, const Space<float>& space,
+                                          const Object* queryObj, size_t K) {
+  KNNQuery<float> query(space, queryObj, K);
+  index.Search(&query, -1);
+  unique_ptr<KNNQueue<float>> res(query.Result()->Clone());
+  vector<std::pair<float, IdType>> resVect;
+  while (!res->Empty()) {
+    resVect.push_back(std::make_pair(res->TopDistance(), res->TopObject()->id()));
+    res->Pop();
+  }
+  return resVect;
+}
+
+bool LoadThrows(SimplInvIndex<float>& index, const string& fileName) {
+  try {
+    index.LoadIndex(fileName);
+  } catch (const std::exception&) {
+    return true;
+  }
+  return false;
+}
+
+class SimplInvIndexTestData {
+ public:
+  SimplInvIndexTestData(size_t dataQty, size_t queryQty) {
+    for (size_t i = 0; i < dataQty + queryQty; ++i) {
+      vector<SparseVectElem<float>> elems;
+      GenSparseVectZipf(500, elems);
+      (i < dataQty ? data_ : queries_).push_back(
+          space_.CreateObjFromVect(i < dataQty ? i : i - dataQty, -1, elems));
+    }
+  }
+  ~SimplInvIndexTestData() {
+    for (const Object* o : data_) delete o;
+    for (const Object* o : queries_) delete o;
+  }
+
+  SpaceSparseNegativeScalarProductFast space_;
+  ObjectVector                         data_;
+  ObjectVector                         queries_;
+};
+
+TEST(SimplInvIndexSaveLoad) {
+  SimplInvIndexTestData td(1000, 50);
+  const size_t K = 10;
+
+  SimplInvIndex<float> index(false, td.space_, td.data_);
+  index.CreateIndex(AnyParams({"blockSize=16", "impactOrdered=1"}));
+  index.SaveIndex(SIMPL_INV_TMP_FILE);
+
+  SimplInvIndex<float> loadedIndex(false, td.space_, td.data_);
+  loadedIndex.LoadIndex(SIMPL_INV_TMP_FILE);
+
+  for (const char* alg : {"invProcAlg=daat", "invProcAlg=wand", "invProcAlg=bmw", "invProcAlg=saat"}) {
+    index.SetQueryTimeParams(AnyParams({alg}));
+    loadedIndex.SetQueryTimeParams(AnyParams({alg}));
+    for (const Object* q : td.queries_) {
+      vector<std::pair<float, IdType>> res1 = RunQuery(index, td.space_, q, K);
+      vector<std::pair<float, IdType>> res2 = RunQuery(loadedIndex, td.space_, q, K);
+      EXPECT_EQ(K, res1.size());
+      EXPECT_TRUE(res1 == res2);
+    }
+  }
+
+  std::remove(SIMPL_INV_TMP_FILE);
+}
+
+TEST(SimplInvIndexLoadCorrupt) {
+  SimplInvIndexTestData td(300, 0);
+
+  {
+    SimplInvIndex<float> index(false, td.space_, td.data_);
+    index.CreateIndex(AnyParams({"blockSize=16", "impactOrdered=1"}));
+    index.SaveIndex(SIMPL_INV_TMP_FILE);
+  }
+  const string bytes = ReadFileBytes(SIMPL_INV_TMP_FILE);
+  const size_t termQty = GetBytes<uint64_t>(bytes, SIMPL_INV_TERM_QTY_OFFSET);
+  CHECK(termQty > 0);
+  const size_t postOffset = SIMPL_INV_HEADER_SIZE + termQty * SIMPL_INV_TERM_ENTRY_SIZE;
+
+  SimplInvIndex<float> index(false, td.space_, td.data_);
+
+  // A truncated file
+  WriteFileBytes(SIMPL_INV_TMP_FILE, bytes.substr(0, bytes.size() / 2));
+  EXPECT_TRUE(LoadThrows(index, SIMPL_INV_TMP_FILE));
+  // A file that isn't an index
+  {
+    string corrupt = bytes;
+    corrupt[0] ^= 1;
+    WriteFileBytes(SIMPL_INV_TMP_FILE, corrupt);
+    EXPECT_TRUE(LoadThrows(index, SIMPL_INV_TMP_FILE));
+  }
+  // An empty posting list, which is never saved
+  {
+    string corrupt = bytes;
+    SetBytes<uint64_t>(corrupt, SIMPL_INV_HEADER_SIZE + SIMPL_INV_TERM_POST_QTY_OFF, 0);
+    SetBytes<uint64_t>(corrupt, SIMPL_INV_HEADER_SIZE + SIMPL_INV_TERM_BLOCK_QTY_OFF, 0);
+    WriteFileBytes(SIMPL_INV_TMP_FILE, corrupt);
+    EXPECT_TRUE(LoadThrows(index, SIMPL_INV_TMP_FILE));
+  }
+  // A document id out of range: posting lists are validated only when they are accessed
+  {
+    string corrupt = bytes;
+    SetBytes<int32_t>(corrupt, postOffset, static_cast<int32_t>(td.data_.size() + 5));
+    WriteFileBytes(SIMPL_INV_TMP_FILE, corrupt);
+    EXPECT_FALSE(LoadThrows(index, SIMPL_INV_TMP_FILE));
+
+    // The query consists of the first term of the dictionary
+    const uint32_t termId = GetBytes<uint32_t>(bytes, SIMPL_INV_HEADER_SIZE);
+    unique_ptr<Object> queryObj(td.space_.CreateObjFromVect(0, -1, {SparseVectElem<float>(termId, 1.0f)}));
+    bool thrown = false;
+    try {
+      RunQuery(index, td.space_, queryObj.get(), 10);
+    } catch (const std::exception&) {
+      thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+  }
+
+  std::remove(SIMPL_INV_TMP_FILE);
+}
+
+}  // namespace similarity
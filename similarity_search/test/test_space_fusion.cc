@@ -0,0 +1,147 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+
+#include "bunit.h"
+#include "space.h"
+#include "knnquery.h"
+#include "genrand_vect.h"
+#include "space/space_sparse_dense_fusion.h"
+
+namespace similarity {
+
+using std::string;
+using std::vector;
+using std::ofstream;
+using std::unique_ptr;
+
+template <class T>
+void WriteFusionPOD(ofstream& out, T val) {
+  out.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+/*
+ * Creates a data file with one sparse component and one dense component.
+ * Some sparse vectors are empty (and some are long) to test different component sizes.
+ * Generated sparse products and dense vectors are memorized in vSparse and vDense.
+ */
+void CreateFusionDataFile(const string& fileName, size_t qty, size_t dim,
+                          vector<vector<SparseVectElem<float>>>& vSparse,
+                          vector<vector<float>>& vDense) {
+  ofstream out(fileName, std::ios::binary);
+  WriteFusionPOD(out, uint32_t(qty));
+  WriteFusionPOD(out, uint32_t(2));
+  WriteFusionPOD(out, uint32_t(1)); WriteFusionPOD(out, uint32_t(0));
+  WriteFusionPOD(out, uint32_t(0)); WriteFusionPOD(out, uint32_t(dim));
+
+  vSparse.resize(qty);
+  vDense.resize(qty);
+
+  for (size_t i = 0; i < qty; ++i) {
+    string id = "doc" + ConvertToString(i);
+    WriteFusionPOD(out, uint32_t(id.size()));
+    out.write(id.data(), id.size());
+
+    size_t sparseQty = (i % 5) * (i % 7) * 3;
+    WriteFusionPOD(out, uint32_t(sparseQty));
+    for (size_t k = 0; k < sparseQty; ++k) {
+      SparseVectElem<float> e(k * 3 + RandomInt() % 3, RandomReal<float>());
+      WriteFusionPOD(out, uint32_t(e.id_));
+      WriteFusionPOD(out, e.val_);
+      vSparse[i].push_back(e);
+    }
+
+    vDense[i].resize(dim);
+    GenRandVect(&vDense[i][0], dim, -1.0f, 1.0f);
+    WriteFusionPOD(out, uint32_t(dim));
+    for (float v : vDense[i]) WriteFusionPOD(out, v);
+  }
+}
+
+float FusionScalarProduct(const vector<SparseVectElem<float>>& v1, const vector<SparseVectElem<float>>& v2) {
+  float res = 0;
+  for (const auto& e1 : v1)
+  for (const auto& e2 : v2) {
+    if (e1.id_ == e2.id_) res += e1.val_ * e2.val_;
+  }
+  return res;
+}
+
+// Products are summed up in a different order, so we allow for a small absolute error
+bool FusionDistEqual(float dist, float expected) {
+  return std::fabs(dist - expected) <= 1e-4f * std::max(1.0f, std::fabs(expected));
+}
+
+TEST(SpaceSparseDenseFusionAgree) {
+  const string weightFileName = "tmp_fusion_weights.txt";
+  const string dataFileName   = "tmp_fusion_data.bin";
+  {
+    ofstream out(weightFileName);
+    out << "queryWeights: 0.7 0.3" << std::endl;
+    out << "indexWeights: 0.5 0" << std::endl;
+  }
+  const size_t qty = 60, dim = 13;
+  vector<vector<SparseVectElem<float>>> vSparse;
+  vector<vector<float>>                 vDense;
+  CreateFusionDataFile(dataFileName, qty, dim, vSparse, vDense);
+
+  bool res = true;
+  {
+    unique_ptr<Space<float>> space(new SpaceSparseDenseFusion(weightFileName));
+    ObjectVector data;
+    vector<string> externIds;
+    unique_ptr<DataFileInputState> inpState(space->ReadDataset(data, externIds, dataFileName));
+    space->UpdateParamsFromFile(*inpState);
+    EXPECT_EQ(qty, data.size());
+
+    for (size_t i = 0; i < data.size(); ++i) {
+      const Object* pQuery = data[i];
+      KNNQuery<float> query(*space, pQuery, 10);
+      for (size_t j = 0; j < data.size(); ++j) {
+        const Object* pObj = data[j];
+        float sparseVal = FusionScalarProduct(vSparse[j], vSparse[i]);
+        float denseVal = 0;
+        for (size_t k = 0; k < dim; ++k) denseVal += vDense[j][k] * vDense[i][k];
+
+        // Query-time distances use query weights
+        float dist = query.DistanceObjLeft(pObj);
+        if (!FusionDistEqual(dist, -(0.7f * sparseVal + 0.3f * denseVal)) ||
+            dist != space->IndexTimeDistance(pObj, pQuery)) {
+          LOG(LIB_ERROR) << "Query-time distance mismatch, query: " << pQuery->id() << " object: " << pObj->id();
+          res = false;
+        }
+        // Index-time distances use index weights, the dense component has zero weight
+        float proxyDist = space->ProxyDistance(pObj, pQuery);
+        if (!FusionDistEqual(proxyDist, -0.5f * sparseVal)) {
+          LOG(LIB_ERROR) << "Index-time distance mismatch, query: " << pQuery->id() << " object: " << pObj->id();
+          res = false;
+        }
+      }
+    }
+    for (const Object* o : data) delete o;
+  }
+  EXPECT_TRUE(res);
+
+  std::remove(weightFileName.c_str());
+  std::remove(dataFileName.c_str());
+}
+
+}  // namespace similarity
@@ -101,6 +101,25 @@ bool fullTestCommon(bool binTest, Space<dist_t>* pSpace,
     }
   }
 
+  if (binTest) {
+    // Memory-mapped objects should be exactly the same as the ones read from the file
+    ObjectVector dataSet3;
+    unique_ptr<MemMappedFile> mappedFile(pSpace->MapObjectVectorFromBinData(dataSet3, tmpFileName));
+    bool res = dataSet3.size() == dataSet2.size();
+    for (size_t i = 0; res && i < dataSet2.size(); ++i) {
+      res = dataSet2[i]->bufferlength() == dataSet3[i]->bufferlength() &&
+            !memcmp(dataSet2[i]->buffer(), dataSet3[i]->buffer(), dataSet2[i]->bufferlength());
+      if (!res) LOG(LIB_ERROR) << "Memory-mapped object is different, i = " << i;
+      // Unaligned objects should be copied
+      if (res && reinterpret_cast<uintptr_t>(dataSet3[i]->data()) % 8 != 0) {
+        LOG(LIB_ERROR) << "Memory-mapped object data isn't 8-byte aligned, i = " << i;
+        res = false;
+      }
+    }
+    for (const Object* o : dataSet3) delete o;
+    if (!res) return false;
+  }
+
   return true;
 }
 
@@ -192,6 +211,46 @@ TEST(Test_DenseVectorSpace) {
   }
 }
 
+TEST(Test_DenseVectorSpaceGenerated) {
+  vector<string> testVect;
+
+  for (size_t i = 0; i < MAX_NUM_REC; ++i) {
+    stringstream ss;
+
+    // An odd dimensionality makes objects in the binary file unaligned
+    for (size_t k = 0; k < 17; ++k) {
+      if (k) ss << " ";
+      ss << RandomReal<float>();
+    }
+    testVect.push_back(ss.str());
+  }
+  for (size_t maxNumRec = 1; maxNumRec < MAX_NUM_REC; ++maxNumRec) {
+    for (unsigned binTest = 0; binTest < 2; ++binTest) {
+      EXPECT_EQ(true, fullTest<float>(binTest, testVect, maxNumRec, "tmp_out_file.txt", "l2", emptyParams, false));
+    }
+  }
+}
+
+TEST(Test_DenseVectorSpaceHalf) {
+  vector<string> testVect;
+
+  for (size_t i = 0; i < MAX_NUM_REC; ++i) {
+    stringstream ss;
+
+    for (size_t k = 0; k < 17; ++k) {
+      if (k) ss << " ";
+      ss << RandomReal<float>();
+    }
+    testVect.push_back(ss.str());
+  }
+  for (size_t maxNumRec = 1; maxNumRec < MAX_NUM_REC; ++maxNumRec) {
+    for (unsigned binTest = 0; binTest < 2; ++binTest) {
+      EXPECT_EQ(true, fullTest<float>(binTest, testVect, maxNumRec, "tmp_out_file.txt", "l2_fp16", emptyParams, false));
+      EXPECT_EQ(true, fullTest<float>(binTest, testVect, maxNumRec, "tmp_out_file.txt", "negdotprod_bf16", emptyParams, false));
+    }
+  }
+}
+
 TEST(Test_DenseVectorKLDiv) {
   // Test KL-diverg. with and without precomputation of logarithms
   for (size_t maxNumRec = 1; maxNumRec < MAX_NUM_REC; ++maxNumRec) {
@@ -220,6 +279,29 @@ TEST(Test_SparseVectorSpaceFast) {
   }
 }
 
+TEST(Test_SparseVectorSpaceQuant) {
+  vector<string> testVect;
+
+  for (size_t i = 0; i < MAX_NUM_REC; ++i) {
+    stringstream ss;
+
+    uint32_t id = 0;
+    for (size_t k = 0; k < 50; ++k) {
+      // Some id differences need more than one byte
+      id += 1 + RandomInt() % (k % 5 ? 100 : 100000);
+      if (k) ss << " ";
+      ss << id << " " << RandomReal<float>() - 0.5f;
+    }
+    testVect.push_back(ss.str());
+  }
+  for (size_t maxNumRec = 1; maxNumRec < MAX_NUM_REC; ++maxNumRec) {
+    for (unsigned binTest = 0; binTest < 2; ++binTest) {
+      EXPECT_EQ(true, fullTest<float>(binTest, testVect, maxNumRec, "tmp_out_file.txt", "cosinesimil_sparse_q8", emptyParams, false));
+      EXPECT_EQ(true, fullTest<float>(binTest, testVect, maxNumRec, "tmp_out_file.txt", "negdotprod_sparse_q16", emptyParams, false));
+    }
+  }
+}
+
 TEST(Test_StringSpace) {
   for (size_t maxNumRec = 1; maxNumRec < MAX_NUM_REC; ++maxNumRec) {
     for (unsigned binTest = 0; binTest < 2; ++binTest) {
@@ -15,9 +15,12 @@
 #if defined(WITH_EXTRAS)
 
 #include <string.h>
+#include <memory>
 #include "space.h"
 #include "bunit.h"
+#include "knnquery.h"
 #include "testdataset.h"
+#include "genrand_vect.h"
 #include "space_sqfd.h"
 
 namespace similarity {
@@ -118,6 +121,48 @@ TEST(Sqfd) {
   delete o;
 }
 
+/*
+ * Objects created from strings keep the cached self-similarity term,
+ * objects created by CreateSqfdObject do not: distances should be the same,
+ * including the distances computed using the query state.
+ */
+TEST(Sqfd_CachedSelfTerm) {
+  const size_t dim = 7;
+  const size_t objQty = 20;
+
+  std::unique_ptr<Space<float>> space(new SpaceSqfd<float>(new SqfdHeuristicFunction<float>(1.0)));
+  std::vector<std::unique_ptr<Object>> rawObjs, cachedObjs;
+
+  for (size_t i = 0; i < objQty; ++i) {
+    // Also more than SQFD_BATCH_QTY clusters
+    const size_t clustQty = 1 + (i * 13) % 80;
+    std::vector<std::vector<float>> clust(clustQty, std::vector<float>(dim));
+    std::vector<float> weight(clustQty);
+    for (size_t k = 0; k < clustQty; ++k) {
+      GenRandVect(&clust[k][0], dim, 0.0f, 1.0f);
+      weight[k] = RandomReal<float>();
+    }
+    rawObjs.emplace_back(CreateSqfdObject(clust, weight));
+    // Raw objects and objects created from strings should have identical clusters
+    std::unique_ptr<Object> tmp(space->CreateObjFromStr(i, -1, space->CreateStrFromObj(rawObjs.back().get(), ""), NULL));
+    EXPECT_EQ(rawObjs.back()->datalength() + sizeof(double), tmp->datalength());
+    cachedObjs.emplace_back(tmp.release());
+  }
+
+  for (size_t i = 0; i < objQty; ++i) {
+    KNNQuery<float> queryRaw(*space, rawObjs[i].get(), 1);
+    KNNQuery<float> queryCached(*space, cachedObjs[i].get(), 1);
+    for (size_t k = 0; k < objQty; ++k) {
+      float d = space->IndexTimeDistance(rawObjs[k].get(), rawObjs[i].get());
+      EXPECT_EQ_EPS(d, space->IndexTimeDistance(cachedObjs[k].get(), cachedObjs[i].get()), 1e-4f);
+      EXPECT_EQ_EPS(d, space->IndexTimeDistance(rawObjs[k].get(), cachedObjs[i].get()), 1e-4f);
+      EXPECT_EQ_EPS(d, queryRaw.DistanceObjLeft(cachedObjs[k].get()), 1e-4f);
+      EXPECT_EQ_EPS(d, queryCached.DistanceObjLeft(rawObjs[k].get()), 1e-4f);
+      if (i == k) EXPECT_EQ_EPS(d, 0.0f, 1e-3f);
+    }
+  }
+}
+
 }  // namespace similarity
 
 #endif
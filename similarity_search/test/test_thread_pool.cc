@@ -12,6 +12,11 @@
  * Apache License Version 2.0 http://www.apache.org/licenses/.
  *
  */
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #include "logging.h"
 #include "bunit.h"
 #include "thread_pool.h"
@@ -43,4 +48,62 @@ TEST(TestParallelForException) {
   }
   EXPECT_EQ(has_thrown, true);
 }
+
+TEST(TestParallelForThreadIds) {
+  // threadId should be < numThreads and concurrent calls must have different threadIds
+  const size_t numThreads = 4;
+  std::vector<std::atomic<int>> busy(numThreads);
+  for (auto& b : busy) b = 0;
+  std::atomic<bool> ok(true);
+  ParallelFor(0, 1000, numThreads, [&](size_t id, size_t threadId) {
+    if (threadId >= numThreads) { ok = false; return; }
+    if (busy[threadId].fetch_add(1) != 0) ok = false;
+    busy[threadId].fetch_sub(1);
+  });
+  EXPECT_TRUE(ok.load());
+}
+
+TEST(TestParallelForNested) {
+  // nested calls should neither deadlock nor miss ids
+  const size_t outerQty = 50, innerQty = 100;
+  std::vector<int> res(outerQty * innerQty);
+  ParallelFor(0, outerQty, 4, [&](size_t outerId, size_t) {
+    ParallelFor(0, innerQty, 4, [&](size_t innerId, size_t) {
+      res[outerId * innerQty + innerId] += 1;
+    });
+  });
+  for (size_t i = 0; i < res.size(); ++i) {
+    EXPECT_EQ(res[i], 1);
+  }
+}
+
+TEST(TestRunInDedicatedThreads) {
+  // all calls should run concurrently, even if there are more of them than pool threads
+  const size_t threadQty = 4 * (ThreadPool::Global().GetThreadQty() + 1);
+  std::atomic<size_t> startedQty(0);
+  std::atomic<bool> ok(true);
+  RunInDedicatedThreads(threadQty, [&](size_t threadId) {
+    ++startedQty;
+    // wait (with a generous timeout) until all other calls start
+    for (size_t i = 0; i < 10000 && startedQty < threadQty; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (startedQty < threadQty) ok = false;
+  });
+  EXPECT_TRUE(ok.load());
+}
+
+TEST(TestThreadPoolSubmit) {
+  ThreadPool pool(2);
+  std::atomic<size_t> sum(0);
+  const size_t qty = 1000;
+  for (size_t i = 0; i < qty; ++i) {
+    pool.Submit([&sum, i] { sum += i; });
+  }
+  while (sum != qty * (qty - 1) / 2) {
+    if (!pool.RunPendingTask()) std::this_thread::yield();
+  }
+  EXPECT_EQ(sum.load(), qty * (qty - 1) / 2);
+}
+
 }  // namespace similarity
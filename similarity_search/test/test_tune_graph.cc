@@ -0,0 +1,84 @@
+/**
+ * Non-metric Space Library
+ *
+ * Main developers: Bilegsaikhan Naidan, Leonid Boytsov, Yury Malkov, Ben Frederickson, David Novak
+ *
+ * For the complete list of contributors and further details see:
+ * https://github.com/nmslib/nmslib
+ *
+ * Copyright (c) 2013-2018
+ *
+ * This code is released under the
+ * Apache License Version 2.0 http://www.apache.org/licenses/.
+ *
+ */
+#include <vector>
+#include <algorithm>
+
+#include "bunit.h"
+#include "ef_schedule.h"
+#include "tune.h"
+
+namespace similarity {
+
+using std::vector;
+
+TEST(EfSchedule) {
+  EfSchedule schedule;
+
+  EXPECT_TRUE(schedule.Empty());
+  EXPECT_EQ(size_t(100), schedule.GetEf(10, 100));
+
+  schedule.Parse("100:200;1:20;10:40");
+  EXPECT_FALSE(schedule.Empty());
+  EXPECT_TRUE(schedule.ToString() == "1:20;10:40;100:200");
+
+  EXPECT_EQ(size_t(20), schedule.GetEf(1, 100));
+  EXPECT_EQ(size_t(40), schedule.GetEf(2, 100));
+  EXPECT_EQ(size_t(40), schedule.GetEf(10, 100));
+  EXPECT_EQ(size_t(200), schedule.GetEf(11, 100));
+  EXPECT_EQ(size_t(200), schedule.GetEf(100, 100));
+  // There's no entry for k > 100, so the default is used
+  EXPECT_EQ(size_t(300), schedule.GetEf(101, 300));
+
+  schedule.Parse("");
+  EXPECT_TRUE(schedule.Empty());
+
+  for (const char* bad : {"10", "10:", "0:10", "10:0", "a:b", "1:2:3"}) {
+    bool thrown = false;
+    try {
+      schedule.Parse(bad);
+    } catch (const std::exception&) {
+      thrown = true;
+    }
+    EXPECT_TRUE(thrown);
+  }
+}
+
+TEST(ParetoFrontier) {
+  auto mkPoint = [](unsigned K, double recall, double p99, double mem) {
+    TunePoint p;
+    p.K = K; p.Ef = 0;
+    p.Recall = recall; p.QueryTime = p.QueryTimeP99 = p99;
+    p.Mem = mem; p.IndexTime = 0;
+    return p;
+  };
+
+  vector<TunePoint> points = {
+    mkPoint(1, 0.90, 1.0, 10),  // 0: on the frontier
+    mkPoint(1, 0.95, 2.0, 10),  // 1: on the frontier
+    mkPoint(1, 0.90, 1.5, 10),  // 2: dominated by 0
+    mkPoint(1, 0.95, 2.0, 20),  // 3: dominated by 1
+    mkPoint(1, 0.80, 0.5, 30),  // 4: on the frontier: the fastest one
+    mkPoint(10, 0.85, 3.0, 30), // 5: on the frontier, points with other k aren't compared
+    mkPoint(1, 0.90, 1.0, 10),  // 6: a duplicate of 0, duplicates don't dominate each other
+  };
+
+  vector<size_t> frontier = ComputeParetoFrontier(points);
+  vector<size_t> expected = {0, 1, 4, 5, 6};
+
+  EXPECT_EQ(expected.size(), frontier.size());
+  EXPECT_TRUE(expected == frontier);
+}
+
+}  // namespace similarity